@@ -48,6 +48,60 @@ DEFINE_ENUM(BLOB_RESULT, BLOB_RESULT_VALUES)
 */
 MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadFromSasUri,const char*, SASURI, const unsigned char*, source, size_t, size, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse)
 
+/**
+* @brief	Called by Blob_UploadMultipleBlocksFromSasUri to read the next part of the data
+*
+* @param	context		    The context passed to Blob_UploadMultipleBlocksFromSasUri
+* @param	buffer		    Where to write the data
+* @param	size		    The number of bytes available in @p buffer
+* @param    bytesRead       Receives the number of bytes written to @p buffer (at most @p size). 0 means the data has ended
+*
+* @return	0 on success, any other value aborts the upload
+*/
+typedef int(*BLOB_UPLOAD_READ_CALLBACK)(void* context, unsigned char* buffer, size_t size, size_t* bytesRead);
+
+/**
+* @brief	Called by Blob_UploadMultipleBlocksFromSasUri every time the uploaded blocks form a longer run from the first block
+*
+* @param	context		    The progressContext passed to Blob_UploadMultipleBlocksFromSasUri
+* @param	blockCount	    The number of blocks uploaded so far, counting the blocks skipped with firstBlockID
+* @param	uploadedSize    The number of bytes uploaded so far by this call
+*/
+typedef void(*BLOB_UPLOAD_PROGRESS_CALLBACK)(void* context, unsigned int blockCount, size_t uploadedSize);
+
+/**
+* @brief	Synchronously uploads to blob storage the data produced by a read callback, one block (1MB to 4MB) at a time
+*
+* @details  Up to @p concurrency blocks are uploaded at the same time, each over its own connection, so at most
+*           2 * @p concurrency blocks are held in memory. The block size starts from @p sizeHint and adapts to the
+*           measured upload time of each block. The block list is committed in order once every block has completed.
+*
+* @param	SASURI	        The URI to use to upload data
+* @param	readCallback    The callback producing the data, called until it reports 0 bytes read. It is only called from the calling thread
+* @param	context		    A pointer passed back to @p readCallback
+* @param	concurrency	    The number of blocks uploaded at the same time (1 to 8)
+* @param	sizeHint	    The total size of the data if known, 0 otherwise
+* @param	firstBlockID    The ID of the first block to upload. Blocks 0 to @p firstBlockID - 1 must already be uploaded (see Blob_GetUploadedBlocks)
+* @param	progressCallback    Optional callback reporting the blocks uploaded so far. It is only called from the calling thread
+* @param	progressContext	    A pointer passed back to @p progressCallback
+* @param    httpStatus      A pointer to an out argument receiving the HTTP status (available only when the return value is BLOB_OK)
+* @param    httpResponse    A BUFFER_HANDLE that receives the HTTP response from the server (available only when the return value is BLOB_OK)
+*
+* @return	A @c BLOB_RESULT. BLOB_OK means the blob has been uploaded successfully. Any other value indicates an error
+*/
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadMultipleBlocksFromSasUri, const char*, SASURI, BLOB_UPLOAD_READ_CALLBACK, readCallback, void*, context, size_t, concurrency, size_t, sizeHint, unsigned int, firstBlockID, BLOB_UPLOAD_PROGRESS_CALLBACK, progressCallback, void*, progressContext, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse)
+
+/**
+* @brief	Queries blob storage for the blocks a previous Blob_UploadMultipleBlocksFromSasUri left uncommitted
+*
+* @param	SASURI	        The URI used by the interrupted upload
+* @param	blockCount	    Receives the number of consecutive uncommitted blocks starting at block 0
+* @param	uploadedSize    Receives the total size of these blocks
+*
+* @return	A @c BLOB_RESULT. BLOB_OK means @p blockCount and @p uploadedSize are valid. Any other value indicates an error
+*/
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_GetUploadedBlocks, const char*, SASURI, unsigned int*, blockCount, size_t*, uploadedSize)
+
 #ifdef __cplusplus
 }
 #endif
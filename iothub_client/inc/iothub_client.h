@@ -21,6 +21,7 @@ typedef struct IOTHUB_CLIENT_INSTANCE_TAG* IOTHUB_CLIENT_HANDLE;
 #endif // IOTHUB_CLIENT_INSTANCE
 
 #include "iothubtransport.h"
+#include "iothubtransport_pool.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -34,7 +35,8 @@ extern "C"
 
 #define IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES \
     FILE_UPLOAD_OK, \
-    FILE_UPLOAD_ERROR
+    FILE_UPLOAD_ERROR, \
+    FILE_UPLOAD_CANCELLED
 
     DEFINE_ENUM(IOTHUB_CLIENT_FILE_UPLOAD_RESULT, IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES)
         typedef void(*IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK)(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, void* userContextCallback);
@@ -86,6 +88,22 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_HANDLE, IoTHubClient_CreateWithTransport, TRANSPORT_HANDLE, transportHandle, const IOTHUB_CLIENT_CONFIG*, config);
 
+    /**
+    * @brief	Creates a IoT Hub client on one of the connections of a
+    * 			transport pool.
+    *
+    * @param	transportPoolHandle	TRANSPORT_POOL_HANDLE which spreads devices over several connections.
+    * @param	config	Pointer to an @c IOTHUB_CLIENT_CONFIG structure
+    *
+    *			The pool picks its least loaded transport, opening a new
+    *			connection when all are full. IoTHubClient_Destroy gives the
+    *			device back to the pool. This is a blocking call.
+    *
+    * @return	A non-NULL @c IOTHUB_CLIENT_HANDLE value that is used when
+    * 			invoking other functions for IoT Hub client and @c NULL on failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_HANDLE, IoTHubClient_CreateWithTransportPool, TRANSPORT_POOL_HANDLE, transportPoolHandle, const IOTHUB_CLIENT_CONFIG*, config);
+
     /**
     * @brief	Disposes of resources allocated by the IoT Hub client. This is a
     * 			blocking call.
@@ -112,6 +130,11 @@ extern "C"
     *			@b NOTE: The application behavior is undefined if the user calls
     *			the ::IoTHubClient_Destroy function from within any callback.
     *
+    *			On a shared transport the message is queued without waiting for
+    *			the transport lock and handed to the transport by its worker
+    *			thread. A failure to hand it over is then reported to
+    *			@p eventConfirmationCallback with IOTHUB_CLIENT_CONFIRMATION_ERROR.
+    *
     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
@@ -340,6 +363,17 @@ extern "C"
     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_UploadToBlobAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, destinationFileName, const unsigned char*, source, size_t, size, IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK, iotHubClientFileUploadCallback, void*, context);
+
+    /**
+    * @brief	IoTHubClient_CancelUploadToBlobAsync cancels the uploads to @p destinationFileName that are still waiting for an upload worker.
+    *           Their callbacks are invoked with FILE_UPLOAD_CANCELLED. An upload that has already started runs to completion.
+    *
+    * @param	iotHubClientHandle	                The handle created by a call to the IoTHubClient_Create function.
+    * @param	destinationFileName	                The name of the file passed to IoTHubClient_UploadToBlobAsync.
+    *
+    * @return	IOTHUB_CLIENT_OK if at least one upload was cancelled or an error code otherwise.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_CancelUploadToBlobAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, destinationFileName);
 #endif
 #ifdef __cplusplus
 }
@@ -169,6 +169,8 @@ extern "C"
     typedef void(*IOTHUB_CLIENT_REPORTED_STATE_CALLBACK)(int status_code, void* userContextCallback);
     typedef int(*IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC)(const char* method_name, const unsigned char* payload, size_t size, unsigned char** response, size_t* response_size, void* userContextCallback);
     typedef int(*IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK)(const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id, void* userContextCallback);
+    typedef int(*IOTHUB_CLIENT_FILE_UPLOAD_READ_CALLBACK)(void* context, unsigned char* buffer, size_t size, size_t* bytesRead);
+    typedef void(*IOTHUB_CLIENT_FILE_UPLOAD_JOURNAL_CALLBACK)(const char* journal, void* context);
 
     /** @brief	This struct captures IoTHub client configuration. */
     typedef struct IOTHUB_CLIENT_CONFIG_TAG
@@ -517,6 +519,23 @@ extern "C"
      */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetDeviceMethodCallback_Ex, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK, inboundDeviceMethodCallback, void*, userContextCallback);
 
+     /**
+     * @brief	This API registers a callback for a single cloud to device method. Registered
+     *          handlers take precedence over the device method callback; once any handler is
+     *          registered, methods without a handler are answered with status 501 unless a
+     *          device method callback is also set.
+     *
+     * @param	iotHubClientHandle		The handle created by a call to the create function.
+     * @param	method_name		        The name of the method handled by methodCallback.
+     * @param	methodCallback	        The callback which will be called by IoTHub. @c NULL
+     *                                  removes the handler registered for method_name.
+     * @param	userContextCallback		User specified context that will be provided to the
+     * 									callback. This can be @c NULL.
+     *
+     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+     */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_RegisterMethodHandler, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, method_name, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, methodCallback, void*, userContextCallback);
+
 
      /**
      * @brief	This API responses to a asnyc method callback identified the methodId.
@@ -545,6 +564,47 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_UploadToBlob, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, destinationFileName, const unsigned char*, source, size_t, size);
 
+    /**
+    * @brief	This API uploads to Azure Storage the data produced by @p readCallback under the blob
+    *           name devicename/@p destinationFileName, one 4MB block at a time, so the whole file
+    *           never needs to be in memory.
+    *
+    * @param	iotHubClientHandle	    The handle created by a call to the create function.
+    * @param	destinationFileName     name of the file.
+    * @param	readCallback            called repeatedly to fill a buffer with the next bytes of the file;
+    *                                  it reports 0 bytes read at the end of the file and returns non-zero to abort.
+    * @param    context                 a pointer passed back to @p readCallback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_UploadMultipleBlocksToBlob, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_READ_CALLBACK, readCallback, void*, context);
+
+    /**
+    * @brief	This API works as @c IoTHubClient_LL_UploadMultipleBlocksToBlob, and keeps a journal
+    *           of the upload so an interrupted upload can be resumed instead of restarted.
+    *
+    * @details  The journal is a JSON string holding the SAS URI of the blob, its expiry, the correlation
+    *           id of the upload and the number of blocks already uploaded. It is handed to @p journalCallback
+    *           after the SAS URI is obtained and after every uploaded block; the application persists it
+    *           and passes it back as @p journal to resume. The blocks already in storage are queried from
+    *           the storage service, so a journal that is behind only costs some blocks being uploaded again.
+    *           @p journalCallback receives NULL once the blob is committed, when the journal can be deleted.
+    *           A journal for another file or whose SAS URI is about to expire starts a new upload.
+    *
+    * @param	iotHubClientHandle	    The handle created by a call to the create function.
+    * @param	destinationFileName     name of the file.
+    * @param	readCallback            called repeatedly to fill a buffer with the next bytes of the file, always
+    *                                  from the beginning of the file; when resuming, the bytes already uploaded are
+    *                                  read and discarded.
+    * @param    context                 a pointer passed back to @p readCallback.
+    * @param    journal                 the last journal received by @p journalCallback for this file, or NULL.
+    * @param    journalCallback         called with the journal to persist. It is called from the calling thread.
+    * @param    journalContext          a pointer passed back to @p journalCallback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_READ_CALLBACK, readCallback, void*, context, const char*, journal, IOTHUB_CLIENT_FILE_UPLOAD_JOURNAL_CALLBACK, journalCallback, void*, journalContext);
+
 #endif /*DONT_USE_UPLOADTOBLOB*/
 
 #ifdef __cplusplus
@@ -20,6 +20,12 @@ extern "C"
     static const char* OPTION_X509_CERT = "x509certificate";
     static const char* OPTION_X509_PRIVATE_KEY = "x509privatekey";
     static const char* OPTION_KEEP_ALIVE = "keepalive";
+    static const char* OPTION_TELEMETRY_QOS0 = "telemetry_qos0";
+    static const char* OPTION_CLEAN_SESSION = "clean_session";
+    static const char* OPTION_RESEND_MAX_COUNT = "resend_max_count";
+    static const char* OPTION_RESEND_TIMEOUT_MIN = "resend_timeout_min";
+    static const char* OPTION_RESEND_TIMEOUT_MAX = "resend_timeout_max";
+    static const char* OPTION_C2D_ZERO_COPY = "c2d_zero_copy";
 
     static const char* OPTION_PROXY_HOST = "proxy_address";
     static const char* OPTION_PROXY_USERNAME = "proxy_username";
@@ -28,9 +34,21 @@ extern "C"
     static const char* OPTION_SAS_TOKEN_LIFETIME = "sas_token_lifetime";
     static const char* OPTION_SAS_TOKEN_REFRESH_TIME = "sas_token_refresh_time";
     static const char* OPTION_CBS_REQUEST_TIMEOUT = "cbs_request_timeout";
+    static const char* OPTION_SAS_TOKEN_REFRESH_JITTER_PERCENT = "sas_token_refresh_jitter_percent";
+    static const char* OPTION_CBS_MAX_PENDING_PUT_TOKENS = "cbs_max_pending_put_tokens";
+    static const char* OPTION_BLOB_UPLOAD_CONCURRENCY = "blob_upload_concurrency";
+    static const char* OPTION_AMQP_INCOMING_WINDOW = "amqp_incoming_window";
+    static const char* OPTION_AMQP_OUTGOING_WINDOW = "amqp_outgoing_window";
+    static const char* OPTION_AMQP_RECEIVER_MAX_MESSAGE_SIZE = "amqp_receiver_max_message_size";
+    static const char* OPTION_AMQP_ADAPTIVE_OUTGOING_WINDOW = "amqp_adaptive_outgoing_window";
+    static const char* OPTION_AMQP_LINK_IDLE_TIMEOUT = "amqp_link_idle_timeout";
+    static const char* OPTION_AMQP_EVENT_BATCHING = "amqp_event_batching";
 
     static const char* OPTION_MIN_POLLING_TIME = "MinimumPollingTime";
     static const char* OPTION_BATCHING = "Batching";
+    static const char* OPTION_BATCH_PRESERVE_ORDER = "BatchPreserveOrder";
+    static const char* OPTION_ADAPTIVE_POLLING = "AdaptivePolling";
+    static const char* OPTION_POLL_AFTER_EVENT = "PollAfterEvent";
 
 #ifdef __cplusplus
 }
@@ -16,6 +16,11 @@
 #include "iothub_message.h"
 #include "iothub_client_ll.h"
 
+#ifndef IOTHUB_CLIENT_INSTANCE_TYPE
+typedef struct IOTHUB_CLIENT_INSTANCE_TAG* IOTHUB_CLIENT_HANDLE;
+#define IOTHUB_CLIENT_INSTANCE_TYPE
+#endif // IOTHUB_CLIENT_INSTANCE
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -38,6 +43,13 @@ MOCKABLE_FUNCTION(, IOTHUBMESSAGE_DISPOSITION_RESULT, IoTHubClient_LL_MessageCal
 MOCKABLE_FUNCTION(, void, IoTHubClient_LL_RetrievePropertyComplete, IOTHUB_CLIENT_LL_HANDLE, handle, DEVICE_TWIN_UPDATE_STATE, update_state, const unsigned char*, payLoad, size_t, size);
 MOCKABLE_FUNCTION(, int, IoTHubClient_LL_DeviceMethodComplete, IOTHUB_CLIENT_LL_HANDLE, handle, const char*, method_name, const unsigned char*, payLoad, size_t, size, METHOD_HANDLE, response_id);
 MOCKABLE_FUNCTION(, void, IotHubClient_LL_ConnectionStatusCallBack, IOTHUB_CLIENT_LL_HANDLE, handle, IOTHUB_CLIENT_CONNECTION_STATUS, status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON, reason);
+/*same as IoTHubClient_LL_SendEventAsync, except that the message is queued as is instead of cloned: on success the LL layer owns (and eventually destroys) eventMessageHandle*/
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsyncTakeOwnership, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+/*hands the events queued by IoTHubClient_SendEventAsync on a shared transport to the LL layer, called by the transport worker thread with the transport lock held.
+Not MOCKABLE: the IoTHubClient unit tests include this header with mocks enabled and link the real function*/
+extern void IoTHubClient_ProcessSubmissions(IOTHUB_CLIENT_HANDLE iotHubClientHandle);
+
 typedef struct IOTHUB_MESSAGE_LIST_TAG
 {
     IOTHUB_MESSAGE_HANDLE messageHandle;
@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_submission_queue.h
+*	@brief Lock-free multi-producer, single-consumer queue.
+*
+*	@details Any thread can push a node without taking a lock; one thread
+*			 takes all the queued nodes at once, in the order they were pushed.
+*			 Nodes are intrusive: embed a SUBMISSION_QUEUE_NODE as the first
+*			 member of the queued structure. The queue does not allocate.
+*/
+
+#ifndef IOTHUB_CLIENT_SUBMISSION_QUEUE_H
+#define IOTHUB_CLIENT_SUBMISSION_QUEUE_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct SUBMISSION_QUEUE_NODE_TAG
+{
+    struct SUBMISSION_QUEUE_NODE_TAG* next;
+} SUBMISSION_QUEUE_NODE;
+
+typedef struct SUBMISSION_QUEUE_TAG
+{
+    /*last pushed node, only changed with an atomic compare and swap*/
+    SUBMISSION_QUEUE_NODE* volatile head;
+} SUBMISSION_QUEUE;
+
+/**
+* @brief	Makes @p queue empty. Not thread safe, call it before sharing the queue.
+*/
+MOCKABLE_FUNCTION(, void, submission_queue_init, SUBMISSION_QUEUE*, queue);
+
+/**
+* @brief	Adds @p node to @p queue. Safe to call from any number of threads at once.
+*/
+MOCKABLE_FUNCTION(, void, submission_queue_push, SUBMISSION_QUEUE*, queue, SUBMISSION_QUEUE_NODE*, node);
+
+/**
+* @brief	Empties @p queue. Only one thread at a time may call it.
+*
+* @return	The queued nodes linked by @c next, oldest first, or @c NULL if the queue was empty.
+*/
+MOCKABLE_FUNCTION(, SUBMISSION_QUEUE_NODE*, submission_queue_take_all, SUBMISSION_QUEUE*, queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_SUBMISSION_QUEUE_H */
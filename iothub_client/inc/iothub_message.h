@@ -68,9 +68,30 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromByteArray, co
  */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromString, const char*, source);
 
+/**
+ * @brief   Creates a new IoT hub message that references (does not copy) a
+ *          byte array. The type of the message will be set to
+ *          @c IOTHUBMESSAGE_BYTEARRAY.
+ *
+ *          The bytes must stay valid and unchanged for the lifetime of the
+ *          message. Transports use this to hand received payloads to the
+ *          message callback without copying them; such a message is only
+ *          valid for the duration of the callback. Use
+ *          @c IoTHubMessage_Clone to retain the content beyond that.
+ *
+ * @param   byteArray   The byte array referenced by the message.
+ * @param   size        The size of the byte array.
+ *
+ * @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+ *          created or @c NULL in case an error occurs.
+ */
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromByteArrayView, const unsigned char*, byteArray, size_t, size);
+
 /**
  * @brief   Creates a new IoT hub message with the content identical to that
- *          of the @p iotHubMessageHandle parameter.
+ *          of the @p iotHubMessageHandle parameter. The new message always
+ *          owns a copy of the content, even when @p iotHubMessageHandle
+ *          is a view created by @c IoTHubMessage_CreateFromByteArrayView.
  *
  * @param   iotHubMessageHandle Handle to the message that is to be cloned.
  *
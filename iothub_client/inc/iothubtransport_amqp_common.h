@@ -4,6 +4,7 @@
 #ifndef IOTHUBTRANSPORTAMQP_COMMON_H
 #define IOTHUBTRANSPORTAMQP_COMMON_H
 
+#include <stdint.h>
 #include "azure_c_shared_utility/strings.h"
 #include "iothub_transport_ll.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
@@ -15,6 +16,18 @@ extern "C"
 
 typedef XIO_HANDLE(*AMQP_GET_IO_TRANSPORT)(const char* target_fqdn);
 
+typedef struct IOTHUB_AMQP_CBS_STATISTICS_TAG
+{
+    size_t putTokensSent;       /*put-token requests sent to CBS (authentications and SAS token refreshes)*/
+    size_t putTokensCompleted;  /*answered by CBS*/
+    size_t putTokensFailed;     /*answered with an error, or timed out*/
+    size_t putTokensPending;    /*waiting for an answer right now*/
+    size_t putTokensDeferred;   /*times a device had to wait because "cbs_max_pending_put_tokens" were pending; each wait counts once*/
+    uint64_t lastLatencyMs;     /*time CBS took to answer the last request*/
+    uint64_t maxLatencyMs;
+    uint64_t averageLatencyMs;
+} IOTHUB_AMQP_CBS_STATISTICS;
+
 MOCKABLE_FUNCTION(, TRANSPORT_LL_HANDLE, IoTHubTransport_AMQP_Common_Create, const IOTHUBTRANSPORT_CONFIG*, config, AMQP_GET_IO_TRANSPORT, get_io_transport);
 MOCKABLE_FUNCTION(, void, IoTHubTransport_AMQP_Common_Destroy, TRANSPORT_LL_HANDLE, handle);
 MOCKABLE_FUNCTION(, int, IoTHubTransport_AMQP_Common_Subscribe, IOTHUB_DEVICE_HANDLE, handle);
@@ -33,6 +46,12 @@ MOCKABLE_FUNCTION(, IOTHUB_DEVICE_HANDLE, IoTHubTransport_AMQP_Common_Register,
 MOCKABLE_FUNCTION(, void, IoTHubTransport_AMQP_Common_Unregister, IOTHUB_DEVICE_HANDLE, deviceHandle);
 MOCKABLE_FUNCTION(, STRING_HANDLE, IoTHubTransport_AMQP_Common_GetHostname, TRANSPORT_LL_HANDLE, handle);
 
+/**
+* @brief	Copies the put-token counters and latencies of the CBS connection shared by the devices of the transport.
+*			Call it from the thread calling DoWork (or holding the lock of a shared transport).
+*/
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubTransport_AMQP_Common_GetCbsStatistics, TRANSPORT_LL_HANDLE, handle, IOTHUB_AMQP_CBS_STATISTICS*, statistics);
+
 #ifdef __cplusplus
 }
 #endif
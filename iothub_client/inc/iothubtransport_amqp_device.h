@@ -20,6 +20,9 @@ extern "C"
 // @brief    name of option to apply the instance obtained using device_retrieve_options
 static const char* DEVICE_OPTION_SAVED_OPTIONS = "saved_device_options";
 static const char* DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS = "event_send_timeout_secs";
+static const char* DEVICE_OPTION_EVENT_BATCHING = "event_batching";
+static const char* DEVICE_OPTION_C2D_ZERO_COPY = "c2d_zero_copy";
+static const char* DEVICE_OPTION_RECEIVER_MAX_MESSAGE_SIZE = "amqp_receiver_max_message_size";
 static const char* DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS = "cbs_request_timeout_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS = "sas_token_refresh_time_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_LIFETIME_SECS = "sas_token_lifetime_secs";
@@ -16,6 +16,9 @@ extern "C"
 
 
 static const char* MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS = "event_send_timeout_secs";
+static const char* MESSENGER_OPTION_EVENT_BATCHING = "event_batching";
+static const char* MESSENGER_OPTION_C2D_ZERO_COPY = "c2d_zero_copy";
+static const char* MESSENGER_OPTION_RECEIVER_MAX_MESSAGE_SIZE = "amqp_receiver_max_message_size";
 static const char* MESSENGER_OPTION_SAVED_OPTIONS = "saved_messenger_options";
 
 typedef struct MESSENGER_INSTANCE* MESSENGER_HANDLE;
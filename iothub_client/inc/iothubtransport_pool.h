@@ -0,0 +1,67 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothubtransport_pool.h
+*	@brief Spreads devices over several shared transports.
+*
+*	@details A TRANSPORT_HANDLE gives one connection, one lock and one worker
+*			 thread to all the devices created on it. A transport pool owns up
+*			 to @c maxTransports of them and hands out the least loaded one to
+*			 each new device, opening a new connection once every transport
+*			 has @c devicesPerTransport devices. Each transport keeps its own
+*			 worker thread, so a gateway with many devices uses several
+*			 connections and cores.
+*/
+
+#ifndef IOTHUBTRANSPORT_POOL_H
+#define IOTHUBTRANSPORT_POOL_H
+
+#include <stddef.h>
+#include "iothubtransport.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct TRANSPORT_POOL_INSTANCE_TAG* TRANSPORT_POOL_HANDLE;
+
+/**
+* @brief	Creates an empty pool. Transports are created as devices are added.
+*
+* @param	devicesPerTransport	Devices a transport takes before the pool opens another one.
+* @param	maxTransports	Transports the pool opens at most; once all are open, devices go to the least loaded one.
+*
+* @return	A non-NULL @c TRANSPORT_POOL_HANDLE on success, @c NULL on failure.
+*/
+MOCKABLE_FUNCTION(, TRANSPORT_POOL_HANDLE, IoTHubTransportPool_Create, IOTHUB_CLIENT_TRANSPORT_PROVIDER, protocol, const char*, iotHubName, const char*, iotHubSuffix, size_t, devicesPerTransport, size_t, maxTransports);
+
+/**
+* @brief	Destroys all the transports of the pool. Destroy the clients using them first.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubTransportPool_Destroy, TRANSPORT_POOL_HANDLE, poolHandle);
+
+/**
+* @brief	Picks the transport a new device shall use and counts the device on it.
+*
+* @return	The least loaded transport, a new one if all are full and the pool is not, or @c NULL on failure.
+*/
+MOCKABLE_FUNCTION(, TRANSPORT_HANDLE, IoTHubTransportPool_AcquireTransport, TRANSPORT_POOL_HANDLE, poolHandle);
+
+/**
+* @brief	Stops counting a device on the transport returned by IoTHubTransportPool_AcquireTransport.
+*			The transport stays open until the pool is destroyed.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubTransportPool_ReleaseTransport, TRANSPORT_POOL_HANDLE, poolHandle, TRANSPORT_HANDLE, transportHandle);
+
+/**
+* @brief	Gets how many transports (connections) the pool opened so far.
+*/
+MOCKABLE_FUNCTION(, size_t, IoTHubTransportPool_GetTransportCount, TRANSPORT_POOL_HANDLE, poolHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUBTRANSPORT_POOL_H */
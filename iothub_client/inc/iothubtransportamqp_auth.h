@@ -34,6 +34,21 @@ typedef struct AMQP_TRANSPORT_CBS_CONNECTION_TAG
 	SASL_MECHANISM_HANDLE sasl_mechanism;
 	// Connection instance with the Azure IoT CBS.
 	CBS_HANDLE cbs_handle;
+
+	// Share of sas_token_refresh_time, in percent, by which each SAS token refresh is randomly brought forward (0 disables it).
+	size_t sas_token_refresh_jitter_percent;
+	// Put-token requests sent to CBS that did not complete yet.
+	size_t pending_put_tokens;
+	// Put-token requests sent to CBS since the transport was created.
+	size_t put_tokens_sent;
+	// Put-token requests CBS answered.
+	size_t put_tokens_completed;
+	// Put-token requests CBS answered with an error, or that timed out.
+	size_t put_tokens_failed;
+	// Time CBS took to complete the last put-token request, the longest one and the sum of all of them, in milliseconds.
+	uint64_t last_put_token_latency;
+	uint64_t max_put_token_latency;
+	uint64_t total_put_token_latency;
 } AMQP_TRANSPORT_CBS_CONNECTION;
 
 typedef struct AUTHENTICATION_CONFIG_TAG
@@ -42,7 +57,7 @@ typedef struct AUTHENTICATION_CONFIG_TAG
 	const char* device_key;
 	const char* device_sas_token;
 	const char* iot_hub_host_fqdn;
-	const AMQP_TRANSPORT_CBS_CONNECTION* cbs_connection;
+	AMQP_TRANSPORT_CBS_CONNECTION* cbs_connection;
 
 } AUTHENTICATION_CONFIG;
 
@@ -11,8 +11,37 @@ extern "C"
 {
 #endif
 
+	typedef struct IOTHUB_HTTP_POLL_STATISTICS_TAG
+	{
+		size_t polls;                 /*GET requests that got an answer from the service*/
+		size_t emptyPolls;            /*answered with 204, no message*/
+		size_t messagesReceived;      /*answered with 200*/
+		size_t pollsAfterEvent;       /*GETs issued right after an event POST ("PollAfterEvent")*/
+		unsigned int pollingInterval; /*seconds between 2 GETs currently applied to the device*/
+	} IOTHUB_HTTP_POLL_STATISTICS;
+
 	extern const TRANSPORT_PROVIDER* HTTP_Protocol(void);
 
+	/*
+	* IoTHubTransportHttp_GetPollStatistics and IoTHubTransportHttp_GetSasTokenCount need the TRANSPORT_LL_HANDLE of the
+	* transport. Only an application that creates the transport itself can get it: with IoTHubTransport_Create and
+	* IoTHubTransport_GetLLTransport, or by creating the lower layer transport it gives to IoTHubClient_LL_CreateWithTransport.
+	* A client created with IoTHubClient_CreateFromConnectionString, IoTHubClient_Create or their _LL_ versions owns a
+	* private transport, and these statistics are not available to it.
+	*/
+
+	/**
+	* @brief	Copies the C2D poll statistics of a device registered with the HTTP transport.
+	*			Call it from the thread calling DoWork (or holding the lock of a shared transport).
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetPollStatistics(TRANSPORT_LL_HANDLE handle, const char* deviceId, IOTHUB_HTTP_POLL_STATISTICS* statistics);
+
+	/**
+	* @brief	Gets how many SAS tokens the transport generated for a device authenticated with a device key.
+	*			Tokens are reused until they are "sas_token_refresh_time" old, so this grows slowly.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetSasTokenCount(TRANSPORT_LL_HANDLE handle, const char* deviceId, size_t* generatedCount);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,9 +8,551 @@
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
 
 /*a block has 4MB*/
 #define BLOCK_SIZE (4*1024*1024)
+/*a block blob can have at most 50000 committed blocks*/
+#define MAXIMUM_BLOCK_COUNT 50000
+/*Blob_UploadMultipleBlocksFromSasUri adapts the block size between MINIMUM_BLOCK_SIZE and BLOCK_SIZE*/
+#define MINIMUM_BLOCK_SIZE (1024*1024)
+/*a block taking longer than this to upload halves the size of the next blocks, one taking less than a quarter of it doubles it*/
+#define TARGET_BLOCK_UPLOAD_TIME_MS 8000
+#define MAXIMUM_UPLOAD_CONCURRENCY 8
+
+/*one block being uploaded by Blob_UploadMultipleBlocksFromSasUri, each over its own connection*/
+typedef struct BLOCK_UPLOAD_TAG
+{
+    HTTPAPIEX_HANDLE httpApiExHandle;
+    const char* relativePath;
+    TICK_COUNTER_HANDLE tickCounter;
+    THREAD_HANDLE thread;
+    int isPending;                  /*the block has been handed to uploadBlock and its result is not collected yet*/
+    unsigned char* block;
+    size_t blockSize;
+    unsigned int blockID;
+    BLOB_RESULT result;
+    unsigned int httpStatus;
+    BUFFER_HANDLE httpResponse;
+    tickcounter_ms_t uploadTime;
+} BLOCK_UPLOAD;
+
+/*finds the hostname and the relative path in SASURI and returns a malloc'd copy of the hostname*/
+static BLOB_RESULT Blob_ParseSasUri(const char* SASURI, char** hostname, const char** relativePath)
+{
+    BLOB_RESULT result;
+    /*to find the hostname, the following logic is applied:*/
+    /*the hostname starts at the first character after "://"*/
+    /*the hostname ends at the first character before the next "/" after "://"*/
+    const char* hostnameBegin = strstr(SASURI, "://");
+    if (hostnameBegin == NULL)
+    {
+        /*Codes_SRS_BLOB_02_005: [ If the hostname cannot be determined, then Blob_UploadFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+        LogError("hostname cannot be determined");
+        result = BLOB_INVALID_ARG;
+    }
+    else
+    {
+        hostnameBegin += 3; /*have to skip 3 characters which are "://"*/
+        const char* hostnameEnd = strchr(hostnameBegin, '/');
+        if (hostnameEnd == NULL)
+        {
+            /*Codes_SRS_BLOB_02_005: [ If the hostname cannot be determined, then Blob_UploadFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+            LogError("hostname cannot be determined");
+            result = BLOB_INVALID_ARG;
+        }
+        else
+        {
+            size_t hostnameSize = hostnameEnd - hostnameBegin;
+            *hostname = (char*)malloc(hostnameSize + 1); /*+1 because of '\0' at the end*/
+            if (*hostname == NULL)
+            {
+                /*Codes_SRS_BLOB_02_016: [ If the hostname copy cannot be made then then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+                LogError("oom - out of memory");
+                result = BLOB_ERROR;
+            }
+            else
+            {
+                (void)memcpy(*hostname, hostnameBegin, hostnameSize);
+                (*hostname)[hostnameSize] = '\0';
+
+                /*Codes_SRS_BLOB_02_008: [ Blob_UploadFromSasUri shall compute the relative path of the request from the SASURI parameter. ]*/
+                /*Codes_SRS_BLOB_02_019: [ Blob_UploadFromSasUri shall compute the base relative path of the request from the SASURI parameter. ]*/
+                *relativePath = hostnameEnd; /*this is where the relative path begins in the SasUri*/
+                result = BLOB_OK;
+            }
+        }
+    }
+    return result;
+}
+
+/*uploads source/size as the whole blob in one Put Blob request*/
+static BLOB_RESULT Blob_UploadSingleRequest(HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, const unsigned char* source, size_t size, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+{
+    BLOB_RESULT result;
+    /*Codes_SRS_BLOB_02_010: [ Blob_UploadFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
+    BUFFER_HANDLE requestBuffer = BUFFER_create(source, size);
+    if (requestBuffer == NULL)
+    {
+        /*Codes_SRS_BLOB_02_011: [ If any of the previous steps related to building the HTTPAPI_EX_ExecuteRequest parameters fails, then Blob_UploadFromSasUri shall fail and return BLOB_ERROR. ]*/
+        LogError("unable to BUFFER_create");
+        result = BLOB_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_BLOB_02_009: [ Blob_UploadFromSasUri shall create an HTTP_HEADERS_HANDLE for the request HTTP headers carrying the following headers: ]*/
+        HTTP_HEADERS_HANDLE requestHttpHeaders = HTTPHeaders_Alloc();
+        if (requestHttpHeaders == NULL)
+        {
+            /*Codes_SRS_BLOB_02_011: [ If any of the previous steps related to building the HTTPAPI_EX_ExecuteRequest parameters fails, then Blob_UploadFromSasUri shall fail and return BLOB_ERROR. ]*/
+            LogError("unable to HTTPHeaders_Alloc");
+            result = BLOB_ERROR;
+        }
+        else
+        {
+            if (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "x-ms-blob-type", "BlockBlob") != HTTP_HEADERS_OK)
+            {
+                /*Codes_SRS_BLOB_02_011: [ If any of the previous steps related to building the HTTPAPI_EX_ExecuteRequest parameters fails, then Blob_UploadFromSasUri shall fail and return BLOB_ERROR. ]*/
+                LogError("unable to HTTPHeaders_AddHeaderNameValuePair");
+                result = BLOB_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BLOB_02_012: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest passing the parameters previously build, httpStatus and httpResponse ]*/
+                if (HTTPAPIEX_ExecuteRequest(httpApiExHandle, HTTPAPI_REQUEST_PUT, relativePath, requestHttpHeaders, requestBuffer, httpStatus, NULL, httpResponse) != HTTPAPIEX_OK)
+                {
+                    /*Codes_SRS_BLOB_02_013: [ If HTTPAPIEX_ExecuteRequest fails, then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
+                    LogError("failed to HTTPAPIEX_ExecuteRequest");
+                    result = BLOB_HTTP_ERROR;
+                }
+                else
+                {
+                    /*Codes_SRS_BLOB_02_015: [ Otherwise, HTTPAPIEX_ExecuteRequest shall succeed and return BLOB_OK. ]*/
+                    result = BLOB_OK;
+                }
+            }
+            HTTPHeaders_Free(requestHttpHeaders);
+        }
+        BUFFER_delete(requestBuffer);
+    }
+    return result;
+}
+
+/*uploads one block (Put Block) and appends its ID to the block list XML, if any. When the result is BLOB_OK the caller shall still check httpStatus*/
+static BLOB_RESULT Blob_UploadBlock(HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, unsigned int blockID, const unsigned char* blockData, size_t blockSize, STRING_HANDLE xml, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+{
+    BLOB_RESULT result;
+    /*Codes_SRS_BLOB_02_020: [ Blob_UploadFromSasUri shall construct a BASE64 encoded string from the block ID (000000... 0499999) ]*/
+    char temp[7]; /*this will contain 000000... 049999*/
+    if (sprintf(temp, "%6u", (unsigned int)blockID) != 6) /*produces 000000... 049999*/
+    {
+        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+        LogError("failed to sprintf");
+        result = BLOB_ERROR;
+    }
+    else
+    {
+        STRING_HANDLE blockIdString = Base64_Encode_Bytes((const unsigned char*)temp, 6);
+        if (blockIdString == NULL)
+        {
+            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+            LogError("unable to Base64_Encode_Bytes");
+            result = BLOB_ERROR;
+        }
+        else
+        {
+            /*add the blockId base64 encoded to the XML*/
+            if (
+                (xml != NULL) && /*Blob_UploadMultipleBlocksFromSasUri builds the list itself, once all blocks have completed*/
+                !(
+                (STRING_concat(xml, "<Latest>")==0) &&
+                (STRING_concat_with_STRING(xml, blockIdString)==0) &&
+                (STRING_concat(xml, "</Latest>") == 0)
+                ))
+            {
+                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+                LogError("unable to STRING_concat");
+                result = BLOB_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BLOB_02_022: [ Blob_UploadFromSasUri shall construct a new relativePath from following string: base relativePath + "&comp=block&blockid=BASE64 encoded string of blockId" ]*/
+                STRING_HANDLE newRelativePath = STRING_construct(relativePath);
+                if (newRelativePath == NULL)
+                {
+                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+                    LogError("unable to STRING_construct");
+                    result = BLOB_ERROR;
+                }
+                else
+                {
+                    if (!(
+                        (STRING_concat(newRelativePath, "&comp=block&blockid=") == 0) &&
+                        (STRING_concat_with_STRING(newRelativePath, blockIdString) == 0)
+                        ))
+                    {
+                        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+                        LogError("unable to STRING concatenate");
+                        result = BLOB_ERROR;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_BLOB_02_023: [ Blob_UploadFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
+                        BUFFER_HANDLE requestContent = BUFFER_create(blockData, blockSize);
+                        if (requestContent == NULL)
+                        {
+                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+                            LogError("unable to BUFFER_create");
+                            result = BLOB_ERROR;
+                        }
+                        else
+                        {
+                            /*Codes_SRS_BLOB_02_024: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing httpStatus and httpResponse. ]*/
+                            if (HTTPAPIEX_ExecuteRequest(
+                                httpApiExHandle,
+                                HTTPAPI_REQUEST_PUT,
+                                STRING_c_str(newRelativePath),
+                                NULL,
+                                requestContent,
+                                httpStatus,
+                                NULL,
+                                httpResponse) != HTTPAPIEX_OK
+                                )
+                            {
+                                /*Codes_SRS_BLOB_02_025: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
+                                LogError("unable to HTTPAPIEX_ExecuteRequest");
+                                result = BLOB_HTTP_ERROR;
+                            }
+                            else
+                            {
+                                result = BLOB_OK;
+                            }
+                            BUFFER_delete(requestContent);
+                        }
+                    }
+                    STRING_delete(newRelativePath);
+                }
+            }
+            STRING_delete(blockIdString);
+        }
+    }
+    return result;
+}
+
+/*completes the block list XML and commits it (Put Block List)*/
+static BLOB_RESULT Blob_UploadBlockList(HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, STRING_HANDLE xml, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+{
+    BLOB_RESULT result;
+    /*complete the XML*/
+    if (STRING_concat(xml, "</BlockList>") != 0)
+    {
+        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+        LogError("failed to STRING_concat");
+        result = BLOB_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_BLOB_02_029: [Blob_UploadFromSasUri shall construct a new relativePath from following string : base relativePath + "&comp=blocklist"]*/
+        STRING_HANDLE newRelativePath = STRING_construct(relativePath);
+        if (newRelativePath == NULL)
+        {
+            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+            LogError("failed to STRING_construct");
+            result = BLOB_ERROR;
+        }
+        else
+        {
+            if (STRING_concat(newRelativePath, "&comp=blocklist") != 0)
+            {
+                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+                LogError("failed to STRING_concat");
+                result = BLOB_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BLOB_02_030: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing the new relativePath, httpStatus and httpResponse and the XML string as content. ]*/
+                const char* s = STRING_c_str(xml);
+                BUFFER_HANDLE xmlAsBuffer = BUFFER_create((const unsigned char*)s, strlen(s));
+                if (xmlAsBuffer == NULL)
+                {
+                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+                    LogError("failed to BUFFER_create");
+                    result = BLOB_ERROR;
+                }
+                else
+                {
+                    if (HTTPAPIEX_ExecuteRequest(
+                        httpApiExHandle,
+                        HTTPAPI_REQUEST_PUT,
+                        STRING_c_str(newRelativePath),
+                        NULL,
+                        xmlAsBuffer,
+                        httpStatus,
+                        NULL,
+                        httpResponse
+                    ) != HTTPAPIEX_OK)
+                    {
+                        /*Codes_SRS_BLOB_02_031: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
+                        LogError("unable to HTTPAPIEX_ExecuteRequest");
+                        result = BLOB_HTTP_ERROR;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_BLOB_02_032: [ Otherwise, Blob_UploadFromSasUri shall succeed and return BLOB_OK. ]*/
+                        result = BLOB_OK;
+                    }
+                    BUFFER_delete(xmlAsBuffer);
+                }
+            }
+            STRING_delete(newRelativePath);
+        }
+    }
+    return result;
+}
+
+/*fills block with up to maxSize bytes from readCallback. *blockSize is less than maxSize only when the data has ended*/
+static int Blob_ReadBlock(BLOB_UPLOAD_READ_CALLBACK readCallback, void* context, unsigned char* block, size_t maxSize, size_t* blockSize)
+{
+    int result = 0;
+    *blockSize = 0;
+    while (*blockSize < maxSize)
+    {
+        size_t bytesRead = 0;
+        if (readCallback(context, block + *blockSize, maxSize - *blockSize, &bytesRead) != 0)
+        {
+            /*Codes_SRS_BLOB_21_006: [ If readCallback returns non-zero then Blob_UploadMultipleBlocksFromSasUri shall stop, shall not commit the block list and shall return BLOB_ERROR. ]*/
+            LogError("read callback failed after %zu bytes of the block", *blockSize);
+            result = __FAILURE__;
+            break;
+        }
+        else if (bytesRead > maxSize - *blockSize)
+        {
+            LogError("read callback returned %zu bytes, more than the %zu requested", bytesRead, maxSize - *blockSize);
+            result = __FAILURE__;
+            break;
+        }
+        else if (bytesRead == 0)
+        {
+            /*end of data*/
+            break;
+        }
+        else
+        {
+            *blockSize += bytesRead;
+        }
+    }
+    return result;
+}
+
+/*picks the first block size: small enough that every connection gets a couple of blocks, big enough to stay under 50000 blocks*/
+static size_t Blob_GetInitialBlockSize(size_t sizeHint, size_t concurrency)
+{
+    size_t result;
+    if (sizeHint == 0)
+    {
+        result = BLOCK_SIZE;
+    }
+    else
+    {
+        size_t perConnection = sizeHint / (concurrency * 2);
+        result = MINIMUM_BLOCK_SIZE;
+        while ((result < BLOCK_SIZE) &&
+            ((result < perConnection) || (sizeHint / result >= MAXIMUM_BLOCK_COUNT)))
+        {
+            result *= 2;
+        }
+    }
+    return result;
+}
+
+/*Codes_SRS_BLOB_21_012: [ Blob_UploadMultipleBlocksFromSasUri shall halve the size of the next blocks when a full block took longer than 8 seconds to upload, and double it when it took less than 2 seconds, keeping it between 1MB and 4MB. ]*/
+static size_t Blob_AdaptBlockSize(size_t blockSize, const BLOCK_UPLOAD* completed)
+{
+    size_t result = blockSize;
+    if (completed->blockSize == blockSize) /*only full blocks say something about the link*/
+    {
+        if ((completed->uploadTime > TARGET_BLOCK_UPLOAD_TIME_MS) &&
+            (blockSize > MINIMUM_BLOCK_SIZE) &&
+            (completed->blockID < MAXIMUM_BLOCK_COUNT / 2)) /*smaller blocks spend the block budget faster*/
+        {
+            result = blockSize / 2;
+        }
+        else if ((completed->uploadTime < TARGET_BLOCK_UPLOAD_TIME_MS / 4) &&
+            (blockSize < BLOCK_SIZE))
+        {
+            result = blockSize * 2;
+        }
+    }
+    return result;
+}
+
+static void uploadBlock(BLOCK_UPLOAD* upload)
+{
+    tickcounter_ms_t start;
+    tickcounter_ms_t end;
+    if (tickcounter_get_current_ms(upload->tickCounter, &start) != 0)
+    {
+        start = 0;
+    }
+    upload->result = Blob_UploadBlock(upload->httpApiExHandle, upload->relativePath, upload->blockID, upload->block, upload->blockSize, NULL, &upload->httpStatus, upload->httpResponse);
+    if (tickcounter_get_current_ms(upload->tickCounter, &end) != 0)
+    {
+        end = start;
+    }
+    upload->uploadTime = end - start;
+}
+
+static int BlockUpload_Thread(void* arg)
+{
+    uploadBlock((BLOCK_UPLOAD*)arg);
+    return 0;
+}
+
+/*creates the connection, the tick counter and the response buffer of a concurrent block the first time it is used*/
+static int Blob_PrepareBlockUpload(BLOCK_UPLOAD* upload, const char* hostname)
+{
+    int result;
+    if ((upload->httpApiExHandle == NULL) &&
+        ((upload->httpApiExHandle = HTTPAPIEX_Create(hostname)) == NULL))
+    {
+        LogError("unable to create a HTTPAPIEX_HANDLE");
+        result = __FAILURE__;
+    }
+    else if ((upload->tickCounter == NULL) &&
+        ((upload->tickCounter = tickcounter_create()) == NULL))
+    {
+        LogError("unable to tickcounter_create");
+        result = __FAILURE__;
+    }
+    else if ((upload->httpResponse == NULL) &&
+        ((upload->httpResponse = BUFFER_new()) == NULL))
+    {
+        LogError("unable to BUFFER_new");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static void Blob_StartBlockUpload(BLOCK_UPLOAD* upload, size_t concurrency)
+{
+    upload->isPending = 1;
+    upload->thread = NULL;
+    if (concurrency == 1)
+    {
+        uploadBlock(upload);
+    }
+    else if (ThreadAPI_Create(&upload->thread, BlockUpload_Thread, upload) != THREADAPI_OK)
+    {
+        /*Codes_SRS_BLOB_21_011: [ If a thread cannot be started, the block shall be uploaded on the calling thread. ]*/
+        LogError("unable to start a thread for block %u, uploading it on the calling thread", upload->blockID);
+        upload->thread = NULL;
+        uploadBlock(upload);
+    }
+}
+
+/*waits for the block and reports its failure in result/httpStatus/httpResponse. Returns non-zero if the upload has to stop*/
+static int Blob_FinishBlockUpload(BLOCK_UPLOAD* upload, BLOB_RESULT* result, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+{
+    int isError;
+    if (upload->thread != NULL)
+    {
+        int threadResult;
+        (void)ThreadAPI_Join(upload->thread, &threadResult);
+        upload->thread = NULL;
+    }
+    upload->isPending = 0;
+
+    if (upload->result != BLOB_OK)
+    {
+        *result = upload->result;
+        isError = 1;
+    }
+    else if (upload->httpStatus >= 300)
+    {
+        /*Codes_SRS_BLOB_21_008: [ If a Put Block returns an HTTP status >= 300 then Blob_UploadMultipleBlocksFromSasUri shall stop and return BLOB_OK, leaving the status in httpStatus. ]*/
+        LogError("HTTP status from storage does not indicate success (%d) for block %u", (int)upload->httpStatus, upload->blockID);
+        *httpStatus = upload->httpStatus;
+        if ((upload->httpResponse != httpResponse) &&
+            (httpResponse != NULL) &&
+            (BUFFER_build(httpResponse, BUFFER_u_char(upload->httpResponse), BUFFER_length(upload->httpResponse)) != 0))
+        {
+            LogError("unable to copy the HTTP response of block %u", upload->blockID);
+        }
+        *result = BLOB_OK;
+        isError = 1;
+    }
+    else
+    {
+        isError = 0;
+    }
+    return isError;
+}
+
+/*Codes_SRS_BLOB_21_013: [ Every time a block completes and all the blocks before it have completed, Blob_UploadMultipleBlocksFromSasUri shall call progressCallback, if not NULL, from the calling thread with the number of blocks uploaded so far and the number of bytes uploaded by this call. ]*/
+static void Blob_ReportProgress(const BLOCK_UPLOAD* completed, unsigned int* completedBlockCount, size_t* completedSize, BLOB_UPLOAD_PROGRESS_CALLBACK progressCallback, void* progressContext)
+{
+    (*completedBlockCount)++;
+    *completedSize += completed->blockSize;
+    if (progressCallback != NULL)
+    {
+        progressCallback(progressContext, *completedBlockCount, *completedSize);
+    }
+}
+
+/*builds the Put Block List XML for blocks 0...blockCount-1, in order*/
+static STRING_HANDLE Blob_CreateBlockList(unsigned int blockCount)
+{
+    STRING_HANDLE result = STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>");
+    if (result == NULL)
+    {
+        LogError("failed to STRING_construct");
+    }
+    else
+    {
+        unsigned int blockID;
+        for (blockID = 0; blockID < blockCount; blockID++)
+        {
+            char temp[7]; /*this will contain 000000... 049999*/
+            STRING_HANDLE blockIdString;
+            if (sprintf(temp, "%6u", (unsigned int)blockID) != 6)
+            {
+                LogError("failed to sprintf");
+                break;
+            }
+            else if ((blockIdString = Base64_Encode_Bytes((const unsigned char*)temp, 6)) == NULL)
+            {
+                LogError("unable to Base64_Encode_Bytes");
+                break;
+            }
+            else
+            {
+                int concatResult = (
+                    (STRING_concat(result, "<Latest>") == 0) &&
+                    (STRING_concat_with_STRING(result, blockIdString) == 0) &&
+                    (STRING_concat(result, "</Latest>") == 0)
+                    ) ? 0 : __FAILURE__;
+                STRING_delete(blockIdString);
+                if (concatResult != 0)
+                {
+                    LogError("unable to STRING_concat");
+                    break;
+                }
+            }
+        }
+
+        if (blockID < blockCount)
+        {
+            STRING_delete(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
 
 BLOB_RESULT Blob_UploadFromSasUri(const char* SASURI, const unsigned char* source, size_t size, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
 {
@@ -36,318 +578,508 @@ BLOB_RESULT Blob_UploadFromSasUri(const char* SASURI, const unsigned char* sourc
         {
             /*Codes_SRS_BLOB_02_017: [ Blob_UploadFromSasUri shall copy from SASURI the hostname to a new const char* ]*/
             /*Codes_SRS_BLOB_02_004: [ Blob_UploadFromSasUri shall copy from SASURI the hostname to a new const char*. ]*/
-            /*to find the hostname, the following logic is applied:*/
-            /*the hostname starts at the first character after "://"*/
-            /*the hostname ends at the first character before the next "/" after "://"*/
-            const char* hostnameBegin = strstr(SASURI, "://");
-            if (hostnameBegin == NULL)
+            char* hostname;
+            const char* relativePath;
+            if ((result = Blob_ParseSasUri(SASURI, &hostname, &relativePath)) != BLOB_OK)
             {
-                /*Codes_SRS_BLOB_02_005: [ If the hostname cannot be determined, then Blob_UploadFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
-                LogError("hostname cannot be determined");
-                result = BLOB_INVALID_ARG;
+                /*already logged, result is reported "as is"*/
             }
             else
             {
-                hostnameBegin += 3; /*have to skip 3 characters which are "://"*/
-                const char* hostnameEnd = strchr(hostnameBegin, '/');
-                if (hostnameEnd == NULL)
+                /*Codes_SRS_BLOB_02_006: [ Blob_UploadFromSasUri shall create a new HTTPAPI_EX_HANDLE by calling HTTPAPIEX_Create passing the hostname. ]*/
+                /*Codes_SRS_BLOB_02_018: [ Blob_UploadFromSasUri shall create a new HTTPAPI_EX_HANDLE by calling HTTPAPIEX_Create passing the hostname. ]*/
+                HTTPAPIEX_HANDLE httpApiExHandle = HTTPAPIEX_Create(hostname);
+                if (httpApiExHandle == NULL)
                 {
-                    /*Codes_SRS_BLOB_02_005: [ If the hostname cannot be determined, then Blob_UploadFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
-                    LogError("hostname cannot be determined");
-                    result = BLOB_INVALID_ARG;
+                    /*Codes_SRS_BLOB_02_007: [ If HTTPAPIEX_Create fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR. ]*/
+                    LogError("unable to create a HTTPAPIEX_HANDLE");
+                    result = BLOB_ERROR;
                 }
                 else
                 {
-                    size_t hostnameSize = hostnameEnd - hostnameBegin;
-                    char* hostname = (char*)malloc(hostnameSize + 1); /*+1 because of '\0' at the end*/
-                    if (hostname == NULL)
+                    if (size < 64 * 1024 * 1024) /*code path for sizes <64MB*/
+                    {
+                        result = Blob_UploadSingleRequest(httpApiExHandle, relativePath, source, size, httpStatus, httpResponse);
+                    }
+                    else /*code path for size >= 64MB*/
                     {
-                        /*Codes_SRS_BLOB_02_016: [ If the hostname copy cannot be made then then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                        LogError("oom - out of memory");
+                        size_t toUpload = size;
+                        /*Codes_SRS_BLOB_02_028: [ Blob_UploadFromSasUri shall construct an XML string with the following content: ]*/
+                        STRING_HANDLE xml = STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"); /*the XML "build as we go"*/
+                        if (xml == NULL)
+                        {
+                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
+                            LogError("failed to STRING_construct");
+                            result = BLOB_HTTP_ERROR;
+                        }
+                        else
+                        {
+                            /*Codes_SRS_BLOB_02_021: [ For every block of 4MB the following operations shall happen: ]*/
+                            unsigned int blockID = 0;
+                            result = BLOB_ERROR;
+
+                            int isError = 0; /*used to cleanly exit the loop*/
+                            do
+                            {
+                                /*setting this block size*/
+                                size_t thisBlockSize = (toUpload > BLOCK_SIZE) ? BLOCK_SIZE : toUpload;
+                                result = Blob_UploadBlock(httpApiExHandle, relativePath, blockID, source + (size - toUpload), thisBlockSize, xml, httpStatus, httpResponse);
+                                if (result != BLOB_OK)
+                                {
+                                    isError = 1;
+                                }
+                                else if (*httpStatus >= 300)
+                                {
+                                    /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadFromSasUri shall succeed and return BLOB_OK. ]*/
+                                    LogError("HTTP status from storage does not indicate success (%d)", (int)*httpStatus);
+                                    isError = 1;
+                                }
+                                else
+                                {
+                                    /*Codes_SRS_BLOB_02_027: [ Otherwise Blob_UploadFromSasUri shall continue execution. ]*/
+                                }
+
+                                blockID++;
+                                toUpload -= thisBlockSize;
+                            } while ((toUpload > 0) && !isError);
+
+                            if (isError)
+                            {
+                                /*do nothing, it will be reported "as is"*/
+                            }
+                            else
+                            {
+                                result = Blob_UploadBlockList(httpApiExHandle, relativePath, xml, httpStatus, httpResponse);
+                            }
+                            STRING_delete(xml);
+                        }
+                    }
+                    HTTPAPIEX_Destroy(httpApiExHandle);
+                }
+                free(hostname);
+            }
+        }
+    }
+    return result;
+}
+
+BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, BLOB_UPLOAD_READ_CALLBACK readCallback, void* context, size_t concurrency, size_t sizeHint, unsigned int firstBlockID, BLOB_UPLOAD_PROGRESS_CALLBACK progressCallback, void* progressContext, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+{
+    BLOB_RESULT result;
+    /*Codes_SRS_BLOB_21_001: [ If SASURI, readCallback or httpStatus is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+    /*Codes_SRS_BLOB_21_009: [ If concurrency is 0 or greater than 8 then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+    if (
+        (SASURI == NULL) ||
+        (readCallback == NULL) ||
+        (httpStatus == NULL) ||
+        (concurrency == 0) ||
+        (concurrency > MAXIMUM_UPLOAD_CONCURRENCY)
+        )
+    {
+        LogError("invalid argument detected SASURI=%p readCallback=%p httpStatus=%p concurrency=%zu", SASURI, readCallback, httpStatus, concurrency);
+        result = BLOB_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_BLOB_21_002: [ Blob_UploadMultipleBlocksFromSasUri shall parse SASURI and create the HTTPAPIEX_HANDLE the same way Blob_UploadFromSasUri does. ]*/
+        char* hostname;
+        const char* relativePath;
+        if ((result = Blob_ParseSasUri(SASURI, &hostname, &relativePath)) != BLOB_OK)
+        {
+            /*already logged, result is reported "as is"*/
+        }
+        else
+        {
+            HTTPAPIEX_HANDLE httpApiExHandle = HTTPAPIEX_Create(hostname);
+            if (httpApiExHandle == NULL)
+            {
+                LogError("unable to create a HTTPAPIEX_HANDLE");
+                result = BLOB_ERROR;
+            }
+            else
+            {
+                TICK_COUNTER_HANDLE tickCounter;
+                BLOCK_UPLOAD* uploads;
+                if ((tickCounter = tickcounter_create()) == NULL)
+                {
+                    LogError("unable to tickcounter_create");
+                    result = BLOB_ERROR;
+                }
+                else
+                {
+                    if ((uploads = (BLOCK_UPLOAD*)malloc(concurrency * sizeof(BLOCK_UPLOAD))) == NULL)
+                    {
+                        LogError("unable to allocate the block uploads");
                         result = BLOB_ERROR;
                     }
                     else
                     {
-                        HTTPAPIEX_HANDLE httpApiExHandle;
-                        (void)memcpy(hostname, hostnameBegin, hostnameSize);
-                        hostname[hostnameSize] = '\0';
-
-                        /*Codes_SRS_BLOB_02_006: [ Blob_UploadFromSasUri shall create a new HTTPAPI_EX_HANDLE by calling HTTPAPIEX_Create passing the hostname. ]*/
-                        /*Codes_SRS_BLOB_02_018: [ Blob_UploadFromSasUri shall create a new HTTPAPI_EX_HANDLE by calling HTTPAPIEX_Create passing the hostname. ]*/
-                        httpApiExHandle = HTTPAPIEX_Create(hostname);
-                        if (httpApiExHandle == NULL)
+                        /*Codes_SRS_BLOB_21_003: [ Blob_UploadMultipleBlocksFromSasUri shall read the data into one 4MB block buffer per concurrent block, each reused for every block it uploads. ]*/
+                        /*Codes_SRS_BLOB_21_010: [ Every concurrent block shall be uploaded over its own HTTPAPIEX_HANDLE, created on first use; the first one is the handle used for the single request and the block list. ]*/
+                        /*Codes_SRS_BLOB_21_020: [ Every concurrent block shall time its uploads with its own tick counter, created on first use, so no tick counter is used by two threads at once. ]*/
+                        size_t nextBlockSize = Blob_GetInitialBlockSize(sizeHint, concurrency);
+                        size_t i;
+                        for (i = 0; i < concurrency; i++)
+                        {
+                            uploads[i].httpApiExHandle = (i == 0) ? httpApiExHandle : NULL;
+                            uploads[i].relativePath = relativePath;
+                            uploads[i].tickCounter = (i == 0) ? tickCounter : NULL;
+                            uploads[i].thread = NULL;
+                            uploads[i].isPending = 0;
+                            uploads[i].block = NULL;
+                            uploads[i].httpResponse = (concurrency == 1) ? httpResponse : NULL; /*concurrent blocks must not share the caller's buffer*/
+                        }
+
+                        if ((uploads[0].block = (unsigned char*)malloc(BLOCK_SIZE)) == NULL)
+                        {
+                            LogError("unable to allocate the block buffer");
+                            result = BLOB_ERROR;
+                        }
+                        else if (Blob_ReadBlock(readCallback, context, uploads[0].block, nextBlockSize, &uploads[0].blockSize) != 0)
                         {
-                            /*Codes_SRS_BLOB_02_007: [ If HTTPAPIEX_Create fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR. ]*/
-                            LogError("unable to create a HTTPAPIEX_HANDLE");
                             result = BLOB_ERROR;
                         }
+                        else if ((firstBlockID == 0) && (uploads[0].blockSize < nextBlockSize))
+                        {
+                            /*Codes_SRS_BLOB_21_004: [ If the data ends before the first block is full, Blob_UploadMultipleBlocksFromSasUri shall upload it with a single request, as Blob_UploadFromSasUri does for sizes below 64MB. ]*/
+                            result = Blob_UploadSingleRequest(httpApiExHandle, relativePath, uploads[0].block, uploads[0].blockSize, httpStatus, httpResponse);
+                        }
                         else
                         {
-                            /*Codes_SRS_BLOB_02_008: [ Blob_UploadFromSasUri shall compute the relative path of the request from the SASURI parameter. ]*/
-                            /*Codes_SRS_BLOB_02_019: [ Blob_UploadFromSasUri shall compute the base relative path of the request from the SASURI parameter. ]*/
-                            const char* relativePath = hostnameEnd; /*this is where the relative path begins in the SasUri*/
+                            /*Codes_SRS_BLOB_21_005: [ Otherwise Blob_UploadMultipleBlocksFromSasUri shall upload every block as it is read with Put Block, up to concurrency blocks at a time, and commit the block list with Put Block List once readCallback reports the end of the data and every block has completed. ]*/
+                            /*Codes_SRS_BLOB_21_014: [ Blocks shall be numbered from firstBlockID; blocks 0...firstBlockID-1 are assumed to be uploaded already and are part of the block list. ]*/
+                            unsigned int blockCount = firstBlockID;
+                            unsigned int completedBlockCount = firstBlockID;
+                            size_t completedSize = 0;
+                            int isError = 0;
+                            int isBlockRead = 1; /*the first block has been read into uploads[0] above*/
 
-                            if (size < 64 * 1024 * 1024) /*code path for sizes <64MB*/
+                            while (!isError)
                             {
-                                /*Codes_SRS_BLOB_02_010: [ Blob_UploadFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
-                                BUFFER_HANDLE requestBuffer = BUFFER_create(source, size);
-                                if (requestBuffer == NULL)
+                                BLOCK_UPLOAD* upload = &uploads[(blockCount - firstBlockID) % concurrency];
+
+                                if (!isBlockRead)
+                                {
+                                    /*the slot is reused in order, so at most concurrency blocks are in flight and they complete in block order*/
+                                    if (upload->isPending)
+                                    {
+                                        if (Blob_FinishBlockUpload(upload, &result, httpStatus, httpResponse) != 0)
+                                        {
+                                            isError = 1;
+                                            break;
+                                        }
+                                        Blob_ReportProgress(upload, &completedBlockCount, &completedSize, progressCallback, progressContext);
+                                        nextBlockSize = Blob_AdaptBlockSize(nextBlockSize, upload);
+                                    }
+
+                                    if ((upload->block == NULL) &&
+                                        ((upload->block = (unsigned char*)malloc(BLOCK_SIZE)) == NULL))
+                                    {
+                                        LogError("unable to allocate the block buffer");
+                                        result = BLOB_ERROR;
+                                        isError = 1;
+                                        break;
+                                    }
+                                    else if (Blob_ReadBlock(readCallback, context, upload->block, nextBlockSize, &upload->blockSize) != 0)
+                                    {
+                                        result = BLOB_ERROR;
+                                        isError = 1;
+                                        break;
+                                    }
+                                }
+                                isBlockRead = 0;
+
+                                if (upload->blockSize == 0)
+                                {
+                                    /*end of data*/
+                                    break;
+                                }
+                                else if (blockCount >= MAXIMUM_BLOCK_COUNT)
                                 {
-                                    /*Codes_SRS_BLOB_02_011: [ If any of the previous steps related to building the HTTPAPI_EX_ExecuteRequest parameters fails, then Blob_UploadFromSasUri shall fail and return BLOB_ERROR. ]*/
-                                    LogError("unable to BUFFER_create");
+                                    /*Codes_SRS_BLOB_21_007: [ If the data needs more than 50000 blocks then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR. ]*/
+                                    LogError("data exceeds the maximum of %d blocks", MAXIMUM_BLOCK_COUNT);
                                     result = BLOB_ERROR;
+                                    isError = 1;
+                                }
+                                else if (Blob_PrepareBlockUpload(upload, hostname) != 0)
+                                {
+                                    result = BLOB_ERROR;
+                                    isError = 1;
                                 }
                                 else
                                 {
-                                    /*Codes_SRS_BLOB_02_009: [ Blob_UploadFromSasUri shall create an HTTP_HEADERS_HANDLE for the request HTTP headers carrying the following headers: ]*/
-                                    HTTP_HEADERS_HANDLE requestHttpHeaders = HTTPHeaders_Alloc();
-                                    if (requestHttpHeaders == NULL)
-                                    {
-                                        /*Codes_SRS_BLOB_02_011: [ If any of the previous steps related to building the HTTPAPI_EX_ExecuteRequest parameters fails, then Blob_UploadFromSasUri shall fail and return BLOB_ERROR. ]*/
-                                        LogError("unable to HTTPHeaders_Alloc");
-                                        result = BLOB_ERROR;
-                                    }
-                                    else
+                                    upload->blockID = blockCount++;
+                                    Blob_StartBlockUpload(upload, concurrency);
+                                }
+                            }
+
+                            /*collect the blocks still in flight, the first failure is the one reported*/
+                            for (i = 0; i < concurrency; i++)
+                            {
+                                BLOCK_UPLOAD* upload = &uploads[(blockCount - firstBlockID + i) % concurrency];
+                                if (upload->isPending)
+                                {
+                                    BLOB_RESULT blockResult = BLOB_OK;
+                                    unsigned int blockHttpStatus = 0;
+                                    if (Blob_FinishBlockUpload(upload, &blockResult, &blockHttpStatus, isError ? NULL : httpResponse) != 0)
                                     {
-                                        if (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "x-ms-blob-type", "BlockBlob") != HTTP_HEADERS_OK)
-                                        {
-                                            /*Codes_SRS_BLOB_02_011: [ If any of the previous steps related to building the HTTPAPI_EX_ExecuteRequest parameters fails, then Blob_UploadFromSasUri shall fail and return BLOB_ERROR. ]*/
-                                            LogError("unable to HTTPHeaders_AddHeaderNameValuePair");
-                                            result = BLOB_ERROR;
-                                        }
-                                        else
+                                        if (!isError)
                                         {
-                                            /*Codes_SRS_BLOB_02_012: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest passing the parameters previously build, httpStatus and httpResponse ]*/
-                                            if (HTTPAPIEX_ExecuteRequest(httpApiExHandle, HTTPAPI_REQUEST_PUT, relativePath, requestHttpHeaders, requestBuffer, httpStatus, NULL, httpResponse) != HTTPAPIEX_OK)
-                                            {
-                                                /*Codes_SRS_BLOB_02_013: [ If HTTPAPIEX_ExecuteRequest fails, then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
-                                                LogError("failed to HTTPAPIEX_ExecuteRequest");
-                                                result = BLOB_HTTP_ERROR;
-                                            }
-                                            else
-                                            {
-                                                /*Codes_SRS_BLOB_02_015: [ Otherwise, HTTPAPIEX_ExecuteRequest shall succeed and return BLOB_OK. ]*/
-                                                result = BLOB_OK;
-                                            }
+                                            result = blockResult;
+                                            *httpStatus = blockHttpStatus;
+                                            isError = 1;
                                         }
-                                        HTTPHeaders_Free(requestHttpHeaders);
                                     }
-                                    BUFFER_delete(requestBuffer);
+                                    else if (!isError)
+                                    {
+                                        Blob_ReportProgress(upload, &completedBlockCount, &completedSize, progressCallback, progressContext);
+                                    }
                                 }
                             }
-                            else /*code path for size >= 64MB*/
+
+                            if (isError)
+                            {
+                                /*do nothing, it will be reported "as is"*/
+                            }
+                            else
                             {
-                                size_t toUpload = size;
-                                /*Codes_SRS_BLOB_02_028: [ Blob_UploadFromSasUri shall construct an XML string with the following content: ]*/
-                                STRING_HANDLE xml = STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"); /*the XML "build as we go"*/
+                                STRING_HANDLE xml = Blob_CreateBlockList(blockCount);
                                 if (xml == NULL)
                                 {
-                                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                    LogError("failed to STRING_construct");
-                                    result = BLOB_HTTP_ERROR;
+                                    result = BLOB_ERROR;
                                 }
                                 else
                                 {
-                                    /*Codes_SRS_BLOB_02_021: [ For every block of 4MB the following operations shall happen: ]*/
-                                    unsigned int blockID = 0;
-                                    result = BLOB_ERROR;
+                                    result = Blob_UploadBlockList(httpApiExHandle, relativePath, xml, httpStatus, httpResponse);
+                                    STRING_delete(xml);
+                                }
+                            }
+                        }
 
-                                    int isError = 0; /*used to cleanly exit the loop*/
-                                    do
-                                    {
-                                        /*setting this block size*/
-                                        size_t thisBlockSize = (toUpload > BLOCK_SIZE) ? BLOCK_SIZE : toUpload;
-                                        /*Codes_SRS_BLOB_02_020: [ Blob_UploadFromSasUri shall construct a BASE64 encoded string from the block ID (000000... 0499999) ]*/
-                                        char temp[7]; /*this will contain 000000... 049999*/
-                                        if (sprintf(temp, "%6u", (unsigned int)blockID) != 6) /*produces 000000... 049999*/
-                                        {
-                                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                            LogError("failed to sprintf");
-                                            result = BLOB_ERROR;
-                                            isError = 1;
-                                        }
-                                        else
-                                        {
-                                            STRING_HANDLE blockIdString = Base64_Encode_Bytes((const unsigned char*)temp, 6);
-                                            if (blockIdString == NULL)
-                                            {
-                                                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                LogError("unable to Base64_Encode_Bytes");
-                                                result = BLOB_ERROR;
-                                                isError = 1;
-                                            }
-                                            else
-                                            {
-                                                /*add the blockId base64 encoded to the XML*/
-                                                if (!(
-                                                    (STRING_concat(xml, "<Latest>")==0) &&
-                                                    (STRING_concat_with_STRING(xml, blockIdString)==0) &&
-                                                    (STRING_concat(xml, "</Latest>") == 0)
-                                                    ))
-                                                {
-                                                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                    LogError("unable to STRING_concat");
-                                                    result = BLOB_ERROR;
-                                                    isError = 1;
-                                                }
-                                                else
-                                                {
-                                                    /*Codes_SRS_BLOB_02_022: [ Blob_UploadFromSasUri shall construct a new relativePath from following string: base relativePath + "&comp=block&blockid=BASE64 encoded string of blockId" ]*/
-                                                    STRING_HANDLE newRelativePath = STRING_construct(relativePath);
-                                                    if (newRelativePath == NULL)
-                                                    {
-                                                        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                        LogError("unable to STRING_construct");
-                                                        result = BLOB_ERROR;
-                                                        isError = 1;
-                                                    }
-                                                    else
-                                                    {
-                                                        if (!(
-                                                            (STRING_concat(newRelativePath, "&comp=block&blockid=") == 0) &&
-                                                            (STRING_concat_with_STRING(newRelativePath, blockIdString) == 0)
-                                                            ))
-                                                        {
-                                                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                            LogError("unable to STRING concatenate");
-                                                            result = BLOB_ERROR;
-                                                            isError = 1;
-                                                        }
-                                                        else
-                                                        {
-                                                            /*Codes_SRS_BLOB_02_023: [ Blob_UploadFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
-                                                            BUFFER_HANDLE requestContent = BUFFER_create(source + (size - toUpload), thisBlockSize);
-                                                            if (requestContent == NULL)
-                                                            {
-                                                                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                                LogError("unable to BUFFER_create");
-                                                                result = BLOB_ERROR;
-                                                                isError = 1;
-                                                            }
-                                                            else
-                                                            {
-                                                                /*Codes_SRS_BLOB_02_024: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing httpStatus and httpResponse. ]*/
-                                                                if (HTTPAPIEX_ExecuteRequest(
-                                                                    httpApiExHandle,
-                                                                    HTTPAPI_REQUEST_PUT,
-                                                                    STRING_c_str(newRelativePath),
-                                                                    NULL,
-                                                                    requestContent,
-                                                                    httpStatus,
-                                                                    NULL,
-                                                                    httpResponse) != HTTPAPIEX_OK
-                                                                    )
-                                                                {
-                                                                    /*Codes_SRS_BLOB_02_025: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
-                                                                    LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                                                    result = BLOB_HTTP_ERROR;
-                                                                    isError = 1;
-                                                                }
-                                                                else if (*httpStatus >= 300)
-                                                                {
-                                                                    /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadFromSasUri shall succeed and return BLOB_OK. ]*/
-                                                                    LogError("HTTP status from storage does not indicate success (%d)", (int)*httpStatus);
-                                                                    result = BLOB_OK;
-                                                                    isError = 1;
-                                                                }
-                                                                else
-                                                                {
-                                                                    /*Codes_SRS_BLOB_02_027: [ Otherwise Blob_UploadFromSasUri shall continue execution. ]*/
-                                                                }
-                                                                BUFFER_delete(requestContent);
-                                                            }
-                                                        }
-                                                        STRING_delete(newRelativePath);
-                                                    }
-                                                }
-                                                STRING_delete(blockIdString);
-                                            }
-                                        }
+                        for (i = 0; i < concurrency; i++)
+                        {
+                            if ((uploads[i].httpApiExHandle != NULL) && (uploads[i].httpApiExHandle != httpApiExHandle))
+                            {
+                                HTTPAPIEX_Destroy(uploads[i].httpApiExHandle);
+                            }
+                            if ((uploads[i].tickCounter != NULL) && (uploads[i].tickCounter != tickCounter))
+                            {
+                                tickcounter_destroy(uploads[i].tickCounter);
+                            }
+                            if ((uploads[i].httpResponse != NULL) && (uploads[i].httpResponse != httpResponse))
+                            {
+                                BUFFER_delete(uploads[i].httpResponse);
+                            }
+                            free(uploads[i].block);
+                        }
+                        free(uploads);
+                    }
+                    tickcounter_destroy(tickCounter);
+                }
+                HTTPAPIEX_Destroy(httpApiExHandle);
+            }
+            free(hostname);
+        }
+    }
+    return result;
+}
 
-                                        blockID++;
-                                        toUpload -= thisBlockSize;
-                                    } while ((toUpload > 0) && !isError);
+/*collects the sizes of the uncommitted blocks named by this module from a Get Block List response, and measures the run of blocks starting at block 0*/
+static BLOB_RESULT Blob_ParseUncommittedBlocks(BUFFER_HANDLE response, unsigned int* blockCount, size_t* uploadedSize)
+{
+    BLOB_RESULT result;
+    size_t length = BUFFER_length(response);
+    char* xml = (char*)malloc(length + 1);
+    if (xml == NULL)
+    {
+        LogError("unable to allocate the block list");
+        result = BLOB_ERROR;
+    }
+    else
+    {
+        size_t* blockSizes = NULL; /*indexed by block ID, 0 means the block is missing*/
+        unsigned int blockSizesCount = 0;
+        const char* cursor;
+        const char* listEnd;
+
+        if (length > 0)
+        {
+            (void)memcpy(xml, BUFFER_u_char(response), length);
+        }
+        xml[length] = '\0';
 
-                                    if (isError)
+        result = BLOB_OK;
+        cursor = strstr(xml, "<UncommittedBlocks>");
+        listEnd = (cursor == NULL) ? NULL : strstr(cursor, "</UncommittedBlocks>");
+        while ((cursor != NULL) && (listEnd != NULL) && (result == BLOB_OK))
+        {
+            const char* name;
+            const char* nameEnd;
+            const char* size;
+            if (((cursor = strstr(cursor, "<Block>")) == NULL) || (cursor > listEnd))
+            {
+                break;
+            }
+            else if (((name = strstr(cursor, "<Name>")) == NULL) ||
+                ((nameEnd = strstr(name, "</Name>")) == NULL) ||
+                ((size = strstr(cursor, "<Size>")) == NULL))
+            {
+                LogError("malformed block list");
+                result = BLOB_ERROR;
+            }
+            else
+            {
+                name += 6; /*skip "<Name>"*/
+                if (nameEnd - name == 8) /*BASE64 of the 6 characters block ID, any other block was not uploaded by this module*/
+                {
+                    char encodedName[9];
+                    BUFFER_HANDLE decodedName;
+                    (void)memcpy(encodedName, name, 8);
+                    encodedName[8] = '\0';
+                    if ((decodedName = Base64_Decoder(encodedName)) == NULL)
+                    {
+                        LogError("unable to Base64_Decoder");
+                        result = BLOB_ERROR;
+                    }
+                    else
+                    {
+                        char temp[7];
+                        unsigned long blockID;
+                        if (BUFFER_length(decodedName) == 6)
+                        {
+                            (void)memcpy(temp, BUFFER_u_char(decodedName), 6);
+                            temp[6] = '\0';
+                            blockID = strtoul(temp, NULL, 10);
+                            if (blockID < MAXIMUM_BLOCK_COUNT)
+                            {
+                                if (blockID >= blockSizesCount)
+                                {
+                                    size_t* newBlockSizes = (size_t*)realloc(blockSizes, (blockID + 1) * sizeof(size_t));
+                                    if (newBlockSizes == NULL)
                                     {
-                                        /*do nothing, it will be reported "as is"*/
+                                        LogError("unable to grow the block list");
+                                        result = BLOB_ERROR;
                                     }
                                     else
                                     {
-                                        /*complete the XML*/
-                                        if (STRING_concat(xml, "</BlockList>") != 0)
-                                        {
-                                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                            LogError("failed to STRING_concat");
-                                            result = BLOB_ERROR;
-                                        }
-                                        else
-                                        {
-                                            /*Codes_SRS_BLOB_02_029: [Blob_UploadFromSasUri shall construct a new relativePath from following string : base relativePath + "&comp=blocklist"]*/
-                                            STRING_HANDLE newRelativePath = STRING_construct(relativePath);
-                                            if (newRelativePath == NULL)
-                                            {
-                                                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                LogError("failed to STRING_construct");
-                                                result = BLOB_ERROR;
-                                            }
-                                            else
-                                            {
-                                                if (STRING_concat(newRelativePath, "&comp=blocklist") != 0)
-                                                {
-                                                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                    LogError("failed to STRING_concat");
-                                                    result = BLOB_ERROR;
-                                                }
-                                                else
-                                                {
-                                                    /*Codes_SRS_BLOB_02_030: [ Blob_UploadFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing the new relativePath, httpStatus and httpResponse and the XML string as content. ]*/
-                                                    const char* s = STRING_c_str(xml);
-                                                    BUFFER_HANDLE xmlAsBuffer = BUFFER_create((const unsigned char*)s, strlen(s));
-                                                    if (xmlAsBuffer == NULL)
-                                                    {
-                                                        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadFromSasUri shall fail and return BLOB_ERROR ]*/
-                                                        LogError("failed to BUFFER_create");
-                                                        result = BLOB_ERROR;
-                                                    }
-                                                    else
-                                                    {
-                                                        if (HTTPAPIEX_ExecuteRequest(
-                                                            httpApiExHandle,
-                                                            HTTPAPI_REQUEST_PUT,
-                                                            STRING_c_str(newRelativePath),
-                                                            NULL,
-                                                            xmlAsBuffer,
-                                                            httpStatus,
-                                                            NULL,
-                                                            httpResponse
-                                                        ) != HTTPAPIEX_OK)
-                                                        {
-                                                            /*Codes_SRS_BLOB_02_031: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
-                                                            LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                                            result = BLOB_HTTP_ERROR;
-                                                        }
-                                                        else
-                                                        {
-                                                            /*Codes_SRS_BLOB_02_032: [ Otherwise, Blob_UploadFromSasUri shall succeed and return BLOB_OK. ]*/
-                                                            result = BLOB_OK;
-                                                        }
-                                                        BUFFER_delete(xmlAsBuffer);
-                                                    }
-                                                }
-                                                STRING_delete(newRelativePath);
-                                            }
-                                        }
+                                        (void)memset(newBlockSizes + blockSizesCount, 0, (blockID + 1 - blockSizesCount) * sizeof(size_t));
+                                        blockSizes = newBlockSizes;
+                                        blockSizesCount = (unsigned int)blockID + 1;
                                     }
-                                    STRING_delete(xml);
+                                }
+                                if (result == BLOB_OK)
+                                {
+                                    blockSizes[blockID] = (size_t)strtoul(size + 6, NULL, 10); /*skip "<Size>"*/
                                 }
                             }
-                            HTTPAPIEX_Destroy(httpApiExHandle);
                         }
-                        free(hostname);
+                        BUFFER_delete(decodedName);
+                    }
+                }
+                cursor = nameEnd;
+            }
+        }
+
+        if (result == BLOB_OK)
+        {
+            /*Codes_SRS_BLOB_21_017: [ Blob_GetUploadedBlocks shall return in blockCount the number of consecutive uncommitted blocks starting at block 0 and in uploadedSize their total size. ]*/
+            *blockCount = 0;
+            *uploadedSize = 0;
+            while ((*blockCount < blockSizesCount) && (blockSizes[*blockCount] != 0))
+            {
+                *uploadedSize += blockSizes[*blockCount];
+                (*blockCount)++;
+            }
+        }
+        free(blockSizes);
+        free(xml);
+    }
+    return result;
+}
+
+BLOB_RESULT Blob_GetUploadedBlocks(const char* SASURI, unsigned int* blockCount, size_t* uploadedSize)
+{
+    BLOB_RESULT result;
+    /*Codes_SRS_BLOB_21_015: [ If SASURI, blockCount or uploadedSize is NULL then Blob_GetUploadedBlocks shall fail and return BLOB_INVALID_ARG. ]*/
+    if (
+        (SASURI == NULL) ||
+        (blockCount == NULL) ||
+        (uploadedSize == NULL)
+        )
+    {
+        LogError("invalid argument detected SASURI=%p blockCount=%p uploadedSize=%p", SASURI, blockCount, uploadedSize);
+        result = BLOB_INVALID_ARG;
+    }
+    else
+    {
+        char* hostname;
+        const char* relativePath;
+        if ((result = Blob_ParseSasUri(SASURI, &hostname, &relativePath)) != BLOB_OK)
+        {
+            /*already logged, result is reported "as is"*/
+        }
+        else
+        {
+            HTTPAPIEX_HANDLE httpApiExHandle = HTTPAPIEX_Create(hostname);
+            if (httpApiExHandle == NULL)
+            {
+                LogError("unable to create a HTTPAPIEX_HANDLE");
+                result = BLOB_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BLOB_21_016: [ Blob_GetUploadedBlocks shall execute a GET request on base relativePath + "&comp=blocklist&blocklisttype=uncommitted" (Get Block List). ]*/
+                STRING_HANDLE newRelativePath = STRING_construct(relativePath);
+                if (newRelativePath == NULL)
+                {
+                    LogError("failed to STRING_construct");
+                    result = BLOB_ERROR;
+                }
+                else
+                {
+                    BUFFER_HANDLE response;
+                    if (STRING_concat(newRelativePath, "&comp=blocklist&blocklisttype=uncommitted") != 0)
+                    {
+                        LogError("failed to STRING_concat");
+                        result = BLOB_ERROR;
+                    }
+                    else if ((response = BUFFER_new()) == NULL)
+                    {
+                        LogError("unable to BUFFER_new");
+                        result = BLOB_ERROR;
+                    }
+                    else
+                    {
+                        unsigned int httpStatus;
+                        if (HTTPAPIEX_ExecuteRequest(httpApiExHandle, HTTPAPI_REQUEST_GET, STRING_c_str(newRelativePath), NULL, NULL, &httpStatus, NULL, response) != HTTPAPIEX_OK)
+                        {
+                            LogError("unable to HTTPAPIEX_ExecuteRequest");
+                            result = BLOB_HTTP_ERROR;
+                        }
+                        else if (httpStatus == 404)
+                        {
+                            /*Codes_SRS_BLOB_21_018: [ If storage answers 404 (no block has been uploaded) then Blob_GetUploadedBlocks shall return 0 blocks and BLOB_OK. ]*/
+                            *blockCount = 0;
+                            *uploadedSize = 0;
+                            result = BLOB_OK;
+                        }
+                        else if (httpStatus >= 300)
+                        {
+                            /*Codes_SRS_BLOB_21_019: [ If any other HTTP status >= 300 is returned then Blob_GetUploadedBlocks shall fail and return BLOB_HTTP_ERROR. ]*/
+                            LogError("HTTP status from storage does not indicate success (%d)", (int)httpStatus);
+                            result = BLOB_HTTP_ERROR;
+                        }
+                        else
+                        {
+                            result = Blob_ParseUncommittedBlocks(response, blockCount, uploadedSize);
+                        }
+                        BUFFER_delete(response);
                     }
+                    STRING_delete(newRelativePath);
                 }
+                HTTPAPIEX_Destroy(httpApiExHandle);
             }
+            free(hostname);
         }
     }
     return result;
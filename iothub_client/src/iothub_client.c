@@ -11,24 +11,56 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothub_client.h"
 #include "iothub_client_ll.h"
+#include "iothub_client_private.h"
 #include "iothubtransport.h"
+#include "iothubtransport_pool.h"
+#include "iothub_client_submission_queue.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 
 struct IOTHUB_QUEUE_CONTEXT_TAG;
 
+#ifndef DONT_USE_UPLOADTOBLOB
+/*number of threads uploading files for one IoTHubClient instance, created at the first IoTHubClient_UploadToBlobAsync*/
+#ifndef UPLOADTOBLOB_WORKER_COUNT
+#define UPLOADTOBLOB_WORKER_COUNT 2
+#endif
+
+/*maximum number of uploads waiting for a free worker, further IoTHubClient_UploadToBlobAsync calls fail*/
+#ifndef UPLOADTOBLOB_MAX_QUEUED
+#define UPLOADTOBLOB_MAX_QUEUED 32
+#endif
+
+/*an idle worker wakes up this often to check if it has to stop*/
+#define UPLOADTOBLOB_WORKER_IDLE_WAIT_MS 1000
+
+struct UPLOADTOBLOB_SAVED_DATA_TAG;
+#endif
+
 typedef struct IOTHUB_CLIENT_INSTANCE_TAG
 {
     IOTHUB_CLIENT_LL_HANDLE IoTHubClientLLHandle;
     TRANSPORT_HANDLE TransportHandle;
+    TRANSPORT_POOL_HANDLE TransportPool; /*pool TransportHandle was acquired from, NULL if the application gave it*/
+    SUBMISSION_QUEUE event_submissions; /*events sent on a shared transport, drained by the transport worker thread*/
+    sig_atomic_t shared_worker_started; /*the shared transport worker thread knows this client, events can be queued without the lock*/
     THREAD_HANDLE ThreadHandle;
     LOCK_HANDLE LockHandle;
     sig_atomic_t StopThread;
 #ifndef DONT_USE_UPLOADTOBLOB
     SINGLYLINKEDLIST_HANDLE savedDataToBeCleaned; /*list containing UPLOADTOBLOB_SAVED_DATA*/
+    LOCK_HANDLE uploadLock; /*protects the upload queue and the canBeGarbageCollected flags*/
+    COND_HANDLE uploadCondition; /*signaled when an upload is queued or when the upload workers have to stop*/
+    struct UPLOADTOBLOB_SAVED_DATA_TAG* uploadQueueHead; /*uploads waiting for a worker, oldest first*/
+    struct UPLOADTOBLOB_SAVED_DATA_TAG* uploadQueueTail;
+    size_t uploadQueueLength;
+    THREAD_HANDLE uploadWorkers[UPLOADTOBLOB_WORKER_COUNT];
+    size_t uploadWorkerCount;
+    sig_atomic_t StopUploadWorkers;
 #endif
     int created_with_transport_handle;
     VECTOR_HANDLE saved_user_callback_list;
@@ -49,10 +81,9 @@ typedef struct UPLOADTOBLOB_SAVED_DATA_TAG
     char* destinationFileName;
     IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK iotHubClientFileUploadCallback;
     void* context;
-    THREAD_HANDLE uploadingThreadHandle;
     IOTHUB_CLIENT_HANDLE iotHubClientHandle;
-    LOCK_HANDLE lockGarbage;
-    int canBeGarbageCollected; /*flag indicating that the UPLOADTOBLOB_SAVED_DATA structure can be freed because the thread deadling with it finished*/
+    struct UPLOADTOBLOB_SAVED_DATA_TAG* next; /*next upload in the queue of uploads waiting for a worker*/
+    int canBeGarbageCollected; /*flag indicating that the UPLOADTOBLOB_SAVED_DATA structure can be freed because the worker deadling with it finished*/
 }UPLOADTOBLOB_SAVED_DATA;
 #endif
 
@@ -116,56 +147,100 @@ typedef struct IOTHUB_QUEUE_CONTEXT_TAG
     void* userContextCallback;
 } IOTHUB_QUEUE_CONTEXT;
 
+typedef struct EVENT_SUBMISSION_TAG
+{
+    SUBMISSION_QUEUE_NODE node; /*first member, the submission queue links the events through it*/
+    IOTHUB_MESSAGE_HANDLE message;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+    void* userContextCallback;
+} EVENT_SUBMISSION;
+
 /*used by unittests only*/
 const size_t IoTHubClient_ThreadTerminationOffset = offsetof(IOTHUB_CLIENT_INSTANCE, StopThread);
+#ifndef DONT_USE_UPLOADTOBLOB
+/*used by unittests only*/
+const size_t IoTHubClient_UploadWorkersTerminationOffset = offsetof(IOTHUB_CLIENT_INSTANCE, StopUploadWorkers);
+#endif
 
 #ifndef DONT_USE_UPLOADTOBLOB
-/*this function is called from _Destroy and from ScheduleWork_Thread to join finished blobUpload threads and free that memory*/
+/*this function is called from _Destroy and from ScheduleWork_Thread to free the data of finished uploads*/
 static void garbageCollectorImpl(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
 {
     /*see if any savedData structures can be disposed of*/
-    /*Codes_SRS_IOTHUBCLIENT_02_072: [ All threads marked as disposable (upon completion of a file upload) shall be joined and the data structures build for them shall be freed. ]*/
+    /*Codes_SRS_IOTHUBCLIENT_02_072: [ All uploads marked as disposable (upon completion of a file upload) shall have the data structures build for them freed. ]*/
     LIST_ITEM_HANDLE item = singlylinkedlist_get_head_item(iotHubClientInstance->savedDataToBeCleaned);
-    while (item != NULL)
+    if (item != NULL)
     {
-        const UPLOADTOBLOB_SAVED_DATA* savedData = (const UPLOADTOBLOB_SAVED_DATA*)singlylinkedlist_item_get_value(item);
-        LIST_ITEM_HANDLE old_item = item;
-        item = singlylinkedlist_get_next_item(item);
-
-        if (Lock(savedData->lockGarbage) != LOCK_OK)
+        if (Lock(iotHubClientInstance->uploadLock) != LOCK_OK)
         {
             LogError("unable to Lock");
         }
         else
         {
-            if (savedData->canBeGarbageCollected == 1)
+            while (item != NULL)
             {
-                int notUsed;
-                if (ThreadAPI_Join(savedData->uploadingThreadHandle, &notUsed) != THREADAPI_OK)
-                {
-                    LogError("unable to ThreadAPI_Join");
-                }
-                (void)singlylinkedlist_remove(iotHubClientInstance->savedDataToBeCleaned, old_item);
-                free((void*)savedData->source);
-                free((void*)savedData->destinationFileName);
+                const UPLOADTOBLOB_SAVED_DATA* savedData = (const UPLOADTOBLOB_SAVED_DATA*)singlylinkedlist_item_get_value(item);
+                LIST_ITEM_HANDLE old_item = item;
+                item = singlylinkedlist_get_next_item(item);
 
-                if (Unlock(savedData->lockGarbage) != LOCK_OK)
+                if (savedData->canBeGarbageCollected == 1)
                 {
-                    LogError("unable to unlock after locking");
+                    (void)singlylinkedlist_remove(iotHubClientInstance->savedDataToBeCleaned, old_item);
+                    free((void*)savedData->source);
+                    free((void*)savedData->destinationFileName);
+                    free((void*)savedData);
                 }
-                (void)Lock_Deinit(savedData->lockGarbage);
-                free((void*)savedData);
             }
-            else
+
+            if (Unlock(iotHubClientInstance->uploadLock) != LOCK_OK)
             {
-                if (Unlock(savedData->lockGarbage) != LOCK_OK)
-                {
-                    LogError("unable to unlock after locking");
-                }
+                LogError("unable to unlock after locking");
             }
         }
     }
 }
+
+/*this function is called from _Destroy once all the uploads have finished*/
+static void StopUploadWorkers(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->uploadLock != NULL)
+    {
+        size_t i;
+        if (Lock(iotHubClientInstance->uploadLock) != LOCK_OK)
+        {
+            LogError("unable to Lock - will still proceed to try to end the upload workers without locking");
+            iotHubClientInstance->StopUploadWorkers = 1;
+        }
+        else
+        {
+            iotHubClientInstance->StopUploadWorkers = 1;
+            for (i = 0; i < iotHubClientInstance->uploadWorkerCount; i++)
+            {
+                (void)Condition_Post(iotHubClientInstance->uploadCondition);
+            }
+
+            if (Unlock(iotHubClientInstance->uploadLock) != LOCK_OK)
+            {
+                LogError("unable to unlock after locking");
+            }
+        }
+
+        for (i = 0; i < iotHubClientInstance->uploadWorkerCount; i++)
+        {
+            int notUsed;
+            if (ThreadAPI_Join(iotHubClientInstance->uploadWorkers[i], &notUsed) != THREADAPI_OK)
+            {
+                LogError("unable to ThreadAPI_Join");
+            }
+        }
+        iotHubClientInstance->uploadWorkerCount = 0;
+
+        Condition_Deinit(iotHubClientInstance->uploadCondition);
+        iotHubClientInstance->uploadCondition = NULL;
+        (void)Lock_Deinit(iotHubClientInstance->uploadLock);
+        iotHubClientInstance->uploadLock = NULL;
+    }
+}
 #endif
 
 static IOTHUBMESSAGE_DISPOSITION_RESULT iothub_ll_message_callback(IOTHUB_MESSAGE_HANDLE message, void* userContextCallback)
@@ -488,6 +563,89 @@ static IOTHUB_CLIENT_RESULT StartWorkerThreadIfNeeded(IOTHUB_CLIENT_INSTANCE* io
     return result;
 }
 
+/*called by IoTHubClient_SendEventAsync for clients on a shared transport, the transport worker thread may be busy in DoWork with the lock*/
+static IOTHUB_CLIENT_RESULT submit_event(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (eventMessageHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_02_091: [ If eventMessageHandle is NULL, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_INVALID_ARG; if starting the worker thread, allocating the queued event or cloning the message fails, it shall return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("NULL eventMessageHandle");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (iotHubClientInstance->shared_worker_started == 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_02_090: [ Only while the worker thread was not started for the client, IoTHubClient_SendEventAsync shall lock the transport lock and start it with IoTHubTransport_StartWorkerThread. ]*/
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            LogError("Could not acquire lock");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            if (StartWorkerThreadIfNeeded(iotHubClientInstance) != IOTHUB_CLIENT_OK)
+            {
+                LogError("Could not start worker thread");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                iotHubClientInstance->shared_worker_started = 1;
+                result = IOTHUB_CLIENT_OK;
+            }
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    if (result == IOTHUB_CLIENT_OK)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_02_089: [ If the client uses a shared transport, IoTHubClient_SendEventAsync shall clone eventMessageHandle with IoTHubMessage_Clone, push it with eventConfirmationCallback and userContextCallback to the submission queue of the client without taking the transport lock and return IOTHUB_CLIENT_OK. ]*/
+        EVENT_SUBMISSION* submission = (EVENT_SUBMISSION*)malloc(sizeof(EVENT_SUBMISSION));
+        if (submission == NULL)
+        {
+            LogError("Failed allocating EVENT_SUBMISSION");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((submission->message = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
+        {
+            LogError("Failed cloning the event message");
+            free(submission);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            submission->eventConfirmationCallback = eventConfirmationCallback;
+            submission->userContextCallback = userContextCallback;
+            submission_queue_push(&iotHubClientInstance->event_submissions, &submission->node);
+        }
+    }
+
+    return result;
+}
+
+static void discard_event_submissions(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    SUBMISSION_QUEUE_NODE* node = submission_queue_take_all(&iotHubClientInstance->event_submissions);
+
+    while (node != NULL)
+    {
+        EVENT_SUBMISSION* submission = (EVENT_SUBMISSION*)node;
+        node = node->next;
+
+        if (submission->eventConfirmationCallback != NULL)
+        {
+            submission->eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, submission->userContextCallback);
+        }
+        IoTHubMessage_Destroy(submission->message);
+        free(submission);
+    }
+}
+
 static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG* config, TRANSPORT_HANDLE transportHandle, const char* connectionString, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
 {
     IOTHUB_CLIENT_INSTANCE* result = (IOTHUB_CLIENT_INSTANCE*)malloc(sizeof(IOTHUB_CLIENT_INSTANCE));
@@ -517,7 +675,20 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
             else
 #endif
             {
+#ifndef DONT_USE_UPLOADTOBLOB
+                /*the upload workers are only created by the first IoTHubClient_UploadToBlobAsync*/
+                result->uploadLock = NULL;
+                result->uploadCondition = NULL;
+                result->uploadQueueHead = NULL;
+                result->uploadQueueTail = NULL;
+                result->uploadQueueLength = 0;
+                result->uploadWorkerCount = 0;
+                result->StopUploadWorkers = 0;
+#endif
                 result->TransportHandle = transportHandle;
+                result->TransportPool = NULL;
+                submission_queue_init(&result->event_submissions);
+                result->shared_worker_started = 0;
                 result->created_with_transport_handle = 0;
                 if (config != NULL)
                 {
@@ -687,6 +858,37 @@ IOTHUB_CLIENT_HANDLE IoTHubClient_CreateWithTransport(TRANSPORT_HANDLE transport
     return result;
 }
 
+IOTHUB_CLIENT_HANDLE IoTHubClient_CreateWithTransportPool(TRANSPORT_POOL_HANDLE transportPoolHandle, const IOTHUB_CLIENT_CONFIG* config)
+{
+    IOTHUB_CLIENT_INSTANCE* result;
+    TRANSPORT_HANDLE transportHandle;
+
+    /*Codes_SRS_IOTHUBCLIENT_02_084: [ IoTHubClient_CreateWithTransportPool shall return NULL if transportPoolHandle or config are NULL. ]*/
+    if (transportPoolHandle == NULL || config == NULL)
+    {
+        LogError("invalid parameter TRANSPORT_POOL_HANDLE transportPoolHandle=%p, const IOTHUB_CLIENT_CONFIG* config=%p", transportPoolHandle, config);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_02_085: [ IoTHubClient_CreateWithTransportPool shall get the transport of the new client by calling IoTHubTransportPool_AcquireTransport and fail if it returns NULL. ]*/
+    else if ((transportHandle = IoTHubTransportPool_AcquireTransport(transportPoolHandle)) == NULL)
+    {
+        LogError("unable to IoTHubTransportPool_AcquireTransport");
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_02_086: [ IoTHubClient_CreateWithTransportPool shall then create the client the same way IoTHubClient_CreateWithTransport does. ]*/
+    else if ((result = create_iothub_instance(config, transportHandle, NULL, NULL)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_02_087: [ If creating the client fails, IoTHubClient_CreateWithTransportPool shall call IoTHubTransportPool_ReleaseTransport and return NULL. ]*/
+        LogError("unable to create the client on the pooled transport");
+        IoTHubTransportPool_ReleaseTransport(transportPoolHandle, transportHandle);
+    }
+    else
+    {
+        result->TransportPool = transportPoolHandle;
+    }
+    return result;
+}
+
 /* Codes_SRS_IOTHUBCLIENT_01_005: [IoTHubClient_Destroy shall free all resources associated with the iotHubClientHandle instance.] */
 void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
 {
@@ -728,6 +930,9 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
             okToJoin = IoTHubTransport_SignalEndWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
         }
 
+        /*Codes_SRS_IOTHUBCLIENT_02_095: [ IoTHubClient_Destroy shall call the event confirmation callback of the events still in the submission queue with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY and free them. ]*/
+        discard_event_submissions(iotHubClientInstance);
+
         /* Codes_SRS_IOTHUBCLIENT_01_006: [That includes destroying the IoTHubClient_LL instance by calling IoTHubClient_LL_Destroy.] */
         IoTHubClient_LL_Destroy(iotHubClientInstance->IoTHubClientLLHandle);
 
@@ -744,6 +949,11 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
             LogError("unable to Unlock");
         }
 
+#ifndef DONT_USE_UPLOADTOBLOB
+        /*Codes_SRS_IOTHUBCLIENT_02_080: [ IoTHubClient_Destroy shall signal the upload workers (if any) to end, join them and destroy the upload lock and condition. ]*/
+        StopUploadWorkers(iotHubClientInstance);
+#endif
+
         if (okToJoin == true)
         {
             if (iotHubClientInstance->ThreadHandle != NULL)
@@ -763,6 +973,12 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
             }
         }
 
+        if (iotHubClientInstance->TransportPool != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_02_088: [ If the client was created with IoTHubClient_CreateWithTransportPool, IoTHubClient_Destroy shall give its transport back by calling IoTHubTransportPool_ReleaseTransport. ]*/
+            IoTHubTransportPool_ReleaseTransport(iotHubClientInstance->TransportPool, iotHubClientInstance->TransportHandle);
+        }
+
         vector_size = VECTOR_size(iotHubClientInstance->saved_user_callback_list);
         size_t index = 0;
         for (index = 0; index < vector_size; index++)
@@ -824,8 +1040,13 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
     {
         IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
 
+        if (iotHubClientInstance->created_with_transport_handle != 0)
+        {
+            /*the events are handed to IoTHubClient_LL_SendEventAsync by the transport worker thread, in IoTHubClient_ProcessSubmissions*/
+            result = submit_event(iotHubClientInstance, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+        }
         /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
             /* Codes_SRS_IOTHUBCLIENT_01_026: [If acquiring the lock fails, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_ERROR.] */
             result = IOTHUB_CLIENT_ERROR;
@@ -833,10 +1054,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
         }
         else
         {
-            if (iotHubClientInstance->created_with_transport_handle == 0)
-            {
-                iotHubClientInstance->event_confirm_callback = eventConfirmationCallback;
-            }
+            iotHubClientInstance->event_confirm_callback = eventConfirmationCallback;
             /* Codes_SRS_IOTHUBCLIENT_01_009: [IoTHubClient_SendEventAsync shall start the worker thread if it was not previously started.] */
             if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
             {
@@ -846,7 +1064,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
             }
             else
             {
-                if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
+                if (eventConfirmationCallback == NULL)
                 {
                     result = IoTHubClient_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
                 }
@@ -918,6 +1136,39 @@ IOTHUB_CLIENT_RESULT IoTHubClient_GetSendStatus(IOTHUB_CLIENT_HANDLE iotHubClien
     return result;
 }
 
+void IoTHubClient_ProcessSubmissions(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
+{
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_02_094: [ If iotHubClientHandle is NULL, IoTHubClient_ProcessSubmissions shall do nothing. ]*/
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+        SUBMISSION_QUEUE_NODE* node = submission_queue_take_all(&iotHubClientInstance->event_submissions);
+
+        while (node != NULL)
+        {
+            EVENT_SUBMISSION* submission = (EVENT_SUBMISSION*)node;
+            node = node->next;
+
+            /*Codes_SRS_IOTHUBCLIENT_02_092: [ IoTHubClient_ProcessSubmissions shall pass the queued events, oldest first, to IoTHubClient_LL_SendEventAsyncTakeOwnership, handing over the message clones instead of cloning them again. ]*/
+            if (IoTHubClient_LL_SendEventAsyncTakeOwnership(iotHubClientInstance->IoTHubClientLLHandle, submission->message, submission->eventConfirmationCallback, submission->userContextCallback) != IOTHUB_CLIENT_OK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_02_093: [ If IoTHubClient_LL_SendEventAsyncTakeOwnership fails, IoTHubClient_ProcessSubmissions shall destroy the message clone and call the event confirmation callback with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+                LogError("IoTHubClient_LL_SendEventAsyncTakeOwnership failed");
+                IoTHubMessage_Destroy(submission->message);
+                if (submission->eventConfirmationCallback != NULL)
+                {
+                    submission->eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_ERROR, submission->userContextCallback);
+                }
+            }
+            free(submission);
+        }
+    }
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_SetMessageCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1498,10 +1749,8 @@ IOTHUB_CLIENT_RESULT IoTHubClient_DeviceMethodResponse(IOTHUB_CLIENT_HANDLE iotH
 }
 
 #ifndef DONT_USE_UPLOADTOBLOB
-static int uploadingThread(void *data)
+static void uploadOne(UPLOADTOBLOB_SAVED_DATA* savedData)
 {
-    UPLOADTOBLOB_SAVED_DATA* savedData = (UPLOADTOBLOB_SAVED_DATA*)data;
-
     /*it so happens that IoTHubClient_LL_UploadToBlob is thread-safe because there's no saved state in the handle and there are no globals, so no need to protect it*/
     /*not having it protected means multiple simultaneous uploads can happen*/
     /*Codes_SRS_IOTHUBCLIENT_02_054: [ The thread shall call IoTHubClient_LL_UploadToBlob passing the information packed in the structure. ]*/
@@ -1523,24 +1772,128 @@ static int uploadingThread(void *data)
             savedData->iotHubClientFileUploadCallback(FILE_UPLOAD_OK, savedData->context);
         }
     }
+}
+
+static int uploadingThread(void *data)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)data;
 
-    /*Codes_SRS_IOTHUBCLIENT_02_071: [ The thread shall mark itself as disposable. ]*/
-    if (Lock(savedData->lockGarbage) != LOCK_OK)
+    if (Lock(iotHubClientInstance->uploadLock) != LOCK_OK)
     {
-        LogError("unable to Lock - trying anyway");
-        savedData->canBeGarbageCollected = 1;
+        LogError("unable to Lock - upload worker exits");
     }
     else
     {
-        savedData->canBeGarbageCollected = 1;
+        int isLocked = 1;
 
-        if (Unlock(savedData->lockGarbage) != LOCK_OK)
+        /*Codes_SRS_IOTHUBCLIENT_02_079: [ The upload worker shall exit when IoTHubClient_Destroy signals it to end. ]*/
+        while (!iotHubClientInstance->StopUploadWorkers)
         {
-            LogError("unable to Unlock after locking");
+            /*Codes_SRS_IOTHUBCLIENT_02_078: [ The upload worker shall take the oldest queued upload. If there is none, it shall wait on the upload condition. ]*/
+            UPLOADTOBLOB_SAVED_DATA* savedData = iotHubClientInstance->uploadQueueHead;
+            if (savedData == NULL)
+            {
+                (void)Condition_Wait(iotHubClientInstance->uploadCondition, iotHubClientInstance->uploadLock, UPLOADTOBLOB_WORKER_IDLE_WAIT_MS);
+            }
+            else
+            {
+                iotHubClientInstance->uploadQueueHead = savedData->next;
+                if (iotHubClientInstance->uploadQueueHead == NULL)
+                {
+                    iotHubClientInstance->uploadQueueTail = NULL;
+                }
+                iotHubClientInstance->uploadQueueLength--;
+                savedData->next = NULL;
+
+                (void)Unlock(iotHubClientInstance->uploadLock);
+
+                uploadOne(savedData);
+
+                /*Codes_SRS_IOTHUBCLIENT_02_071: [ The thread shall mark the upload as disposable. ]*/
+                if (Lock(iotHubClientInstance->uploadLock) != LOCK_OK)
+                {
+                    LogError("unable to Lock - trying anyway, upload worker exits");
+                    savedData->canBeGarbageCollected = 1;
+                    isLocked = 0;
+                    break;
+                }
+                else
+                {
+                    savedData->canBeGarbageCollected = 1;
+                }
+            }
+        }
+
+        if (isLocked == 1)
+        {
+            (void)Unlock(iotHubClientInstance->uploadLock);
         }
     }
     return 0;
 }
+
+/*called with LockHandle held, creates the upload workers the first time a file upload is requested*/
+static IOTHUB_CLIENT_RESULT StartUploadWorkersIfNeeded(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientInstance->uploadLock != NULL)
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_02_075: [ The first call to IoTHubClient_UploadToBlobAsync shall create an upload lock, an upload condition and UPLOADTOBLOB_WORKER_COUNT upload workers. ]*/
+        if ((iotHubClientInstance->uploadLock = Lock_Init()) == NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_02_076: [ If creating the lock, the condition or all of the upload workers fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("unable to Lock_Init");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            if ((iotHubClientInstance->uploadCondition = Condition_Init()) == NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_02_076: [ If creating the lock, the condition or all of the upload workers fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("unable to Condition_Init");
+                (void)Lock_Deinit(iotHubClientInstance->uploadLock);
+                iotHubClientInstance->uploadLock = NULL;
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                size_t i;
+                iotHubClientInstance->StopUploadWorkers = 0;
+                iotHubClientInstance->uploadWorkerCount = 0;
+                for (i = 0; i < UPLOADTOBLOB_WORKER_COUNT; i++)
+                {
+                    if (ThreadAPI_Create(&iotHubClientInstance->uploadWorkers[iotHubClientInstance->uploadWorkerCount], uploadingThread, iotHubClientInstance) != THREADAPI_OK)
+                    {
+                        LogError("unable to ThreadAPI_Create upload worker %zu", i);
+                    }
+                    else
+                    {
+                        iotHubClientInstance->uploadWorkerCount++;
+                    }
+                }
+
+                if (iotHubClientInstance->uploadWorkerCount == 0)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_02_076: [ If creating the lock, the condition or all of the upload workers fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                    Condition_Deinit(iotHubClientInstance->uploadCondition);
+                    iotHubClientInstance->uploadCondition = NULL;
+                    (void)Lock_Deinit(iotHubClientInstance->uploadLock);
+                    iotHubClientInstance->uploadLock = NULL;
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+        }
+    }
+    return result;
+}
 #endif
 
 #ifndef DONT_USE_UPLOADTOBLOB
@@ -1641,6 +1994,14 @@ IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlobAsync(IOTHUB_CLIENT_HANDLE iotHubC
                             result = IOTHUB_CLIENT_ERROR;
                             LogError("Could not start worker thread");
                         }
+                        else if (StartUploadWorkersIfNeeded(iotHubClientHandleData) != IOTHUB_CLIENT_OK)
+                        {
+                            free(savedData->source);
+                            free(savedData->destinationFileName);
+                            free(savedData);
+                            result = IOTHUB_CLIENT_ERROR;
+                            LogError("Could not start upload workers");
+                        }
                         else
                         {
                             /*Codes_SRS_IOTHUBCLIENT_02_058: [ IoTHubClient_UploadToBlobAsync shall add the structure to the list of structures that need to be cleaned once file upload finishes. ]*/
@@ -1657,23 +2018,23 @@ IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlobAsync(IOTHUB_CLIENT_HANDLE iotHubC
                             {
                                 savedData->iotHubClientHandle = iotHubClientHandle;
                                 savedData->canBeGarbageCollected = 0;
-                                if ((savedData->lockGarbage = Lock_Init()) == NULL)
+                                savedData->next = NULL;
+                                if (Lock(iotHubClientHandleData->uploadLock) != LOCK_OK)
                                 {
+                                    /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or queueing the upload fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                                    LogError("unable to Lock");
                                     (void)singlylinkedlist_remove(iotHubClientHandleData->savedDataToBeCleaned, item);
                                     free(savedData->source);
                                     free(savedData->destinationFileName);
                                     free(savedData);
                                     result = IOTHUB_CLIENT_ERROR;
-                                    LogError("unable to Lock_Init");
                                 }
                                 else
                                 {
-                                    /*Codes_SRS_IOTHUBCLIENT_02_052: [ IoTHubClient_UploadToBlobAsync shall spawn a thread passing the structure build in SRS IOTHUBCLIENT 02 051 as thread data.]*/
-                                    if (ThreadAPI_Create(&savedData->uploadingThreadHandle, uploadingThread, savedData) != THREADAPI_OK)
+                                    if (iotHubClientHandleData->uploadQueueLength >= UPLOADTOBLOB_MAX_QUEUED)
                                     {
-                                        /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
-                                        LogError("unablet to ThreadAPI_Create");
-                                        (void)Lock_Deinit(savedData->lockGarbage);
+                                        /*Codes_SRS_IOTHUBCLIENT_02_077: [ If UPLOADTOBLOB_MAX_QUEUED uploads are already waiting for a worker, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                                        LogError("too many file uploads waiting (%zu), try again later", iotHubClientHandleData->uploadQueueLength);
                                         (void)singlylinkedlist_remove(iotHubClientHandleData->savedDataToBeCleaned, item);
                                         free(savedData->source);
                                         free(savedData->destinationFileName);
@@ -1682,8 +2043,21 @@ IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlobAsync(IOTHUB_CLIENT_HANDLE iotHubC
                                     }
                                     else
                                     {
+                                        /*Codes_SRS_IOTHUBCLIENT_02_052: [ IoTHubClient_UploadToBlobAsync shall append the structure build in SRS IOTHUBCLIENT 02 051 to the upload queue and signal the upload condition. ]*/
+                                        if (iotHubClientHandleData->uploadQueueTail == NULL)
+                                        {
+                                            iotHubClientHandleData->uploadQueueHead = savedData;
+                                        }
+                                        else
+                                        {
+                                            iotHubClientHandleData->uploadQueueTail->next = savedData;
+                                        }
+                                        iotHubClientHandleData->uploadQueueTail = savedData;
+                                        iotHubClientHandleData->uploadQueueLength++;
+                                        (void)Condition_Post(iotHubClientHandleData->uploadCondition);
                                         result = IOTHUB_CLIENT_OK;
                                     }
+                                    (void)Unlock(iotHubClientHandleData->uploadLock);
                                 }
                             }
                         }
@@ -1695,4 +2069,132 @@ IOTHUB_CLIENT_RESULT IoTHubClient_UploadToBlobAsync(IOTHUB_CLIENT_HANDLE iotHubC
     }
     return result;
 }
+
+IOTHUB_CLIENT_RESULT IoTHubClient_CancelUploadToBlobAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const char* destinationFileName)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_02_081: [ If iotHubClientHandle or destinationFileName is NULL then IoTHubClient_CancelUploadToBlobAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_HANDLE iotHubClientHandle = %p , const char* destinationFileName = %s",
+            iotHubClientHandle,
+            destinationFileName
+        );
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+        UPLOADTOBLOB_SAVED_DATA* cancelledHead = NULL;
+        UPLOADTOBLOB_SAVED_DATA* cancelledTail = NULL;
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            LogError("unable to Lock");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            if (iotHubClientInstance->uploadLock != NULL)
+            {
+                if (Lock(iotHubClientInstance->uploadLock) != LOCK_OK)
+                {
+                    LogError("unable to Lock");
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_02_082: [ IoTHubClient_CancelUploadToBlobAsync shall remove from the upload queue all the uploads to destinationFileName that no worker has started and shall call their callbacks with FILE_UPLOAD_CANCELLED. ]*/
+                    UPLOADTOBLOB_SAVED_DATA* previous = NULL;
+                    UPLOADTOBLOB_SAVED_DATA* current = iotHubClientInstance->uploadQueueHead;
+                    while (current != NULL)
+                    {
+                        UPLOADTOBLOB_SAVED_DATA* next = current->next;
+                        if (strcmp(current->destinationFileName, destinationFileName) == 0)
+                        {
+                            if (previous == NULL)
+                            {
+                                iotHubClientInstance->uploadQueueHead = next;
+                            }
+                            else
+                            {
+                                previous->next = next;
+                            }
+
+                            if (iotHubClientInstance->uploadQueueTail == current)
+                            {
+                                iotHubClientInstance->uploadQueueTail = previous;
+                            }
+                            iotHubClientInstance->uploadQueueLength--;
+
+                            current->next = NULL;
+                            if (cancelledTail == NULL)
+                            {
+                                cancelledHead = current;
+                            }
+                            else
+                            {
+                                cancelledTail->next = current;
+                            }
+                            cancelledTail = current;
+                        }
+                        else
+                        {
+                            previous = current;
+                        }
+                        current = next;
+                    }
+                    (void)Unlock(iotHubClientInstance->uploadLock);
+                }
+            }
+            (void)Unlock(iotHubClientInstance->LockHandle);
+
+            if (cancelledHead == NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_02_083: [ If no upload was removed then IoTHubClient_CancelUploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR, otherwise it shall return IOTHUB_CLIENT_OK. ]*/
+                LogError("no file upload to %s is waiting for a worker", destinationFileName);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                UPLOADTOBLOB_SAVED_DATA* current;
+
+                /*Codes_SRS_IOTHUBCLIENT_02_082: [ IoTHubClient_CancelUploadToBlobAsync shall remove from the upload queue all the uploads to destinationFileName that no worker has started and shall call their callbacks with FILE_UPLOAD_CANCELLED. ]*/
+                for (current = cancelledHead; current != NULL; current = current->next)
+                {
+                    if (current->iotHubClientFileUploadCallback != NULL)
+                    {
+                        current->iotHubClientFileUploadCallback(FILE_UPLOAD_CANCELLED, current->context);
+                    }
+                }
+
+                /*the cancelled uploads are freed by the garbage collector as any other finished upload*/
+                int isLocked = (Lock(iotHubClientInstance->uploadLock) == LOCK_OK);
+                if (!isLocked)
+                {
+                    LogError("unable to Lock - trying anyway");
+                }
+
+                current = cancelledHead;
+                while (current != NULL)
+                {
+                    UPLOADTOBLOB_SAVED_DATA* next = current->next;
+                    current->canBeGarbageCollected = 1;
+                    current = next;
+                }
+
+                if (isLocked)
+                {
+                    (void)Unlock(iotHubClientInstance->uploadLock);
+                }
+
+                /*Codes_SRS_IOTHUBCLIENT_02_083: [ If no upload was removed then IoTHubClient_CancelUploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR, otherwise it shall return IOTHUB_CLIENT_OK. ]*/
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+    }
+    return result;
+}
 #endif /*DONT_USE_UPLOADTOBLOB*/
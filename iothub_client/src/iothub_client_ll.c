@@ -23,10 +23,21 @@
 
 #define LOG_ERROR_RESULT LogError("result = %s", ENUM_TO_STRING(IOTHUB_CLIENT_RESULT, result));
 #define INDEFINITE_TIME ((time_t)(-1))
+#define METHOD_HANDLER_BUCKET_COUNT 16
+#define METHOD_NOT_IMPLEMENTED_STATUS 501
 
 DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
 DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_RESULT_VALUES);
 
+typedef struct METHOD_HANDLER_ENTRY_TAG
+{
+    uint32_t hash;
+    IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC callback;
+    void* context;
+    struct METHOD_HANDLER_ENTRY_TAG* next;
+    char* method_name; /*points at the end of this allocation*/
+} METHOD_HANDLER_ENTRY;
+
 typedef struct IOTHUB_CLIENT_LL_HANDLE_DATA_TAG
 {
     DLIST_ENTRY waitingToSend;
@@ -49,6 +60,8 @@ typedef struct IOTHUB_CLIENT_LL_HANDLE_DATA_TAG
     IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC deviceMethodCallback;
     IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK deviceInboundMethodCallback;
     void* deviceMethodUserContextCallback;
+    METHOD_HANDLER_ENTRY* methodHandlers[METHOD_HANDLER_BUCKET_COUNT];
+    size_t methodHandlerCount;
     IOTHUB_CLIENT_RETRY_POLICY retryPolicy;
     size_t retryTimeoutLimitInSeconds;
 #ifndef DONT_USE_UPLOADTOBLOB
@@ -65,6 +78,44 @@ static const char X509_TOKEN_ONLY_ACCEPTABLE_VALUE[] = "true";
 static const char DEVICEKEY_TOKEN[] = "SharedAccessKey";
 static const char DEVICESAS_TOKEN[] = "SharedAccessSignature";
 static const char PROTOCOL_GATEWAY_HOST[] = "GatewayHostName";
+static const unsigned char METHOD_NOT_IMPLEMENTED_RESPONSE[] = "{}";
+
+/*FNV-1a, good enough to spread the handful of method names a device registers*/
+static uint32_t hash_method_name(const char* method_name)
+{
+    uint32_t result = 2166136261u;
+    while (*method_name != '\0')
+    {
+        result ^= (unsigned char)*method_name++;
+        result *= 16777619u;
+    }
+    return result;
+}
+
+static METHOD_HANDLER_ENTRY** find_method_handler(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const char* method_name, uint32_t hash)
+{
+    METHOD_HANDLER_ENTRY** result = &handleData->methodHandlers[hash % METHOD_HANDLER_BUCKET_COUNT];
+    while (*result != NULL && ((*result)->hash != hash || strcmp((*result)->method_name, method_name) != 0))
+    {
+        result = &(*result)->next;
+    }
+    return result;
+}
+
+static void destroy_method_handlers(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    size_t i;
+    for (i = 0; i < METHOD_HANDLER_BUCKET_COUNT; i++)
+    {
+        while (handleData->methodHandlers[i] != NULL)
+        {
+            METHOD_HANDLER_ENTRY* next = handleData->methodHandlers[i]->next;
+            free(handleData->methodHandlers[i]);
+            handleData->methodHandlers[i] = next;
+        }
+    }
+    handleData->methodHandlerCount = 0;
+}
 
 static void device_twin_data_destroy(IOTHUB_DEVICE_TWIN* client_item)
 {
@@ -474,6 +525,8 @@ IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_Create(const IOTHUB_CLIENT_CONFIG* confi
                     handleData->deviceMethodCallback = NULL;
                     handleData->deviceInboundMethodCallback = NULL;
                     handleData->deviceMethodUserContextCallback = NULL;
+                    memset(handleData->methodHandlers, 0, sizeof(handleData->methodHandlers));
+                    handleData->methodHandlerCount = 0;
                     handleData->lastMessageReceiveTime = INDEFINITE_TIME;
                     handleData->data_msg_id = 1;
                     handleData->complete_twin_update_encountered = false;
@@ -645,6 +698,8 @@ IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_CreateWithTransport(const IOTHUB_CLIENT_
                             handleData->deviceMethodCallback = NULL;
                             handleData->deviceInboundMethodCallback = NULL;
                             handleData->deviceMethodUserContextCallback = NULL;
+                            memset(handleData->methodHandlers, 0, sizeof(handleData->methodHandlers));
+                            handleData->methodHandlerCount = 0;
                             handleData->lastMessageReceiveTime = INDEFINITE_TIME;
                             handleData->data_msg_id = 1;
                             handleData->complete_twin_update_encountered = false;
@@ -736,6 +791,7 @@ void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
         }
 
         /*Codes_SRS_IOTHUBCLIENT_LL_17_011: [IoTHubClient_LL_Destroy  shall free the resources allocated by IoTHubClient (if any).] */
+        destroy_method_handlers(handleData);
         tickcounter_destroy(handleData->tickCounter);
 #ifndef DONT_USE_UPLOADTOBLOB
         IoTHubClient_LL_UploadToBlob_Destroy(handleData->uploadToBlobHandle);
@@ -772,7 +828,7 @@ static int attach_ms_timesOutAfter(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOT
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+static IOTHUB_CLIENT_RESULT queue_event(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool take_ownership)
 {
     IOTHUB_CLIENT_RESULT result;
     /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
@@ -807,7 +863,8 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
-                if ((newEntry->messageHandle = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
+                /*Codes_SRS_IOTHUBCLIENT_LL_02_111: [ IoTHubClient_LL_SendEventAsyncTakeOwnership shall behave as IoTHubClient_LL_SendEventAsync, except that the new record shall hold eventMessageHandle itself instead of a clone of it. ]*/
+                if ((newEntry->messageHandle = (take_ownership ? eventMessageHandle : IoTHubMessage_Clone(eventMessageHandle))) == NULL)
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information fails for any reason, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
                     result = IOTHUB_CLIENT_ERROR;
@@ -829,6 +886,17 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return queue_event(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, false);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsyncTakeOwnership(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_112: [ If IoTHubClient_LL_SendEventAsyncTakeOwnership fails, the ownership of eventMessageHandle shall remain with the caller. ]*/
+    return queue_event(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, true);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1004,6 +1072,28 @@ void IoTHubClient_LL_SendComplete(IOTHUB_CLIENT_LL_HANDLE handle, PDLIST_ENTRY c
     }
 }
 
+static int invoke_device_method_callback(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC callback, void* context, const char* method_name, const unsigned char* payLoad, size_t size, METHOD_HANDLE response_id)
+{
+    int result;
+    unsigned char* payload_resp = NULL;
+    size_t response_size = 0;
+    result = callback(method_name, payLoad, size, &payload_resp, &response_size, context);
+    /* Codes_SRS_IOTHUBCLIENT_LL_07_020: [ deviceMethodCallback shall buil the BUFFER_HANDLE with the response payload from the IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC callback. ] */
+    if (payload_resp != NULL && response_size > 0)
+    {
+        result = handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, response_id, payload_resp, response_size, result);
+    }
+    else
+    {
+        result = __FAILURE__;
+    }
+    if (payload_resp != NULL)
+    {
+        free(payload_resp);
+    }
+    return result;
+}
+
 int IoTHubClient_LL_DeviceMethodComplete(IOTHUB_CLIENT_LL_HANDLE handle, const char* method_name, const unsigned char* payLoad, size_t size, METHOD_HANDLE response_id)
 {
     int result;
@@ -1015,31 +1105,32 @@ int IoTHubClient_LL_DeviceMethodComplete(IOTHUB_CLIENT_LL_HANDLE handle, const c
     }
     else
     {
-        /* Codes_SRS_IOTHUBCLIENT_LL_07_018: [ If deviceMethodCallback is not NULL IoTHubClient_LL_DeviceMethodComplete shall execute deviceMethodCallback and return the status. ] */
         IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)handle;
-        if (handleData->deviceMethodCallback)
+        METHOD_HANDLER_ENTRY* handler = NULL;
+        if (handleData->methodHandlerCount > 0 && method_name != NULL)
         {
-            unsigned char* payload_resp = NULL;
-            size_t response_size = 0;
-            result = handleData->deviceMethodCallback(method_name, payLoad, size, &payload_resp, &response_size, handleData->deviceMethodUserContextCallback);
-            /* Codes_SRS_IOTHUBCLIENT_LL_07_020: [ deviceMethodCallback shall buil the BUFFER_HANDLE with the response payload from the IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC callback. ] */
-            if (payload_resp != NULL && response_size > 0)
-            {
-                result = handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, response_id, payload_resp, response_size, result);
-            }
-            else
-            {
-                result = __FAILURE__;
-            }
-            if (payload_resp != NULL)
-            {
-                free(payload_resp);
-            }
+            handler = *find_method_handler(handleData, method_name, hash_method_name(method_name));
+        }
+
+        if (handler != NULL)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_LL_21_005: [ If a handler is registered for method_name, IoTHubClient_LL_DeviceMethodComplete shall execute it instead of deviceMethodCallback and send its response. ] */
+            result = invoke_device_method_callback(handleData, handler->callback, handler->context, method_name, payLoad, size, response_id);
+        }
+        /* Codes_SRS_IOTHUBCLIENT_LL_07_018: [ If deviceMethodCallback is not NULL IoTHubClient_LL_DeviceMethodComplete shall execute deviceMethodCallback and return the status. ] */
+        else if (handleData->deviceMethodCallback)
+        {
+            result = invoke_device_method_callback(handleData, handleData->deviceMethodCallback, handleData->deviceMethodUserContextCallback, method_name, payLoad, size, response_id);
         }
         else if (handleData->deviceInboundMethodCallback)
         {
             result = handleData->deviceInboundMethodCallback(method_name, payLoad, size, response_id, handleData->deviceMethodUserContextCallback);
         }
+        else if (handleData->methodHandlerCount > 0)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_LL_21_006: [ If handlers are registered but none matches method_name and no device method callback is set, IoTHubClient_LL_DeviceMethodComplete shall answer with status 501 without calling the application. ] */
+            result = handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, response_id, METHOD_NOT_IMPLEMENTED_RESPONSE, sizeof(METHOD_NOT_IMPLEMENTED_RESPONSE) - 1, METHOD_NOT_IMPLEMENTED_STATUS);
+        }
         else
         {
             /* Codes_SRS_IOTHUBCLIENT_LL_07_019: [ If deviceMethodCallback is NULL IoTHubClient_LL_DeviceMethodComplete shall return 404. ] */
@@ -1439,7 +1530,10 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodCallback(IOTHUB_CLIENT_LL_HA
         {
             /*Codes_SRS_IOTHUBCLIENT_LL_12_018: [If deviceMethodCallback is NULL, then IoTHubClient_LL_SetDeviceMethodCallback shall call the underlying layer's IoTHubTransport_Unsubscribe_DeviceMethod function and return IOTHUB_CLIENT_OK. ] */
             /*Codes_SRS_IOTHUBCLIENT_LL_12_022: [ Otherwise IoTHubClient_LL_SetDeviceMethodCallback shall succeed and return IOTHUB_CLIENT_OK. ]*/
-            handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->transportHandle);
+            if (handleData->methodHandlerCount == 0)
+            {
+                handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->transportHandle);
+            }
             handleData->deviceMethodCallback = NULL;
             result = IOTHUB_CLIENT_OK;
         }
@@ -1480,7 +1574,10 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodCallback_Ex(IOTHUB_CLIENT_LL
         if (inboundDeviceMethodCallback == NULL)
         {
             /* Codes_SRS_IOTHUBCLIENT_LL_07_022: [ If inboundDeviceMethodCallback is NULL then IoTHubClient_LL_SetDeviceMethodCallback_Ex shall call the underlying layer's IoTHubTransport_Unsubscribe_DeviceMethod function and return IOTHUB_CLIENT_OK.] */
-            handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->transportHandle);
+            if (handleData->methodHandlerCount == 0)
+            {
+                handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->transportHandle);
+            }
             handleData->deviceInboundMethodCallback = NULL;
             result = IOTHUB_CLIENT_OK;
         }
@@ -1505,6 +1602,78 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodCallback_Ex(IOTHUB_CLIENT_LL
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_RegisterMethodHandler(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* method_name, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC methodCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /* Codes_SRS_IOTHUBCLIENT_LL_21_001: [ If iotHubClientHandle or method_name is NULL then IoTHubClient_LL_RegisterMethodHandler shall return IOTHUB_CLIENT_INVALID_ARG. ] */
+    if (iotHubClientHandle == NULL || method_name == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        uint32_t hash = hash_method_name(method_name);
+        METHOD_HANDLER_ENTRY** slot = find_method_handler(handleData, method_name, hash);
+
+        if (methodCallback == NULL)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_LL_21_004: [ If methodCallback is NULL, IoTHubClient_LL_RegisterMethodHandler shall remove the handler for method_name, and call IoTHubTransport_Unsubscribe_DeviceMethod when no handler or device method callback remains. ] */
+            if (*slot != NULL)
+            {
+                METHOD_HANDLER_ENTRY* removed = *slot;
+                *slot = removed->next;
+                free(removed);
+                handleData->methodHandlerCount--;
+                if (handleData->methodHandlerCount == 0 && handleData->deviceMethodCallback == NULL && handleData->deviceInboundMethodCallback == NULL)
+                {
+                    handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->transportHandle);
+                }
+            }
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (*slot != NULL)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_LL_21_003: [ If a handler is already registered for method_name, IoTHubClient_LL_RegisterMethodHandler shall replace it. ] */
+            (*slot)->callback = methodCallback;
+            (*slot)->context = userContextCallback;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else
+        {
+            size_t name_length = strlen(method_name) + 1;
+            METHOD_HANDLER_ENTRY* entry = (METHOD_HANDLER_ENTRY*)malloc(sizeof(METHOD_HANDLER_ENTRY) + name_length);
+            if (entry == NULL)
+            {
+                /* Codes_SRS_IOTHUBCLIENT_LL_21_007: [ If any error is encountered then IoTHubClient_LL_RegisterMethodHandler shall return IOTHUB_CLIENT_ERROR. ] */
+                result = IOTHUB_CLIENT_ERROR;
+                LOG_ERROR_RESULT;
+            }
+            /* Codes_SRS_IOTHUBCLIENT_LL_21_002: [ When registering the first handler, IoTHubClient_LL_RegisterMethodHandler shall call the underlying layer's IoTHubTransport_Subscribe_DeviceMethod function. ] */
+            else if (handleData->methodHandlerCount == 0 && handleData->IoTHubTransport_Subscribe_DeviceMethod(handleData->deviceHandle) != 0)
+            {
+                free(entry);
+                result = IOTHUB_CLIENT_ERROR;
+                LOG_ERROR_RESULT;
+            }
+            else
+            {
+                entry->method_name = (char*)(entry + 1);
+                (void)memcpy(entry->method_name, method_name, name_length);
+                entry->hash = hash;
+                entry->callback = methodCallback;
+                entry->context = userContextCallback;
+                entry->next = NULL;
+                *slot = entry;
+                handleData->methodHandlerCount++;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_DeviceMethodResponse(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, METHOD_HANDLE methodId, const unsigned char* response, size_t response_size, int status_response)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1552,4 +1721,45 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob(IOTHUB_CLIENT_LL_HANDLE iotHub
     }
     return result;
 }
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_READ_CALLBACK readCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_21_001: [ If iotHubClientHandle, destinationFileName or readCallback is NULL then IoTHubClient_LL_UploadMultipleBlocksToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL) ||
+        (readCallback == NULL)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle=%p, const char* destinationFileName=%s, readCallback=%p", iotHubClientHandle, destinationFileName, readCallback);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        result = IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(iotHubClientHandle->uploadToBlobHandle, destinationFileName, readCallback, context);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_READ_CALLBACK readCallback, void* context, const char* journal, IOTHUB_CLIENT_FILE_UPLOAD_JOURNAL_CALLBACK journalCallback, void* journalContext)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_21_014: [ If iotHubClientHandle, destinationFileName, readCallback or journalCallback is NULL then IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL) ||
+        (readCallback == NULL) ||
+        (journalCallback == NULL)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle=%p, const char* destinationFileName=%s, readCallback=%p, journalCallback=%p", iotHubClientHandle, destinationFileName, readCallback, journalCallback);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        result = IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_Impl(iotHubClientHandle->uploadToBlobHandle, destinationFileName, readCallback, context, journal, journalCallback, journalContext);
+    }
+    return result;
+}
 #endif
@@ -6,6 +6,7 @@
 #else
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
@@ -14,6 +15,7 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
+#include "azure_c_shared_utility/agenttime.h"
 
 #include "iothub_client_ll.h"
 #include "iothub_client_options.h"
@@ -43,6 +45,9 @@ int snprintf(char * s, size_t n, const char * format, ...)
 /*Codes_SRS_IOTHUBCLIENT_LL_02_085: [ IoTHubClient_LL_UploadToBlob shall use the same authorization as step 1. to prepare and perform a HTTP request with the following parameters: ]*/
 #define FILE_UPLOAD_FAILED_BODY "{ \"isSuccess\":false, \"statusCode\":-1,\"statusDescription\" : \"client not able to connect with the server\" }"
 
+/*a journal is not resumed when its SAS URI expires in less than this (seconds)*/
+#define JOURNAL_MINIMUM_SAS_LIFETIME 300
+
 #define AUTHORIZATION_SCHEME_VALUES \
     DEVICE_KEY, \
     X509,       \
@@ -65,8 +70,252 @@ typedef struct IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA_TAG
         STRING_HANDLE sas;          /*used when authorizationScheme is SAS_TOKEN*/
         UPLOADTOBLOB_X509_CREDENTIALS x509credentials; /*assumed to be used when both deviceKey and deviceSasToken are NULL*/
     } credentials;                              /*needed for file upload*/
+    size_t blobUploadConcurrency;               /*number of blocks uploaded to storage at the same time*/
 }IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA;
 
+/*feeds an in-memory source to Blob_UploadMultipleBlocksFromSasUri*/
+typedef struct UPLOADTOBLOB_MEMORY_SOURCE_TAG
+{
+    const unsigned char* source;
+    size_t size;
+    size_t position;
+}UPLOADTOBLOB_MEMORY_SOURCE;
+
+static int readFromMemory(void* context, unsigned char* buffer, size_t size, size_t* bytesRead)
+{
+    UPLOADTOBLOB_MEMORY_SOURCE* memorySource = (UPLOADTOBLOB_MEMORY_SOURCE*)context;
+    size_t left = memorySource->size - memorySource->position;
+    *bytesRead = (left < size) ? left : size;
+    if (*bytesRead > 0)
+    {
+        (void)memcpy(buffer, memorySource->source + memorySource->position, *bytesRead);
+        memorySource->position += *bytesRead;
+    }
+    return 0;
+}
+
+/*state of an upload done by IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal*/
+typedef struct UPLOADTOBLOB_JOURNAL_TAG
+{
+    const char* previousJournal;                            /*the journal to resume from, can be NULL*/
+    IOTHUB_CLIENT_FILE_UPLOAD_JOURNAL_CALLBACK callback;
+    void* callbackContext;
+    const char* destinationFileName;
+    STRING_HANDLE correlationId;
+    STRING_HANDLE sasUri;
+    IOTHUB_CLIENT_FILE_UPLOAD_READ_CALLBACK readCallback;
+    void* readContext;
+    size_t resumedSize;                                     /*bytes already in storage when the upload was resumed*/
+    size_t bytesToSkip;                                     /*bytes of resumedSize not yet read from readCallback*/
+}UPLOADTOBLOB_JOURNAL;
+
+static int hexDigitValue(char c)
+{
+    int result;
+    if ((c >= '0') && (c <= '9'))
+    {
+        result = c - '0';
+    }
+    else if ((c >= 'A') && (c <= 'F'))
+    {
+        result = c - 'A' + 10;
+    }
+    else if ((c >= 'a') && (c <= 'f'))
+    {
+        result = c - 'a' + 10;
+    }
+    else
+    {
+        result = -1;
+    }
+    return result;
+}
+
+/*extracts the "se" (signed expiry) of a SAS URI, URL decoded (for example "YYYY-MM-DDThh:mm:ssZ"), returns 0 on success*/
+static int getSasUriExpiry(const char* sasUri, char* expiry, size_t expirySize)
+{
+    int result;
+    const char* se = strstr(sasUri, "?se=");
+    if (se == NULL)
+    {
+        se = strstr(sasUri, "&se=");
+    }
+
+    if (se == NULL)
+    {
+        LogError("SAS URI has no expiry");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t length = 0;
+        se += 4; /*skip "?se=" or "&se="*/
+        result = 0;
+        while ((*se != '\0') && (*se != '&') && (result == 0))
+        {
+            if (length + 1 >= expirySize)
+            {
+                LogError("SAS URI expiry is too long");
+                result = __FAILURE__;
+            }
+            else if (*se == '%')
+            {
+                int high = hexDigitValue(se[1]); /*se[1] is '\0' at the end of the URI, so se[2] is not read*/
+                int low = (high < 0) ? -1 : hexDigitValue(se[2]);
+                if (low < 0)
+                {
+                    LogError("SAS URI expiry is not URL encoded correctly");
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    expiry[length++] = (char)(high * 16 + low);
+                    se += 3;
+                }
+            }
+            else if (*se == '+')
+            {
+                expiry[length++] = ' ';
+                se++;
+            }
+            else
+            {
+                expiry[length++] = *se++;
+            }
+        }
+        expiry[length] = '\0';
+        if ((result == 0) && (length == 0))
+        {
+            LogError("SAS URI expiry is empty");
+            result = __FAILURE__;
+        }
+    }
+    return result;
+}
+
+/*converts an expiry as returned by getSasUriExpiry ("YYYY-MM-DD", "YYYY-MM-DDThh:mmZ" or "YYYY-MM-DDThh:mm:ss[.fff]Z", always UTC) to time_t, returns 0 on success*/
+static int parseSasUriExpiry(const char* expiry, time_t* expiryTime)
+{
+    int result;
+    int year;
+    int month;
+    int day;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    char separator = 'T';
+    int fieldCount = sscanf(expiry, "%4d-%2d-%2d%c%2d:%2d:%2d", &year, &month, &day, &separator, &hour, &minute, &second);
+    if (
+        ((fieldCount != 3) && (fieldCount < 6)) ||
+        (separator != 'T') ||
+        (year < 1970) ||
+        (month < 1) || (month > 12) ||
+        (day < 1) || (day > 31) ||
+        (hour < 0) || (hour > 23) ||
+        (minute < 0) || (minute > 59) ||
+        (second < 0) || (second > 60)
+        )
+    {
+        LogError("unable to parse the SAS URI expiry %s", expiry);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*days since 1970-01-01 of a date of the proleptic Gregorian calendar, counting the years from March so the leap day is the last day of the year*/
+        long shiftedYear = (month <= 2) ? year - 1 : year;
+        long era = shiftedYear / 400;
+        long yearOfEra = shiftedYear - era * 400;
+        long dayOfYear = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        long days = era * 146097 + dayOfEra - 719468;
+
+        /*as in sastoken, time_t is taken to count the seconds since 1970-01-01 UTC*/
+        *expiryTime = (time_t)days * 86400 + (time_t)(hour * 3600 + minute * 60 + second);
+        result = 0;
+    }
+    return result;
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_21_017: [ IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall call journalCallback with a JSON journal carrying destinationFileName, correlationId, sasUri, sasUriExpiry, blockCount and uploadedSize after step 1 and every time more blocks have been uploaded. ]*/
+static void notifyJournal(UPLOADTOBLOB_JOURNAL* journal, unsigned int blockCount, size_t uploadedSize)
+{
+    char expiry[32];
+    JSON_Value* journalValue = json_value_init_object();
+    if (journalValue == NULL)
+    {
+        LogError("unable to json_value_init_object");
+    }
+    else
+    {
+        JSON_Object* journalObject = json_value_get_object(journalValue);
+        char* serialized;
+        if (getSasUriExpiry(STRING_c_str(journal->sasUri), expiry, sizeof(expiry)) != 0)
+        {
+            /*the journal cannot be resumed without knowing when the SAS URI expires*/
+            expiry[0] = '\0';
+        }
+
+        if (!(
+            (json_object_set_string(journalObject, "destinationFileName", journal->destinationFileName) == JSONSuccess) &&
+            (json_object_set_string(journalObject, "correlationId", STRING_c_str(journal->correlationId)) == JSONSuccess) &&
+            (json_object_set_string(journalObject, "sasUri", STRING_c_str(journal->sasUri)) == JSONSuccess) &&
+            (json_object_set_string(journalObject, "sasUriExpiry", expiry) == JSONSuccess) &&
+            (json_object_set_number(journalObject, "blockCount", (double)blockCount) == JSONSuccess) &&
+            (json_object_set_number(journalObject, "uploadedSize", (double)uploadedSize) == JSONSuccess)
+            ))
+        {
+            LogError("unable to build the journal");
+        }
+        else if ((serialized = json_serialize_to_string(journalValue)) == NULL)
+        {
+            LogError("unable to json_serialize_to_string");
+        }
+        else
+        {
+            journal->callback(serialized, journal->callbackContext);
+            json_free_serialized_string(serialized);
+        }
+        json_value_free(journalValue);
+    }
+}
+
+static void onBlobUploadProgress(void* context, unsigned int blockCount, size_t uploadedSize)
+{
+    UPLOADTOBLOB_JOURNAL* journal = (UPLOADTOBLOB_JOURNAL*)context;
+    notifyJournal(journal, blockCount, journal->resumedSize + uploadedSize);
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_21_019: [ When resuming, IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall read and discard the bytes already in storage before uploading the rest of the data produced by readCallback. ]*/
+static int readSkippingUploaded(void* context, unsigned char* buffer, size_t size, size_t* bytesRead)
+{
+    int result = 0;
+    UPLOADTOBLOB_JOURNAL* journal = (UPLOADTOBLOB_JOURNAL*)context;
+    while ((result == 0) && (journal->bytesToSkip > 0))
+    {
+        size_t skipped;
+        if (journal->readCallback(journal->readContext, buffer, (journal->bytesToSkip < size) ? journal->bytesToSkip : size, &skipped) != 0)
+        {
+            LogError("readCallback failed");
+            result = __FAILURE__;
+        }
+        else if (skipped == 0)
+        {
+            LogError("the data is shorter than what has already been uploaded");
+            result = __FAILURE__;
+        }
+        else
+        {
+            journal->bytesToSkip -= skipped;
+        }
+    }
+
+    if (result == 0)
+    {
+        result = journal->readCallback(journal->readContext, buffer, size, bytesRead);
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE IoTHubClient_LL_UploadToBlob_Create(const IOTHUB_CLIENT_CONFIG* config)
 {
     IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData = malloc(sizeof(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA));
@@ -79,6 +328,7 @@ IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE IoTHubClient_LL_UploadToBlob_Create(const I
     {
         size_t iotHubNameLength = strlen(config->iotHubName);
         size_t iotHubSuffixLength = strlen(config->iotHubSuffix);
+        handleData->blobUploadConcurrency = 1;
         handleData->deviceId = STRING_construct(config->deviceId);
         if (handleData->deviceId == NULL)
         {
@@ -149,6 +399,28 @@ IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE IoTHubClient_LL_UploadToBlob_Create(const I
     
 }
 
+/*adds the request HTTP headers shared by step 1 and step 3, returns 0 on success*/
+static int IoTHubClient_LL_UploadToBlob_AddRequestHeaders(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData, HTTP_HEADERS_HANDLE requestHttpHeaders)
+{
+    int result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_072: [ IoTHubClient_LL_UploadToBlob shall add the following name:value to request HTTP headers: ] "Content-Type": "application/json" "Accept": "application/json" "User-Agent": "iothubclient/" IOTHUB_SDK_VERSION*/
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_107: [ - "Authorization" header shall not be build. ]*/
+    if (!(
+        (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "Content-Type", "application/json") == HTTP_HEADERS_OK) &&
+        (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "Accept", "application/json") == HTTP_HEADERS_OK) &&
+        (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "User-Agent", "iothubclient/" IOTHUB_SDK_VERSION) == HTTP_HEADERS_OK) &&
+        (handleData->authorizationScheme==X509 || (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "Authorization", "") == HTTP_HEADERS_OK))
+        ))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
 /*returns 0 when correlationId, sasUri contain data*/
 static int IoTHubClient_LL_UploadToBlob_step1and2(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData, HTTPAPIEX_HANDLE iotHubHttpApiExHandle, HTTP_HEADERS_HANDLE requestHttpHeaders, const char* destinationFileName,
     STRING_HANDLE correlationId, STRING_HANDLE sasUri)
@@ -188,14 +460,7 @@ static int IoTHubClient_LL_UploadToBlob_step1and2(IOTHUB_CLIENT_LL_UPLOADTOBLOB_
             }
             else
             {
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_072: [ IoTHubClient_LL_UploadToBlob shall add the following name:value to request HTTP headers: ] "Content-Type": "application/json" "Accept": "application/json" "User-Agent": "iothubclient/" IOTHUB_SDK_VERSION*/
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_107: [ - "Authorization" header shall not be build. ]*/
-                if (!(
-                    (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "Content-Type", "application/json") == HTTP_HEADERS_OK) &&
-                    (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "Accept", "application/json") == HTTP_HEADERS_OK) &&
-                    (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "User-Agent", "iothubclient/" IOTHUB_SDK_VERSION) == HTTP_HEADERS_OK) &&
-                    (handleData->authorizationScheme==X509 || (HTTPHeaders_AddHeaderNameValuePair(requestHttpHeaders, "Authorization", "") == HTTP_HEADERS_OK))
-                    ))
+                if (IoTHubClient_LL_UploadToBlob_AddRequestHeaders(handleData, requestHttpHeaders) != 0)
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_071: [ If creating the HTTP headers fails then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
                     LogError("unable to HTTPHeaders_AddHeaderNameValuePair");
@@ -698,170 +963,369 @@ static int IoTHubClient_LL_UploadToBlob_step3(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HAND
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const unsigned char* source, size_t size)
+/*takes correlationId and sasUri from the previous journal instead of asking IoTHub for them (step 1), returns 0 when the upload can be resumed from block firstBlockID*/
+static int IoTHubClient_LL_UploadToBlob_resume(UPLOADTOBLOB_JOURNAL* journal, unsigned int* firstBlockID)
+{
+    int result;
+    JSON_Value* journalValue = json_parse_string(journal->previousJournal);
+    if (journalValue == NULL)
+    {
+        LogError("the journal is not valid JSON");
+        result = __FAILURE__;
+    }
+    else
+    {
+        JSON_Object* journalObject = json_value_get_object(journalValue);
+        const char* json_destinationFileName = json_object_get_string(journalObject, "destinationFileName");
+        const char* json_correlationId = json_object_get_string(journalObject, "correlationId");
+        const char* json_sasUri = json_object_get_string(journalObject, "sasUri");
+        const char* json_sasUriExpiry = json_object_get_string(journalObject, "sasUriExpiry");
+        time_t now;
+        time_t expiry;
+
+        if ((json_destinationFileName == NULL) || (json_correlationId == NULL) || (json_sasUri == NULL) || (json_sasUriExpiry == NULL))
+        {
+            LogError("the journal is incomplete");
+            result = __FAILURE__;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_21_016: [ If journal is not valid, is for another destinationFileName or its SAS URI expires in less than 5 minutes then IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall start a new upload. ]*/
+        else if (strcmp(json_destinationFileName, journal->destinationFileName) != 0)
+        {
+            LogError("the journal is for %s, not %s", json_destinationFileName, journal->destinationFileName);
+            result = __FAILURE__;
+        }
+        else if (parseSasUriExpiry(json_sasUriExpiry, &expiry) != 0)
+        {
+            /*already logged*/
+            result = __FAILURE__;
+        }
+        else if ((now = get_time(NULL)) == (time_t)-1)
+        {
+            LogError("unable to get_time");
+            result = __FAILURE__;
+        }
+        else if (get_difftime(expiry, now) < JOURNAL_MINIMUM_SAS_LIFETIME)
+        {
+            LogError("the SAS URI of the journal expires at %s", json_sasUriExpiry);
+            result = __FAILURE__;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_21_018: [ Otherwise IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall skip step 1, reuse the correlationId and sasUri of journal, and call Blob_GetUploadedBlocks to find the block to resume from. ]*/
+        else if (Blob_GetUploadedBlocks(json_sasUri, firstBlockID, &journal->resumedSize) != BLOB_OK)
+        {
+            LogError("unable to Blob_GetUploadedBlocks");
+            result = __FAILURE__;
+        }
+        else if (
+            (STRING_copy(journal->correlationId, json_correlationId) != 0) ||
+            (STRING_copy(journal->sasUri, json_sasUri) != 0)
+            )
+        {
+            LogError("unable to STRING_copy");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        json_value_free(journalValue);
+    }
+    return result;
+}
+
+/*runs steps 1, 2 and 3 of the file upload. Step 2 uploads source/size, or the data produced by readCallback when readCallback is not NULL. journal is not NULL only for IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal*/
+static IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_Upload(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData, const char* destinationFileName, const unsigned char* source, size_t size, BLOB_UPLOAD_READ_CALLBACK readCallback, void* context, UPLOADTOBLOB_JOURNAL* journal)
 {
     IOTHUB_CLIENT_RESULT result;
     BUFFER_HANDLE toBeTransmitted;
     int requiredStringLength;
     char* requiredString;
 
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_061: [ If handle is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_062: [ If destinationFileName is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_063: [ If source is NULL and size is greater than 0 then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
-    if (
-        (handle == NULL) ||
-        (destinationFileName == NULL) ||
-        ((source == NULL) && (size > 0))
-        )
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_064: [ IoTHubClient_LL_UploadToBlob shall create an HTTPAPIEX_HANDLE to the IoTHub hostname. ]*/
+    HTTPAPIEX_HANDLE iotHubHttpApiExHandle = HTTPAPIEX_Create(handleData->hostname);
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_065: [ If creating the HTTPAPIEX_HANDLE fails then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+    if (iotHubHttpApiExHandle == NULL)
     {
-        LogError("invalid argument detected handle=%p destinationFileName=%p source=%p size=%zu", handle, destinationFileName, source, size);
-        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("unable to HTTPAPIEX_Create");
+        result = IOTHUB_CLIENT_ERROR;
     }
     else
     {
-        IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle;
-
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_064: [ IoTHubClient_LL_UploadToBlob shall create an HTTPAPIEX_HANDLE to the IoTHub hostname. ]*/
-        HTTPAPIEX_HANDLE iotHubHttpApiExHandle = HTTPAPIEX_Create(handleData->hostname);
+        if (
+            (handleData->authorizationScheme == X509) &&
 
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_065: [ If creating the HTTPAPIEX_HANDLE fails then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
-        if (iotHubHttpApiExHandle == NULL)
+            /*transmit the x509certificate and x509privatekey*/
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_106: [ - x509certificate and x509privatekey saved options shall be passed on the HTTPAPIEX_SetOption ]*/
+            (!(
+                (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_X509_CERT, handleData->credentials.x509credentials.x509certificate) == HTTPAPIEX_OK) &&
+                (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_X509_PRIVATE_KEY, handleData->credentials.x509credentials.x509privatekey) == HTTPAPIEX_OK)
+            ))
+            )
         {
-            LogError("unable to HTTPAPIEX_Create");
+            LogError("unable to HTTPAPIEX_SetOption for x509");
             result = IOTHUB_CLIENT_ERROR;
         }
         else
         {
-            if (
-                (handleData->authorizationScheme == X509) &&
-
-                /*transmit the x509certificate and x509privatekey*/
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_106: [ - x509certificate and x509privatekey saved options shall be passed on the HTTPAPIEX_SetOption ]*/
-                (!(
-                    (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_X509_CERT, handleData->credentials.x509credentials.x509certificate) == HTTPAPIEX_OK) &&
-                    (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_X509_PRIVATE_KEY, handleData->credentials.x509credentials.x509privatekey) == HTTPAPIEX_OK)
-                ))
-                )
+
+            STRING_HANDLE correlationId = STRING_new();
+            if (correlationId == NULL)
             {
-                LogError("unable to HTTPAPIEX_SetOption for x509");
+                LogError("unable to STRING_new");
                 result = IOTHUB_CLIENT_ERROR;
             }
             else
             {
-
-                STRING_HANDLE correlationId = STRING_new();
-                if (correlationId == NULL)
+                STRING_HANDLE sasUri = STRING_new();
+                if (sasUri == NULL)
                 {
                     LogError("unable to STRING_new");
                     result = IOTHUB_CLIENT_ERROR;
                 }
                 else
                 {
-                    STRING_HANDLE sasUri = STRING_new();
-                    if (sasUri == NULL)
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_070: [ IoTHubClient_LL_UploadToBlob shall create request HTTP headers. ]*/
+                    HTTP_HEADERS_HANDLE requestHttpHeaders = HTTPHeaders_Alloc(); /*these are build by step 1 and used by step 3 too*/
+                    if (requestHttpHeaders == NULL)
                     {
-                        LogError("unable to STRING_new");
+                        LogError("unable to HTTPHeaders_Alloc");
                         result = IOTHUB_CLIENT_ERROR;
                     }
                     else
                     {
-                        /*Codes_SRS_IOTHUBCLIENT_LL_02_070: [ IoTHubClient_LL_UploadToBlob shall create request HTTP headers. ]*/
-                        HTTP_HEADERS_HANDLE requestHttpHeaders = HTTPHeaders_Alloc(); /*these are build by step 1 and used by step 3 too*/
-                        if (requestHttpHeaders == NULL)
+                        unsigned int firstBlockID = 0;
+                        int step1Result;
+                        if (journal != NULL)
                         {
-                            LogError("unable to HTTPHeaders_Alloc");
-                            result = IOTHUB_CLIENT_ERROR;
+                            journal->correlationId = correlationId;
+                            journal->sasUri = sasUri;
+                        }
+
+                        if ((journal != NULL) && (journal->previousJournal != NULL) && (IoTHubClient_LL_UploadToBlob_resume(journal, &firstBlockID) == 0))
+                        {
+                            /*step 1 is skipped, step 3 still needs its request HTTP headers*/
+                            step1Result = (
+                                (IoTHubClient_LL_UploadToBlob_AddRequestHeaders(handleData, requestHttpHeaders) == 0) &&
+                                ((handleData->authorizationScheme != SAS_TOKEN) || (HTTPHeaders_ReplaceHeaderNameValuePair(requestHttpHeaders, "Authorization", STRING_c_str(handleData->credentials.sas)) == HTTP_HEADERS_OK))
+                                ) ? 0 : __FAILURE__;
                         }
                         else
                         {
+                            firstBlockID = 0;
+                            if (journal != NULL)
+                            {
+                                journal->resumedSize = 0;
+                            }
+
                             /*do step 1*/
-                            if (IoTHubClient_LL_UploadToBlob_step1and2(handleData, iotHubHttpApiExHandle, requestHttpHeaders, destinationFileName, correlationId, sasUri) != 0)
+                            step1Result = IoTHubClient_LL_UploadToBlob_step1and2(handleData, iotHubHttpApiExHandle, requestHttpHeaders, destinationFileName, correlationId, sasUri);
+                            if ((step1Result == 0) && (journal != NULL))
+                            {
+                                notifyJournal(journal, 0, 0);
+                            }
+                        }
+
+                        if (step1Result != 0)
+                        {
+                            LogError("error in IoTHubClient_LL_UploadToBlob_step1");
+                            result = IOTHUB_CLIENT_ERROR;
+                        }
+                        else
+                        {
+                            /*do step 2.*/
+
+                            unsigned int httpResponse;
+                            BUFFER_HANDLE responseToIoTHub = BUFFER_new();
+                            if (responseToIoTHub == NULL)
                             {
-                                LogError("error in IoTHubClient_LL_UploadToBlob_step1");
                                 result = IOTHUB_CLIENT_ERROR;
+                                LogError("unable to BUFFER_new");
                             }
                             else
                             {
-                                /*do step 2.*/
-
-                                unsigned int httpResponse;
-                                BUFFER_HANDLE responseToIoTHub = BUFFER_new();
-                                if (responseToIoTHub == NULL)
+                                int step2success;
+                                if (journal != NULL)
                                 {
-                                    result = IOTHUB_CLIENT_ERROR;
-                                    LogError("unable to BUFFER_new");
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_21_015: [ IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall call Blob_UploadMultipleBlocksFromSasUri as IoTHubClient_LL_UploadMultipleBlocksToBlob does, starting from the first block not yet uploaded and reporting its progress to the journal. ]*/
+                                    journal->readCallback = readCallback;
+                                    journal->readContext = context;
+                                    journal->bytesToSkip = journal->resumedSize;
+                                    step2success = (Blob_UploadMultipleBlocksFromSasUri(STRING_c_str(sasUri), readSkippingUploaded, journal, handleData->blobUploadConcurrency, 0, firstBlockID, onBlobUploadProgress, journal, &httpResponse, responseToIoTHub) == BLOB_OK);
+                                }
+                                else if (readCallback != NULL)
+                                {
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_21_002: [ IoTHubClient_LL_UploadMultipleBlocksToBlob shall call Blob_UploadMultipleBlocksFromSasUri passing readCallback, context and the blob_upload_concurrency option, and capture the HTTP return code and HTTP body. ]*/
+                                    step2success = (Blob_UploadMultipleBlocksFromSasUri(STRING_c_str(sasUri), readCallback, context, handleData->blobUploadConcurrency, 0, 0, NULL, NULL, &httpResponse, responseToIoTHub) == BLOB_OK);
+                                }
+                                else if (handleData->blobUploadConcurrency > 1)
+                                {
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_21_005: [ If blob_upload_concurrency is greater than 1, IoTHubClient_LL_UploadToBlob shall call Blob_UploadMultipleBlocksFromSasUri reading from source, passing size as the size hint. ]*/
+                                    UPLOADTOBLOB_MEMORY_SOURCE memorySource;
+                                    memorySource.source = source;
+                                    memorySource.size = size;
+                                    memorySource.position = 0;
+                                    step2success = (Blob_UploadMultipleBlocksFromSasUri(STRING_c_str(sasUri), readFromMemory, &memorySource, handleData->blobUploadConcurrency, size, 0, NULL, NULL, &httpResponse, responseToIoTHub) == BLOB_OK);
                                 }
                                 else
                                 {
-                                    int step2success;
                                     /*Codes_SRS_IOTHUBCLIENT_LL_02_083: [ IoTHubClient_LL_UploadToBlob shall call Blob_UploadFromSasUri and capture the HTTP return code and HTTP body. ]*/
                                     step2success = (Blob_UploadFromSasUri(STRING_c_str(sasUri), source, size, &httpResponse, responseToIoTHub) == BLOB_OK);
-                                    if (!step2success)
-                                    {
-                                        /*Codes_SRS_IOTHUBCLIENT_LL_02_084: [ If Blob_UploadFromSasUri fails then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
-                                        LogError("unable to Blob_UploadFromSasUri");
+                                }
+                                if (!step2success && (journal != NULL))
+                                {
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_21_020: [ If step 2 fails, IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall not notify IoTHub, so the upload can be resumed, and shall return IOTHUB_CLIENT_ERROR. ]*/
+                                    LogError("unable to Blob_UploadMultipleBlocksFromSasUri, the upload can be resumed from the journal");
+                                    result = IOTHUB_CLIENT_ERROR;
+                                }
+                                else if (!step2success)
+                                {
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_02_084: [ If Blob_UploadFromSasUri fails then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                                    LogError("unable to Blob_UploadFromSasUri");
 
-                                        /*do step 3*/ /*try*/
-                                        /*Codes_SRS_IOTHUBCLIENT_LL_02_091: [ If step 2 fails without establishing an HTTP dialogue, then the HTTP message body shall look like: ]*/
-                                        if (BUFFER_build(responseToIoTHub, (const unsigned char*)FILE_UPLOAD_FAILED_BODY, sizeof(FILE_UPLOAD_FAILED_BODY) / sizeof(FILE_UPLOAD_FAILED_BODY[0])) == 0)
+                                    /*do step 3*/ /*try*/
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_02_091: [ If step 2 fails without establishing an HTTP dialogue, then the HTTP message body shall look like: ]*/
+                                    if (BUFFER_build(responseToIoTHub, (const unsigned char*)FILE_UPLOAD_FAILED_BODY, sizeof(FILE_UPLOAD_FAILED_BODY) / sizeof(FILE_UPLOAD_FAILED_BODY[0])) == 0)
+                                    {
+                                        if (IoTHubClient_LL_UploadToBlob_step3(handleData, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, responseToIoTHub) != 0)
                                         {
-                                            if (IoTHubClient_LL_UploadToBlob_step3(handleData, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, responseToIoTHub) != 0)
-                                            {
-                                                LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
-                                            }
+                                            LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
                                         }
-                                        result = IOTHUB_CLIENT_ERROR;
                                     }
-                                    else
+                                    result = IOTHUB_CLIENT_ERROR;
+                                }
+                                else
+                                {
+                                    if (journal != NULL)
                                     {
-                                        /*must make a json*/
+                                        /*Codes_SRS_IOTHUBCLIENT_LL_21_021: [ Once step 2 succeeds, IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall call journalCallback with NULL, the journal cannot be resumed anymore. ]*/
+                                        journal->callback(NULL, journal->callbackContext);
+                                    }
+
+                                    /*must make a json*/
 
-                                        requiredStringLength = snprintf(NULL, 0, "{\"isSuccess\":%s, \"statusCode\":%d, \"statusDescription\":\"%s\"}", ((httpResponse < 300) ? "true" : "false"), httpResponse, BUFFER_u_char(responseToIoTHub));
+                                    requiredStringLength = snprintf(NULL, 0, "{\"isSuccess\":%s, \"statusCode\":%d, \"statusDescription\":\"%s\"}", ((httpResponse < 300) ? "true" : "false"), httpResponse, BUFFER_u_char(responseToIoTHub));
 
-                                        requiredString = malloc(requiredStringLength + 1);
-                                        if (requiredString == 0)
+                                    requiredString = malloc(requiredStringLength + 1);
+                                    if (requiredString == 0)
+                                    {
+                                        LogError("unable to malloc");
+                                        result = IOTHUB_CLIENT_ERROR;
+                                    }
+                                    else
+                                    {
+                                        /*do again snprintf*/
+                                        (void)snprintf(requiredString, requiredStringLength + 1, "{\"isSuccess\":%s, \"statusCode\":%d, \"statusDescription\":\"%s\"}", ((httpResponse < 300) ? "true" : "false"), httpResponse, BUFFER_u_char(responseToIoTHub));
+                                        toBeTransmitted = BUFFER_create((const unsigned char*)requiredString, requiredStringLength);
+                                        if (toBeTransmitted == NULL)
                                         {
-                                            LogError("unable to malloc");
+                                            LogError("unable to BUFFER_create");
                                             result = IOTHUB_CLIENT_ERROR;
                                         }
                                         else
                                         {
-                                            /*do again snprintf*/
-                                            (void)snprintf(requiredString, requiredStringLength + 1, "{\"isSuccess\":%s, \"statusCode\":%d, \"statusDescription\":\"%s\"}", ((httpResponse < 300) ? "true" : "false"), httpResponse, BUFFER_u_char(responseToIoTHub));
-                                            toBeTransmitted = BUFFER_create((const unsigned char*)requiredString, requiredStringLength);
-                                            if (toBeTransmitted == NULL)
+                                            if (IoTHubClient_LL_UploadToBlob_step3(handleData, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, toBeTransmitted) != 0)
                                             {
-                                                LogError("unable to BUFFER_create");
+                                                LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
                                                 result = IOTHUB_CLIENT_ERROR;
                                             }
                                             else
                                             {
-                                                if (IoTHubClient_LL_UploadToBlob_step3(handleData, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, toBeTransmitted) != 0)
-                                                {
-                                                    LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
-                                                    result = IOTHUB_CLIENT_ERROR;
-                                                }
-                                                else
-                                                {
-                                                    result = (httpResponse < 300) ? IOTHUB_CLIENT_OK : IOTHUB_CLIENT_ERROR;
-                                                }
-                                                BUFFER_delete(toBeTransmitted);
+                                                result = (httpResponse < 300) ? IOTHUB_CLIENT_OK : IOTHUB_CLIENT_ERROR;
                                             }
-                                            free(requiredString);
+                                            BUFFER_delete(toBeTransmitted);
                                         }
+                                        free(requiredString);
                                     }
-                                    BUFFER_delete(responseToIoTHub);
                                 }
+                                BUFFER_delete(responseToIoTHub);
                             }
-                            HTTPHeaders_Free(requestHttpHeaders);
                         }
-                        STRING_delete(sasUri);
+                        HTTPHeaders_Free(requestHttpHeaders);
                     }
-                    STRING_delete(correlationId);
+                    STRING_delete(sasUri);
                 }
+                STRING_delete(correlationId);
             }
-            HTTPAPIEX_Destroy(iotHubHttpApiExHandle);
         }
+        HTTPAPIEX_Destroy(iotHubHttpApiExHandle);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const unsigned char* source, size_t size)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_061: [ If handle is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_062: [ If destinationFileName is NULL then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_063: [ If source is NULL and size is greater than 0 then IoTHubClient_LL_UploadToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (handle == NULL) ||
+        (destinationFileName == NULL) ||
+        ((source == NULL) && (size > 0))
+        )
+    {
+        LogError("invalid argument detected handle=%p destinationFileName=%p source=%p size=%zu", handle, destinationFileName, source, size);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        result = IoTHubClient_LL_UploadToBlob_Upload((IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle, destinationFileName, source, size, NULL, NULL, NULL);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_READ_CALLBACK readCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_21_001: [ If handle, destinationFileName or readCallback is NULL then IoTHubClient_LL_UploadMultipleBlocksToBlob shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (handle == NULL) ||
+        (destinationFileName == NULL) ||
+        (readCallback == NULL)
+        )
+    {
+        LogError("invalid argument detected handle=%p destinationFileName=%p readCallback=%p", handle, destinationFileName, readCallback);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_21_003: [ Otherwise IoTHubClient_LL_UploadMultipleBlocksToBlob shall run the same steps as IoTHubClient_LL_UploadToBlob. ]*/
+        result = IoTHubClient_LL_UploadToBlob_Upload((IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle, destinationFileName, NULL, 0, readCallback, context, NULL);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_READ_CALLBACK readCallback, void* context, const char* journal, IOTHUB_CLIENT_FILE_UPLOAD_JOURNAL_CALLBACK journalCallback, void* journalContext)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_21_014: [ If handle, destinationFileName, readCallback or journalCallback is NULL then IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (
+        (handle == NULL) ||
+        (destinationFileName == NULL) ||
+        (readCallback == NULL) ||
+        (journalCallback == NULL)
+        )
+    {
+        LogError("invalid argument detected handle=%p destinationFileName=%p readCallback=%p journalCallback=%p", handle, destinationFileName, readCallback, journalCallback);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        UPLOADTOBLOB_JOURNAL uploadJournal;
+        uploadJournal.previousJournal = journal;
+        uploadJournal.callback = journalCallback;
+        uploadJournal.callbackContext = journalContext;
+        uploadJournal.destinationFileName = destinationFileName;
+        uploadJournal.correlationId = NULL;
+        uploadJournal.sasUri = NULL;
+        uploadJournal.readCallback = readCallback;
+        uploadJournal.readContext = context;
+        uploadJournal.resumedSize = 0;
+        uploadJournal.bytesToSkip = 0;
+        result = IoTHubClient_LL_UploadToBlob_Upload((IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle, destinationFileName, NULL, 0, readCallback, context, &uploadJournal);
     }
     return result;
 }
@@ -988,6 +1452,23 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_SetOption(IOTHUB_CLIENT_LL_UPL
                 }
             }
         }
+        /*Codes_SRS_IOTHUBCLIENT_LL_21_004: [ blob_upload_concurrency - value is a pointer to a size_t between 1 and 8, the number of blocks uploaded to storage at the same time. ]*/
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_CONCURRENCY) == 0)
+        {
+            size_t concurrency;
+            if ((value == NULL) ||
+                ((concurrency = *(const size_t*)value) == 0) ||
+                (concurrency > 8))
+            {
+                LogError("invalid blob upload concurrency");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                handleData->blobUploadConcurrency = concurrency;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else
         {
             /*Codes_SRS_IOTHUBCLIENT_LL_02_102: [ If an unknown option is presented then IoTHubClient_LL_UploadToBlob_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
@@ -0,0 +1,86 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/xlogging.h"
+#include "iothub_client_submission_queue.h"
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#define SUBMISSION_QUEUE_CAS(target, expected, desired) \
+    (InterlockedCompareExchangePointer((PVOID volatile*)(target), (PVOID)(desired), (PVOID)(expected)) == (PVOID)(expected))
+#elif defined(__GNUC__)
+/*full barrier, so the node written by a producer is visible to the consumer that takes it*/
+#define SUBMISSION_QUEUE_CAS(target, expected, desired) \
+    __sync_bool_compare_and_swap((target), (expected), (desired))
+#else
+#error "iothub_client_submission_queue needs an atomic compare and swap, port SUBMISSION_QUEUE_CAS to this compiler"
+#endif
+
+void submission_queue_init(SUBMISSION_QUEUE* queue)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_001: [ If queue is NULL, submission_queue_init shall do nothing. ]*/
+    if (queue == NULL)
+    {
+        LogError("Invalid argument (queue is NULL)");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_002: [ submission_queue_init shall make the queue empty. ]*/
+        queue->head = NULL;
+    }
+}
+
+void submission_queue_push(SUBMISSION_QUEUE* queue, SUBMISSION_QUEUE_NODE* node)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_003: [ If queue or node are NULL, submission_queue_push shall do nothing. ]*/
+    if (queue == NULL || node == NULL)
+    {
+        LogError("Invalid argument (queue=%p, node=%p)", queue, node);
+    }
+    else
+    {
+        SUBMISSION_QUEUE_NODE* head;
+
+        /*Codes_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_004: [ submission_queue_push shall link node in front of the last pushed node and publish it with an atomic compare and swap, retrying if another producer pushed in between. ]*/
+        do
+        {
+            head = queue->head;
+            node->next = head;
+        } while (!SUBMISSION_QUEUE_CAS(&queue->head, head, node));
+    }
+}
+
+SUBMISSION_QUEUE_NODE* submission_queue_take_all(SUBMISSION_QUEUE* queue)
+{
+    SUBMISSION_QUEUE_NODE* result;
+
+    if (queue == NULL)
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_005: [ If queue is NULL, submission_queue_take_all shall return NULL. ]*/
+        LogError("Invalid argument (queue is NULL)");
+        result = NULL;
+    }
+    else
+    {
+        SUBMISSION_QUEUE_NODE* newest;
+
+        /*Codes_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_006: [ submission_queue_take_all shall detach all the queued nodes at once with an atomic compare and swap. ]*/
+        do
+        {
+            newest = queue->head;
+        } while (newest != NULL && !SUBMISSION_QUEUE_CAS(&queue->head, newest, NULL));
+
+        /*Codes_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_007: [ submission_queue_take_all shall return the detached nodes oldest first, or NULL if the queue was empty. ]*/
+        result = NULL;
+        while (newest != NULL)
+        {
+            SUBMISSION_QUEUE_NODE* next = newest->next;
+            newest->next = result;
+            result = newest;
+            newest = next;
+        }
+    }
+
+    return result;
+}
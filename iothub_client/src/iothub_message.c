@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
@@ -22,7 +23,14 @@ typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
     {
         BUFFER_HANDLE byteArray;
         STRING_HANDLE string;
+        struct
+        {
+            const unsigned char* bytes;
+            size_t size;
+        } view;
     } value;
+    // true when the content is a borrowed view (value.view) instead of an owned BUFFER.
+    bool isView;
     MAP_HANDLE properties;
     char* messageId;
     char* correlationId;
@@ -118,6 +126,7 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
                 /*Codes_SRS_IOTHUBMESSAGE_02_025: [Otherwise, IoTHubMessage_CreateFromByteArray shall return a non-NULL handle.] */
                 /*Codes_SRS_IOTHUBMESSAGE_02_026: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.] */
                 result->contentType = IOTHUBMESSAGE_BYTEARRAY;
+                result->isView = false;
                 result->messageId = NULL;
                 result->correlationId = NULL;
                 /*all is fine, return result*/
@@ -160,6 +169,7 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
             /*Codes_SRS_IOTHUBMESSAGE_02_031: [Otherwise, IoTHubMessage_CreateFromString shall return a non-NULL handle.] */
             /*Codes_SRS_IOTHUBMESSAGE_02_032: [The type of the new message shall be IOTHUBMESSAGE_STRING.] */
             result->contentType = IOTHUBMESSAGE_STRING;
+            result->isView = false;
             result->messageId = NULL;
             result->correlationId = NULL;
         }
@@ -167,6 +177,44 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
     return result;
 }
 
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArrayView(const unsigned char* byteArray, size_t size)
+{
+    static const unsigned char empty_content = 0x00;
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+
+    /*Codes_SRS_IOTHUBMESSAGE_09_002: [If size is NOT zero and byteArray is NULL, IoTHubMessage_CreateFromByteArrayView shall return NULL.]*/
+    if (size != 0 && byteArray == NULL)
+    {
+        LogError("Attempted to create a Hub Message view over a NULL pointer!");
+        result = NULL;
+    }
+    else if ((result = malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_09_005: [If there are any errors then IoTHubMessage_CreateFromByteArrayView shall return NULL.]*/
+        LogError("unable to malloc");
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_09_003: [IoTHubMessage_CreateFromByteArrayView shall call Map_Create to create the message properties.]*/
+    else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_09_005: [If there are any errors then IoTHubMessage_CreateFromByteArrayView shall return NULL.]*/
+        LogError("Map_Create failed");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_09_001: [IoTHubMessage_CreateFromByteArrayView shall reference byteArray and size as the content of the message, without copying the bytes.]*/
+        result->value.view.bytes = (size == 0) ? &empty_content : byteArray;
+        result->value.view.size = size;
+        result->isView = true;
+        /*Codes_SRS_IOTHUBMESSAGE_09_004: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.]*/
+        result->contentType = IOTHUBMESSAGE_BYTEARRAY;
+        result->messageId = NULL;
+        result->correlationId = NULL;
+    }
+    return result;
+}
+
 /*Codes_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
 IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
 {
@@ -212,7 +260,10 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
             else if (source->contentType == IOTHUBMESSAGE_BYTEARRAY)
             {
                 /*Codes_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone to content by a call to BUFFER_clone] */
-                if ((result->value.byteArray = BUFFER_clone(source->value.byteArray)) == NULL)
+                /*Codes_SRS_IOTHUBMESSAGE_09_006: [If iotHubMessageHandle is a view, IoTHubMessage_Clone shall copy the referenced bytes by calling BUFFER_create, so the clone owns its content and outlives the view.]*/
+                if ((result->value.byteArray = (source->isView ?
+                    BUFFER_create(source->value.view.bytes, source->value.view.size) :
+                    BUFFER_clone(source->value.byteArray))) == NULL)
                 {
                     /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
                     LogError("unable to BUFFER_clone");
@@ -251,6 +302,7 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
                 else
                 {
                     result->contentType = IOTHUBMESSAGE_BYTEARRAY;
+                    result->isView = false;
                     /*Codes_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
                     /*return as is, this is a good result*/
                 }
@@ -297,6 +349,7 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
                 else
                 {
                     result->contentType = IOTHUBMESSAGE_STRING;
+                    result->isView = false;
                     /*all is fine*/
                 }
             }
@@ -327,6 +380,13 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMes
             result = IOTHUB_MESSAGE_INVALID_ARG;
             LogError("invalid type of message %s", ENUM_TO_STRING(IOTHUBMESSAGE_CONTENT_TYPE, handleData->contentType));
         }
+        else if (handleData->isView)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_09_007: [If iotHubMessageHandle is a view, IoTHubMessage_GetByteArray shall return the referenced bytes and size without copying them.]*/
+            *buffer = handleData->value.view.bytes;
+            *size = handleData->value.view.size;
+            result = IOTHUB_MESSAGE_OK;
+        }
         else
         {
             /*Codes_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
@@ -507,7 +567,11 @@ void IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
         if (handleData->contentType == IOTHUBMESSAGE_BYTEARRAY)
         {
-            BUFFER_delete(handleData->value.byteArray);
+            /*Codes_SRS_IOTHUBMESSAGE_09_008: [IoTHubMessage_Destroy shall not free the bytes referenced by a view.]*/
+            if (!handleData->isView)
+            {
+                BUFFER_delete(handleData->value.byteArray);
+            }
         }
         else
         {
@@ -141,6 +141,16 @@ static int transport_worker_thread(void* threadArgument)
 			}
 			else
 			{
+				size_t index;
+				size_t clientCount = VECTOR_size(transportData->clients);
+
+				/*Codes_SRS_IOTHUBTRANSPORT_17_046: [ Before calling lower layer transport DoWork, the thread shall call IoTHubClient_ProcessSubmissions for each clientHandle in the list, so events queued without the lock are sent in this DoWork. ]*/
+				for (index = 0; index < clientCount; index++)
+				{
+					IOTHUB_CLIENT_HANDLE* clientHandle = (IOTHUB_CLIENT_HANDLE*)VECTOR_element(transportData->clients, index);
+					IoTHubClient_ProcessSubmissions(*clientHandle);
+				}
+
 				(transportData->IoTHubTransport_DoWork)(transportData->transportLLHandle, NULL);
 				(void)Unlock(transportData->lockHandle);
 			}
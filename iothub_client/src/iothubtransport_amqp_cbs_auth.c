@@ -6,11 +6,14 @@
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/agenttime.h" 
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/sastoken.h"
 
 #define RESULT_OK                                 0
 #define INDEFINITE_TIME                           ((time_t)(-1))
+#define INDEFINITE_TICK_COUNT                     ((tickcounter_ms_t)(-1))
+#define MS_PER_SEC                                1000
 #define SAS_TOKEN_TYPE                            "servicebus.windows.net:sastoken"
 #define IOTHUB_DEVICES_PATH_FMT                   "%s/devices/%s"
 #define DEFAULT_CBS_REQUEST_TIMEOUT_SECS          UINT32_MAX
@@ -50,7 +53,8 @@ typedef struct AUTHENTICATION_INSTANCE_TAG
 	bool is_cbs_put_token_in_progress;
 	bool is_sas_token_refresh_in_progress;
 
-	time_t current_sas_token_put_time;
+	TICK_COUNTER_HANDLE tick_counter;
+	tickcounter_ms_t current_sas_token_put_time;
 
 	CREDENTIAL_TYPE current_credential_in_use;
 } AUTHENTICATION_INSTANCE;
@@ -104,22 +108,22 @@ static int verify_cbs_put_token_timeout(AUTHENTICATION_INSTANCE* instance, bool*
 {
 	int result;
 
-	if (instance->current_sas_token_put_time == INDEFINITE_TIME)
+	if (instance->current_sas_token_put_time == INDEFINITE_TICK_COUNT)
 	{
 		result = __FAILURE__;
 		LogError("Failed verifying if cbs_put_token has timed out (current_sas_token_put_time is not set)");
 	}
 	else
 	{
-		time_t current_time;
+		tickcounter_ms_t current_time;
 
-		if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
+		if (tickcounter_get_current_ms(instance->tick_counter, &current_time) != 0)
 		{
 			result = __FAILURE__;
-			LogError("Failed verifying if cbs_put_token has timed out (get_time failed)");
+			LogError("Failed verifying if cbs_put_token has timed out (tickcounter_get_current_ms failed)");
 		}
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_083: [authentication_do_work() shall check for authentication timeout comparing the current time since `instance->current_sas_token_put_time` to `instance->cbs_request_timeout_secs`]
-		else if ((uint32_t)get_difftime(current_time, instance->current_sas_token_put_time) >= instance->cbs_request_timeout_secs)
+		else if ((current_time - instance->current_sas_token_put_time) / MS_PER_SEC >= instance->cbs_request_timeout_secs)
 		{
 			*is_timed_out = true;
 			result = RESULT_OK;
@@ -138,21 +142,21 @@ static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, b
 {
 	int result;
 
-	if (instance->current_sas_token_put_time == INDEFINITE_TIME)
+	if (instance->current_sas_token_put_time == INDEFINITE_TICK_COUNT)
 	{
 		result = __FAILURE__;
 		LogError("Failed verifying if SAS token refresh timed out (current_sas_token_put_time is not set)");
 	}
 	else
 	{
-		time_t current_time;
+		tickcounter_ms_t current_time;
 
-		if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
+		if (tickcounter_get_current_ms(instance->tick_counter, &current_time) != 0)
 		{
 			result = __FAILURE__;
-			LogError("Failed verifying if SAS token refresh timed out (get_time failed)");
+			LogError("Failed verifying if SAS token refresh timed out (tickcounter_get_current_ms failed)");
 		}
-		else if ((uint32_t)get_difftime(current_time, instance->current_sas_token_put_time) >= instance->sas_token_refresh_time_secs)
+		else if ((current_time - instance->current_sas_token_put_time) / MS_PER_SEC >= instance->sas_token_refresh_time_secs)
 		{
 			*is_timed_out = true;
 			result = RESULT_OK;
@@ -320,14 +324,15 @@ static int put_SAS_token_to_cbs(AUTHENTICATION_INSTANCE* instance, STRING_HANDLE
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_047: [If cbs_put_token() succeeds, authentication_do_work() shall set `instance->current_sas_token_put_time` with current time]
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_059: [If cbs_put_token() succeeds, authentication_do_work() shall set `instance->current_sas_token_put_time` with current time]
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_077: [If cbs_put_token() succeeds, authentication_do_work() shall set `instance->current_sas_token_put_time` with the current time]
-		time_t current_time;
+		tickcounter_ms_t current_time;
 
-		if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
+		if (tickcounter_get_current_ms(instance->tick_counter, &current_time) != 0)
 		{
-			LogError("Failed setting current_sas_token_put_time for device '%s' (get_time() failed)", STRING_c_str(instance->device_id));
+			LogError("Failed setting current_sas_token_put_time for device '%s' (tickcounter_get_current_ms failed)", STRING_c_str(instance->device_id));
+			current_time = INDEFINITE_TICK_COUNT;
 		}
 
-		instance->current_sas_token_put_time = current_time; // If it failed, fear not. `current_sas_token_put_time` shall be checked for INDEFINITE_TIME wherever it is used.
+		instance->current_sas_token_put_time = current_time; // If it failed, fear not. `current_sas_token_put_time` shall be checked for INDEFINITE_TICK_COUNT wherever it is used.
 
 		result = RESULT_OK;
 	}
@@ -576,6 +581,10 @@ void authentication_destroy(AUTHENTICATION_HANDLE authentication_handle)
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_112: [authentication_destroy() shall destroy `instance->iothub_host_fqdn` using STRING_delete()]
 		if (instance->iothub_host_fqdn != NULL)
 			STRING_delete(instance->iothub_host_fqdn);
+
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_131: [authentication_destroy() shall destroy `instance->tick_counter` using tickcounter_destroy()]
+		if (instance->tick_counter != NULL)
+			tickcounter_destroy(instance->tick_counter);
 		
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_113: [authentication_destroy() shall destroy `instance` using free()]
 		free(instance);
@@ -672,6 +681,13 @@ AUTHENTICATION_HANDLE authentication_create(const AUTHENTICATION_CONFIG* config)
 				result = NULL;
 				LogError("authentication_create failed (config->iothub_host_fqdn could not be copied; STRING_construct failed)");
 			}
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_129: [authentication_create() shall create `instance->tick_counter` using tickcounter_create()]
+			else if ((instance->tick_counter = tickcounter_create()) == NULL)
+			{
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_130: [If tickcounter_create() fails, authentication_create() shall fail and return NULL]
+				result = NULL;
+				LogError("authentication_create failed (tickcounter_create failed)");
+			}
 			else
 			{
 				instance->state = AUTHENTICATION_STATE_STOPPED;
@@ -13,6 +13,7 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/urlencode.h"
 #include "azure_c_shared_utility/tlsio.h"
 #include "azure_c_shared_utility/vector.h"
@@ -41,9 +42,12 @@
 #define RESULT_OK 0
 
 #define INDEFINITE_TIME ((time_t)(-1))
+#define INDEFINITE_TICK ((tickcounter_ms_t)(-1))
 #define RFC1035_MAX_FQDN_LENGTH 255
 #define DEFAULT_SAS_TOKEN_LIFETIME_MS 3600000
 #define DEFAULT_CBS_REQUEST_TIMEOUT_MS 30000
+#define DEFAULT_SAS_TOKEN_REFRESH_JITTER_PERCENT 20
+#define DEFAULT_CBS_MAX_PENDING_PUT_TOKENS 10
 #define DEFAULT_CONTAINER_ID "default_container_id"
 #define DEFAULT_INCOMING_WINDOW_SIZE UINT_MAX
 #define DEFAULT_OUTGOING_WINDOW_SIZE 100
@@ -53,6 +57,16 @@
 #define MESSAGE_SENDER_LINK_NAME_TAG "sender"
 #define MESSAGE_SENDER_SOURCE_NAME_TAG "source"
 #define MESSAGE_SENDER_MAX_LINK_SIZE UINT64_MAX
+#define ADAPTIVE_WINDOW_INITIAL_SIZE 10
+#define ADAPTIVE_WINDOW_MIN_SIZE 1
+#define ADAPTIVE_WINDOW_FAST_DISPOSITION_MS 1000
+#define ADAPTIVE_WINDOW_BACKPRESSURE_MS 5000
+#define DEFAULT_LINK_IDLE_TIMEOUT_SECS 0
+#define IDLE_DEVICES_SWEEP_INTERVAL_MS 5000
+#define MS_PER_SEC 1000
+#define AMQP_BATCHING_FORMAT_CODE 0x80013700
+#define EVENT_BATCH_MAX_SIZE (256 * 1024)
+#define EVENT_BATCH_DATA_SECTION_OVERHEAD 8
 
 typedef enum RESULT_TAG
 {
@@ -78,6 +92,10 @@ typedef struct AMQP_TRANSPORT_STATE_TAG
     SESSION_HANDLE session;
     // All things CBS (and only CBS)
     AMQP_TRANSPORT_CBS_CONNECTION cbs_connection;
+    // Put-token requests allowed to be pending on the CBS connection at once; 0 means no limit.
+    size_t cbs_max_pending_put_tokens;
+    // Times a device had its authentication or refresh postponed because cbs_max_pending_put_tokens were pending; each wait counts once.
+    size_t cbs_put_token_deferrals;
 
     // Current AMQP connection state;
     AMQP_MANAGEMENT_STATE connection_state;
@@ -85,8 +103,30 @@ typedef struct AMQP_TRANSPORT_STATE_TAG
     AMQP_TRANSPORT_CREDENTIAL_TYPE preferred_credential_type;
     // List of registered devices.
     VECTOR_HANDLE registered_devices;
+    // Registered devices with pending work; the only ones visited by DoWork.
+    DLIST_ENTRY active_devices;
+    // Registered devices with nothing to do, checked for new events on each DoWork.
+    DLIST_ENTRY idle_devices;
+    // When all idle devices were last moved back to active_devices.
+    tickcounter_ms_t last_idle_devices_sweep_time;
+    // Millisecond clock used to measure the adaptive send windows, the idle device sweeps and the link idle timeouts.
+    TICK_COUNTER_HANDLE tick_counter;
     // Turns logging on and off
     bool is_trace_on;
+    // Hands received messages to the application as views over the uAMQP message body
+    bool c2d_zero_copy;
+    // AMQP session incoming window, applied to new sessions.
+    uint32_t incoming_window_size;
+    // AMQP session outgoing window; upper bound of the adaptive send window.
+    uint32_t outgoing_window_size;
+    // Max message size set on the message receiver links.
+    uint64_t receiver_max_message_size;
+    // Adjusts how many events each device keeps in flight according to how fast dispositions return.
+    bool adaptive_outgoing_window;
+    // Seconds an event sender link may stay without events before it is detached; 0 keeps it attached.
+    size_t link_idle_timeout_secs;
+    // Packs the events of each device into batched AMQP messages instead of sending one AMQP message per event.
+    bool event_batching;
     // Used to generate unique AMQP link names
     int link_count;
 
@@ -129,6 +169,25 @@ typedef struct AMQP_TRANSPORT_DEVICE_STATE_TAG
     PDLIST_ENTRY waitingToSend;
     // Internal list with the items currently being processed/sent through uAMQP.
     DLIST_ENTRY inProgress;
+    // Number of events in the inProgress list.
+    size_t events_in_progress_count;
+    // Current adaptive send window (max events in flight), used if adaptive_outgoing_window is on.
+    uint32_t send_window;
+    // Events in flight right after the last call to sendPendingEvents.
+    size_t events_in_flight_after_send;
+    // When the send window last became full; INDEFINITE_TICK if it is not full.
+    tickcounter_ms_t send_window_full_since;
+    // When events were last handed to the message sender.
+    tickcounter_ms_t last_send_time;
+    // Entry in either the active_devices or the idle_devices list of the transport.
+    DLIST_ENTRY activity_list_entry;
+    // Tells which of the two lists the device is in.
+    bool is_active;
+    // Set while the authentication or refresh of the device is waiting for a put-token slot.
+    bool is_put_token_deferred;
+    // AMQP message that messagesender_send() failed to take, kept with its send context to be sent again as is.
+    MESSAGE_HANDLE unsent_message;
+    struct EVENT_SEND_CONTEXT_TAG* unsent_send_context;
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
     // the methods portion
     IOTHUBTRANSPORT_AMQP_METHODS_HANDLE methods_handle;
@@ -139,6 +198,17 @@ typedef struct AMQP_TRANSPORT_DEVICE_STATE_TAG
 #endif
 } AMQP_TRANSPORT_DEVICE_STATE;
 
+// Context of each AMQP message handed to uAMQP, so its settlement can be accounted on the device that sent it.
+typedef struct EVENT_SEND_CONTEXT_TAG
+{
+    // Events carried by the AMQP message; more than one only for batched messages.
+    IOTHUB_MESSAGE_LIST** messages;
+    size_t message_count;
+    AMQP_TRANSPORT_DEVICE_STATE* device_state;
+    // Storage of `messages` when the AMQP message carries a single event.
+    IOTHUB_MESSAGE_LIST* message;
+} EVENT_SEND_CONTEXT;
+
 
 // Auxiliary functions
 
@@ -184,6 +254,19 @@ static int getSecondsSinceEpoch(size_t* seconds)
     return result;
 }
 
+static tickcounter_ms_t getCurrentTimeMs(AMQP_TRANSPORT_INSTANCE* transport_state)
+{
+    tickcounter_ms_t current_time;
+
+    if (tickcounter_get_current_ms(transport_state->tick_counter, &current_time) != 0)
+    {
+        LogError("Failed getting the current time (tickcounter_get_current_ms failed)");
+        current_time = INDEFINITE_TICK;
+    }
+
+    return current_time;
+}
+
 static STRING_HANDLE create_link_name(const char* deviceId, const char* tag, int index)
 {
     STRING_HANDLE name = NULL;
@@ -248,6 +331,7 @@ static void trackEventInProgress(IOTHUB_MESSAGE_LIST* message, AMQP_TRANSPORT_DE
 {
     DList_RemoveEntryList(&message->entry);
     DList_InsertTailList(&device_state->inProgress, &message->entry);
+    device_state->events_in_progress_count++;
 }
 
 static IOTHUB_MESSAGE_LIST* getNextEventToSend(AMQP_TRANSPORT_DEVICE_STATE* device_state)
@@ -272,15 +356,20 @@ static int isEventInInProgressList(IOTHUB_MESSAGE_LIST* message)
     return !DList_IsListEmpty(&message->entry);
 }
 
-static void removeEventFromInProgressList(IOTHUB_MESSAGE_LIST* message)
+static void removeEventFromInProgressList(IOTHUB_MESSAGE_LIST* message, AMQP_TRANSPORT_DEVICE_STATE* device_state)
 {
     DList_RemoveEntryList(&message->entry);
     DList_InitializeListHead(&message->entry);
+
+    if (device_state->events_in_progress_count > 0)
+    {
+        device_state->events_in_progress_count--;
+    }
 }
 
 static void rollEventBackToWaitList(IOTHUB_MESSAGE_LIST* message, AMQP_TRANSPORT_DEVICE_STATE* device_state)
 {
-    removeEventFromInProgressList(message);
+    removeEventFromInProgressList(message, device_state);
     DList_InsertTailList(device_state->waitingToSend, &message->entry);
 }
 
@@ -296,10 +385,8 @@ static void rollEventsBackToWaitList(AMQP_TRANSPORT_DEVICE_STATE* device_state)
     }
 }
 
-static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+static void completeEvent(IOTHUB_MESSAGE_LIST* message, AMQP_TRANSPORT_DEVICE_STATE* device_state, MESSAGE_SEND_RESULT send_result)
 {
-    IOTHUB_MESSAGE_LIST* message = (IOTHUB_MESSAGE_LIST*)context;
-
     IOTHUB_CLIENT_CONFIRMATION_RESULT iot_hub_send_result;
 
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_142: [The callback 'on_message_send_complete' shall pass to the upper layer callback an IOTHUB_CLIENT_CONFIRMATION_OK if the result received is MESSAGE_SEND_OK] 
@@ -322,7 +409,7 @@ static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_res
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_100: [The callback 'on_message_send_complete' shall remove the target message from the in-progress list after the upper layer callback] 
     if (isEventInInProgressList(message))
     {
-        removeEventFromInProgressList(message);
+        removeEventFromInProgressList(message, device_state);
     }
 
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_151: [The callback 'on_message_send_complete' shall destroy the message handle (IOTHUB_MESSAGE_HANDLE) using IoTHubMessage_Destroy()]
@@ -332,13 +419,125 @@ static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_res
     free(message); 
 }
 
+static EVENT_SEND_CONTEXT* createEventSendContext(AMQP_TRANSPORT_DEVICE_STATE* device_state)
+{
+    EVENT_SEND_CONTEXT* send_context;
+
+    if ((send_context = (EVENT_SEND_CONTEXT*)malloc(sizeof(EVENT_SEND_CONTEXT))) != NULL)
+    {
+        send_context->messages = NULL;
+        send_context->message_count = 0;
+        send_context->device_state = device_state;
+        send_context->message = NULL;
+    }
+
+    return send_context;
+}
+
+static int addEventToSendContext(EVENT_SEND_CONTEXT* send_context, IOTHUB_MESSAGE_LIST* message)
+{
+    int result;
+
+    if (send_context->message_count == 0)
+    {
+        send_context->message = message;
+        send_context->messages = &send_context->message;
+        send_context->message_count = 1;
+        result = RESULT_OK;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_LIST** messages = (send_context->messages == &send_context->message ? NULL : send_context->messages);
+
+        if ((messages = (IOTHUB_MESSAGE_LIST**)realloc(messages, (send_context->message_count + 1) * sizeof(IOTHUB_MESSAGE_LIST*))) == NULL)
+        {
+            LogError("Failed growing the list of events of the batched message.");
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (send_context->messages == &send_context->message)
+            {
+                messages[0] = send_context->message;
+            }
+
+            messages[send_context->message_count++] = message;
+            send_context->messages = messages;
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
+static void destroyEventSendContext(EVENT_SEND_CONTEXT* send_context)
+{
+    if (send_context->messages != &send_context->message)
+    {
+        free(send_context->messages);
+    }
+
+    free(send_context);
+}
+
+static void keepUnsentMessage(AMQP_TRANSPORT_DEVICE_STATE* device_state, MESSAGE_HANDLE amqp_message, EVENT_SEND_CONTEXT* send_context)
+{
+    device_state->unsent_message = amqp_message;
+    device_state->unsent_send_context = send_context;
+}
+
+static void discardUnsentMessage(AMQP_TRANSPORT_DEVICE_STATE* device_state)
+{
+    if (device_state->unsent_message != NULL)
+    {
+        message_destroy(device_state->unsent_message);
+        device_state->unsent_message = NULL;
+
+        destroyEventSendContext(device_state->unsent_send_context);
+        device_state->unsent_send_context = NULL;
+    }
+}
+
+// Puts the events of the unsent AMQP message back in progress after rollEventsBackToWaitList, so they are not built again.
+static void keepUnsentEventsInProgress(AMQP_TRANSPORT_DEVICE_STATE* device_state)
+{
+    if (device_state->unsent_send_context != NULL)
+    {
+        size_t i;
+
+        for (i = 0; i < device_state->unsent_send_context->message_count; i++)
+        {
+            trackEventInProgress(device_state->unsent_send_context->messages[i], device_state);
+        }
+    }
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+    EVENT_SEND_CONTEXT* send_context = (EVENT_SEND_CONTEXT*)context;
+    size_t i;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_292: [The callback 'on_message_send_complete' shall complete every event carried by the AMQP message, so the disposition of a batched message is passed to each of its events]
+    for (i = 0; i < send_context->message_count; i++)
+    {
+        completeEvent(send_context->messages[i], send_context->device_state, send_result);
+    }
+
+    destroyEventSendContext(send_context);
+}
+
 static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
 {
     AMQP_VALUE result = NULL;
     int api_call_result;
     IOTHUB_MESSAGE_HANDLE iothub_message = NULL;
+    AMQP_TRANSPORT_DEVICE_STATE* device_state = (AMQP_TRANSPORT_DEVICE_STATE*)context;
+
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_195: [The callback 'on_message_received' shall shall get a IOTHUB_MESSAGE_HANDLE instance out of the uamqp's MESSAGE_HANDLE instance by using IoTHubMessage_CreateFromUamqpMessage()]
-    if ((api_call_result = IoTHubMessage_CreateFromUamqpMessage(message, &iothub_message)) != RESULT_OK)
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_256: [If the `c2d_zero_copy` option is set, the callback 'on_message_received' shall use IoTHubMessage_CreateViewFromUamqpMessage() instead, so the message body references the uAMQP message until the callback returns]
+    if ((api_call_result = (device_state->transport_state->c2d_zero_copy ?
+        IoTHubMessage_CreateViewFromUamqpMessage(message, &iothub_message) :
+        IoTHubMessage_CreateFromUamqpMessage(message, &iothub_message))) != RESULT_OK)
     {
         LogError("Transport failed processing the message received (error = %d).", api_call_result);
 
@@ -350,7 +549,7 @@ static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE messag
         IOTHUBMESSAGE_DISPOSITION_RESULT disposition_result;
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_104: [The callback 'on_message_received' shall invoke IoTHubClient_LL_MessageCallback() passing the client and the incoming message handles as parameters] 
-        disposition_result = IoTHubClient_LL_MessageCallback((IOTHUB_CLIENT_LL_HANDLE)context, iothub_message);
+        disposition_result = IoTHubClient_LL_MessageCallback(device_state->iothub_client_handle, iothub_message);
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_197: [The callback 'on_message_received' shall destroy the IOTHUB_MESSAGE_HANDLE instance after invoking IoTHubClient_LL_MessageCallback().]
         IoTHubMessage_Destroy(iothub_message);
@@ -383,6 +582,9 @@ static void destroyConnection(AMQP_TRANSPORT_INSTANCE* transport_state)
         transport_state->cbs_connection.cbs_handle = NULL;
     }
 
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_278: [When the CBS connection is destroyed, the count of pending put-token requests shall be set to zero]
+    transport_state->cbs_connection.pending_put_tokens = 0;
+
     if (transport_state->session != NULL)
     {
         session_destroy(transport_state->session);
@@ -503,21 +705,71 @@ static int subscribe_methods(AMQP_TRANSPORT_DEVICE_STATE* deviceState)
 }
 #endif
 
-static void set_session_options(SESSION_HANDLE session)
+static void set_session_options(AMQP_TRANSPORT_INSTANCE* transport_state)
 {
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_065: [IoTHubTransport_AMQP_Common_DoWork shall apply a default value of UINT_MAX for the parameter 'AMQP incoming window'] 
-    if (session_set_incoming_window(session, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE) != 0)
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_259: [IoTHubTransport_AMQP_Common_DoWork shall apply the value of `amqp_incoming_window` instead of the default if it was set]
+    if (session_set_incoming_window(transport_state->session, transport_state->incoming_window_size) != 0)
     {
         LogError("Failed to set the AMQP incoming window size.");
     }
 
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_115: [IoTHubTransport_AMQP_Common_DoWork shall apply a default value of 100 for the parameter 'AMQP outgoing window'] 
-    if (session_set_outgoing_window(session, DEFAULT_OUTGOING_WINDOW_SIZE) != 0)
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_260: [IoTHubTransport_AMQP_Common_DoWork shall apply the value of `amqp_outgoing_window` instead of the default if it was set]
+    if (session_set_outgoing_window(transport_state->session, transport_state->outgoing_window_size) != 0)
     {
         LogError("Failed to set the AMQP outgoing window size.");
     }
 }
 
+static void updateAdaptiveSendWindow(AMQP_TRANSPORT_DEVICE_STATE* device_state, size_t events_in_flight)
+{
+    uint32_t max_window = device_state->transport_state->outgoing_window_size;
+
+    if (device_state->send_window == 0 || device_state->send_window > max_window)
+    {
+        device_state->send_window = (max_window < ADAPTIVE_WINDOW_INITIAL_SIZE ? max_window : ADAPTIVE_WINDOW_INITIAL_SIZE);
+    }
+
+    // Only a full window tells something about the service; otherwise the application is the one not sending enough.
+    if (device_state->send_window_full_since != INDEFINITE_TICK)
+    {
+        tickcounter_ms_t current_time;
+
+        if ((current_time = getCurrentTimeMs(device_state->transport_state)) == INDEFINITE_TICK)
+        {
+            LogError("Failed getting the current time; the AMQP send window of device %s is kept at %u", STRING_c_str(device_state->deviceId), (unsigned int)device_state->send_window);
+        }
+        else
+        {
+            tickcounter_ms_t ms_full = current_time - device_state->send_window_full_since;
+
+            if (events_in_flight == 0)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_262: [If `amqp_adaptive_outgoing_window` is on and all events of a full send window were settled within ADAPTIVE_WINDOW_FAST_DISPOSITION_MS, IoTHubTransport_AMQP_Common_DoWork shall double the send window, up to the AMQP outgoing window size]
+                if (ms_full <= ADAPTIVE_WINDOW_FAST_DISPOSITION_MS)
+                {
+                    device_state->send_window = (device_state->send_window > max_window / 2 ? max_window : device_state->send_window * 2);
+                }
+
+                device_state->send_window_full_since = INDEFINITE_TICK;
+            }
+            else if (events_in_flight < device_state->events_in_flight_after_send)
+            {
+                // Dispositions are still coming back, the window is draining.
+                device_state->send_window_full_since = INDEFINITE_TICK;
+            }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_263: [If `amqp_adaptive_outgoing_window` is on and no event of a full send window was settled for ADAPTIVE_WINDOW_BACKPRESSURE_MS, IoTHubTransport_AMQP_Common_DoWork shall halve the send window, down to 1]
+            else if (ms_full >= ADAPTIVE_WINDOW_BACKPRESSURE_MS)
+            {
+                device_state->send_window = (device_state->send_window / 2 < ADAPTIVE_WINDOW_MIN_SIZE ? ADAPTIVE_WINDOW_MIN_SIZE : device_state->send_window / 2);
+                LogInfo("AMQP send window of device %s reduced to %u (no dispositions for %lu ms)", STRING_c_str(device_state->deviceId), (unsigned int)device_state->send_window, (unsigned long)ms_full);
+                device_state->send_window_full_since = current_time;
+            }
+        }
+    }
+}
+
 static int establishConnection(AMQP_TRANSPORT_INSTANCE* transport_state)
 {
     int result;
@@ -587,7 +839,7 @@ static int establishConnection(AMQP_TRANSPORT_INSTANCE* transport_state)
                     }
                     else
                     {
-                        set_session_options(transport_state->session);
+                        set_session_options(transport_state);
 
                         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_066: [IoTHubTransport_AMQP_Common_DoWork shall establish the CBS connection using the cbs_create() AMQP API] 
                         if ((transport_state->cbs_connection.cbs_handle = cbs_create(transport_state->session, on_amqp_management_state_changed, NULL)) == NULL)
@@ -636,7 +888,7 @@ static int establishConnection(AMQP_TRANSPORT_INSTANCE* transport_state)
                     }
                     else
                     {
-                        set_session_options(transport_state->session);
+                        set_session_options(transport_state);
                     
                         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_199: [The value of the option `logtrace` saved by the transport instance shall be applied to each new connection instance using connection_set_trace().]
                         connection_set_trace(transport_state->connection, transport_state->is_trace_on);
@@ -725,6 +977,8 @@ static void destroyEventSender(AMQP_TRANSPORT_DEVICE_STATE* device_state)
 
         link_destroy(device_state->sender_link);
         device_state->sender_link = NULL;
+
+        device_state->message_sender_state = MESSAGE_SENDER_STATE_IDLE;
     }
 }
 
@@ -936,7 +1190,8 @@ static int createMessageReceiver(AMQP_TRANSPORT_DEVICE_STATE* device_state)
     else
     {
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_119: [IoTHubTransport_AMQP_Common_DoWork shall apply a default value of 65536 for the parameter 'Link MAX message size']
-        if (link_set_max_message_size(device_state->receiver_link, MESSAGE_RECEIVER_MAX_LINK_SIZE) != RESULT_OK)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_261: [IoTHubTransport_AMQP_Common_DoWork shall apply the value of `amqp_receiver_max_message_size` instead of the default if it was set]
+        if (link_set_max_message_size(device_state->receiver_link, device_state->transport_state->receiver_max_message_size) != RESULT_OK)
         {
             LogError("Failed setting AMQP link max message size for message receiver.");
         }
@@ -957,7 +1212,7 @@ static int createMessageReceiver(AMQP_TRANSPORT_DEVICE_STATE* device_state)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_079: [IoTHubTransport_AMQP_Common_DoWork shall open the AMQP message receiver using messagereceiver_open() AMQP API, passing a callback function for handling C2D incoming messages] 
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_123: [IoTHubTransport_AMQP_Common_DoWork shall create each AMQP message_receiver passing the 'on_message_received' as the callback function] 
-            if (messagereceiver_open(device_state->message_receiver, on_message_received, (const void*)device_state->iothub_client_handle) != RESULT_OK)
+            if (messagereceiver_open(device_state->message_receiver, on_message_received, (const void*)device_state) != RESULT_OK)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_080: [IoTHubTransport_AMQP_Common_DoWork shall fail and return immediately if the AMQP message receiver instance fails to be opened, flagging the connection to be re-established] 
                 LogError("Failed opening the AMQP message receiver.");
@@ -982,37 +1237,71 @@ static int createMessageReceiver(AMQP_TRANSPORT_DEVICE_STATE* device_state)
     return result;
 }
 
-static int sendPendingEvents(AMQP_TRANSPORT_DEVICE_STATE* device_state)
+static bool isSendWindowOpen(AMQP_TRANSPORT_DEVICE_STATE* device_state)
+{
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_264: [If `amqp_adaptive_outgoing_window` is on, IoTHubTransport_AMQP_Common_DoWork shall not have more events in progress than the current send window]
+    return (!device_state->transport_state->adaptive_outgoing_window || device_state->events_in_progress_count < device_state->send_window);
+}
+
+static int sendPendingEventsIndividually(AMQP_TRANSPORT_DEVICE_STATE* device_state, size_t* events_sent)
 {
     int result = RESULT_OK;
     IOTHUB_MESSAGE_LIST* message;
 
-    while ((message = getNextEventToSend(device_state)) != NULL)
+    while (isSendWindowOpen(device_state) && (message = getNextEventToSend(device_state)) != NULL)
     {
         result = __FAILURE__;
 
         MESSAGE_HANDLE amqp_message = NULL;
+        EVENT_SEND_CONTEXT* send_context;
         bool is_message_error = false;
+        bool is_message_kept = false;
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_086: [IoTHubTransport_AMQP_Common_DoWork shall move queued events to an "in-progress" list right before processing them for sending]
         trackEventInProgress(message, device_state);
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_288: [IoTHubTransport_AMQP_Common_DoWork shall allocate a context for each event sent, holding the event and its device, to be passed to on_message_send_complete]
+        if ((send_context = createEventSendContext(device_state)) == NULL)
+        {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_289: [If the context of the event cannot be allocated, IoTHubTransport_AMQP_Common_DoWork shall roll back the event to waitToSend list and return]
+            LogError("Failed allocating the send context of the event.");
+            result = __FAILURE__;
+        }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_193: [IoTHubTransport_AMQP_Common_DoWork shall get a MESSAGE_HANDLE instance out of the event's IOTHUB_MESSAGE_HANDLE instance by using message_create_from_iothub_message().]
-        if ((result = message_create_from_iothub_message(message->messageHandle, &amqp_message)) != RESULT_OK)
+        else if ((result = message_create_from_iothub_message(message->messageHandle, &amqp_message)) != RESULT_OK)
         {
             LogError("Failed creating AMQP message (error=%d).", result);
             result = __FAILURE__;
             is_message_error = true;
         }
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_097: [IoTHubTransport_AMQP_Common_DoWork shall pass the MESSAGE_HANDLE intance to uAMQP for sending (along with on_message_send_complete callback) using messagesender_send()] 
-        else if (messagesender_send(device_state->message_sender, amqp_message, on_message_send_complete, message) != RESULT_OK)
+        else
         {
-            LogError("Failed sending the AMQP message.");
-            result = __FAILURE__;
+            (void)addEventToSendContext(send_context, message);
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_097: [IoTHubTransport_AMQP_Common_DoWork shall pass the MESSAGE_HANDLE intance to uAMQP for sending (along with on_message_send_complete callback) using messagesender_send()] 
+            if (messagesender_send(device_state->message_sender, amqp_message, on_message_send_complete, send_context) != RESULT_OK)
+            {
+                LogError("Failed sending the AMQP message.");
+
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_113: [If messagesender_send() fails, IoTHubTransport_AMQP_Common_DoWork shall keep the MESSAGE_HANDLE instance and its context, with the event in progress, to be sent again, and return]
+                keepUnsentMessage(device_state, amqp_message, send_context);
+                amqp_message = NULL;
+                send_context = NULL;
+                is_message_kept = true;
+                result = __FAILURE__;
+            }
+            else
+            {
+                // Owned by on_message_send_complete from now on.
+                send_context = NULL;
+                (*events_sent)++;
+                result = RESULT_OK;
+            }
         }
-        else
+
+        if (send_context != NULL)
         {
-            result = RESULT_OK;
+            destroyEventSendContext(send_context);
         }
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_194: [IoTHubTransport_AMQP_Common_DoWork shall destroy the MESSAGE_HANDLE instance after messagesender_send() is invoked.]
@@ -1026,12 +1315,15 @@ static int sendPendingEvents(AMQP_TRANSPORT_DEVICE_STATE* device_state)
         {
             if (is_message_error)
             {
-                on_message_send_complete(message, MESSAGE_SEND_ERROR);
+                completeEvent(message, device_state, MESSAGE_SEND_ERROR);
+            }
+            else if (is_message_kept)
+            {
+                break;
             }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_111: [If message_create_from_iothub_message() fails, IoTHubTransport_AMQP_Common_DoWork notify the failure, roll back the event to waitToSend list and return]
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_113: [If messagesender_send() fails, IoTHubTransport_AMQP_Common_DoWork notify the failure, roll back the event to waitToSend list and return]
                 rollEventBackToWaitList(message, device_state);
                 break;
             }
@@ -1041,6 +1333,323 @@ static int sendPendingEvents(AMQP_TRANSPORT_DEVICE_STATE* device_state)
     return result;
 }
 
+// Hands a batched AMQP message to uAMQP; on failure the message is kept on the device to be sent again, otherwise it is destroyed.
+static int sendEventBatch(AMQP_TRANSPORT_DEVICE_STATE* device_state, MESSAGE_HANDLE batch_message, EVENT_SEND_CONTEXT* send_context)
+{
+    int result;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_297: [If `amqp_event_batching` is on, each batched MESSAGE_HANDLE shall be passed to uAMQP using messagesender_send(), with one context holding all the events packed in it]
+    if (messagesender_send(device_state->message_sender, batch_message, on_message_send_complete, send_context) != RESULT_OK)
+    {
+        LogError("Failed sending the AMQP batched message.");
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_298: [If messagesender_send() fails for a batched message, IoTHubTransport_AMQP_Common_DoWork shall keep the batched MESSAGE_HANDLE and its context, with its events in progress, to be sent again, and return]
+        keepUnsentMessage(device_state, batch_message, send_context);
+        result = __FAILURE__;
+    }
+    else
+    {
+        // It can be destroyed because AMQP keeps a clone of the message.
+        message_destroy(batch_message);
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static int sendPendingEventsInBatches(AMQP_TRANSPORT_DEVICE_STATE* device_state, size_t* events_sent)
+{
+    int result = RESULT_OK;
+    IOTHUB_MESSAGE_LIST* message;
+    MESSAGE_HANDLE batch_message = NULL;
+    EVENT_SEND_CONTEXT* send_context = NULL;
+    size_t batch_size = 0;
+
+    while (isSendWindowOpen(device_state) && (message = getNextEventToSend(device_state)) != NULL)
+    {
+        BINARY_DATA encoded_event;
+
+        trackEventInProgress(message, device_state);
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_294: [If `amqp_event_batching` is on, IoTHubTransport_AMQP_Common_DoWork shall encode each event using message_create_uamqp_encoding_from_iothub_message()]
+        if (message_create_uamqp_encoding_from_iothub_message(message->messageHandle, &encoded_event) != RESULT_OK)
+        {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_295: [If message_create_uamqp_encoding_from_iothub_message() fails, the event shall be completed with IOTHUB_CLIENT_CONFIRMATION_ERROR and IoTHubTransport_AMQP_Common_DoWork shall continue with the next event]
+            LogError("Failed encoding the event for batching.");
+            completeEvent(message, device_state, MESSAGE_SEND_ERROR);
+            continue;
+        }
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_296: [If adding the encoded event would make the current batched message exceed EVENT_BATCH_MAX_SIZE, that message shall be sent before a new one is started]
+        if (batch_message != NULL && batch_size + encoded_event.length + EVENT_BATCH_DATA_SECTION_OVERHEAD > EVENT_BATCH_MAX_SIZE)
+        {
+            size_t batch_event_count = send_context->message_count;
+
+            result = sendEventBatch(device_state, batch_message, send_context);
+            batch_message = NULL;
+            send_context = NULL;
+            batch_size = 0;
+
+            if (result != RESULT_OK)
+            {
+                free((void*)encoded_event.bytes);
+                rollEventBackToWaitList(message, device_state);
+                break;
+            }
+
+            *events_sent += batch_event_count;
+        }
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_293: [If `amqp_event_batching` is on, IoTHubTransport_AMQP_Common_DoWork shall create each batched MESSAGE_HANDLE using message_create() and set its format to AMQP_BATCHING_FORMAT_CODE using message_set_message_format()]
+        if (batch_message == NULL)
+        {
+            if ((batch_message = message_create()) == NULL)
+            {
+                LogError("Failed creating the AMQP batched message.");
+            }
+            else if (message_set_message_format(batch_message, AMQP_BATCHING_FORMAT_CODE) != RESULT_OK)
+            {
+                LogError("Failed setting the format of the AMQP batched message.");
+                message_destroy(batch_message);
+                batch_message = NULL;
+            }
+            else if ((send_context = createEventSendContext(device_state)) == NULL)
+            {
+                LogError("Failed allocating the send context of the AMQP batched message.");
+                message_destroy(batch_message);
+                batch_message = NULL;
+            }
+        }
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_299: [Each encoded event shall be added to the batched MESSAGE_HANDLE as a data section using message_add_body_amqp_data()]
+        if (batch_message == NULL ||
+            addEventToSendContext(send_context, message) != RESULT_OK)
+        {
+            result = __FAILURE__;
+        }
+        else if (message_add_body_amqp_data(batch_message, encoded_event) != RESULT_OK)
+        {
+            LogError("Failed adding the event to the AMQP batched message.");
+            send_context->message_count--;
+            result = __FAILURE__;
+        }
+        else
+        {
+            batch_size += encoded_event.length + EVENT_BATCH_DATA_SECTION_OVERHEAD;
+        }
+
+        // message_add_body_amqp_data() copies the encoded event.
+        free((void*)encoded_event.bytes);
+
+        if (result != RESULT_OK)
+        {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_300: [If the batched message cannot be created or the event added to it, IoTHubTransport_AMQP_Common_DoWork shall roll back the event to the waitToSend list, send the events already batched and return]
+            rollEventBackToWaitList(message, device_state);
+            break;
+        }
+    }
+
+    if (batch_message != NULL)
+    {
+        size_t batch_event_count = send_context->message_count;
+
+        if (batch_event_count == 0)
+        {
+            destroyEventSendContext(send_context);
+            message_destroy(batch_message);
+        }
+        else if (sendEventBatch(device_state, batch_message, send_context) != RESULT_OK)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            *events_sent += batch_event_count;
+        }
+    }
+
+    return result;
+}
+
+static int sendUnsentMessage(AMQP_TRANSPORT_DEVICE_STATE* device_state, size_t* events_sent)
+{
+    int result;
+
+    if (device_state->unsent_message == NULL)
+    {
+        result = RESULT_OK;
+    }
+    else
+    {
+        size_t unsent_event_count = device_state->unsent_send_context->message_count;
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_303: [If an AMQP message was kept because messagesender_send() failed, IoTHubTransport_AMQP_Common_DoWork shall first pass that same MESSAGE_HANDLE and context to messagesender_send(), without creating or encoding its events again]
+        if (messagesender_send(device_state->message_sender, device_state->unsent_message, on_message_send_complete, device_state->unsent_send_context) != RESULT_OK)
+        {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_304: [If messagesender_send() fails again, the AMQP message shall stay kept and IoTHubTransport_AMQP_Common_DoWork shall not send other events of the device]
+            LogError("Failed sending again the AMQP message kept from a previous attempt.");
+            result = __FAILURE__;
+        }
+        else
+        {
+            // The context is owned by on_message_send_complete from now on.
+            device_state->unsent_send_context = NULL;
+            message_destroy(device_state->unsent_message);
+            device_state->unsent_message = NULL;
+
+            *events_sent += unsent_event_count;
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
+static int sendPendingEvents(AMQP_TRANSPORT_DEVICE_STATE* device_state)
+{
+    int result;
+    bool adaptive_window = device_state->transport_state->adaptive_outgoing_window;
+    size_t events_sent = 0;
+
+    if (adaptive_window)
+    {
+        updateAdaptiveSendWindow(device_state, device_state->events_in_progress_count);
+    }
+
+    if (sendUnsentMessage(device_state, &events_sent) != RESULT_OK)
+    {
+        result = __FAILURE__;
+    }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_301: [If `amqp_event_batching` is on, IoTHubTransport_AMQP_Common_DoWork shall pack the pending events of each device into batched AMQP messages of up to EVENT_BATCH_MAX_SIZE bytes]
+    else if (device_state->transport_state->event_batching)
+    {
+        result = sendPendingEventsInBatches(device_state, &events_sent);
+    }
+    else
+    {
+        result = sendPendingEventsIndividually(device_state, &events_sent);
+    }
+
+    if (adaptive_window)
+    {
+        if (device_state->events_in_progress_count >= device_state->send_window)
+        {
+            if (device_state->send_window_full_since == INDEFINITE_TICK)
+            {
+                device_state->send_window_full_since = getCurrentTimeMs(device_state->transport_state);
+            }
+        }
+        else
+        {
+            device_state->send_window_full_since = INDEFINITE_TICK;
+        }
+
+        device_state->events_in_flight_after_send = device_state->events_in_progress_count;
+    }
+
+    if (events_sent > 0)
+    {
+        device_state->last_send_time = getCurrentTimeMs(device_state->transport_state);
+    }
+
+    return result;
+}
+
+static void setDeviceActive(AMQP_TRANSPORT_DEVICE_STATE* device_state, bool is_active)
+{
+    if (device_state->is_active != is_active)
+    {
+        AMQP_TRANSPORT_INSTANCE* transport_state = device_state->transport_state;
+
+        (void)DList_RemoveEntryList(&device_state->activity_list_entry);
+        DList_InsertTailList(is_active ? &transport_state->active_devices : &transport_state->idle_devices, &device_state->activity_list_entry);
+        device_state->is_active = is_active;
+    }
+}
+
+static void activateIdleDevices(AMQP_TRANSPORT_INSTANCE* transport_state)
+{
+    bool activate_all;
+    tickcounter_ms_t current_time = getCurrentTimeMs(transport_state);
+
+    if (current_time == INDEFINITE_TICK)
+    {
+        LogError("Failed getting the current time; all idle devices will be processed.");
+        activate_all = true;
+    }
+    else if (transport_state->last_idle_devices_sweep_time == INDEFINITE_TICK ||
+        current_time - transport_state->last_idle_devices_sweep_time >= IDLE_DEVICES_SWEEP_INTERVAL_MS)
+    {
+        transport_state->last_idle_devices_sweep_time = current_time;
+        activate_all = true;
+    }
+    else
+    {
+        activate_all = false;
+    }
+
+    PDLIST_ENTRY entry = transport_state->idle_devices.Flink;
+
+    while (entry != &transport_state->idle_devices)
+    {
+        AMQP_TRANSPORT_DEVICE_STATE* device_state = containingRecord(entry, AMQP_TRANSPORT_DEVICE_STATE, activity_list_entry);
+        // The device may be moved to the active list below.
+        entry = entry->Flink;
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_267: [IoTHubTransport_AMQP_Common_DoWork shall move to the active device list every idle device that has events waiting to be sent]
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_268: [Every IDLE_DEVICES_SWEEP_INTERVAL_MS, IoTHubTransport_AMQP_Common_DoWork shall move all idle devices to the active device list, so their authentication gets refreshed and idle links detached]
+        if (activate_all || !DList_IsListEmpty(device_state->waitingToSend))
+        {
+            setDeviceActive(device_state, true);
+        }
+    }
+}
+
+static bool isDeviceIdle(AMQP_TRANSPORT_DEVICE_STATE* device_state)
+{
+    return device_state->receive_messages == (device_state->message_receiver != NULL) &&
+#ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
+        (!device_state->subscribe_methods_needed || device_state->subscribed_for_methods) &&
+#endif
+        DList_IsListEmpty(device_state->waitingToSend) &&
+        DList_IsListEmpty(&device_state->inProgress);
+}
+
+static bool isEventSenderIdleTimeoutReached(AMQP_TRANSPORT_DEVICE_STATE* device_state)
+{
+    bool result;
+    size_t idle_timeout_secs = device_state->transport_state->link_idle_timeout_secs;
+
+    if (idle_timeout_secs == 0 ||
+        !DList_IsListEmpty(device_state->waitingToSend) ||
+        !DList_IsListEmpty(&device_state->inProgress))
+    {
+        result = false;
+    }
+    else
+    {
+        tickcounter_ms_t current_time = getCurrentTimeMs(device_state->transport_state);
+
+        if (current_time == INDEFINITE_TICK)
+        {
+            LogError("Failed getting the current time to verify the event sender idle timeout.");
+            result = false;
+        }
+        else if (device_state->last_send_time == INDEFINITE_TICK)
+        {
+            // The idle period starts when the sender is first checked.
+            device_state->last_send_time = current_time;
+            result = false;
+        }
+        else
+        {
+            result = (current_time - device_state->last_send_time >= (tickcounter_ms_t)idle_timeout_secs * MS_PER_SEC);
+        }
+    }
+
+    return result;
+}
+
 static void prepareDeviceForConnectionRetry(AMQP_TRANSPORT_DEVICE_STATE* device_state)
 {
     if (authentication_reset(device_state->authentication) != RESULT_OK)
@@ -1056,6 +1665,17 @@ static void prepareDeviceForConnectionRetry(AMQP_TRANSPORT_DEVICE_STATE* device_
     destroyMessageReceiver(device_state);
     destroyEventSender(device_state);
     rollEventsBackToWaitList(device_state);
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_305: [On a connection retry, the AMQP message kept because messagesender_send() failed shall be kept, with its events in progress, to be sent on the new connection]
+    keepUnsentEventsInProgress(device_state);
+
+    // The events rolled back will not be settled, the adaptive send window keeps its size but starts measuring again
+    device_state->events_in_flight_after_send = 0;
+    device_state->send_window_full_since = INDEFINITE_TICK;
+    device_state->last_send_time = INDEFINITE_TICK;
+
+    // Every device has to authenticate again on the new connection.
+    setDeviceActive(device_state, true);
 }
 
 static void prepareForConnectionRetry(AMQP_TRANSPORT_INSTANCE* transport_state)
@@ -1146,12 +1766,24 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
             bool cleanup_required = false;
 
             transport_state->iotHubHostFqdn = NULL;
+            transport_state->registered_devices = NULL;
+            transport_state->tick_counter = NULL;
             transport_state->connection = NULL;
             transport_state->connection_state = AMQP_MANAGEMENT_STATE_IDLE;
             transport_state->session = NULL;
             transport_state->tls_io = NULL;
             transport_state->underlying_io_transport_provider = get_io_transport;
             transport_state->is_trace_on = false;
+            transport_state->c2d_zero_copy = false;
+            transport_state->incoming_window_size = (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE;
+            transport_state->outgoing_window_size = DEFAULT_OUTGOING_WINDOW_SIZE;
+            transport_state->receiver_max_message_size = MESSAGE_RECEIVER_MAX_LINK_SIZE;
+            transport_state->adaptive_outgoing_window = false;
+            transport_state->link_idle_timeout_secs = DEFAULT_LINK_IDLE_TIMEOUT_SECS;
+            transport_state->event_batching = false;
+            DList_InitializeListHead(&transport_state->active_devices);
+            DList_InitializeListHead(&transport_state->idle_devices);
+            transport_state->last_idle_devices_sweep_time = INDEFINITE_TICK;
 
             transport_state->cbs_connection.cbs_handle = NULL;
             transport_state->cbs_connection.sasl_io = NULL;
@@ -1163,6 +1795,17 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
             transport_state->cbs_connection.sas_token_refresh_time = transport_state->cbs_connection.sas_token_lifetime / 2;
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_129 : [IoTHubTransport_AMQP_Common_Create shall set parameter device_state->cbs_request_timeout with the default value of 30000 (milliseconds).]
             transport_state->cbs_connection.cbs_request_timeout = DEFAULT_CBS_REQUEST_TIMEOUT_MS;
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_279: [IoTHubTransport_AMQP_Common_Create shall set `sas_token_refresh_jitter_percent` to 20 and `cbs_max_pending_put_tokens` to 10, and zero the CBS statistics.]
+            transport_state->cbs_connection.sas_token_refresh_jitter_percent = DEFAULT_SAS_TOKEN_REFRESH_JITTER_PERCENT;
+            transport_state->cbs_connection.pending_put_tokens = 0;
+            transport_state->cbs_connection.put_tokens_sent = 0;
+            transport_state->cbs_connection.put_tokens_completed = 0;
+            transport_state->cbs_connection.put_tokens_failed = 0;
+            transport_state->cbs_connection.last_put_token_latency = 0;
+            transport_state->cbs_connection.max_put_token_latency = 0;
+            transport_state->cbs_connection.total_put_token_latency = 0;
+            transport_state->cbs_max_pending_put_tokens = DEFAULT_CBS_MAX_PENDING_PUT_TOKENS;
+            transport_state->cbs_put_token_deferrals = 0;
 
             transport_state->preferred_credential_type = CREDENTIAL_NOT_BUILD;
 
@@ -1183,16 +1826,30 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
                 LogError("Failed to initialize the internal list of registered devices");
                 cleanup_required = true;
             }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_285: [IoTHubTransport_AMQP_Common_Create shall create a TICK_COUNTER_HANDLE using tickcounter_create(), used to measure the adaptive send window, the idle device sweep and the link idle timeout]
+            else if ((transport_state->tick_counter = tickcounter_create()) == NULL)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_286: [If tickcounter_create fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL.]
+                LogError("Failed to create the tick counter");
+                cleanup_required = true;
+            }
 
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_236: [If IoTHubTransport_AMQP_Common_Create fails it shall free any memory it allocated (iotHubHostFqdn, transport state).]
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_236: [If IoTHubTransport_AMQP_Common_Create fails it shall free any memory it allocated (iotHubHostFqdn, registered device list, transport state).]
             if (cleanup_required)
             {
                 if (transport_state->iotHubHostFqdn != NULL)
                     STRING_delete(transport_state->iotHubHostFqdn);
+                if (transport_state->registered_devices != NULL)
+                    VECTOR_destroy(transport_state->registered_devices);
 
                 free(transport_state);
                 transport_state = NULL;
             }
+            else
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_291: [IoTHubTransport_AMQP_Common_Create shall seed the random number generator with the current time using srand(), so the SAS token refresh jitter is not the same on every run]
+                srand((unsigned int)get_time(NULL));
+            }
         }
     }
 
@@ -1200,6 +1857,31 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
     return transport_state;
 }
 
+static bool isPutTokenSlotAvailable(AMQP_TRANSPORT_DEVICE_STATE* device_state)
+{
+    bool result;
+    AMQP_TRANSPORT_INSTANCE* transport_state = device_state->transport_state;
+
+    if (transport_state->cbs_max_pending_put_tokens == 0 ||
+        transport_state->cbs_connection.pending_put_tokens < transport_state->cbs_max_pending_put_tokens)
+    {
+        device_state->is_put_token_deferred = false;
+        result = true;
+    }
+    else
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_290: [Each device shall be counted once in `putTokensDeferred` for as long as it keeps waiting for a put-token slot]
+        if (!device_state->is_put_token_deferred)
+        {
+            transport_state->cbs_put_token_deferrals++;
+            device_state->is_put_token_deferred = true;
+        }
+        result = false;
+    }
+
+    return result;
+}
+
 static RESULT device_DoWork(AMQP_TRANSPORT_DEVICE_STATE* device_state)
 {
     RESULT result = RESULT_SUCCESS;
@@ -1209,8 +1891,13 @@ static RESULT device_DoWork(AMQP_TRANSPORT_DEVICE_STATE* device_state)
     switch (auth_status)
     {
         case AUTHENTICATION_STATUS_IDLE:
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_277: [If `cbs_max_pending_put_tokens` is not zero and as many put-token requests are pending on the CBS connection, IoTHubTransport_AMQP_Common_DoWork shall leave the device authentication or refresh for a later call]
+            if (!isPutTokenSlotAvailable(device_state))
+            {
+                // Retried on a later DoWork call, the device stays in the active list.
+            }
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_243: [If the device authentication status is AUTHENTICATION_STATUS_IDLE, IoTHubTransport_AMQP_Common_DoWork shall authenticate it using authentication_authenticate()]
-            if (authentication_authenticate(device_state->authentication) != RESULT_OK)
+            else if (authentication_authenticate(device_state->authentication) != RESULT_OK)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_146: [If authentication_authenticate() fails, IoTHubTransport_AMQP_Common_DoWork shall fail and process the next device]
                 LogError("Failed authenticating AMQP connection [%s]", STRING_c_str(device_state->deviceId));
@@ -1218,8 +1905,13 @@ static RESULT device_DoWork(AMQP_TRANSPORT_DEVICE_STATE* device_state)
             }
             break;
         case AUTHENTICATION_STATUS_REFRESH_REQUIRED:
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_277: [If `cbs_max_pending_put_tokens` is not zero and as many put-token requests are pending on the CBS connection, IoTHubTransport_AMQP_Common_DoWork shall leave the device authentication or refresh for a later call]
+            if (!isPutTokenSlotAvailable(device_state))
+            {
+                // Retried on a later DoWork call, the device stays in the active list.
+            }
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_081: [If the device authentication status is AUTHENTICATION_STATUS_REFRESH_REQUIRED, IoTHubTransport_AMQP_Common_DoWork shall refresh it using authentication_refresh()]
-            if (authentication_refresh(device_state->authentication) != RESULT_OK)
+            else if (authentication_refresh(device_state->authentication) != RESULT_OK)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_082: [**If authentication_refresh() fails, IoTHubTransport_AMQP_Common_DoWork shall fail and process the next device]
                 LogError("AMQP transport failed to refresh authentication [%s]", STRING_c_str(device_state->deviceId));
@@ -1254,11 +1946,15 @@ static RESULT device_DoWork(AMQP_TRANSPORT_DEVICE_STATE* device_state)
                 LogError("Failed destroying AMQP transport message receiver [%s]", STRING_c_str(device_state->deviceId));
             }
 
-            if (device_state->message_sender == NULL &&
-                createEventSender(device_state) != RESULT_OK)
+            if (device_state->message_sender == NULL)
             {
-                LogError("Failed creating AMQP transport event sender [%s]", STRING_c_str(device_state->deviceId));
-                result = RESULT_CRITICAL_ERROR;
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_269: [IoTHubTransport_AMQP_Common_DoWork shall create the AMQP message_sender only when the device has events waiting to be sent]
+                if (!DList_IsListEmpty(device_state->waitingToSend) &&
+                    createEventSender(device_state) != RESULT_OK)
+                {
+                    LogError("Failed creating AMQP transport event sender [%s]", STRING_c_str(device_state->deviceId));
+                    result = RESULT_CRITICAL_ERROR;
+                }
             }
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_245: [IoTHubTransport_AMQP_Common_DoWork shall skip sending events if the state of the message_sender is not MESSAGE_SENDER_STATE_OPEN]
             else if (device_state->message_sender_state == MESSAGE_SENDER_STATE_OPEN &&
@@ -1267,6 +1963,23 @@ static RESULT device_DoWork(AMQP_TRANSPORT_DEVICE_STATE* device_state)
                 LogError("AMQP transport failed sending events [%s]", STRING_c_str(device_state->deviceId));
                 result = RESULT_CRITICAL_ERROR;
             }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_270: [If `amqp_link_idle_timeout` is greater than zero and the device had no events waiting or in progress for that many seconds, IoTHubTransport_AMQP_Common_DoWork shall destroy the AMQP message_sender and its link]
+            else if (isEventSenderIdleTimeoutReached(device_state))
+            {
+                if (device_state->transport_state->is_trace_on)
+                {
+                    LogInfo("Detaching idle event sender link [%s]", STRING_c_str(device_state->deviceId));
+                }
+
+                destroyEventSender(device_state);
+                device_state->last_send_time = INDEFINITE_TICK;
+            }
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_271: [IoTHubTransport_AMQP_Common_DoWork shall move the device to the idle device list if it has no events waiting or in progress and its message_receiver matches its subscription state]
+            if (result == RESULT_SUCCESS && isDeviceIdle(device_state))
+            {
+                setDeviceActive(device_state, false);
+            }
             break;
         case AUTHENTICATION_STATUS_FAILURE:
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_083: [If the device authentication status is AUTHENTICATION_STATUS_FAILURE, IoTHubTransport_AMQP_Common_DoWork shall fail and process the next device]
@@ -1328,10 +2041,16 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
             }
             else
             {
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_241: [IoTHubTransport_AMQP_Common_DoWork shall iterate through all its registered devices to process authentication, events to be sent, messages to be received]
-                for (size_t i = 0; i < number_of_registered_devices; i++)
+                activateIdleDevices(transport_state);
+
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_241: [IoTHubTransport_AMQP_Common_DoWork shall iterate through all its active devices to process authentication, events to be sent, messages to be received]
+                PDLIST_ENTRY entry = transport_state->active_devices.Flink;
+
+                while (entry != &transport_state->active_devices)
                 {
-                    AMQP_TRANSPORT_DEVICE_STATE* device_state = *(AMQP_TRANSPORT_DEVICE_STATE**)VECTOR_element(transport_state->registered_devices, i);
+                    AMQP_TRANSPORT_DEVICE_STATE* device_state = containingRecord(entry, AMQP_TRANSPORT_DEVICE_STATE, activity_list_entry);
+                    // device_DoWork may move the device to the idle list.
+                    entry = entry->Flink;
 
                     RESULT actionable_result = device_DoWork(device_state);
 
@@ -1370,6 +2089,8 @@ int IoTHubTransport_AMQP_Common_Subscribe(IOTHUB_DEVICE_HANDLE handle)
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_038: [IoTHubTransport_AMQP_Common_Subscribe shall set transport_handle->receive_messages to true and return success code.]
         AMQP_TRANSPORT_DEVICE_STATE* device_state = (AMQP_TRANSPORT_DEVICE_STATE*)handle;
         device_state->receive_messages = true;
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_275: [IoTHubTransport_AMQP_Common_Subscribe shall move the device to the active device list, so the message_receiver gets created on the next DoWork]
+        setDeviceActive(device_state, true);
         result = 0;
     }
 
@@ -1388,6 +2109,8 @@ void IoTHubTransport_AMQP_Common_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_040: [IoTHubTransport_AMQP_Common_Unsubscribe shall set transport_handle->receive_messages to false.]
         AMQP_TRANSPORT_DEVICE_STATE* device_state = (AMQP_TRANSPORT_DEVICE_STATE*)handle;
         device_state->receive_messages = false;
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_276: [IoTHubTransport_AMQP_Common_Unsubscribe shall move the device to the active device list, so the message_receiver gets destroyed on the next DoWork]
+        setDeviceActive(device_state, true);
     }
 }
 
@@ -1425,6 +2148,7 @@ int IoTHubTransport_AMQP_Common_Subscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE hand
         /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_005: [ If the transport is already subscribed to receive C2D method requests, `IoTHubTransport_AMQP_Common_Subscribe_DeviceMethod` shall perform no additional action and return 0. ]*/
         device_state->subscribe_methods_needed = true;
         device_state->subscribed_for_methods = false;
+        setDeviceActive(device_state, true);
         result = 0;
 #else
         LogError("Not implemented");
@@ -1570,6 +2294,98 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
             transport_state->cbs_connection.cbs_request_timeout = *((size_t*)value);
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(OPTION_SAS_TOKEN_REFRESH_JITTER_PERCENT, option) == 0)
+        {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_281: [If `optionName` is `sas_token_refresh_jitter_percent` and the value is 100 or more, IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG]
+            if (*((size_t*)value) >= 100)
+            {
+                LogError("IoTHubTransport_AMQP_Common_SetOption failed (sas_token_refresh_jitter_percent must be lower than 100)");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_280: [If `optionName` is `sas_token_refresh_jitter_percent`, the size_t value shall be saved on the transport instance, to be applied to SAS tokens created afterwards, and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK]
+                transport_state->cbs_connection.sas_token_refresh_jitter_percent = *((size_t*)value);
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_282: [If `optionName` is `cbs_max_pending_put_tokens`, the size_t value shall be saved on the transport instance and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK]
+        else if (strcmp(OPTION_CBS_MAX_PENDING_PUT_TOKENS, option) == 0)
+        {
+            transport_state->cbs_max_pending_put_tokens = *((size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_255: [If `optionName` is `c2d_zero_copy`, the bool value shall be saved on the transport instance and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK]
+        else if (strcmp(OPTION_C2D_ZERO_COPY, option) == 0)
+        {
+            transport_state->c2d_zero_copy = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_257: [If `optionName` is `amqp_incoming_window` or `amqp_outgoing_window`, the uint32_t value shall be saved on the transport instance, applied to the current AMQP session if it exists, and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK]
+        else if (strcmp(OPTION_AMQP_INCOMING_WINDOW, option) == 0)
+        {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_258: [If `optionName` is `amqp_incoming_window` or `amqp_outgoing_window` and the value is zero, IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG]
+            if (*((uint32_t*)value) == 0)
+            {
+                LogError("IoTHubTransport_AMQP_Common_SetOption failed (amqp_incoming_window cannot be zero)");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_state->incoming_window_size = *((uint32_t*)value);
+
+                if (transport_state->session != NULL &&
+                    session_set_incoming_window(transport_state->session, transport_state->incoming_window_size) != 0)
+                {
+                    LogError("Failed to set the AMQP incoming window size on the current session.");
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_AMQP_OUTGOING_WINDOW, option) == 0)
+        {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_258: [If `optionName` is `amqp_incoming_window` or `amqp_outgoing_window` and the value is zero, IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG]
+            if (*((uint32_t*)value) == 0)
+            {
+                LogError("IoTHubTransport_AMQP_Common_SetOption failed (amqp_outgoing_window cannot be zero)");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_state->outgoing_window_size = *((uint32_t*)value);
+
+                if (transport_state->session != NULL &&
+                    session_set_outgoing_window(transport_state->session, transport_state->outgoing_window_size) != 0)
+                {
+                    LogError("Failed to set the AMQP outgoing window size on the current session.");
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_265: [If `optionName` is `amqp_receiver_max_message_size`, the uint64_t value shall be saved on the transport instance, to be applied to message receiver links created afterwards, and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK]
+        else if (strcmp(OPTION_AMQP_RECEIVER_MAX_MESSAGE_SIZE, option) == 0)
+        {
+            transport_state->receiver_max_message_size = *((uint64_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_266: [If `optionName` is `amqp_adaptive_outgoing_window`, the bool value shall be saved on the transport instance and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK]
+        else if (strcmp(OPTION_AMQP_ADAPTIVE_OUTGOING_WINDOW, option) == 0)
+        {
+            transport_state->adaptive_outgoing_window = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_272: [If `optionName` is `amqp_link_idle_timeout`, the size_t value (in seconds) shall be saved on the transport instance and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK]
+        else if (strcmp(OPTION_AMQP_LINK_IDLE_TIMEOUT, option) == 0)
+        {
+            transport_state->link_idle_timeout_secs = *((size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_302: [If `optionName` is `amqp_event_batching`, the bool value shall be saved on the transport instance and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK]
+        else if (strcmp(OPTION_AMQP_EVENT_BATCHING, option) == 0)
+        {
+            transport_state->event_batching = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
         else if (strcmp(OPTION_LOG_TRACE, option) == 0)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_198: [If `optionName` is `logtrace`, IoTHubTransport_AMQP_Common_SetOption shall save the value on the transport instance.]
@@ -1736,6 +2552,15 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                 device_state->waitingToSend = waitingToSend;
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_226: [IoTHubTransport_AMQP_Common_Register shall initialize the device state inProgress list using DList_InitializeListHead().]
                 DList_InitializeListHead(&device_state->inProgress);
+                device_state->events_in_progress_count = 0;
+                device_state->send_window = 0;
+                device_state->events_in_flight_after_send = 0;
+                device_state->send_window_full_since = INDEFINITE_TICK;
+                device_state->last_send_time = INDEFINITE_TICK;
+                device_state->is_active = false;
+                device_state->is_put_token_deferred = false;
+                device_state->unsent_message = NULL;
+                device_state->unsent_send_context = NULL;
 
                 device_state->deviceId = NULL;
                 device_state->authentication = NULL;
@@ -1826,6 +2651,10 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                                 transport_state->preferred_credential_type = authentication_get_credential(device_state->authentication)->type;
                             }
 
+                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_273: [IoTHubTransport_AMQP_Common_Register shall add the new device to the active device list, so it gets authenticated on the next DoWork]
+                            DList_InsertTailList(&transport_state->active_devices, &device_state->activity_list_entry);
+                            device_state->is_active = true;
+
                             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_233: [IoTHubTransport_AMQP_Common_Register shall return its internal device representation as a IOTHUB_DEVICE_HANDLE.]
                             result = (IOTHUB_DEVICE_HANDLE)device_state;
                             cleanup_required = false;
@@ -1891,6 +2720,9 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_211: [IoTHubTransport_AMQP_Common_Unregister shall destroy the AMQP message_receiver link.]
                 destroyMessageReceiver(device_state);
 
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_306: [IoTHubTransport_AMQP_Common_Unregister shall destroy the AMQP message kept because messagesender_send() failed, and its context]
+                discardUnsentMessage(device_state);
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_036: [IoTHubTransport_AMQP_Common_Unregister shall return the remaining items in inProgress to waitingToSend list.]
                 rollEventsBackToWaitList(device_state);
 
@@ -1910,6 +2742,9 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_218: [IoTHubTransport_AMQP_Common_Unregister shall remove the device from its list of registered devices using VECTOR_erase().]
                 VECTOR_erase(device_state->transport_state->registered_devices, registered_device_state, 1);
 
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_274: [IoTHubTransport_AMQP_Common_Unregister shall remove the device from the active or idle device list using DList_RemoveEntryList().]
+                (void)DList_RemoveEntryList(&device_state->activity_list_entry);
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_219: [IoTHubTransport_AMQP_Common_Unregister shall destroy the IOTHUB_DEVICE_HANDLE instance provided.]
                 free(device_state);
             }
@@ -1951,6 +2786,9 @@ void IoTHubTransport_AMQP_Common_Destroy(TRANSPORT_LL_HANDLE handle)
             OptionHandler_Destroy(transport_state->xioOptions);
         }
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_287: [IoTHubTransport_AMQP_Common_Destroy shall destroy the tick counter using tickcounter_destroy()]
+        tickcounter_destroy(transport_state->tick_counter);
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_150: [IoTHubTransport_AMQP_Common_Destroy shall destroy the transport instance]
         free(transport_state);
     }
@@ -1969,6 +2807,36 @@ int IoTHubTransport_AMQP_Common_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHU
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_GetCbsStatistics(TRANSPORT_LL_HANDLE handle, IOTHUB_AMQP_CBS_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_283: [If `handle` or `statistics` are NULL, IoTHubTransport_AMQP_Common_GetCbsStatistics shall return IOTHUB_CLIENT_INVALID_ARG]
+    if ((handle == NULL) || (statistics == NULL))
+    {
+        LogError("invalid arg (handle=%p, statistics=%p)", handle, statistics);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        AMQP_TRANSPORT_INSTANCE* transport_state = (AMQP_TRANSPORT_INSTANCE*)handle;
+        const AMQP_TRANSPORT_CBS_CONNECTION* cbs_connection = &transport_state->cbs_connection;
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_284: [Otherwise IoTHubTransport_AMQP_Common_GetCbsStatistics shall copy the put-token counters and latencies of the CBS connection into `statistics` and return IOTHUB_CLIENT_OK]
+        statistics->putTokensSent = cbs_connection->put_tokens_sent;
+        statistics->putTokensCompleted = cbs_connection->put_tokens_completed;
+        statistics->putTokensFailed = cbs_connection->put_tokens_failed;
+        statistics->putTokensPending = cbs_connection->pending_put_tokens;
+        statistics->putTokensDeferred = transport_state->cbs_put_token_deferrals;
+        statistics->lastLatencyMs = cbs_connection->last_put_token_latency;
+        statistics->maxLatencyMs = cbs_connection->max_put_token_latency;
+        statistics->averageLatencyMs = (cbs_connection->put_tokens_completed == 0) ? 0 : cbs_connection->total_put_token_latency / cbs_connection->put_tokens_completed;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 STRING_HANDLE IoTHubTransport_AMQP_Common_GetHostname(TRANSPORT_LL_HANDLE handle)
 {
     STRING_HANDLE result;
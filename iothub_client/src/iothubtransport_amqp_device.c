@@ -5,14 +5,15 @@
 #include "iothubtransport_amqp_messenger.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
-#include "azure_c_shared_utility/agenttime.h" 
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/strings.h"
 #include "iothubtransport_amqp_cbs_auth.h"
 #include "iothubtransport_amqp_device.h"
 
 #define RESULT_OK                                  0
-#define INDEFINITE_TIME                            ((time_t)-1)
+#define INDEFINITE_TIME                            ((tickcounter_ms_t)(-1))
+#define MS_PER_SEC                                 1000
 #define DEFAULT_AUTH_STATE_CHANGED_TIMEOUT_SECS    60
 #define DEFAULT_MSGR_STATE_CHANGED_TIMEOUT_SECS    60
 
@@ -30,16 +31,18 @@ typedef struct DEVICE_INSTANCE_TAG
 	AUTHENTICATION_HANDLE authentication_handle;
 	AUTHENTICATION_STATE auth_state;
 	AUTHENTICATION_ERROR_CODE auth_error_code;
-	time_t auth_state_last_changed_time;
+	tickcounter_ms_t auth_state_last_changed_time;
 	size_t auth_state_change_timeout_secs;
 
 	MESSENGER_HANDLE messenger_handle;
 	MESSENGER_STATE msgr_state;
-	time_t msgr_state_last_changed_time;
+	tickcounter_ms_t msgr_state_last_changed_time;
 	size_t msgr_state_change_timeout_secs;
 
 	ON_DEVICE_C2D_MESSAGE_RECEIVED on_message_received_callback;
 	void* on_message_received_context;
+
+	TICK_COUNTER_HANDLE tick_counter;
 } DEVICE_INSTANCE;
 
 typedef struct SEND_EVENT_TASK_TAG
@@ -65,7 +68,20 @@ static void update_state(DEVICE_INSTANCE* instance, DEVICE_STATE new_state)
 	}
 }
 
-static int is_timeout_reached(time_t start_time, size_t timeout_in_secs, int *is_timed_out)
+static tickcounter_ms_t get_current_time(DEVICE_INSTANCE* instance)
+{
+	tickcounter_ms_t current_time;
+
+	if (tickcounter_get_current_ms(instance->tick_counter, &current_time) != 0)
+	{
+		LogError("Failed getting the current time (tickcounter_get_current_ms failed)");
+		current_time = INDEFINITE_TIME;
+	}
+
+	return current_time;
+}
+
+static int is_timeout_reached(DEVICE_INSTANCE* instance, tickcounter_ms_t start_time, size_t timeout_in_secs, int *is_timed_out)
 {
 	int result;
 
@@ -76,16 +92,16 @@ static int is_timeout_reached(time_t start_time, size_t timeout_in_secs, int *is
 	}
 	else
 	{
-		time_t current_time;
+		tickcounter_ms_t current_time;
 
-		if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
+		if ((current_time = get_current_time(instance)) == INDEFINITE_TIME)
 		{
-			LogError("Failed to verify timeout (get_time failed)");
+			LogError("Failed to verify timeout (could not get the current time)");
 			result = __FAILURE__;
 		}
 		else
 		{
-			if (get_difftime(current_time, start_time) >= timeout_in_secs)
+			if (current_time - start_time >= (tickcounter_ms_t)timeout_in_secs * MS_PER_SEC)
 			{
 				*is_timed_out = 1;
 			}
@@ -186,9 +202,9 @@ static void on_authentication_state_changed_callback(void* context, AUTHENTICATI
 		DEVICE_INSTANCE* instance = (DEVICE_INSTANCE*)context;
 		instance->auth_state = new_state;
 
-		if ((instance->auth_state_last_changed_time = get_time(NULL)) == INDEFINITE_TIME)
+		if ((instance->auth_state_last_changed_time = get_current_time(instance)) == INDEFINITE_TIME)
 		{
-			LogError("Device '%s' failed to set time of last authentication state change (get_time failed)", instance->config->device_id);
+			LogError("Device '%s' failed to set time of last authentication state change (could not get the current time)", instance->config->device_id);
 		}
 	}
 }
@@ -204,9 +220,9 @@ static void on_messenger_state_changed_callback(void* context, MESSENGER_STATE p
 		DEVICE_INSTANCE* instance = (DEVICE_INSTANCE*)context;
 		instance->msgr_state = new_state;
 
-		if ((instance->msgr_state_last_changed_time = get_time(NULL)) == INDEFINITE_TIME)
+		if ((instance->msgr_state_last_changed_time = get_current_time(instance)) == INDEFINITE_TIME)
 		{
-			LogError("Device '%s' failed to set time of last messenger state change (get_time failed)", instance->config->device_id);
+			LogError("Device '%s' failed to set time of last messenger state change (could not get the current time)", instance->config->device_id);
 		}
 	}
 }
@@ -364,6 +380,11 @@ static void internal_destroy_device(DEVICE_INSTANCE* instance)
 			authentication_destroy(instance->authentication_handle);
 		}
 
+		if (instance->tick_counter != NULL)
+		{
+			tickcounter_destroy(instance->tick_counter);
+		}
+
 		destroy_device_config(instance->config);
 		free(instance);
 	}
@@ -525,6 +546,13 @@ DEVICE_HANDLE device_create(DEVICE_CONFIG *config)
 			LogError("Failed creating the device instance for device '%s' (failed creating the messenger instance)", instance->config->device_id);
 			result = __FAILURE__;
 		}
+		// Codes_SRS_DEVICE_09_111: [`instance->tick_counter` shall be set using tickcounter_create()]
+		else if ((instance->tick_counter = tickcounter_create()) == NULL)
+		{
+			// Codes_SRS_DEVICE_09_112: [If tickcounter_create() fails, device_create shall fail and return NULL]
+			LogError("Failed creating the device instance for device '%s' (tickcounter_create failed)", instance->config->device_id);
+			result = __FAILURE__;
+		}
 		else
 		{
 			instance->auth_state = AUTHENTICATION_STATE_STOPPED;
@@ -693,7 +721,7 @@ void device_do_work(DEVICE_HANDLE handle)
 				else if (instance->auth_state == AUTHENTICATION_STATE_STARTING)
 				{
 					int is_timed_out;
-					if (is_timeout_reached(instance->auth_state_last_changed_time, instance->auth_state_change_timeout_secs, &is_timed_out) != RESULT_OK)
+					if (is_timeout_reached(instance, instance->auth_state_last_changed_time, instance->auth_state_change_timeout_secs, &is_timed_out) != RESULT_OK)
 					{
 						LogError("Device '%s' failed verifying the timeout for authentication start (is_timeout_reached failed)", instance->config->device_id);
 						update_state(instance, DEVICE_STATE_ERROR_AUTH);
@@ -740,7 +768,7 @@ void device_do_work(DEVICE_HANDLE handle)
 				else if (instance->msgr_state == MESSENGER_STATE_STARTING)
 				{
 					int is_timed_out;
-					if (is_timeout_reached(instance->msgr_state_last_changed_time, instance->msgr_state_change_timeout_secs, &is_timed_out) != RESULT_OK)
+					if (is_timeout_reached(instance, instance->msgr_state_last_changed_time, instance->msgr_state_change_timeout_secs, &is_timed_out) != RESULT_OK)
 					{
 						LogError("Device '%s' failed verifying the timeout for messenger start (is_timeout_reached failed)", instance->config->device_id);
 
@@ -839,6 +867,7 @@ void device_destroy(DEVICE_HANDLE handle)
 
 		// Codes_SRS_DEVICE_09_014: [`instance->messenger_handle shall be destroyed using messenger_destroy()`]
 		// Codes_SRS_DEVICE_09_015: [If created, `instance->authentication_handle` shall be destroyed using authentication_destroy()`]
+		// Codes_SRS_DEVICE_09_113: [`instance->tick_counter` shall be destroyed using tickcounter_destroy()]
 		// Codes_SRS_DEVICE_09_016: [The contents of `instance->config` shall be detroyed and then it shall be freed]
 		internal_destroy_device((DEVICE_INSTANCE*)handle);
 	}
@@ -1063,7 +1092,10 @@ int device_set_option(DEVICE_HANDLE handle, const char* name, void* value)
 				result = RESULT_OK;
 			}
 		}
-		else if (strcmp(DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0)
+		else if (strcmp(DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0 ||
+			strcmp(DEVICE_OPTION_EVENT_BATCHING, name) == 0 ||
+			strcmp(DEVICE_OPTION_C2D_ZERO_COPY, name) == 0 ||
+			strcmp(DEVICE_OPTION_RECEIVER_MAX_MESSAGE_SIZE, name) == 0)
 		{
 			// Codes_SRS_DEVICE_09_086: [If `name` refers to messenger module, it shall be passed along with `value` to messenger_set_option]
 			if (messenger_set_option(instance->messenger_handle, name, value) != RESULT_OK)
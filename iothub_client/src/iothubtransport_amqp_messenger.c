@@ -7,7 +7,8 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/uniqueid.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_uamqp_c/link.h"
 #include "azure_uamqp_c/messaging.h"
 #include "azure_uamqp_c/message_sender.h"
@@ -18,7 +19,7 @@
 #include "iothubtransport_amqp_messenger.h"
 
 #define RESULT_OK 0
-#define INDEFINITE_TIME ((time_t)(-1))
+#define INDEFINITE_TIME ((tickcounter_ms_t)(-1))
 
 #define IOTHUB_DEVICES_PATH_FMT                         "%s/devices/%s"
 #define IOTHUB_EVENT_SEND_ADDRESS_FMT                   "amqps://%s/messages/events"
@@ -31,15 +32,19 @@
 #define DEFAULT_EVENT_SEND_TIMEOUT_SECS                 600
 #define MAX_MESSAGE_SENDER_STATE_CHANGE_TIMEOUT_SECS    300
 #define MAX_MESSAGE_RECEIVER_STATE_CHANGE_TIMEOUT_SECS  300
+#define MS_PER_SEC                                      1000
 #define UNIQUE_ID_BUFFER_SIZE                           37
+#define AMQP_BATCHING_FORMAT_CODE                       0x80013700
+#define EVENT_BATCH_MAX_SIZE                            (256 * 1024)
+#define EVENT_BATCH_DATA_SECTION_OVERHEAD               8
 #define STRING_NULL_TERMINATOR                          '\0'
  
 typedef struct MESSENGER_INSTANCE_TAG
 {
 	STRING_HANDLE device_id;
 	STRING_HANDLE iothub_host_fqdn;
-	SINGLYLINKEDLIST_HANDLE waiting_to_send;
-	SINGLYLINKEDLIST_HANDLE in_progress_list;
+	DLIST_ENTRY waiting_to_send;
+	DLIST_ENTRY in_progress_list;
 	MESSENGER_STATE state;
 	
 	ON_MESSENGER_STATE_CHANGED_CALLBACK on_state_changed_callback;
@@ -62,27 +67,51 @@ typedef struct MESSENGER_INSTANCE_TAG
 	size_t event_send_retry_limit;
 	size_t event_send_error_count;
 	size_t event_send_timeout_secs;
-	time_t last_message_sender_state_change_time;
-	time_t last_message_receiver_state_change_time;
+	bool event_batching_enabled;
+	bool c2d_zero_copy;
+	uint64_t receiver_max_message_size;
+	TICK_COUNTER_HANDLE tick_counter;
+	tickcounter_ms_t last_message_sender_state_change_time;
+	tickcounter_ms_t last_message_receiver_state_change_time;
 } MESSENGER_INSTANCE;
 
 typedef struct SEND_EVENT_TASK_TAG
 {
+	DLIST_ENTRY entry; // links the task into either `waiting_to_send` or `in_progress_list`
 	IOTHUB_MESSAGE_LIST* message;
 	ON_MESSENGER_EVENT_SEND_COMPLETE on_event_send_complete_callback;
 	void* context;
-	time_t send_time;
+	tickcounter_ms_t send_time;
 	MESSENGER_INSTANCE *messenger;
 	bool is_timed_out;
+	struct SEND_EVENT_TASK_TAG* next_in_batch; // next event packed in the same batched AMQP message, if any
+	BINARY_DATA encoded_event; // batched mode only; encoded on the first send attempt and reused on retries
 } SEND_EVENT_TASK;
 
+// @brief
+//     Gets the current time in milliseconds from the messenger's monotonic tick counter.
+// @returns
+//     The current time, or INDEFINITE_TIME if tickcounter_get_current_ms() fails.
+static tickcounter_ms_t get_current_time(MESSENGER_INSTANCE* instance)
+{
+	tickcounter_ms_t current_time;
+
+	if (tickcounter_get_current_ms(instance->tick_counter, &current_time) != 0)
+	{
+		LogError("Failed getting the current time (tickcounter_get_current_ms failed)");
+		current_time = INDEFINITE_TIME;
+	}
+
+	return current_time;
+}
+
 // @brief
 //     Evaluates if the ammount of time since start_time is greater or lesser than timeout_in_secs.
 // @param is_timed_out
 //     Set to 1 if a timeout has been reached, 0 otherwise. Not set if any failure occurs.
 // @returns
 //     0 if no failures occur, non-zero otherwise.
-static int is_timeout_reached(time_t start_time, size_t timeout_in_secs, int *is_timed_out)
+static int is_timeout_reached(MESSENGER_INSTANCE* instance, tickcounter_ms_t start_time, size_t timeout_in_secs, int *is_timed_out)
 {
 	int result;
 
@@ -93,16 +122,16 @@ static int is_timeout_reached(time_t start_time, size_t timeout_in_secs, int *is
 	}
 	else
 	{
-		time_t current_time;
+		tickcounter_ms_t current_time;
 
-		if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
+		if ((current_time = get_current_time(instance)) == INDEFINITE_TIME)
 		{
-			LogError("Failed to verify timeout (get_time failed)");
+			LogError("Failed to verify timeout (could not get the current time)");
 			result = __FAILURE__;
 		}
 		else
 		{
-			if (get_difftime(current_time, start_time) >= timeout_in_secs)
+			if (current_time - start_time >= (tickcounter_ms_t)timeout_in_secs * MS_PER_SEC)
 			{
 				*is_timed_out = 1;
 			}
@@ -354,7 +383,7 @@ static void on_event_sender_state_changed_callback(void* context, MESSAGE_SENDER
 			MESSENGER_INSTANCE* instance = (MESSENGER_INSTANCE*)context;
 			instance->message_sender_current_state = new_state;
 			instance->message_sender_previous_state = previous_state;
-			instance->last_message_sender_state_change_time = get_time(NULL);
+			instance->last_message_sender_state_change_time = get_current_time(instance);
 		}
 	}
 }
@@ -522,7 +551,7 @@ static void on_message_receiver_state_changed_callback(const void* context, MESS
 			MESSENGER_INSTANCE* instance = (MESSENGER_INSTANCE*)context;
 			instance->message_receiver_current_state = new_state;
 			instance->message_receiver_previous_state = previous_state;
-			instance->last_message_receiver_state_change_time = get_time(NULL);
+			instance->last_message_receiver_state_change_time = get_current_time(instance);
 		}
 	}
 }
@@ -533,8 +562,13 @@ static AMQP_VALUE on_message_received_internal_callback(const void* context, MES
 	int api_call_result;
 	IOTHUB_MESSAGE_HANDLE iothub_message = NULL;
 
+	MESSENGER_INSTANCE* instance = (MESSENGER_INSTANCE*)context;
+
 	// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_121: [An IOTHUB_MESSAGE_HANDLE shall be obtained from MESSAGE_HANDLE using IoTHubMessage_CreateFromUamqpMessage()]
-	if ((api_call_result = IoTHubMessage_CreateFromUamqpMessage(message, &iothub_message)) != RESULT_OK)
+	// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_193: [If `instance->c2d_zero_copy` is true, the IOTHUB_MESSAGE_HANDLE shall be obtained using IoTHubMessage_CreateViewFromUamqpMessage() instead]
+	if ((api_call_result = (instance->c2d_zero_copy ?
+		IoTHubMessage_CreateViewFromUamqpMessage(message, &iothub_message) :
+		IoTHubMessage_CreateFromUamqpMessage(message, &iothub_message))) != RESULT_OK)
 	{
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_122: [If IoTHubMessage_CreateFromUamqpMessage() fails, on_message_received_internal_callback shall return the result of messaging_delivery_rejected()]
 		result = messaging_delivery_rejected("Rejected due to failure reading AMQP message", "Failed reading AMQP message");
@@ -543,8 +577,6 @@ static AMQP_VALUE on_message_received_internal_callback(const void* context, MES
 	}
 	else
 	{
-		MESSENGER_INSTANCE* instance = (MESSENGER_INSTANCE*)context;
-
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_123: [`instance->on_message_received_callback` shall be invoked passing the IOTHUB_MESSAGE_HANDLE]
 		MESSENGER_DISPOSITION_RESULT disposition_result = instance->on_message_received_callback(iothub_message, instance->on_message_received_context);
 
@@ -639,7 +671,8 @@ static int create_message_receiver(MESSENGER_INSTANCE* instance)
 	else
 	{
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_082: [`instance->receiver_link` maximum message size shall be set to 65536 using link_set_max_message_size()]
-		if (link_set_max_message_size(instance->receiver_link, MESSAGE_RECEIVER_MAX_LINK_SIZE) != RESULT_OK)
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_200: [If MESSENGER_OPTION_RECEIVER_MAX_MESSAGE_SIZE was set, its value shall be used as the maximum message size of `instance->receiver_link` instead of 65536]
+		if (link_set_max_message_size(instance->receiver_link, instance->receiver_max_message_size) != RESULT_OK)
 		{
 			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_083: [If link_set_max_message_size() fails, it shall be logged and ignored.]
 			LogError("Failed setting message receiver link max message size.");
@@ -691,201 +724,278 @@ static int create_message_receiver(MESSENGER_INSTANCE* instance)
 	return result;
 }
 
-static int move_event_to_in_progress_list(SEND_EVENT_TASK* task)
+static void move_event_to_in_progress_list(SEND_EVENT_TASK* task)
 {
-	int result; 
-
-	if (singlylinkedlist_add(task->messenger->in_progress_list, (void*)task) == NULL)
-	{
-		result = __FAILURE__;
-		LogError("Failed moving event to in_progress list (singlylinkedlist_add failed)");
-	}
-	else
-	{
-		result = RESULT_OK;
-	}
-
-	return result;
+	DList_InsertTailList(&task->messenger->in_progress_list, &task->entry);
 }
 
-static bool find_send_event_task_on_list(LIST_ITEM_HANDLE list_item, const void* match_context)
+static void remove_event_from_in_progress_list(SEND_EVENT_TASK *task)
 {
-	return (list_item != NULL && singlylinkedlist_item_get_value(list_item) == match_context);
+	(void)DList_RemoveEntryList(&task->entry);
 }
 
-static void remove_event_from_in_progress_list(SEND_EVENT_TASK *task)
+static void destroy_event_task(SEND_EVENT_TASK* task)
 {
-	LIST_ITEM_HANDLE list_item = singlylinkedlist_find(task->messenger->in_progress_list, find_send_event_task_on_list, (void*)task);
+	// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_192: [The encoding saved in the task shall be freed only when the task is destroyed]
+	if (task->encoded_event.bytes != NULL)
+	{
+		free((void*)task->encoded_event.bytes);
+	}
 
-	if (list_item != NULL)
+	free(task);
+}
+
+// @brief
+//     Moves all the entries of `from_list` to the end of `to_list`, leaving `from_list` empty, in constant time.
+static void append_events_to_list(PDLIST_ENTRY to_list, PDLIST_ENTRY from_list)
+{
+	if (!DList_IsListEmpty(from_list))
 	{
-		if (singlylinkedlist_remove(task->messenger->in_progress_list, list_item) != RESULT_OK)
-		{
-			LogError("Failed removing event from in_progress list (singlylinkedlist_remove failed)");
-		}
+		PDLIST_ENTRY first_entry = from_list->Flink;
+
+		// Unlinking the list head leaves the entries linked among themselves, ready to be appended.
+		(void)DList_RemoveEntryList(from_list);
+		DList_AppendTailList(to_list, first_entry);
+		DList_InitializeListHead(from_list);
 	}
 }
 
-static int copy_events_to_list(SINGLYLINKEDLIST_HANDLE from_list, SINGLYLINKEDLIST_HANDLE to_list)
+static void move_events_to_wait_to_send_list(MESSENGER_INSTANCE* instance)
 {
-	int result;
-	LIST_ITEM_HANDLE list_item;
+	// The events in progress go back to the beginning of waiting_to_send, ahead of the ones never sent.
+	append_events_to_list(&instance->in_progress_list, &instance->waiting_to_send);
+	append_events_to_list(&instance->waiting_to_send, &instance->in_progress_list);
+}
 
-	result = RESULT_OK;
-	list_item = singlylinkedlist_get_head_item(from_list);
+static void internal_on_event_send_complete_callback(void* context, MESSAGE_SEND_RESULT send_result)
+{ 
+	SEND_EVENT_TASK* task = (SEND_EVENT_TASK*)context;
 
-	while (list_item != NULL)
+	// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_180: [If the event was sent in a batched message, the following shall be done for each event packed in that message]
+	while (task != NULL)
 	{
-		SEND_EVENT_TASK *task = (SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_item);
+		SEND_EVENT_TASK* next_task = task->next_in_batch;
 
-		if (singlylinkedlist_add(to_list, task) == NULL)
+		if (task->is_timed_out == false)
 		{
-			LogError("Failed copying event to destination list (singlylinkedlist_add failed)");
-			result = __FAILURE__;
-			break;
+			MESSENGER_EVENT_SEND_COMPLETE_RESULT messenger_send_result;
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_107: [If no failure occurs, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_OK]  
+			if (send_result == MESSAGE_SEND_OK)
+			{
+				messenger_send_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_OK;
+			}
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_108: [If a failure occurred, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING] 
+			else
+			{
+				messenger_send_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING;
+			}
+
+			task->on_event_send_complete_callback(task->message, messenger_send_result, (void*)task->context);
 		}
 		else
 		{
-			list_item = singlylinkedlist_get_next_item(list_item);
+			LogInfo("messenger on_event_send_complete_callback invoked for timed out event %p; not firing upper layer callback.", task->message);
 		}
+
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_128: [`task` shall be removed from `instance->in_progress_list`]  
+		remove_event_from_in_progress_list(task);
+
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_130: [`task` shall be destroyed using free()]  
+		destroy_event_task(task);
+
+		task = next_task;
 	}
+}
 
-	return result;
+static SEND_EVENT_TASK* get_next_event_to_send(MESSENGER_INSTANCE* instance)
+{
+	SEND_EVENT_TASK* task;
+
+	if (DList_IsListEmpty(&instance->waiting_to_send))
+	{
+		task = NULL;
+	}
+	else
+	{
+		task = containingRecord(DList_RemoveHeadList(&instance->waiting_to_send), SEND_EVENT_TASK, entry);
+		task->next_in_batch = NULL;
+	}
+
+	return task;
 }
 
-static int singlylinkedlist_clear(SINGLYLINKEDLIST_HANDLE list)
+// @brief
+//     Submits a batched AMQP message for sending, on behalf of all the events chained from `batch_leader`.
+// @remarks
+//     The batched message is destroyed by this function. If messagesender_send() fails, all the events in the batch are failed and destroyed.
+// @returns
+//     0 if no failures occur, non-zero otherwise.
+static int send_event_batch(MESSENGER_INSTANCE* instance, MESSAGE_HANDLE batch_message, SEND_EVENT_TASK* batch_leader)
 {
 	int result;
-	LIST_ITEM_HANDLE list_item;
+	SEND_EVENT_TASK* task;
+	tickcounter_ms_t send_time;
 
-	result = RESULT_OK;
+	// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_186: [The batched MESSAGE_HANDLE shall be submitted for sending using messagesender_send(), passing `internal_on_event_send_complete_callback` and the first event of the batch as context]
+	int uamqp_result = messagesender_send(instance->message_sender, batch_message, internal_on_event_send_complete_callback, batch_leader);
 
-	while ((list_item = singlylinkedlist_get_head_item(list)) != NULL)
+	// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_188: [The batched MESSAGE_HANDLE shall be destroyed using message_destroy()]
+	message_destroy(batch_message);
+
+	if (uamqp_result != RESULT_OK)
 	{
-		if (singlylinkedlist_remove(list, list_item) != RESULT_OK)
+		LogError("Failed sending event batch (messagesender_send failed; error: %d)", uamqp_result);
+
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_187: [If messagesender_send() fails, `on_event_send_complete_callback` of each event in the batch shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, and the events removed from `instance->in_progress_list` and destroyed]
+		task = batch_leader;
+
+		while (task != NULL)
 		{
-			LogError("Failed removing items from list (%d)", list);
-			result = __FAILURE__;
-			break;
+			SEND_EVENT_TASK* next_task = task->next_in_batch;
+
+			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, (void*)task->context);
+
+			remove_event_from_in_progress_list(task);
+			destroy_event_task(task);
+
+			task = next_task;
 		}
+
+		result = __FAILURE__;
+	}
+	else
+	{
+		send_time = get_current_time(instance);
+
+		for (task = batch_leader; task != NULL; task = task->next_in_batch)
+		{
+			task->send_time = send_time;
+		}
+
+		result = RESULT_OK;
 	}
 
 	return result;
 }
 
-static int move_events_to_wait_to_send_list(MESSENGER_INSTANCE* instance)
+// @brief
+//     Packs as many pending events as fit in EVENT_BATCH_MAX_SIZE into each batched AMQP message (format AMQP_BATCHING_FORMAT_CODE) and sends them.
+// @returns
+//     0 if no failures occur, non-zero otherwise.
+static int send_pending_events_in_batches(MESSENGER_INSTANCE* instance)
 {
-	int result;
-	LIST_ITEM_HANDLE list_item;
+	int result = RESULT_OK;
 
-	if ((list_item = singlylinkedlist_get_head_item(instance->in_progress_list)) == NULL)
-	{
-		result = RESULT_OK;
-	}
-	else
+	MESSAGE_HANDLE batch_message = NULL;
+	SEND_EVENT_TASK* batch_leader = NULL;
+	SEND_EVENT_TASK* batch_tail = NULL;
+	size_t batch_size = 0;
+	SEND_EVENT_TASK* task;
+
+	while ((task = get_next_event_to_send(instance)) != NULL)
 	{
-		SINGLYLINKEDLIST_HANDLE new_wait_to_send_list;
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_153: [messenger_do_work() shall move each event to be sent from `instance->wait_to_send_list` to `instance->in_progress_list`] 
+		move_event_to_in_progress_list(task);
 
-		if ((new_wait_to_send_list = singlylinkedlist_create()) == NULL)
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_181: [If `instance->event_batching_enabled` is true, each event not yet encoded shall be encoded using message_create_uamqp_encoding_from_iothub_message() and the encoding saved in the task for retries]
+		if (task->encoded_event.bytes == NULL &&
+			message_create_uamqp_encoding_from_iothub_message(task->message->messageHandle, &task->encoded_event) != RESULT_OK)
 		{
-			LogError("Failed moving events back to wait_to_send list (singlylinkedlist_create failed to create new wait_to_send_list)");
-			result = __FAILURE__;
+			LogError("Failed sending event message (failed encoding it for batching).");
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_182: [If message_create_uamqp_encoding_from_iothub_message() fails, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE, the event removed from `instance->in_progress_list` and destroyed, and messenger_do_work() shall skip to the next event]
+			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE, (void*)task->context);
+			remove_event_from_in_progress_list(task);
+			destroy_event_task(task);
+			continue;
 		}
-		else
+
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_183: [If adding the encoded event would make the current batch exceed EVENT_BATCH_MAX_SIZE, the current batch shall be sent before a new one is started]
+		if (batch_message != NULL && batch_size + task->encoded_event.length + EVENT_BATCH_DATA_SECTION_OVERHEAD > EVENT_BATCH_MAX_SIZE)
 		{
-			SINGLYLINKEDLIST_HANDLE new_in_progress_list;
-		
-			if (copy_events_to_list(instance->in_progress_list, new_wait_to_send_list) != RESULT_OK)
+			int send_result = send_event_batch(instance, batch_message, batch_leader);
+
+			batch_message = NULL;
+			batch_leader = NULL;
+			batch_tail = NULL;
+			batch_size = 0;
+
+			if (send_result != RESULT_OK)
 			{
-				LogError("Failed moving events back to wait_to_send list (failed adding in_progress_list items to new_wait_to_send_list)");
-				singlylinkedlist_destroy(new_wait_to_send_list);
+				// The current event was not part of the failed batch, so it goes back to be retried on the next messenger_do_work().
+				remove_event_from_in_progress_list(task);
+				DList_InsertHeadList(&instance->waiting_to_send, &task->entry);
 				result = __FAILURE__;
+				break;
 			}
-			else if (copy_events_to_list(instance->waiting_to_send, new_wait_to_send_list) != RESULT_OK)
+		}
+
+		if (batch_message == NULL)
+		{
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_184: [A batched MESSAGE_HANDLE shall be created using message_create() and its format set to AMQP_BATCHING_FORMAT_CODE using message_set_message_format()]
+			if ((batch_message = message_create()) == NULL)
 			{
-				LogError("Failed moving events back to wait_to_send list (failed adding wait_to_send items to new_wait_to_send_list)");
-				singlylinkedlist_destroy(new_wait_to_send_list);
+				LogError("Failed sending event batch (message_create failed)");
 				result = __FAILURE__;
 			}
-			else if ((new_in_progress_list = singlylinkedlist_create()) == NULL)
+			else if (message_set_message_format(batch_message, AMQP_BATCHING_FORMAT_CODE) != RESULT_OK)
 			{
-				LogError("Failed moving events back to wait_to_send list (singlylinkedlist_create failed to create new in_progress_list)");
-				singlylinkedlist_destroy(new_wait_to_send_list);
+				LogError("Failed sending event batch (message_set_message_format failed)");
+				message_destroy(batch_message);
+				batch_message = NULL;
 				result = __FAILURE__;
 			}
-			else 
-			{
-				singlylinkedlist_destroy(instance->waiting_to_send);
-				singlylinkedlist_destroy(instance->in_progress_list);
-				instance->waiting_to_send = new_wait_to_send_list;
-				instance->in_progress_list = new_in_progress_list;
-				result = RESULT_OK;
-			}
 		}
-	}
 
-	return result;
-}
-
-static void internal_on_event_send_complete_callback(void* context, MESSAGE_SEND_RESULT send_result)
-{ 
-	if (context != NULL)
-	{
-		SEND_EVENT_TASK* task = (SEND_EVENT_TASK*)context;
-
-		if (task->is_timed_out == false)
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_185: [The encoded event shall be added to the batched MESSAGE_HANDLE as a data section using message_add_body_amqp_data()]
+		if (batch_message == NULL || message_add_body_amqp_data(batch_message, task->encoded_event) != RESULT_OK)
 		{
-			MESSENGER_EVENT_SEND_COMPLETE_RESULT messenger_send_result;
+			LogError("Failed sending event message (failed adding it to the batched message)");
 
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_107: [If no failure occurs, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_OK]  
-			if (send_result == MESSAGE_SEND_OK)
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_189: [If creating or filling the batched message fails, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, the event removed from `instance->in_progress_list` and destroyed]
+			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, (void*)task->context);
+			remove_event_from_in_progress_list(task);
+			destroy_event_task(task);
+			result = __FAILURE__;
+		}
+		else
+		{
+			if (batch_tail == NULL)
 			{
-				messenger_send_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_OK;
+				batch_leader = task;
 			}
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_108: [If a failure occurred, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING] 
 			else
 			{
-				messenger_send_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING;
+				batch_tail->next_in_batch = task;
 			}
 
-			task->on_event_send_complete_callback(task->message, messenger_send_result, (void*)task->context);
+			batch_tail = task;
+			batch_size += task->encoded_event.length + EVENT_BATCH_DATA_SECTION_OVERHEAD;
 		}
-		else
+
+		if (result != RESULT_OK)
 		{
-			LogInfo("messenger on_event_send_complete_callback invoked for timed out event %p; not firing upper layer callback.", task->message);
+			break;
 		}
-
-		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_128: [`task` shall be removed from `instance->in_progress_list`]  
-		remove_event_from_in_progress_list(task);
-
-		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_130: [`task` shall be destroyed using free()]  
-		free(task);
 	}
-}
 
-static SEND_EVENT_TASK* get_next_event_to_send(MESSENGER_INSTANCE* instance)
-{
-	SEND_EVENT_TASK* task;
-	LIST_ITEM_HANDLE list_item;
-
-	if ((list_item = singlylinkedlist_get_head_item(instance->waiting_to_send)) == NULL)
-	{
-		task = NULL;
-	}
-	else
+	if (batch_message != NULL)
 	{
-		task = (SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_item);
-
-		if (singlylinkedlist_remove(instance->waiting_to_send, list_item) != RESULT_OK)
+		if (batch_leader == NULL)
+		{
+			message_destroy(batch_message);
+		}
+		else if (send_event_batch(instance, batch_message, batch_leader) != RESULT_OK)
 		{
-			LogError("Failed removing item from waiting_to_send list (singlylinkedlist_remove failed)");
+			result = __FAILURE__;
 		}
 	}
 
-	return task;
+	return result;
 }
 
-static int send_pending_events(MESSENGER_INSTANCE* instance)
+static int send_pending_events_individually(MESSENGER_INSTANCE* instance)
 {
 	int result = RESULT_OK;
 
@@ -893,88 +1003,121 @@ static int send_pending_events(MESSENGER_INSTANCE* instance)
 
 	while ((task = get_next_event_to_send(instance)) != NULL)
 	{
+		int uamqp_result;
+		MESSAGE_HANDLE amqp_message = NULL;
+
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_153: [messenger_do_work() shall move each event to be sent from `instance->wait_to_send_list` to `instance->in_progress_list`] 
-		if (move_event_to_in_progress_list(task) != RESULT_OK)
+		move_event_to_in_progress_list(task);
+
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_154: [A MESSAGE_HANDLE shall be obtained out of the event's IOTHUB_MESSAGE_HANDLE instance by using message_create_from_iothub_message()]  
+		if ((uamqp_result = message_create_from_iothub_message(task->message->messageHandle, &amqp_message)) != RESULT_OK)
 		{
-			result = __FAILURE__;
-			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, (void*)task->context);
-			break;
+			LogError("Failed sending event message (failed creating AMQP message; error: %d).", uamqp_result);
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_155: [If message_create_from_iothub_message() fails, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE]  
+			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE, (void*)task->context);
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_160: [If any failure occurs the event shall be removed from `instance->in_progress_list` and destroyed]  
+			remove_event_from_in_progress_list(task);
+			destroy_event_task(task);
+			
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_156: [If message_create_from_iothub_message() fails, messenger_do_work() shall skip to the next event to be sent]  
 		}
 		else
 		{
-			int uamqp_result;
-			MESSAGE_HANDLE amqp_message = NULL;
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_157: [The MESSAGE_HANDLE shall be submitted for sending using messagesender_send(), passing `internal_on_event_send_complete_callback`]  
+			uamqp_result = messagesender_send(instance->message_sender, amqp_message, internal_on_event_send_complete_callback, task);
 
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_154: [A MESSAGE_HANDLE shall be obtained out of the event's IOTHUB_MESSAGE_HANDLE instance by using message_create_from_iothub_message()]  
-			if ((uamqp_result = message_create_from_iothub_message(task->message->messageHandle, &amqp_message)) != RESULT_OK)
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_159: [The MESSAGE_HANDLE shall be destroyed using message_destroy().]
+			// Note: messagesender_send() keeps its own clone, so the task does not hold a second copy of the payload while the event is in flight.
+			message_destroy(amqp_message);
+
+			if (uamqp_result != RESULT_OK)
 			{
-				LogError("Failed sending event message (failed creating AMQP message; error: %d).", uamqp_result);
+				LogError("Failed sending event (messagesender_send failed; error: %d)", uamqp_result);
+
+				result = __FAILURE__;
 
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_155: [If message_create_from_iothub_message() fails, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE]  
-				task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE, (void*)task->context);
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_158: [If messagesender_send() fails, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING]
+				task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, (void*)task->context);
 
 				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_160: [If any failure occurs the event shall be removed from `instance->in_progress_list` and destroyed]  
 				remove_event_from_in_progress_list(task);
-				free(task);
-				
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_156: [If message_create_from_iothub_message() fails, messenger_do_work() shall skip to the next event to be sent]  
+				destroy_event_task(task);
+
+				break;
 			}
 			else
 			{
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_157: [The MESSAGE_HANDLE shall be submitted for sending using messagesender_send(), passing `internal_on_event_send_complete_callback`]  
-				uamqp_result = messagesender_send(instance->message_sender, amqp_message, internal_on_event_send_complete_callback, task);
-				task->send_time = get_time(NULL);
-
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_159: [The MESSAGE_HANDLE shall be destroyed using message_destroy().]
-				message_destroy(amqp_message);
-
-				if (uamqp_result != RESULT_OK)
-				{
-					LogError("Failed sending event (messagesender_send failed; error: %d)", uamqp_result);
-
-					result = __FAILURE__;
+				task->send_time = get_current_time(instance);
+			}
+		}
+	}
 
-					// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_158: [If messagesender_send() fails, `task->on_event_send_complete_callback` shall be invoked with result EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING]
-					task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, (void*)task->context);
+	return result;
+}
 
-					// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_160: [If any failure occurs the event shall be removed from `instance->in_progress_list` and destroyed]  
-					remove_event_from_in_progress_list(task);
-					free(task);
+static int send_pending_events(MESSENGER_INSTANCE* instance)
+{
+	int result;
 
-					break;
-				}
-			}
-		}
+	// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_190: [If `instance->event_batching_enabled` is true, the pending events shall be sent packed in batched AMQP messages]
+	if (instance->event_batching_enabled)
+	{
+		result = send_pending_events_in_batches(instance);
+	}
+	else
+	{
+		result = send_pending_events_individually(instance);
 	}
 
 	return result;
 }
 
 // @brief
-//     Goes through each task in in_progress_list and checks if the events timed out to be sent.
+//     Goes through the tasks in in_progress_list, oldest first, and checks if the events timed out to be sent.
 // @remarks
 //     If an event is timed out, it is marked as such but not removed, and the upper layer callback is invoked.
+//     Events are appended to in_progress_list as they are sent and all share the same timeout, so the list is
+//     ordered by deadline and the scan stops at the first event that has not timed out.
 // @returns
 //     0 if no failures occur, non-zero otherwise.
 static int process_event_send_timeouts(MESSENGER_INSTANCE* instance)
 {
 	int result = RESULT_OK;
 
-	if (instance->event_send_timeout_secs > 0)
+	if (instance->event_send_timeout_secs > 0 && instance->in_progress_list.Flink != &instance->in_progress_list)
 	{
-		LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(instance->in_progress_list);
+		tickcounter_ms_t current_time;
 
-		while (list_item != NULL)
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_195: [messenger_do_work() shall get the current time only once per call to evaluate the event send timeouts, using tickcounter_get_current_ms()]
+		if ((current_time = get_current_time(instance)) == INDEFINITE_TIME)
 		{
-			SEND_EVENT_TASK* task = (SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_item);
+			LogError("messenger failed to evaluate event send timeouts (could not get the current time)");
+			result = __FAILURE__;
+		}
+		else
+		{
+			tickcounter_ms_t event_send_timeout = (tickcounter_ms_t)instance->event_send_timeout_secs * MS_PER_SEC;
+			PDLIST_ENTRY list_entry = instance->in_progress_list.Flink;
 
-			if (task->is_timed_out == false)
+			while (list_entry != &instance->in_progress_list)
 			{
-				int is_timed_out;
+				SEND_EVENT_TASK* task = containingRecord(list_entry, SEND_EVENT_TASK, entry);
 
-				if (is_timeout_reached(task->send_time, instance->event_send_timeout_secs, &is_timed_out) == RESULT_OK)
+				if (task->is_timed_out == false)
 				{
-					if (is_timed_out)
+					if (task->send_time == INDEFINITE_TIME)
+					{
+						LogError("messenger failed to evaluate event send timeout of event %p (send time is unknown)", task->message);
+						result = __FAILURE__;
+					}
+					// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_196: [messenger_do_work() shall stop evaluating event send timeouts at the first event in `instance->in_progress_list` that has not timed out]
+					else if (current_time - task->send_time < event_send_timeout)
+					{
+						break;
+					}
+					else
 					{
 						task->is_timed_out = true;
 
@@ -984,14 +1127,9 @@ static int process_event_send_timeouts(MESSENGER_INSTANCE* instance)
 						}
 					}
 				}
-				else
-				{
-					LogError("messenger failed to evaluate event send timeout of event %d", task->message);
-					result = __FAILURE__;
-				}
-			}
 
-			list_item = singlylinkedlist_get_next_item(list_item);
+				list_entry = list_entry->Flink;
+			}
 		}
 	}
 
@@ -1002,20 +1140,20 @@ static int process_event_send_timeouts(MESSENGER_INSTANCE* instance)
 //     Removes all the timed out events from the in_progress_list, without invoking callbacks or detroying the messages.
 static void remove_timed_out_events(MESSENGER_INSTANCE* instance)
 {
-	LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(instance->in_progress_list);
+	PDLIST_ENTRY list_entry = instance->in_progress_list.Flink;
 
-	while (list_item != NULL)
+	while (list_entry != &instance->in_progress_list)
 	{
-		SEND_EVENT_TASK* task = (SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_item);
+		SEND_EVENT_TASK* task = containingRecord(list_entry, SEND_EVENT_TASK, entry);
+
+		list_entry = list_entry->Flink;
 
 		if (task->is_timed_out == true)
 		{
 			remove_event_from_in_progress_list(task);
 
-			free(task);
+			destroy_event_task(task);
 		}
-
-		list_item = singlylinkedlist_get_next_item(list_item);
 	}
 }
 
@@ -1039,6 +1177,9 @@ static void* messenger_clone_option(const char* name, const void* value)
 	else
 	{
 		if (strcmp(MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0 ||
+			strcmp(MESSENGER_OPTION_EVENT_BATCHING, name) == 0 ||
+			strcmp(MESSENGER_OPTION_C2D_ZERO_COPY, name) == 0 ||
+			strcmp(MESSENGER_OPTION_RECEIVER_MAX_MESSAGE_SIZE, name) == 0 ||
 			strcmp(MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
 		{
 			result = (void*)value;
@@ -1190,17 +1331,6 @@ int messenger_send_async(MESSENGER_HANDLE messenger_handle, IOTHUB_MESSAGE_LIST*
 			LogError("Failed sending event (failed to create struct for task; malloc failed)");
 			result = __FAILURE__;
 		}
-		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_100: [`task` shall be added to `instance->waiting_to_send` using singlylinkedlist_add()]  
-		else if (singlylinkedlist_add(instance->waiting_to_send, task) == NULL)
-		{
-			LogError("Failed sending event (singlylinkedlist_add failed)");
-
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_139: [If singlylinkedlist_add() fails, messenger_send_async() shall fail and return a non-zero value]
-			result = __FAILURE__;
-
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_142: [If any failure occurs, messenger_send_async() shall free any memory it has allocated]
-			free(task);
-		}
 		else
 		{
 			memset(task, 0, sizeof(SEND_EVENT_TASK));
@@ -1210,6 +1340,9 @@ int messenger_send_async(MESSENGER_HANDLE messenger_handle, IOTHUB_MESSAGE_LIST*
 			task->send_time = INDEFINITE_TIME;
 			task->messenger = instance;
 			task->is_timed_out = false;
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_100: [`task` shall be added to the end of `instance->waiting_to_send` using DList_InsertTailList()]  
+			DList_InsertTailList(&instance->waiting_to_send, &task->entry);
 			
 			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_143: [If no failures occur, messenger_send_async() shall return zero]  
 			result = RESULT_OK;
@@ -1238,11 +1371,8 @@ int messenger_get_send_status(MESSENGER_HANDLE messenger_handle, MESSENGER_SEND_
 	else
 	{
 		MESSENGER_INSTANCE* instance = (MESSENGER_INSTANCE*)messenger_handle;
-		LIST_ITEM_HANDLE wts_list_head = singlylinkedlist_get_head_item(instance->waiting_to_send);
-		LIST_ITEM_HANDLE ip_list_head = singlylinkedlist_get_head_item(instance->in_progress_list);
-
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_147: [If `instance->in_progress_list` and `instance->wait_to_send_list` are empty, send_status shall be set to MESSENGER_SEND_STATUS_IDLE] 
-		if (wts_list_head == NULL && ip_list_head == NULL)
+		if (DList_IsListEmpty(&instance->waiting_to_send) && DList_IsListEmpty(&instance->in_progress_list))
 		{
 			*send_status = MESSENGER_SEND_STATUS_IDLE;
 		}
@@ -1332,20 +1462,11 @@ int messenger_stop(MESSENGER_HANDLE messenger_handle)
 			remove_timed_out_events(instance);
 
 			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_162: [messenger_stop() shall move all items from `instance->in_progress_list` to the beginning of `instance->wait_to_send_list`]
-			if (move_events_to_wait_to_send_list(instance) != RESULT_OK)
-			{
-				LogError("Messenger failed to move events in progress back to wait_to_send list");
-				
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_163: [If not all items from `instance->in_progress_list` can be moved back to `instance->wait_to_send_list`, `instance->state` shall be set to MESSENGER_STATE_ERROR, and `instance->on_state_changed_callback` invoked]
-				update_messenger_state(instance, MESSENGER_STATE_ERROR);
-				result = __FAILURE__;
-			}
-			else
-			{
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_164: [If all items get successfuly moved back to `instance->wait_to_send_list`, `instance->state` shall be set to MESSENGER_STATE_STOPPED, and `instance->on_state_changed_callback` invoked]
-				update_messenger_state(instance, MESSENGER_STATE_STOPPED);
-				result = RESULT_OK;
-			}
+			move_events_to_wait_to_send_list(instance);
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_164: [`instance->state` shall be set to MESSENGER_STATE_STOPPED, and `instance->on_state_changed_callback` invoked]
+			update_messenger_state(instance, MESSENGER_STATE_STOPPED);
+			result = RESULT_OK;
 		}
 	}
 
@@ -1371,7 +1492,7 @@ static void process_state_changes(MESSENGER_INSTANCE* instance)
 			if (instance->message_receiver_current_state == MESSAGE_RECEIVER_STATE_OPENING)
 			{
 				int is_timed_out;
-				if (is_timeout_reached(instance->last_message_receiver_state_change_time, MAX_MESSAGE_RECEIVER_STATE_CHANGE_TIMEOUT_SECS, &is_timed_out) != RESULT_OK)
+				if (is_timeout_reached(instance, instance->last_message_receiver_state_change_time, MAX_MESSAGE_RECEIVER_STATE_CHANGE_TIMEOUT_SECS, &is_timed_out) != RESULT_OK)
 				{
 					LogError("messenger got an error (failed to verify messagereceiver start timeout)");
 					update_messenger_state(instance, MESSENGER_STATE_ERROR);
@@ -1401,7 +1522,7 @@ static void process_state_changes(MESSENGER_INSTANCE* instance)
 			else if (instance->message_sender_current_state == MESSAGE_SENDER_STATE_OPENING)
 			{
 				int is_timed_out;
-				if (is_timeout_reached(instance->last_message_sender_state_change_time, MAX_MESSAGE_SENDER_STATE_CHANGE_TIMEOUT_SECS, &is_timed_out) != RESULT_OK)
+				if (is_timeout_reached(instance, instance->last_message_sender_state_change_time, MAX_MESSAGE_SENDER_STATE_CHANGE_TIMEOUT_SECS, &is_timed_out) != RESULT_OK)
 				{
 					LogError("messenger failed to start (failed to verify messagesender start timeout)");
 					update_messenger_state(instance, MESSENGER_STATE_ERROR);
@@ -1498,7 +1619,6 @@ void messenger_destroy(MESSENGER_HANDLE messenger_handle)
 	}
 	else
 	{
-		LIST_ITEM_HANDLE list_node;
 		MESSENGER_INSTANCE* instance = (MESSENGER_INSTANCE*)messenger_handle;
 
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_110: [If the `instance->state` is not MESSENGER_STATE_STOPPED, messenger_destroy() shall invoke messenger_stop()]
@@ -1509,44 +1629,36 @@ void messenger_destroy(MESSENGER_HANDLE messenger_handle)
 
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_111: [All elements of `instance->in_progress_list` and `instance->wait_to_send_list` shall be removed, invoking `task->on_event_send_complete_callback` for each with EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED]
 
-		// Note: yes messenger_stop() tried to move all events from in_progress_list to wait_to_send_list, 
-		//       but we need to iterate through in case any events failed to be moved.
-		while ((list_node = singlylinkedlist_get_head_item(instance->in_progress_list)) != NULL)
+		// Note: messenger_stop() moves all events from in_progress_list to wait_to_send_list, 
+		//       but in_progress_list is also drained in case the messenger was already stopped with events in it.
+		while (!DList_IsListEmpty(&instance->in_progress_list))
 		{
-			SEND_EVENT_TASK* task = (SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_node);
+			SEND_EVENT_TASK* task = containingRecord(DList_RemoveHeadList(&instance->in_progress_list), SEND_EVENT_TASK, entry);
 
-			(void)singlylinkedlist_remove(instance->in_progress_list, list_node);
-
-			if (task != NULL)
-			{
-				task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED, (void*)task->context);
-				free(task);
-			}
+			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED, (void*)task->context);
+			destroy_event_task(task);
 		}
 
-		while ((list_node = singlylinkedlist_get_head_item(instance->waiting_to_send)) != NULL)
+		while (!DList_IsListEmpty(&instance->waiting_to_send))
 		{
-			SEND_EVENT_TASK* task = (SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_node);
+			SEND_EVENT_TASK* task = containingRecord(DList_RemoveHeadList(&instance->waiting_to_send), SEND_EVENT_TASK, entry);
 
-			(void)singlylinkedlist_remove(instance->waiting_to_send, list_node);
-
-			if (task != NULL)
-			{
-				task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED, (void*)task->context);
-				free(task);
-			}
+			task->on_event_send_complete_callback(task->message, MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED, (void*)task->context);
+			destroy_event_task(task);
 		}
 
-		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_150: [`instance->in_progress_list` and `instance->wait_to_send_list` shall be destroyed using singlylinkedlist_destroy()]
-		singlylinkedlist_destroy(instance->waiting_to_send);
-		singlylinkedlist_destroy(instance->in_progress_list);
-
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_112: [`instance->iothub_host_fqdn` shall be destroyed using STRING_delete()]
 		STRING_delete(instance->iothub_host_fqdn);
 		
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_113: [`instance->device_id` shall be destroyed using STRING_delete()]
 		STRING_delete(instance->device_id);
 
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_199: [`instance->tick_counter` shall be destroyed using tickcounter_destroy()]
+		if (instance->tick_counter != NULL)
+		{
+			tickcounter_destroy(instance->tick_counter);
+		}
+
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_114: [messenger_destroy() shall destroy `instance` with free()]
 		(void)free(instance);
 	}
@@ -1595,9 +1707,16 @@ MESSENGER_HANDLE messenger_create(const MESSENGER_CONFIG* messenger_config)
 			instance->message_receiver_previous_state = MESSAGE_RECEIVER_STATE_IDLE;
 			instance->event_send_retry_limit = DEFAULT_EVENT_SEND_RETRY_LIMIT;
 			instance->event_send_timeout_secs = DEFAULT_EVENT_SEND_TIMEOUT_SECS;
+			instance->receiver_max_message_size = MESSAGE_RECEIVER_MAX_LINK_SIZE;
 			instance->last_message_sender_state_change_time = INDEFINITE_TIME;
 			instance->last_message_receiver_state_change_time = INDEFINITE_TIME;
 
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_165: [`instance->wait_to_send_list` shall be initialized using DList_InitializeListHead()]
+			DList_InitializeListHead(&instance->waiting_to_send);
+
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_132: [`instance->in_progress_list` shall be initialized using DList_InitializeListHead()]  
+			DList_InitializeListHead(&instance->in_progress_list);
+
 			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_008: [messenger_create() shall save a copy of `messenger_config->device_id` into `instance->device_id`]
 			if ((instance->device_id = STRING_construct(messenger_config->device_id)) == NULL)
 			{
@@ -1612,19 +1731,12 @@ MESSENGER_HANDLE messenger_create(const MESSENGER_CONFIG* messenger_config)
 				handle = NULL;
 				LogError("messenger_create failed (iothub_host_fqdn could not be copied; STRING_construct failed)");
 			}
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_165: [`instance->wait_to_send_list` shall be set using singlylinkedlist_create()]
-			else if ((instance->waiting_to_send = singlylinkedlist_create()) == NULL)
-			{
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_166: [If singlylinkedlist_create() fails, messenger_create() shall fail and return NULL]  
-				handle = NULL;
-				LogError("messenger_create failed (singlylinkedlist_create failed to create wait_to_send_list)");
-			}
-			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_132: [`instance->in_progress_list` shall be set using singlylinkedlist_create()]  
-			else if ((instance->in_progress_list = singlylinkedlist_create()) == NULL)
+			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_197: [messenger_create() shall create a monotonic tick counter for measuring timeouts using tickcounter_create()]
+			else if ((instance->tick_counter = tickcounter_create()) == NULL)
 			{
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_133: [If singlylinkedlist_create() fails, messenger_create() shall fail and return NULL] 
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_198: [If tickcounter_create() fails, messenger_create() shall fail and return NULL]
 				handle = NULL;
-				LogError("messenger_create failed (singlylinkedlist_create failed to create in_progress_list)");
+				LogError("messenger_create failed (tickcounter_create failed)");
 			}
 			else
 			{
@@ -1669,6 +1781,24 @@ int messenger_set_option(MESSENGER_HANDLE messenger_handle, const char* name, vo
 			instance->event_send_timeout_secs = *((size_t*)value);
 			result = RESULT_OK;
 		}
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_191: [If name matches MESSENGER_OPTION_EVENT_BATCHING, `value` shall be saved on `instance->event_batching_enabled`]
+		else if (strcmp(MESSENGER_OPTION_EVENT_BATCHING, name) == 0)
+		{
+			instance->event_batching_enabled = *((bool*)value);
+			result = RESULT_OK;
+		}
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_194: [If name matches MESSENGER_OPTION_C2D_ZERO_COPY, `value` shall be saved on `instance->c2d_zero_copy`]
+		else if (strcmp(MESSENGER_OPTION_C2D_ZERO_COPY, name) == 0)
+		{
+			instance->c2d_zero_copy = *((bool*)value);
+			result = RESULT_OK;
+		}
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_201: [If name matches MESSENGER_OPTION_RECEIVER_MAX_MESSAGE_SIZE, the uint64_t `value` shall be saved on `instance->receiver_max_message_size`, to be applied to message receiver links created afterwards]
+		else if (strcmp(MESSENGER_OPTION_RECEIVER_MAX_MESSAGE_SIZE, name) == 0)
+		{
+			instance->receiver_max_message_size = *((uint64_t*)value);
+			result = RESULT_OK;
+		}
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
 		else if (strcmp(MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
 		{
@@ -1727,6 +1857,21 @@ OPTIONHANDLER_HANDLE messenger_retrieve_options(MESSENGER_HANDLE messenger_handl
 				LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS);
 				result = NULL;
 			}
+			else if (OptionHandler_AddOption(options, MESSENGER_OPTION_EVENT_BATCHING, (void*)&instance->event_batching_enabled) != OPTIONHANDLER_OK)
+			{
+				LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_EVENT_BATCHING);
+				result = NULL;
+			}
+			else if (OptionHandler_AddOption(options, MESSENGER_OPTION_C2D_ZERO_COPY, (void*)&instance->c2d_zero_copy) != OPTIONHANDLER_OK)
+			{
+				LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_C2D_ZERO_COPY);
+				result = NULL;
+			}
+			else if (OptionHandler_AddOption(options, MESSENGER_OPTION_RECEIVER_MAX_MESSAGE_SIZE, (void*)&instance->receiver_max_message_size) != OPTIONHANDLER_OK)
+			{
+				LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_RECEIVER_MAX_MESSAGE_SIZE);
+				result = NULL;
+			}
 			else
 			{
 				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_179: [If no failures occur, messenger_retrieve_options shall return the OPTIONHANDLER_HANDLE instance]
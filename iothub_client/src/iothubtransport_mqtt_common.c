@@ -40,6 +40,9 @@
 #define SAS_TOKEN_DEFAULT_LEN       10
 #define RESEND_TIMEOUT_VALUE_MIN    1*60
 #define MAX_SEND_RECOUNT_LIMIT      2
+#define RESEND_TIMEOUT_MIN_MS       10*1000
+#define RESEND_TIMEOUT_MAX_MS       4*60*1000
+#define RTT_CLOCK_GRANULARITY_MS    100
 #define DEFAULT_CONNECTION_INTERVAL 30
 #define FAILED_CONN_BACKOFF_VALUE   5
 #define STATUS_CODE_FAILURE_VALUE   500
@@ -194,6 +197,10 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     tickcounter_ms_t connectTick;
     bool log_trace;
     bool raw_trace;
+    bool telemetry_qos0;
+    bool clean_session;
+    bool replay_in_flight;
+    bool c2d_zero_copy;
     TICK_COUNTER_HANDLE msgTickCounter;
 
     // Internal lists for message tracking
@@ -206,6 +213,14 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     // Telemetry specific
     DLIST_ENTRY telemetry_waitingForAck;
 
+    // Resend timeout estimation, smoothed round trip time and variance of PUBACKs
+    bool rtt_sampled;
+    tickcounter_ms_t srtt_ms;
+    tickcounter_ms_t rttvar_ms;
+    tickcounter_ms_t resend_timeout_min_ms;
+    tickcounter_ms_t resend_timeout_max_ms;
+    size_t resend_max_count;
+
     //Retry Logic
     RETRY_LOGIC* retryLogic;
 } MQTTTRANSPORT_HANDLE_DATA, *PMQTTTRANSPORT_HANDLE_DATA;
@@ -548,6 +563,55 @@ static uint16_t get_next_packet_id(PMQTTTRANSPORT_HANDLE_DATA transport_data)
     return transport_data->packetId;
 }
 
+static void update_rtt_estimate(PMQTTTRANSPORT_HANDLE_DATA transport_data, tickcounter_ms_t rtt_ms)
+{
+    if (!transport_data->rtt_sampled)
+    {
+        transport_data->srtt_ms = rtt_ms;
+        transport_data->rttvar_ms = rtt_ms / 2;
+        transport_data->rtt_sampled = true;
+    }
+    else
+    {
+        tickcounter_ms_t delta = (transport_data->srtt_ms > rtt_ms) ? (transport_data->srtt_ms - rtt_ms) : (rtt_ms - transport_data->srtt_ms);
+        // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R
+        transport_data->rttvar_ms = (3 * transport_data->rttvar_ms + delta) / 4;
+        transport_data->srtt_ms = (7 * transport_data->srtt_ms + rtt_ms) / 8;
+    }
+}
+
+static tickcounter_ms_t get_resend_timeout(PMQTTTRANSPORT_HANDLE_DATA transport_data, size_t retryCount)
+{
+    tickcounter_ms_t result;
+    if (!transport_data->rtt_sampled)
+    {
+        // No PUBACK measured yet, fall back to the legacy fixed timeout
+        result = RESEND_TIMEOUT_VALUE_MIN * 1000;
+    }
+    else
+    {
+        tickcounter_ms_t variance = 4 * transport_data->rttvar_ms;
+        result = transport_data->srtt_ms + (variance > RTT_CLOCK_GRANULARITY_MS ? variance : RTT_CLOCK_GRANULARITY_MS);
+    }
+
+    // Back off exponentially for every publish already made
+    while (retryCount > 1 && result < transport_data->resend_timeout_max_ms)
+    {
+        result *= 2;
+        retryCount--;
+    }
+
+    if (result < transport_data->resend_timeout_min_ms)
+    {
+        result = transport_data->resend_timeout_min_ms;
+    }
+    else if (result > transport_data->resend_timeout_max_ms)
+    {
+        result = transport_data->resend_timeout_max_ms;
+    }
+    return result;
+}
+
 static const char* retrieve_mqtt_return_codes(CONNECT_RETURN_CODE rtn_code)
 {
     switch (rtn_code)
@@ -813,7 +877,7 @@ static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_me
     return result;
 }
 
-static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
+static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len, bool is_replay)
 {
     int result;
     STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(mqttMsgEntry->iotHubMessageEntry->messageHandle, STRING_c_str(transport_data->topic_MqttEvent));
@@ -830,7 +894,13 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
         }
         else
         {
-            if (tickcounter_get_current_ms(transport_data->msgTickCounter, &mqttMsgEntry->msgPublishTime) != 0)
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_010: [ A telemetry message that has already been published shall be published again with its original packet id and the DUP flag set. ] */
+            if (mqttMsgEntry->retryCount > 0 && mqttmessage_setIsDuplicateMsg(mqttMsg, true) != 0)
+            {
+                LogError("Failed setting the duplicate flag on the mqtt message");
+                result = __FAILURE__;
+            }
+            else if (tickcounter_get_current_ms(transport_data->msgTickCounter, &mqttMsgEntry->msgPublishTime) != 0)
             {
                 LogError("Failed retrieving tickcounter info");
                 result = __FAILURE__;
@@ -843,7 +913,11 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
                 }
                 else
                 {
-                    mqttMsgEntry->retryCount++;
+                    // A replay after reconnect does not use up the resend budget of the message
+                    if (!is_replay)
+                    {
+                        mqttMsgEntry->retryCount++;
+                    }
                     result = 0;
                 }
             }
@@ -854,6 +928,39 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
     return result;
 }
 
+static int publish_mqtt_telemetry_msg_at_most_once(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE messageHandle, const unsigned char* payload, size_t len)
+{
+    int result;
+    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(messageHandle, STRING_c_str(transport_data->topic_MqttEvent));
+    if (msgTopic == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        // QoS0 publishes carry no packet id on the wire and are never acknowledged
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(0, STRING_c_str(msgTopic), DELIVER_AT_MOST_ONCE, payload, len);
+        if (mqttMsg == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (mqtt_client_publish(transport_data->mqttClient, mqttMsg) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            mqttmessage_destroy(mqttMsg);
+        }
+        STRING_delete(msgTopic);
+    }
+    return result;
+}
+
 static int publish_device_method_message(MQTTTRANSPORT_HANDLE_DATA* transport_data, int status_code, STRING_HANDLE request_id, const unsigned char* response, size_t response_size)
 {
     int result;
@@ -1268,7 +1375,10 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
             else
             {
                 const APP_PAYLOAD* appPayload = mqttmessage_getApplicationMsg(msgHandle);
-                IOTHUB_MESSAGE_HANDLE IoTHubMessage = IoTHubMessage_CreateFromByteArray(appPayload->message, appPayload->length);
+                /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_017: [ If the "c2d_zero_copy" option is set, mqtt_notification_callback shall create the message with IoTHubMessage_CreateFromByteArrayView over the payload of the MQTT message, which stays valid until the message callback returns. ] */
+                IOTHUB_MESSAGE_HANDLE IoTHubMessage = transportData->c2d_zero_copy ?
+                    IoTHubMessage_CreateFromByteArrayView(appPayload->message, appPayload->length) :
+                    IoTHubMessage_CreateFromByteArray(appPayload->message, appPayload->length);
                 if (IoTHubMessage == NULL)
                 {
                     LogError("Failure: IotHub Message creation has failed.");
@@ -1319,6 +1429,12 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
 
                         if (puback->packetId == mqttMsgEntry->packet_id)
                         {
+                            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_004: [ On a PUBACK for a message that was published only once, the transport shall update the smoothed round trip time and its variance with the time elapsed since the publish. ] */
+                            tickcounter_ms_t current_ms;
+                            if (mqttMsgEntry->retryCount == 1 && tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) == 0)
+                            {
+                                update_rtt_estimate(transport_data, current_ms - mqttMsgEntry->msgPublishTime);
+                            }
                             (void)DList_RemoveEntryList(currentListEntry); //First remove the item from Waiting for Ack List.
                             sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
                             free(mqttMsgEntry);
@@ -1342,6 +1458,8 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                         // The connect packet has been acked
                         transport_data->currPacketState = CONNACK_TYPE;
                         transport_data->isRecoverableError = true;
+                        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_011: [ On an accepted CONNACK the transport shall schedule every message waiting for acknowledgement to be replayed on the next IoTHubTransport_MQTT_Common_DoWork that can publish. ] */
+                        transport_data->replay_in_flight = true;
                         StopRetryTimer(transport_data->retryLogic);
                         IotHubClient_LL_ConnectionStatusCallBack(transport_data->llClientHandle, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK);
                     }
@@ -1647,7 +1765,8 @@ static int SendMqttConnectMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data)
                 options.password = (char*)STRING_c_str(sasToken);
             }
             options.keepAliveInterval = transport_data->keepAliveValue;
-            options.useCleanSession = false;
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_012: [ The CONNECT packet shall request a clean session only if the clean_session option is set. ] */
+            options.useCleanSession = transport_data->clean_session;
             options.qualityOfServiceValue = DELIVER_AT_LEAST_ONCE;
 
             if (GetTransportProviderIfNecessary(transport_data) == 0)
@@ -1942,6 +2061,16 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
                     state->topics_ToSubscribe = UNSUBSCRIBE_FROM_TOPIC;
                     state->topic_DeviceMethods = NULL;
                     state->log_trace = state->raw_trace = false;
+                    state->telemetry_qos0 = false;
+                    state->clean_session = false;
+                    state->replay_in_flight = false;
+                    state->c2d_zero_copy = false;
+                    state->rtt_sampled = false;
+                    state->srtt_ms = 0;
+                    state->rttvar_ms = 0;
+                    state->resend_timeout_min_ms = RESEND_TIMEOUT_MIN_MS;
+                    state->resend_timeout_max_ms = RESEND_TIMEOUT_MAX_MS;
+                    state->resend_max_count = MAX_SEND_RECOUNT_LIMIT - 1;
                     state->retryLogic = NULL;
                     srand((unsigned int)get_time(NULL));
                 }
@@ -2457,7 +2586,35 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
             }
             else if (transport_data->currPacketState == PUBLISH_TYPE)
             {
-                PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
+                PDLIST_ENTRY currentListEntry;
+                if (transport_data->replay_in_flight)
+                {
+                    transport_data->replay_in_flight = false;
+                    currentListEntry = transport_data->telemetry_waitingForAck.Flink;
+                    while (currentListEntry != &transport_data->telemetry_waitingForAck)
+                    {
+                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
+                        DLIST_ENTRY nextListEntry;
+                        nextListEntry.Flink = currentListEntry->Flink;
+
+                        size_t messageLength;
+                        const unsigned char* messagePayload = RetrieveMessagePayload(mqttMsgEntry->iotHubMessageEntry->messageHandle, &messageLength);
+                        if (messageLength == 0 || messagePayload == NULL)
+                        {
+                            LogError("Failure from creating Message IoTHubMessage_GetData");
+                        }
+                        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_013: [ Replayed messages shall keep their packet id and their resend count. ] */
+                        else if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength, true) != 0)
+                        {
+                            (void)DList_RemoveEntryList(currentListEntry);
+                            sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                            free(mqttMsgEntry);
+                        }
+                        currentListEntry = nextListEntry.Flink;
+                    }
+                }
+
+                currentListEntry = transport_data->telemetry_waitingForAck.Flink;
                 while (currentListEntry != &transport_data->telemetry_waitingForAck)
                 {
                     MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
@@ -2467,10 +2624,11 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
                     tickcounter_ms_t current_ms;
                     (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms);
                     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_033: [IoTHubTransport_MQTT_Common_DoWork shall iterate through the Waiting Acknowledge messages looking for any message that has been waiting longer than 2 min.]*/
-                    if (((current_ms - mqttMsgEntry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN)
+                    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_005: [ The resend timeout shall be the smoothed round trip time plus four times its variance, doubled for every previous publish of the message and bounded by the configured minimum and maximum. ] */
+                    if ((current_ms - mqttMsgEntry->msgPublishTime) > get_resend_timeout(transport_data, mqttMsgEntry->retryCount))
                     {
                         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_034: [If IoTHubTransport_MQTT_Common_DoWork has resent the message two times then it shall fail the message] */
-                        if (mqttMsgEntry->retryCount >= MAX_SEND_RECOUNT_LIMIT)
+                        if (mqttMsgEntry->retryCount > transport_data->resend_max_count)
                         {
                             (void)DList_RemoveEntryList(currentListEntry);
                             sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
@@ -2486,7 +2644,7 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
                             }
                             else
                             {
-                                if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
+                                if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength, false) != 0)
                                 {
                                     (void)DList_RemoveEntryList(currentListEntry);
                                     sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
@@ -2513,6 +2671,22 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
                     {
                         LogError("Failure result from IoTHubMessage_GetData");
                     }
+                    else if (transport_data->telemetry_qos0)
+                    {
+                        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_002: [ If the telemetry_qos0 option is set, IoTHubTransport_MQTT_Common_DoWork shall publish the message with DELIVER_AT_MOST_ONCE and shall not add it to the waiting for acknowledgement list. ] */
+                        IOTHUB_CLIENT_CONFIRMATION_RESULT confirmResult;
+                        if (publish_mqtt_telemetry_msg_at_most_once(transport_data, iothubMsgList->messageHandle, messagePayload, messageLength) != 0)
+                        {
+                            confirmResult = IOTHUB_CLIENT_CONFIRMATION_ERROR;
+                        }
+                        else
+                        {
+                            confirmResult = IOTHUB_CLIENT_CONFIRMATION_OK;
+                        }
+                        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_003: [ A message published with DELIVER_AT_MOST_ONCE shall be completed with IOTHUB_CLIENT_CONFIRMATION_OK as soon as mqtt_client_publish succeeds. ] */
+                        (void)(DList_RemoveEntryList(currentListEntry));
+                        sendMsgComplete(iothubMsgList, transport_data, confirmResult);
+                    }
                     else
                     {
                         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_029: [IoTHubTransport_MQTT_Common_DoWork shall create a MQTT_MESSAGE_HANDLE and pass this to a call to mqtt_client_publish.] */
@@ -2526,7 +2700,7 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
                             mqttMsgEntry->retryCount = 0;
                             mqttMsgEntry->iotHubMessageEntry = iothubMsgList;
                             mqttMsgEntry->packet_id = get_next_packet_id(transport_data);
-                            if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
+                            if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength, false) != 0)
                             {
                                 (void)(DList_RemoveEntryList(currentListEntry));
                                 sendMsgComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
@@ -2605,6 +2779,50 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             mqtt_client_set_trace(transport_data->mqttClient, transport_data->log_trace, transport_data->raw_trace);
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(OPTION_TELEMETRY_QOS0, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_001: [ If the option parameter is set to "telemetry_qos0" then the value shall be a bool_ptr and the value will determine if telemetry messages are published with DELIVER_AT_MOST_ONCE. ] */
+            transport_data->telemetry_qos0 = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_C2D_ZERO_COPY, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_016: [ If the option parameter is set to "c2d_zero_copy" then the value shall be a bool_ptr and the value will determine if received messages reference the MQTT payload instead of copying it. ] */
+            transport_data->c2d_zero_copy = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_CLEAN_SESSION, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_009: [ If the option parameter is set to "clean_session" then the value shall be a bool_ptr and the value will be used as the clean session flag of the next CONNECT packet. ] */
+            transport_data->clean_session = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_RESEND_MAX_COUNT, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_006: [ If the option parameter is set to "resend_max_count" then the value shall be a size_t_ptr and the value will determine how many times an unacknowledged telemetry message is resent before it is failed. ] */
+            transport_data->resend_max_count = *((size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_RESEND_TIMEOUT_MIN, option) == 0 || strcmp(OPTION_RESEND_TIMEOUT_MAX, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_007: [ If the option parameter is set to "resend_timeout_min" or "resend_timeout_max" then the value shall be a size_t_ptr holding the bound of the resend timeout in milliseconds. ] */
+            tickcounter_ms_t bound = (tickcounter_ms_t)(*((size_t*)value));
+            bool is_min = (strcmp(OPTION_RESEND_TIMEOUT_MIN, option) == 0);
+            tickcounter_ms_t new_min = is_min ? bound : transport_data->resend_timeout_min_ms;
+            tickcounter_ms_t new_max = is_min ? transport_data->resend_timeout_max_ms : bound;
+            if (new_min == 0 || new_min > new_max)
+            {
+                /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_21_008: [ If the resulting minimum is zero or greater than the maximum, IoTHubTransport_MQTT_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ] */
+                LogError("invalid resend timeout bounds, min %lu max %lu", (unsigned long)new_min, (unsigned long)new_max);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_data->resend_timeout_min_ms = new_min;
+                transport_data->resend_timeout_max_ms = new_max;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else if (strcmp(OPTION_KEEP_ALIVE, option) == 0)
         {
             /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_036: [If the option parameter is set to "keepalive" then the value shall be a int_ptr and the value will determine the mqtt keepalive time that is set for pings.] */
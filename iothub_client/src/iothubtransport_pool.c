@@ -0,0 +1,266 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "iothubtransport_pool.h"
+
+typedef struct TRANSPORT_POOL_ENTRY_TAG
+{
+    TRANSPORT_HANDLE transport;
+    size_t device_count;
+} TRANSPORT_POOL_ENTRY;
+
+typedef struct TRANSPORT_POOL_INSTANCE_TAG
+{
+    IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;
+    char* iothub_name;
+    char* iothub_suffix;
+    size_t devices_per_transport;
+    // Transports are created in order and never removed before the pool is destroyed.
+    TRANSPORT_POOL_ENTRY* entries;
+    size_t max_transports;
+    size_t transport_count;
+    // Serializes the clients being created and destroyed on different threads.
+    LOCK_HANDLE lock;
+} TRANSPORT_POOL_INSTANCE;
+
+static TRANSPORT_POOL_ENTRY* find_least_loaded(TRANSPORT_POOL_INSTANCE* pool)
+{
+    TRANSPORT_POOL_ENTRY* result = NULL;
+    size_t i;
+
+    for (i = 0; i < pool->transport_count; i++)
+    {
+        if (result == NULL || pool->entries[i].device_count < result->device_count)
+        {
+            result = &pool->entries[i];
+        }
+    }
+
+    return result;
+}
+
+static TRANSPORT_POOL_ENTRY* find_entry(TRANSPORT_POOL_INSTANCE* pool, TRANSPORT_HANDLE transport)
+{
+    TRANSPORT_POOL_ENTRY* result = NULL;
+    size_t i;
+
+    for (i = 0; i < pool->transport_count && result == NULL; i++)
+    {
+        if (pool->entries[i].transport == transport)
+        {
+            result = &pool->entries[i];
+        }
+    }
+
+    return result;
+}
+
+static void destroy_pool(TRANSPORT_POOL_INSTANCE* pool)
+{
+    size_t i;
+
+    for (i = 0; i < pool->transport_count; i++)
+    {
+        IoTHubTransport_Destroy(pool->entries[i].transport);
+    }
+
+    if (pool->lock != NULL)
+    {
+        Lock_Deinit(pool->lock);
+    }
+    free(pool->entries);
+    free(pool->iothub_suffix);
+    free(pool->iothub_name);
+    free(pool);
+}
+
+TRANSPORT_POOL_HANDLE IoTHubTransportPool_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix, size_t devicesPerTransport, size_t maxTransports)
+{
+    TRANSPORT_POOL_INSTANCE* result;
+
+    /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_001: [ If protocol, iotHubName or iotHubSuffix are NULL, or devicesPerTransport or maxTransports are 0, IoTHubTransportPool_Create shall return NULL. ]*/
+    if (protocol == NULL || iotHubName == NULL || iotHubSuffix == NULL || devicesPerTransport == 0 || maxTransports == 0)
+    {
+        LogError("Invalid argument (protocol=%p, iotHubName=%p, iotHubSuffix=%p, devicesPerTransport=%zu, maxTransports=%zu)", protocol, iotHubName, iotHubSuffix, devicesPerTransport, maxTransports);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_002: [ IoTHubTransportPool_Create shall allocate the pool, copy iotHubName and iotHubSuffix, allocate room for maxTransports transports and create the pool lock with Lock_Init. ]*/
+    else if ((result = (TRANSPORT_POOL_INSTANCE*)malloc(sizeof(TRANSPORT_POOL_INSTANCE))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_003: [ If any of these fails, IoTHubTransportPool_Create shall free what it allocated and return NULL. ]*/
+        LogError("Failed allocating the transport pool");
+    }
+    else
+    {
+        result->protocol = protocol;
+        result->iothub_name = NULL;
+        result->iothub_suffix = NULL;
+        result->devices_per_transport = devicesPerTransport;
+        result->entries = NULL;
+        result->max_transports = maxTransports;
+        result->transport_count = 0;
+        result->lock = NULL;
+
+        if (mallocAndStrcpy_s(&result->iothub_name, iotHubName) != 0)
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_003: [ If any of these fails, IoTHubTransportPool_Create shall free what it allocated and return NULL. ]*/
+            LogError("Failed copying the IoT Hub name");
+            result->iothub_name = NULL;
+            destroy_pool(result);
+            result = NULL;
+        }
+        else if (mallocAndStrcpy_s(&result->iothub_suffix, iotHubSuffix) != 0)
+        {
+            LogError("Failed copying the IoT Hub suffix");
+            result->iothub_suffix = NULL;
+            destroy_pool(result);
+            result = NULL;
+        }
+        else if ((result->entries = (TRANSPORT_POOL_ENTRY*)malloc(maxTransports * sizeof(TRANSPORT_POOL_ENTRY))) == NULL)
+        {
+            LogError("Failed allocating the transport list of the pool");
+            destroy_pool(result);
+            result = NULL;
+        }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Failed creating the transport pool lock");
+            destroy_pool(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void IoTHubTransportPool_Destroy(TRANSPORT_POOL_HANDLE poolHandle)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_004: [ If poolHandle is NULL, IoTHubTransportPool_Destroy shall do nothing. ]*/
+    if (poolHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_005: [ IoTHubTransportPool_Destroy shall destroy every transport of the pool with IoTHubTransport_Destroy, the lock and the pool. ]*/
+        destroy_pool((TRANSPORT_POOL_INSTANCE*)poolHandle);
+    }
+}
+
+TRANSPORT_HANDLE IoTHubTransportPool_AcquireTransport(TRANSPORT_POOL_HANDLE poolHandle)
+{
+    TRANSPORT_HANDLE result;
+
+    if (poolHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_006: [ If poolHandle is NULL, IoTHubTransportPool_AcquireTransport shall return NULL. ]*/
+        LogError("Invalid argument (poolHandle is NULL)");
+        result = NULL;
+    }
+    else
+    {
+        TRANSPORT_POOL_INSTANCE* pool = (TRANSPORT_POOL_INSTANCE*)poolHandle;
+
+        if (Lock(pool->lock) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_007: [ If Lock fails, IoTHubTransportPool_AcquireTransport shall return NULL. ]*/
+            LogError("Failed locking the transport pool");
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_008: [ IoTHubTransportPool_AcquireTransport shall pick the transport with the fewest devices. ]*/
+            TRANSPORT_POOL_ENTRY* entry = find_least_loaded(pool);
+
+            /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_009: [ If there is no transport, or that transport has devicesPerTransport devices, and the pool has less than maxTransports transports, IoTHubTransportPool_AcquireTransport shall create a new one with IoTHubTransport_Create and pick it. ]*/
+            if ((entry == NULL || entry->device_count >= pool->devices_per_transport) &&
+                pool->transport_count < pool->max_transports)
+            {
+                TRANSPORT_HANDLE transport = IoTHubTransport_Create(pool->protocol, pool->iothub_name, pool->iothub_suffix);
+
+                if (transport == NULL)
+                {
+                    /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_010: [ If IoTHubTransport_Create fails, IoTHubTransportPool_AcquireTransport shall pick the least loaded transport, or return NULL if there is none. ]*/
+                    LogError("Failed creating a new transport for the pool, using the least loaded one");
+                }
+                else
+                {
+                    entry = &pool->entries[pool->transport_count];
+                    entry->transport = transport;
+                    entry->device_count = 0;
+                    pool->transport_count++;
+                }
+            }
+
+            if (entry == NULL)
+            {
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_011: [ IoTHubTransportPool_AcquireTransport shall count one more device on the picked transport and return it. ]*/
+                entry->device_count++;
+                result = entry->transport;
+            }
+
+            (void)Unlock(pool->lock);
+        }
+    }
+
+    return result;
+}
+
+void IoTHubTransportPool_ReleaseTransport(TRANSPORT_POOL_HANDLE poolHandle, TRANSPORT_HANDLE transportHandle)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_012: [ If poolHandle or transportHandle are NULL, IoTHubTransportPool_ReleaseTransport shall do nothing. ]*/
+    if (poolHandle == NULL || transportHandle == NULL)
+    {
+        LogError("Invalid argument (poolHandle=%p, transportHandle=%p)", poolHandle, transportHandle);
+    }
+    else
+    {
+        TRANSPORT_POOL_INSTANCE* pool = (TRANSPORT_POOL_INSTANCE*)poolHandle;
+
+        if (Lock(pool->lock) != LOCK_OK)
+        {
+            LogError("Failed locking the transport pool");
+        }
+        else
+        {
+            TRANSPORT_POOL_ENTRY* entry = find_entry(pool, transportHandle);
+
+            if (entry == NULL || entry->device_count == 0)
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_013: [ If transportHandle was not acquired from the pool, IoTHubTransportPool_ReleaseTransport shall do nothing. ]*/
+                LogError("Transport %p has no device acquired from this pool", transportHandle);
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_014: [ IoTHubTransportPool_ReleaseTransport shall count one device less on the transport, keeping the transport open. ]*/
+                entry->device_count--;
+            }
+
+            (void)Unlock(pool->lock);
+        }
+    }
+}
+
+size_t IoTHubTransportPool_GetTransportCount(TRANSPORT_POOL_HANDLE poolHandle)
+{
+    size_t result;
+
+    if (poolHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_015: [ If poolHandle is NULL, IoTHubTransportPool_GetTransportCount shall return 0. ]*/
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_POOL_21_016: [ Otherwise IoTHubTransportPool_GetTransportCount shall return how many transports the pool created. ]*/
+        result = ((TRANSPORT_POOL_INSTANCE*)poolHandle)->transport_count;
+    }
+
+    return result;
+}
@@ -4,10 +4,12 @@
 #include "iothubtransportamqp_auth.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/agenttime.h" 
+#include "azure_c_shared_utility/tickcounter.h"
 
 #define RESULT_OK 0
 #define INDEFINITE_TIME ((time_t)(-1))
 #define SAS_TOKEN_TYPE "servicebus.windows.net:sastoken"
+#define UNKNOWN_PUT_TOKEN_START_TIME ((tickcounter_ms_t)(-1))
 
 typedef struct AMQP_TRANSPORT_CBS_STATE_TAG
 {
@@ -17,6 +19,12 @@ typedef struct AMQP_TRANSPORT_CBS_STATE_TAG
 	size_t current_sas_token_create_time;
 	// Time when the current SAS token was put to CBS, in seconds since epoch.
 	size_t current_sas_token_put_time;
+	// Seconds by which the refresh of the current SAS token is brought forward.
+	size_t refresh_jitter;
+	// Set while a put-token request of this device is counted in cbs_connection->pending_put_tokens.
+	bool is_put_token_pending;
+	// Time when the pending put-token request was sent, in milliseconds.
+	tickcounter_ms_t put_token_start_time;
 } AMQP_TRANSPORT_CBS_STATE;
 
 typedef struct AUTHENTICATION_STATE_TAG
@@ -25,13 +33,16 @@ typedef struct AUTHENTICATION_STATE_TAG
 
 	STRING_HANDLE iot_hub_host_fqdn;
 
-	const AMQP_TRANSPORT_CBS_CONNECTION* cbs_connection;
+	AMQP_TRANSPORT_CBS_CONNECTION* cbs_connection;
 
 	AMQP_TRANSPORT_CREDENTIAL credential;
 
 	AMQP_TRANSPORT_CBS_STATE cbs_state;
 
 	AUTHENTICATION_STATUS status;
+
+	// Used to measure how long CBS takes to answer put-token requests.
+	TICK_COUNTER_HANDLE tick_counter;
 } AUTHENTICATION_STATE;
 
 static int getSecondsSinceEpoch(size_t* seconds)
@@ -54,6 +65,52 @@ static int getSecondsSinceEpoch(size_t* seconds)
 	return result;
 }
 
+static void releasePutTokenSlot(AUTHENTICATION_STATE* auth_state, bool failed)
+{
+	if (auth_state->cbs_state.is_put_token_pending)
+	{
+		auth_state->cbs_state.is_put_token_pending = false;
+
+		// The transport zeroes the counter when it creates a new CBS instance, so requests sent on the previous one may complete after that.
+		if (auth_state->cbs_connection->pending_put_tokens > 0)
+		{
+			auth_state->cbs_connection->pending_put_tokens--;
+		}
+
+		if (failed)
+		{
+			auth_state->cbs_connection->put_tokens_failed++;
+		}
+	}
+}
+
+static void updatePutTokenLatency(AUTHENTICATION_STATE* auth_state)
+{
+	tickcounter_ms_t current_time;
+
+	if (auth_state->cbs_state.put_token_start_time == UNKNOWN_PUT_TOKEN_START_TIME)
+	{
+		LogInfo("Put-token latency not measured (the request start time is unknown)");
+	}
+	else if (tickcounter_get_current_ms(auth_state->tick_counter, &current_time) != 0)
+	{
+		LogError("Put-token latency not measured (tickcounter_get_current_ms failed)");
+	}
+	else
+	{
+		AMQP_TRANSPORT_CBS_CONNECTION* cbs_connection = auth_state->cbs_connection;
+		uint64_t latency = (uint64_t)(current_time - auth_state->cbs_state.put_token_start_time);
+
+		cbs_connection->last_put_token_latency = latency;
+		cbs_connection->total_put_token_latency += latency;
+
+		if (latency > cbs_connection->max_put_token_latency)
+		{
+			cbs_connection->max_put_token_latency = latency;
+		}
+	}
+}
+
 static void on_put_token_complete(void* context, CBS_OPERATION_RESULT operation_result, unsigned int status_code, const char* status_description)
 {
 #ifdef NO_LOGGING
@@ -63,6 +120,15 @@ static void on_put_token_complete(void* context, CBS_OPERATION_RESULT operation_
 
 	AUTHENTICATION_STATE* auth_state = (AUTHENTICATION_STATE*)context;
 
+	// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_083: [When cbs_put_token() calls back for a request counted in `pending_put_tokens`, the time elapsed since the request was sent shall be saved in `last_put_token_latency`, added to `total_put_token_latency` and to `max_put_token_latency` if larger, `put_tokens_completed` shall be incremented and `pending_put_tokens` decremented]
+	if (auth_state->cbs_state.is_put_token_pending)
+	{
+		updatePutTokenLatency(auth_state);
+		auth_state->cbs_connection->put_tokens_completed++;
+		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_084: [If that result is not CBS_OPERATION_RESULT_OK, `put_tokens_failed` shall be incremented]
+		releasePutTokenSlot(auth_state, operation_result != CBS_OPERATION_RESULT_OK);
+	}
+
 	if (operation_result == CBS_OPERATION_RESULT_OK)
 	{
 		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_041: [When cbs_put_token() calls back, if the result is CBS_OPERATION_RESULT_OK the state status shall be set to AUTHENTICATION_STATUS_OK]
@@ -103,6 +169,17 @@ static int handSASTokenToCbs(AUTHENTICATION_STATE* auth_state, STRING_HANDLE cbs
 
 	// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_035: [The SAS token provided shall be sent to CBS using cbs_put_token(), using `servicebus.windows.net:sastoken` as token type and `devices_path` as audience]
 	// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_028: [The SAS token shall be sent to CBS using cbs_put_token(), using `servicebus.windows.net:sastoken` as token type and `devices_path` as audience]
+	tickcounter_ms_t start_time;
+
+	if (tickcounter_get_current_ms(auth_state->tick_counter, &start_time) != 0)
+	{
+		LogError("Failed getting the put-token start time (tickcounter_get_current_ms failed)");
+		start_time = UNKNOWN_PUT_TOKEN_START_TIME;
+	}
+
+	// A request CBS never answered must not keep holding a slot.
+	releasePutTokenSlot(auth_state, false);
+
 	if (cbs_put_token(auth_state->cbs_connection->cbs_handle, SAS_TOKEN_TYPE, STRING_c_str(cbs_audience), STRING_c_str(sasToken), on_put_token_complete, auth_state) != RESULT_OK)
 	{
 		LogError("Failed applying new SAS token to CBS.");
@@ -110,6 +187,12 @@ static int handSASTokenToCbs(AUTHENTICATION_STATE* auth_state, STRING_HANDLE cbs
 	}
 	else
 	{
+		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_085: [If cbs_put_token() succeeds, authentication_authenticate() shall increment `pending_put_tokens` and `put_tokens_sent` in the `cbs_connection`]
+		auth_state->cbs_state.is_put_token_pending = true;
+		auth_state->cbs_state.put_token_start_time = start_time;
+		auth_state->cbs_connection->pending_put_tokens++;
+		auth_state->cbs_connection->put_tokens_sent++;
+
 		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_029: [If cbs_put_token() succeeds, authentication_authenticate() shall set the state status to AUTHENTICATION_STATUS_IN_PROGRESS]
 		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_037: [If cbs_put_token() succeeds, authentication_authenticate() shall set the state status to AUTHENTICATION_STATUS_IN_PROGRESS]
 		auth_state->status = AUTHENTICATION_STATUS_IN_PROGRESS;
@@ -160,12 +243,30 @@ static bool isSasTokenRefreshRequired(AUTHENTICATION_STATE* auth_state)
 	else
 	{
 		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_049: [The SAS token expiration shall be computed comparing its create time to `sas_token_refresh_time`]
-		result = ((currentTimeInSeconds - auth_state->cbs_state.current_sas_token_create_time) >= (auth_state->cbs_connection->sas_token_refresh_time / 1000)) ? true : false;
+		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_087: [The SAS token refresh shall be brought forward by the `refresh_jitter` drawn when the token was created]
+		result = ((currentTimeInSeconds - auth_state->cbs_state.current_sas_token_create_time) + auth_state->cbs_state.refresh_jitter >= (auth_state->cbs_connection->sas_token_refresh_time / 1000)) ? true : false;
 	}
 
 	return result;
 } 
 
+static size_t getRefreshJitter(const AMQP_TRANSPORT_CBS_CONNECTION* cbs_connection)
+{
+	size_t result;
+	size_t max_jitter = (cbs_connection->sas_token_refresh_time / 1000) * cbs_connection->sas_token_refresh_jitter_percent / 100;
+
+	if (max_jitter == 0)
+	{
+		result = 0;
+	}
+	else
+	{
+		result = (size_t)rand() % (max_jitter + 1);
+	}
+
+	return result;
+}
+
 AUTHENTICATION_STATE_HANDLE authentication_create(const AUTHENTICATION_CONFIG* config)
 {
 	AUTHENTICATION_STATE* auth_state = NULL;
@@ -197,6 +298,8 @@ AUTHENTICATION_STATE_HANDLE authentication_create(const AUTHENTICATION_CONFIG* c
 	else
 	{
 		auth_state->device_id = NULL;
+		auth_state->iot_hub_host_fqdn = NULL;
+		auth_state->tick_counter = NULL;
 		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_005: [authentication_create() shall save a reference to the `cbs_connection` into the AUTHENTICATION_STATE instance.]
 		auth_state->cbs_connection = config->cbs_connection;
 		auth_state->credential.type = CREDENTIAL_NOT_BUILD;
@@ -205,6 +308,9 @@ AUTHENTICATION_STATE_HANDLE authentication_create(const AUTHENTICATION_CONFIG* c
 		auth_state->credential.data.x509credential.x509certificate = NULL;
 		auth_state->credential.data.x509credential.x509privatekey = NULL;
 		auth_state->cbs_state.sasTokenKeyName = NULL;
+		auth_state->cbs_state.refresh_jitter = 0;
+		auth_state->cbs_state.is_put_token_pending = false;
+		auth_state->cbs_state.put_token_start_time = UNKNOWN_PUT_TOKEN_START_TIME;
 		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_004: [authentication_create() shall set the initial status of AUTHENTICATION_STATE as AUTHENTICATION_STATUS_IDLE.]
 		auth_state->status = AUTHENTICATION_STATUS_IDLE;
 
@@ -220,6 +326,12 @@ AUTHENTICATION_STATE_HANDLE authentication_create(const AUTHENTICATION_CONFIG* c
 			// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_009: [If STRING_clone() fails to copy `iot_hub_host_fqdn`, authentication_create() shall fail and return NULL]
 			LogError("Failed creating the authentication state (could not clone the devices_path)");
 		}
+		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_080: [authentication_create() shall create a tick counter using tickcounter_create() to measure how long CBS takes to answer put-token requests]
+		else if ((auth_state->tick_counter = tickcounter_create()) == NULL)
+		{
+			// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_081: [If tickcounter_create() fails, authentication_create() shall fail and return NULL]
+			LogError("Failed creating the authentication state (tickcounter_create failed)");
+		}
 		else
 		{
 			if (config->device_sas_token != NULL)
@@ -307,6 +419,8 @@ AUTHENTICATION_STATE_HANDLE authentication_create(const AUTHENTICATION_CONFIG* c
 			STRING_delete(auth_state->credential.data.deviceSasToken);
 		if (auth_state->cbs_state.sasTokenKeyName != NULL)
 			STRING_delete(auth_state->cbs_state.sasTokenKeyName);
+		if (auth_state->tick_counter != NULL)
+			tickcounter_destroy(auth_state->tick_counter);
 		if (auth_state != NULL)
 			free(auth_state);
 	}
@@ -400,6 +514,8 @@ int authentication_authenticate(AUTHENTICATION_STATE_HANDLE authentication_state
 					else
 					{
 						auth_state->cbs_state.current_sas_token_create_time = currentTimeInSeconds;
+						// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_086: [authentication_authenticate() shall draw the `refresh_jitter` of the new SAS token at random between 0 and `sas_token_refresh_jitter_percent` percent of `sas_token_refresh_time`]
+						auth_state->cbs_state.refresh_jitter = getRefreshJitter(auth_state->cbs_connection);
 
 						if (handSASTokenToCbs(auth_state, devices_path, newSASToken, currentTimeInSeconds) != 0)
 						{
@@ -515,6 +631,8 @@ AUTHENTICATION_STATUS authentication_get_status(AUTHENTICATION_STATE_HANDLE auth
 					{
 						// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_047: [If authentication has timed out, authentication_get_status() shall set the status of the state to AUTHENTICATION_STATUS_TIMEOUT]
 						auth_state->status = AUTHENTICATION_STATUS_TIMEOUT;
+						// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_088: [If authentication has timed out, authentication_get_status() shall decrement `pending_put_tokens` and increment `put_tokens_failed`]
+						releasePutTokenSlot(auth_state, true);
 					}
 				}
 				// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_048: [If the credential type is DEVICE_KEY and current status is AUTHENTICATION_STATUS_OK, authentication_get_status() shall check if SAS token must be refreshed]
@@ -538,6 +656,8 @@ AUTHENTICATION_STATUS authentication_get_status(AUTHENTICATION_STATE_HANDLE auth
 					{
 						// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_053: [If authentication has timed out, authentication_get_status() shall set the status of the state to AUTHENTICATION_STATUS_TIMEOUT]
 						auth_state->status = AUTHENTICATION_STATUS_TIMEOUT;
+						// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_088: [If authentication has timed out, authentication_get_status() shall decrement `pending_put_tokens` and increment `put_tokens_failed`]
+						releasePutTokenSlot(auth_state, true);
 					}
 				}
 				break;
@@ -627,6 +747,9 @@ int authentication_reset(AUTHENTICATION_STATE_HANDLE authentication_state_handle
 			{
 				STRING_HANDLE devices_path = NULL;
 
+				// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_089: [authentication_reset() shall stop counting any put-token request of the device still in `pending_put_tokens`]
+				releasePutTokenSlot(auth_state, false);
+
 				if (auth_state->status == AUTHENTICATION_STATUS_FAILURE || auth_state->status == AUTHENTICATION_STATUS_REFRESH_REQUIRED || auth_state->status == AUTHENTICATION_STATUS_TIMEOUT)
 				{
 					// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_063: [If the authentication_state status is AUTHENTICATION_STATUS_FAILURE or AUTHENTICATION_STATUS_REFRESH_REQUIRED, authentication_reset() shall set the status to AUTHENTICATION_STATUS_IDLE]
@@ -690,6 +813,15 @@ void authentication_destroy(AUTHENTICATION_STATE_HANDLE authentication_state_han
 		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_070: [authentication_destroy() shall destroy the AUTHENTICATION_STATE->iot_hub_host_fqdn using STRING_delete()]
 		STRING_delete(auth_state->iot_hub_host_fqdn);
 
+		if (auth_state->cbs_connection != NULL)
+		{
+			// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_090: [authentication_destroy() shall stop counting any put-token request of the device still in `pending_put_tokens`]
+			releasePutTokenSlot(auth_state, false);
+		}
+
+		// Codes_IOTHUBTRANSPORTAMQP_AUTH_09_091: [authentication_destroy() shall destroy the tick counter using tickcounter_destroy()]
+		tickcounter_destroy(auth_state->tick_counter);
+
 		switch (auth_state->credential.type)
 		{
 			case (CREDENTIAL_NOT_BUILD):
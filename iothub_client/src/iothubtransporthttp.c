@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <time.h>
@@ -18,11 +19,11 @@
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/sastoken.h"
 
 #define IOTHUB_APP_PREFIX "iothub-app-"
 const char* IOTHUB_MESSAGE_ID = "iothub-messageid";
@@ -36,12 +37,22 @@ const char* IOTHUB_CORRELATION_ID = "iothub-correlationid";
 /*the default is 25 minutes*/
 #define DEFAULT_GETMINIMUMPOLLINGTIME ((unsigned int)25*60) 
 
+/*with adaptive polling the interval between 2 GETs restarts at ADAPTIVE_POLLING_MINIMUM_INTERVAL seconds when a message arrives*/
+/*and doubles after every empty GET, up to getMinimumPollingTime*/
+#define ADAPTIVE_POLLING_MINIMUM_INTERVAL ((unsigned int)2)
+
+/*SAS tokens generated for device keys are reused until they are sas_token_refresh_time old (milliseconds, same defaults as AMQP)*/
+#define DEFAULT_SAS_TOKEN_LIFETIME_MS ((size_t)3600000)
+#define DEFAULT_SAS_TOKEN_REFRESH_TIME_MS (DEFAULT_SAS_TOKEN_LIFETIME_MS / 2)
+
 #define MAXIMUM_MESSAGE_SIZE (255*1024-1)
 #define MAXIMUM_PAYLOAD_OVERHEAD 384
 #define MAXIMUM_PROPERTY_OVERHEAD 16
+/*how many items that do not fit a batch can be stepped over while looking for items that do*/
+#define MAXIMUM_BATCH_LOOK_AHEAD 16
+
 
 /*forward declaration*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count);
 
 typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
 {
@@ -49,6 +60,11 @@ typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
     HTTPAPIEX_HANDLE httpApiExHandle;
     bool doBatchedTransfers;
     unsigned int getMinimumPollingTime;
+    bool doAdaptivePolling;
+    bool doPollAfterEvent;
+    bool doBatchPreserveOrder;
+    size_t sasTokenLifetime;
+    size_t sasTokenRefreshTime;
     VECTOR_HANDLE perDeviceList;
 }HTTPTRANSPORT_HANDLE_DATA;
 
@@ -65,9 +81,17 @@ typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
     HTTP_HEADERS_HANDLE messageHTTPrequestHeaders;
     STRING_HANDLE abandonHTTPrelativePathBegin;
     HTTPAPIEX_SAS_HANDLE sasObject;
+    STRING_HANDLE sasTokenScope; /*hostName/devices/deviceId, kept from create_deviceSASObject*/
+    STRING_HANDLE sasTokenKeyName; /*zero length, kept from create_deviceSASObject*/
+    STRING_HANDLE cachedSasToken;
+    time_t cachedSasTokenCreationTime;
+    size_t sasTokensGenerated;
     bool DoWork_PullMessage;
     time_t lastPollTime;
     bool isFirstPoll;
+    unsigned int pollingInterval; /*seconds, only used with adaptive polling*/
+    bool isPollAfterEventDue;
+    IOTHUB_HTTP_POLL_STATISTICS pollStatistics;
 
     IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle;
     PDLIST_ENTRY waitingToSend;
@@ -299,12 +323,21 @@ static void destroy_SASObject(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
 {
     HTTPAPIEX_SAS_Destroy(handleData->sasObject);
     handleData->sasObject = NULL;
+    STRING_delete(handleData->sasTokenScope);
+    handleData->sasTokenScope = NULL;
+    STRING_delete(handleData->sasTokenKeyName);
+    handleData->sasTokenKeyName = NULL;
+    STRING_delete(handleData->cachedSasToken);
+    handleData->cachedSasToken = NULL;
 }
 
 static bool create_deviceSASObject(HTTPTRANSPORT_PERDEVICE_DATA* handleData, STRING_HANDLE hostName, const char * deviceId, const char * deviceKey)
 {
     STRING_HANDLE keyName;
     bool result;
+    handleData->sasTokenScope = NULL;
+    handleData->sasTokenKeyName = NULL;
+    handleData->cachedSasToken = NULL;
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_026: [IoTHubTransportHttp_Create shall invoke URL_EncodeString with an argument of device id.]*/
     keyName = URL_EncodeString(deviceId);
     if (keyName == NULL)
@@ -359,14 +392,31 @@ static bool create_deviceSASObject(HTTPTRANSPORT_PERDEVICE_DATA* handleData, STR
                 LogError("STRING_concat uri resource failed");
                 result = false;
             }
-            STRING_delete(uriResource);
+
+            if (result)
+            {
+                /*the cached SAS tokens are signed for the same scope and key name*/
+                handleData->sasTokenScope = uriResource;
+            }
+            else
+            {
+                STRING_delete(uriResource);
+            }
         }
         else
         {
             LogError("STRING_staticclone uri resource failed");
             result = false;
         }
-        STRING_delete(keyName);
+
+        if (result)
+        {
+            handleData->sasTokenKeyName = keyName;
+        }
+        else
+        {
+            STRING_delete(keyName);
+        }
     }
     return result;
 }
@@ -524,6 +574,9 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                     was_create_deviceSasToken_ok = create_deviceSasToken(result, device->deviceSasToken);
                     result->deviceKey = NULL;
                     result->sasObject = NULL;
+                    result->sasTokenScope = NULL;
+                    result->sasTokenKeyName = NULL;
+                    result->cachedSasToken = NULL;
                 }
                 else /*when deviceSasToken == NULL*/
                 {
@@ -551,6 +604,9 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
             if (was_x509_ok)
             {
                 result->sasObject = NULL; /**/
+                result->sasTokenScope = NULL;
+                result->sasTokenKeyName = NULL;
+                result->cachedSasToken = NULL;
                 was_sasObject_ok = true;
             }
             else
@@ -571,6 +627,10 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_128: [ IoTHubTransportHttp_Register shall mark this device as unsubscribed. ]*/
                 result->DoWork_PullMessage = false;
                 result->isFirstPoll = true;
+                result->pollingInterval = ADAPTIVE_POLLING_MINIMUM_INTERVAL;
+                result->sasTokensGenerated = 0;
+                result->isPollAfterEventDue = false;
+                (void)memset(&result->pollStatistics, 0, sizeof(result->pollStatistics));
                 result->iotHubClientHandle = iotHubClientHandle;
                 result->waitingToSend = waitingToSend;
                 DList_InitializeListHead(&(result->eventConfirmations));
@@ -813,6 +873,11 @@ static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONF
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]*/
                 result->doBatchedTransfers = false;
                 result->getMinimumPollingTime = DEFAULT_GETMINIMUMPOLLINGTIME;
+                result->doAdaptivePolling = false;
+                result->doBatchPreserveOrder = true;
+                result->sasTokenLifetime = DEFAULT_SAS_TOKEN_LIFETIME_MS;
+                result->sasTokenRefreshTime = DEFAULT_SAS_TOKEN_REFRESH_TIME_MS;
+                result->doPollAfterEvent = false;
             }
             else
             {
@@ -952,232 +1017,359 @@ static int IoTHubTransportHttp_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle
     return __FAILURE__;
 }
 
-/*produces a representation of the properties, if they exist*/
-/*if they do not exist, produces ""*/
-static int concat_Properties(STRING_HANDLE existing, MAP_HANDLE map, size_t* propertiesMessageSizeContribution)
+/*Codes_SRS_TRANSPORTMULTITHTTP_21_020: [ For a device authenticated with a device key, the SAS token shall be generated once and reused by every request until it is older than the "sas_token_refresh_time" option. ]*/
+static STRING_HANDLE getCachedSasToken(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
 {
-    int result;
-    const char*const* keys;
-    const char*const* values;
-    size_t count;
-    if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
+    time_t timeNow = get_time(NULL);
+    if (timeNow == (time_t)(-1))
     {
-        result = __FAILURE__;
-        LogError("error while Map_GetInternals");
+        /*no expiry can be computed without time, HTTPAPIEX_SAS deals with it*/
+        LogError("time is not available, the SAS token is not cached");
+        STRING_delete(deviceData->cachedSasToken);
+        deviceData->cachedSasToken = NULL;
+    }
+    else if ((deviceData->cachedSasToken == NULL) ||
+        (get_difftime(timeNow, deviceData->cachedSasTokenCreationTime) * 1000 >= (double)handleData->sasTokenRefreshTime))
+    {
+        size_t expiry = (size_t)get_difftime(timeNow, (time_t)0) + handleData->sasTokenLifetime / 1000;
+        STRING_HANDLE newToken = SASToken_Create(deviceData->deviceKey, deviceData->sasTokenScope, deviceData->sasTokenKeyName, expiry);
+        if (newToken == NULL)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_21_021: [ If a new token cannot be generated, the cached token shall be used while it has not expired, and the request shall be signed by HTTPAPIEX_SAS_ExecuteRequest otherwise. ]*/
+            LogError("unable to create a SAS token");
+            if ((deviceData->cachedSasToken != NULL) &&
+                (get_difftime(timeNow, deviceData->cachedSasTokenCreationTime) * 1000 >= (double)handleData->sasTokenLifetime))
+            {
+                STRING_delete(deviceData->cachedSasToken);
+                deviceData->cachedSasToken = NULL;
+            }
+        }
+        else
+        {
+            STRING_delete(deviceData->cachedSasToken);
+            deviceData->cachedSasToken = newToken;
+            deviceData->cachedSasTokenCreationTime = timeNow;
+            deviceData->sasTokensGenerated++;
+        }
+    }
+    return deviceData->cachedSasToken;
+}
+
+/*executes a request on the transport connection, authorizing it with the cached SAS token when the device has a key*/
+static HTTPAPIEX_RESULT executeDeviceRequest(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath,
+    HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    HTTPAPIEX_RESULT result;
+    STRING_HANDLE sasToken = (deviceData->sasObject == NULL) ? NULL : getCachedSasToken(handleData, deviceData);
+
+    if (sasToken == NULL)
+    {
+        /*x509 and user supplied SAS tokens have nothing to sign (sasObject is NULL)*/
+        result = HTTPAPIEX_SAS_ExecuteRequest(deviceData->sasObject, handleData->httpApiExHandle, requestType, relativePath, requestHttpHeadersHandle, requestContent, statusCode, responseHttpHeadersHandle, responseContent);
+    }
+    else if (HTTPHeaders_ReplaceHeaderNameValuePair(requestHttpHeadersHandle, "Authorization", STRING_c_str(sasToken)) != HTTP_HEADERS_OK)
+    {
+        LogError("unable to set the Authorization header");
+        result = HTTPAPIEX_ERROR;
     }
     else
     {
+        result = HTTPAPIEX_ExecuteRequest(handleData->httpApiExHandle, requestType, relativePath, requestHttpHeadersHandle, requestContent, statusCode, responseHttpHeadersHandle, responseContent);
+    }
+    return result;
+}
 
-        if (count == 0)
+static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
+{
+    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
+    DList_AppendTailList(destination->Flink, source);
+    DList_RemoveEntryList(source);
+    DList_InitializeListHead(source);
+}
+
+static const char base64char[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char hexToASCII[] = "0123456789ABCDEF";
+
+#define BODY_BEGIN "{\"body\":"
+#define BASE64_ENCODED_FALSE ",\"base64Encoded\":false"
+#define PROPERTIES_BEGIN ",\"properties\":{"
+#define ITEM_END "},"
+#define CONST_STRLEN(s) (sizeof(s) - 1)
+
+/*the event batch is written in two passes over waitingToSend: the first pass measures every item exactly and decides
+which items make it into the batch, the second pass writes them all into a single buffer allocated once. This avoids
+building (and re-copying) a STRING_HANDLE per item, per base64 encoding and per JSON escaping*/
+
+static size_t base64EncodedLength(size_t size)
+{
+    return ((size + 2) / 3) * 4;
+}
+
+static char* writeBase64(char* destination, const unsigned char* source, size_t size)
+{
+    size_t i;
+    for (i = 0; i + 3 <= size; i += 3)
+    {
+        *destination++ = base64char[source[i] >> 2];
+        *destination++ = base64char[((source[i] & 0x03) << 4) | (source[i + 1] >> 4)];
+        *destination++ = base64char[((source[i + 1] & 0x0F) << 2) | (source[i + 2] >> 6)];
+        *destination++ = base64char[source[i + 2] & 0x3F];
+    }
+    if (size - i == 1)
+    {
+        *destination++ = base64char[source[i] >> 2];
+        *destination++ = base64char[(source[i] & 0x03) << 4];
+        *destination++ = '=';
+        *destination++ = '=';
+    }
+    else if (size - i == 2)
+    {
+        *destination++ = base64char[source[i] >> 2];
+        *destination++ = base64char[((source[i] & 0x03) << 4) | (source[i + 1] >> 4)];
+        *destination++ = base64char[(source[i + 1] & 0x0F) << 2];
+        *destination++ = '=';
+    }
+    return destination;
+}
+
+/*length of source as a JSON string, quotes included, with the same escaping as STRING_new_JSON*/
+/*returns non-zero if source has characters STRING_new_JSON would refuse (anything above 127)*/
+static int measureJSONString(const char* source, size_t* length)
+{
+    int result = 0;
+    size_t i;
+    *length = 2;
+    for (i = 0; source[i] != '\0'; i++)
+    {
+        unsigned char c = (unsigned char)source[i];
+        if (c >= 128)
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_064: [If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload*/
-            /*no properties - do nothing with existing*/
-            result = 0;
-            *propertiesMessageSizeContribution = 0;
+            LogError("invalid character in input string");
+            result = __FAILURE__;
+            break;
+        }
+        else if (c <= 0x1F)
+        {
+            *length += 6;
+        }
+        else if ((c == '"') || (c == '\\') || (c == '/'))
+        {
+            *length += 2;
         }
         else
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_058: [If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*/
-            if (STRING_concat(existing, ",\"properties\":") != 0)
-            {
-                /*go ahead and return it*/
-                result = __FAILURE__;
-                LogError("failed STRING_concat");
-            }
-            else if (appendMapToJSON(existing, keys, values, count) != 0)
-            {
-                result = __FAILURE__;
-                LogError("unable to append the properties");
-            }
-            else
-            {
-                /*all is fine*/
-                size_t i;
-                *propertiesMessageSizeContribution = 0;
-                for (i = 0;i < count;i++)
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_063: [Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes.] */
-                    *propertiesMessageSizeContribution += (strlen(keys[i]) + strlen(values[i]) + MAXIMUM_PROPERTY_OVERHEAD);
-                }
-                result = 0;
-            }
+            *length += 1;
         }
     }
     return result;
 }
 
-/*produces a JSON representation of the map : {"a": "value_of_a","b":"value_of_b"}*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count) /*under consideration: move to MAP module when it has more than 1 user*/
+static char* writeJSONString(char* destination, const char* source)
+{
+    *destination++ = '"';
+    for (; *source != '\0'; source++)
+    {
+        unsigned char c = (unsigned char)*source;
+        if (c <= 0x1F)
+        {
+            *destination++ = '\\';
+            *destination++ = 'u';
+            *destination++ = '0';
+            *destination++ = '0';
+            *destination++ = hexToASCII[c >> 4];
+            *destination++ = hexToASCII[c & 0x0F];
+        }
+        else if ((c == '"') || (c == '\\') || (c == '/'))
+        {
+            *destination++ = '\\';
+            *destination++ = (char)c;
+        }
+        else
+        {
+            *destination++ = (char)c;
+        }
+    }
+    *destination++ = '"';
+    return destination;
+}
+
+static char* writeRaw(char* destination, const char* source, size_t length)
+{
+    (void)memcpy(destination, source, length);
+    return destination + length;
+}
+
+/*measures ,"properties":{"iothub-app-a":"valueOfA",...} - nothing when there are no properties*/
+static int measureProperties(MAP_HANDLE map, size_t* jsonLength)
 {
     int result;
-    if (STRING_concat(existing, "{") != 0)
+    const char*const* keys;
+    const char*const* values;
+    size_t count;
+    if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
     {
-        /*go on and return it*/
-        LogError("STRING_construct failed");
         result = __FAILURE__;
+        LogError("error while Map_GetInternals");
     }
     else
     {
         size_t i;
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_064: [If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload*/
+        *jsonLength = (count == 0) ? 0 : (CONST_STRLEN(PROPERTIES_BEGIN) + 1);
         for (i = 0; i < count; i++)
         {
-            if (!(
-                (STRING_concat(existing, (i == 0) ? "\"" IOTHUB_APP_PREFIX : ",\"" IOTHUB_APP_PREFIX) == 0) &&
-                (STRING_concat(existing, keys[i]) == 0) &&
-                (STRING_concat(existing, "\":\"") == 0) &&
-                (STRING_concat(existing, values[i]) == 0) &&
-                (STRING_concat(existing, "\"") == 0)
-                ))
-            {
-                LogError("unable to STRING_concat");
-                break;
-            }
+            /*"iothub-app-key":"value" preceded by a comma for all but the first one*/
+            *jsonLength += ((i == 0) ? 0 : 1) + 1 + CONST_STRLEN(IOTHUB_APP_PREFIX) + strlen(keys[i]) + 3 + strlen(values[i]) + 1;
         }
+        result = 0;
+    }
+    return result;
+}
 
-        if (i < count)
-        {
-            result = __FAILURE__;
-            /*error, let it go through*/
-        }
-        else if (STRING_concat(existing, "}") != 0)
-        {
-            LogError("unable to STRING_concat");
-            result = __FAILURE__;
-        }
-        else
+static char* writeProperties(char* destination, MAP_HANDLE map)
+{
+    const char*const* keys;
+    const char*const* values;
+    size_t count;
+    if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
+    {
+        LogError("error while Map_GetInternals");
+        destination = NULL;
+    }
+    else if (count > 0)
+    {
+        size_t i;
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_058: [If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*/
+        destination = writeRaw(destination, PROPERTIES_BEGIN, CONST_STRLEN(PROPERTIES_BEGIN));
+        for (i = 0; i < count; i++)
         {
-            /*all is fine*/
-            result = 0;
+            if (i > 0)
+            {
+                *destination++ = ',';
+            }
+            *destination++ = '"';
+            destination = writeRaw(destination, IOTHUB_APP_PREFIX, CONST_STRLEN(IOTHUB_APP_PREFIX));
+            destination = writeRaw(destination, keys[i], strlen(keys[i]));
+            destination = writeRaw(destination, "\":\"", 3);
+            destination = writeRaw(destination, values[i], strlen(values[i]));
+            *destination++ = '"';
         }
+        *destination++ = '}';
     }
-    return result;
+    return destination;
 }
 
-/*makes the following string:{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-/*return NULL if there was a failure, or a non-NULL STRING_HANDLE that contains the intended data*/
-static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeContribution)
+/*measures {"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}, including the trailing comma*/
+/*the trailing comma of the last item is replaced by the closing ']' of the batch*/
+static int measure1EventJSONitem(IOTHUB_MESSAGE_LIST* message, size_t* jsonLength)
 {
-    STRING_HANDLE result; /*temp wants to contain :{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-    IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
+    int result;
+    size_t propertiesJSONLength;
     IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message->messageHandle);
 
     switch (contentType)
     {
     case IOTHUBMESSAGE_BYTEARRAY:
     {
-        result = STRING_construct("{\"body\":\"");
-        if (result == NULL)
+        const unsigned char* source;
+        size_t size;
+        if (IoTHubMessage_GetByteArray(message->messageHandle, &source, &size) != IOTHUB_MESSAGE_OK)
+        {
+            LogError("unable to get the data for the message.");
+            result = __FAILURE__;
+        }
+        else if (measureProperties(IoTHubMessage_Properties(message->messageHandle), &propertiesJSONLength) != 0)
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to measure the message properties");
+            result = __FAILURE__;
         }
         else
         {
-            const unsigned char* source;
-            size_t size;
-
-            if (IoTHubMessage_GetByteArray(message->messageHandle, &source, &size) != IOTHUB_MESSAGE_OK)
-            {
-                LogError("unable to get the data for the message.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            else
-            {
-                STRING_HANDLE encoded = Base64_Encode_Bytes(source, size);
-                if (encoded == NULL)
-                {
-                    LogError("unable to Base64_Encode_Bytes.");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
-                {
-                    size_t propertiesSize;
-                    if (!(
-                        (STRING_concat_with_STRING(result, encoded) == 0) &&
-                        (STRING_concat(result, "\"") == 0) && /*\" because closing value*/
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        STRING_delete(result);
-                        result = NULL;
-                        LogError("unable to STRING_concat_with_STRING.");
-                    }
-                    else
-                    {
-                        /*all is fine... */
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = size + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(encoded);
-                }
-            }
+            *jsonLength = CONST_STRLEN(BODY_BEGIN) + 2 + base64EncodedLength(size) + propertiesJSONLength + CONST_STRLEN(ITEM_END);
+            result = 0;
         }
         break;
     }
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_057: [If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false}] */
     case IOTHUBMESSAGE_STRING:
     {
-        result = STRING_construct("{\"body\":");
-        if (result == NULL)
+        const char* source = IoTHubMessage_GetString(message->messageHandle);
+        size_t bodyLength;
+        if (source == NULL)
+        {
+            LogError("unable to IoTHubMessage_GetString");
+            result = __FAILURE__;
+        }
+        else if (measureJSONString(source, &bodyLength) != 0)
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to encode the message as a JSON string");
+            result = __FAILURE__;
+        }
+        else if (measureProperties(IoTHubMessage_Properties(message->messageHandle), &propertiesJSONLength) != 0)
+        {
+            LogError("unable to measure the message properties");
+            result = __FAILURE__;
         }
         else
         {
-            const char* source = IoTHubMessage_GetString(message->messageHandle);
-            if (source == NULL)
-            {
-                LogError("unable to IoTHubMessage_GetString");
-                STRING_delete(result);
-                result = NULL;
-            }
-            else
-            {
-                STRING_HANDLE asJson = STRING_new_JSON(source);
-                if (asJson == NULL)
-                {
-                    LogError("unable to STRING_new_JSON");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
-                {
-                    size_t propertiesSize;
-                    if (!(
-                        (STRING_concat_with_STRING(result, asJson) == 0) &&
-                        (STRING_concat(result, ",\"base64Encoded\":false") == 0) &&
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        LogError("unable to STRING_concat_with_STRING");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        /*result has the intended content*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = strlen(source) + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(asJson);
-                }
-            }
+            *jsonLength = CONST_STRLEN(BODY_BEGIN) + bodyLength + CONST_STRLEN(BASE64_ENCODED_FALSE) + propertiesJSONLength + CONST_STRLEN(ITEM_END);
+            result = 0;
         }
         break;
     }
     default:
     {
         LogError("an unknown message type was encountered (%d)", contentType);
-        result = NULL; /*unknown message type*/
+        result = __FAILURE__; /*unknown message type*/
         break;
     }
     }
     return result;
 }
 
+/*writes exactly the bytes measured by measure1EventJSONitem, returns the position after them or NULL on failure*/
+static char* write1EventJSONitem(IOTHUB_MESSAGE_LIST* message, char* destination)
+{
+    destination = writeRaw(destination, BODY_BEGIN, CONST_STRLEN(BODY_BEGIN));
+    if (IoTHubMessage_GetContentType(message->messageHandle) == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        const unsigned char* source;
+        size_t size;
+        if (IoTHubMessage_GetByteArray(message->messageHandle, &source, &size) != IOTHUB_MESSAGE_OK)
+        {
+            LogError("unable to get the data for the message.");
+            destination = NULL;
+        }
+        else
+        {
+            *destination++ = '"';
+            destination = writeBase64(destination, source, size);
+            *destination++ = '"';
+        }
+    }
+    else
+    {
+        const char* source = IoTHubMessage_GetString(message->messageHandle);
+        if (source == NULL)
+        {
+            LogError("unable to IoTHubMessage_GetString");
+            destination = NULL;
+        }
+        else
+        {
+            destination = writeJSONString(destination, source);
+            destination = writeRaw(destination, BASE64_ENCODED_FALSE, CONST_STRLEN(BASE64_ENCODED_FALSE));
+        }
+    }
+
+    if ((destination != NULL) &&
+        ((destination = writeProperties(destination, IoTHubMessage_Properties(message->messageHandle))) != NULL))
+    {
+        destination = writeRaw(destination, ITEM_END, CONST_STRLEN(ITEM_END));
+    }
+    return destination;
+}
+
 #define MAKE_PAYLOAD_RESULT_VALUES \
     MAKE_PAYLOAD_OK, /*returned when there is a payload to be later send by HTTP*/ \
     MAKE_PAYLOAD_NO_ITEMS, /*returned when there are no items to be send*/ \
@@ -1186,133 +1378,117 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
 
 DEFINE_ENUM(MAKE_PAYLOAD_RESULT, MAKE_PAYLOAD_RESULT_VALUES);
 
+/*the smallest possible item, {"body":""}, used to stop looking ahead once the batch is full*/
+#define MINIMUM_ITEM_LENGTH (CONST_STRLEN(BODY_BEGIN) + 2 + CONST_STRLEN(ITEM_END))
+
 /*this function assembles several {"body":"base64 encoding of the message content"," base64Encoded": true} into 1 payload*/
 /*Codes_SRS_TRANSPORTMULTITHTTP_17_056: [IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...]]*/
-static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, STRING_HANDLE* payload)
+static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, BUFFER_HANDLE* payload)
 {
     MAKE_PAYLOAD_RESULT result;
-    size_t allMessagesSize = 0;
-    *payload = STRING_construct("[");
-    if (*payload == NULL)
-    {
-        LogError("unable to STRING_construct");
-        result = MAKE_PAYLOAD_ERROR;
-    }
-    else
+    size_t payloadLength = 1; /*the opening '['; the last item's trailing ',' becomes the closing ']'*/
+    size_t itemCount = 0;
+    size_t skippedCount = 0;
+    PDLIST_ENTRY actual = deviceData->waitingToSend->Flink;
+
+    *payload = NULL;
+    result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
+
+    /*first pass: move the items that make it into the batch to eventConfirmations, in order, adding up exactly how many bytes they need*/
+    while ((actual != deviceData->waitingToSend) && (payloadLength + MINIMUM_ITEM_LENGTH <= MAXIMUM_MESSAGE_SIZE))
     {
-        bool isFirst = true;
-        PDLIST_ENTRY actual;
-        bool keepGoing = true; /*keepGoing gets sometimes to false from within the loop*/
-                               /*either all the items enter the list or only some*/
-        result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
-        while (keepGoing && ((actual = deviceData->waitingToSend->Flink) != deviceData->waitingToSend))
+        PDLIST_ENTRY next = actual->Flink;
+        size_t jsonLength;
+        if (measure1EventJSONitem(containingRecord(actual, IOTHUB_MESSAGE_LIST, entry), &jsonLength) != 0)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
+            result = (itemCount == 0) ? MAKE_PAYLOAD_ERROR : MAKE_PAYLOAD_OK;
+            break;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
+        /*Codes_SRS_TRANSPORTMULTITHTTP_21_018: [ The size of a batch shall be the exact length of its encoded payload, base64 and JSON escaping included. ]*/
+        else if (payloadLength + jsonLength > MAXIMUM_MESSAGE_SIZE)
         {
-            size_t messageSize;
-            STRING_HANDLE temp = make1EventJSONitem(actual, &messageSize);
-            if (isFirst)
+            if ((itemCount == 0) && (skippedCount == 0))
             {
-                isFirst = false;
-                /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                if (temp == NULL) /*first item failed to create, nothing to send*/
-                {
-                    result = MAKE_PAYLOAD_ERROR;
-                    STRING_delete(*payload);
-                    *payload = NULL;
-                    keepGoing = false;
-                }
-                else
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
-                    if (messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
-                        STRING_delete(*payload);
-                        *payload = NULL;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        if (STRING_concat_with_STRING(*payload, temp) != 0)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            result = MAKE_PAYLOAD_ERROR;
-                            STRING_delete(*payload);
-                            *payload = NULL;
-                            keepGoing = false;
-                        }
-                        else
-                        {
-                            /*first item was put nicely in the payload*/
-                            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                            DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                            allMessagesSize += messageSize;
-                        }
-                    }
-                    STRING_delete(temp);
-                }
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
+                PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
+                break;
             }
-            else
+            /*Codes_SRS_TRANSPORTMULTITHTTP_21_019: [ If option "BatchPreserveOrder" is false, items that do not fit shall stay in waitingToSend and the following items shall be tried, up to 16 skipped items. ]*/
+            else if (handleData->doBatchPreserveOrder || (++skippedCount > MAXIMUM_BATCH_LOOK_AHEAD))
             {
-                /*there is at least 1 item already in the payload*/
-                if (temp == NULL)
-                {
-                    /*there are multiple payloads encoded, the last one had an internal error, just go with those - closing the payload happens "after the loop"*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                    result = MAKE_PAYLOAD_OK;
-                    keepGoing = false;
-                }
-                else
-                {
-                    if (allMessagesSize + messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        /*this item doesn't make it to the payload, but the payload is valid so far*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else if (STRING_concat_with_STRING(*payload, temp) != 0)
-                    {
-                        /*should still send what there is so far...*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        /*cool, the payload made it there, let's continue... */
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        allMessagesSize += messageSize;
-                    }
-                    STRING_delete(temp);
-                }
+                /*this item doesn't make it to the payload, but the payload is valid so far*/
+                break;
             }
         }
+        else
+        {
+            (void)DList_RemoveEntryList(actual);
+            DList_InsertTailList(&(deviceData->eventConfirmations), actual);
+            payloadLength += jsonLength;
+            itemCount++;
+        }
+        actual = next;
+    }
 
-        /*closing the payload*/
-        if (result == MAKE_PAYLOAD_OK)
+    if ((result == MAKE_PAYLOAD_OK) && (itemCount == 0))
+    {
+        /*an oldest item that does not fit is handled above, so this only happens when waitingToSend is empty*/
+        result = MAKE_PAYLOAD_NO_ITEMS;
+    }
+    else if (result == MAKE_PAYLOAD_OK)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_21_001: [ The batch payload shall be allocated once, at its exact final size, and every item shall be encoded directly into it. ]*/
+        if ((*payload = BUFFER_new()) == NULL)
+        {
+            LogError("unable to BUFFER_new");
+            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+            result = MAKE_PAYLOAD_ERROR;
+        }
+        else if (BUFFER_pre_build(*payload, payloadLength) != 0)
         {
-            ((char*)STRING_c_str(*payload))[STRING_length(*payload) - 1] = ']'; /*TODO - do this in STRING_HANDLE*/
+            LogError("unable to BUFFER_pre_build");
+            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+            BUFFER_delete(*payload);
+            *payload = NULL;
+            result = MAKE_PAYLOAD_ERROR;
         }
         else
         {
-            /*no need to close anything*/
+            /*second pass: encode the items selected above*/
+            char* destination = (char*)BUFFER_u_char(*payload);
+            *destination++ = '[';
+            for (actual = deviceData->eventConfirmations.Flink; actual != &(deviceData->eventConfirmations); actual = actual->Flink)
+            {
+                if ((destination = write1EventJSONitem(containingRecord(actual, IOTHUB_MESSAGE_LIST, entry), destination)) == NULL)
+                {
+                    break;
+                }
+            }
+
+            if (destination == NULL)
+            {
+                /*the items that were measured successfully cannot fail here, unless the message changed in between*/
+                LogError("unable to encode the batched messages");
+                reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                BUFFER_delete(*payload);
+                *payload = NULL;
+                result = MAKE_PAYLOAD_ERROR;
+            }
+            else
+            {
+                /*closing the payload*/
+                destination[-1] = ']';
+            }
         }
     }
     return result;
 }
 
-static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
-{
-    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
-    DList_AppendTailList(destination->Flink, source);
-    DList_RemoveEntryList(source);
-    DList_InitializeListHead(source);
-}
-
 static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
 
@@ -1334,67 +1510,48 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
             else
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_059: [It shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                STRING_HANDLE payload;
-                switch (makePayload(deviceData, &payload))
+                BUFFER_HANDLE payload;
+                switch (makePayload(handleData, deviceData, &payload))
                 {
                 case MAKE_PAYLOAD_OK:
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_068: [Once a final payload has been obtained, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters:] */
-                    BUFFER_HANDLE temp = BUFFER_new();
-                    if (temp == NULL)
+                    unsigned int statusCode;
+                    if (executeDeviceRequest(
+                        handleData,
+                        deviceData,
+                        HTTPAPI_REQUEST_POST,
+                        STRING_c_str(deviceData->eventHTTPrelativePath),
+                        deviceData->eventHTTPrequestHeaders,
+                        payload,
+                        &statusCode,
+                        NULL,
+                        NULL
+                        ) != HTTPAPIEX_OK)
                     {
-                        LogError("unable to BUFFER_new");
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+                        LogError("unable to HTTPAPIEX_ExecuteRequest");
+                        //items go back to waitingToSend
+                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
                         reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                     }
                     else
                     {
-                        if (BUFFER_build(temp, (const unsigned char*)STRING_c_str(payload), STRING_length(payload)) != 0)
+                        if (statusCode < 300)
                         {
-                            LogError("unable to BUFFER_build");
-                            //items go back to waitingToSend
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
+                            IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK);
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_21_014: [ If option "PollAfterEvent" is true, every successful event POST shall allow the next GET regardless of the polling interval. ]*/
+                            deviceData->isPollAfterEventDue = handleData->doPollAfterEvent;
                         }
                         else
                         {
-                            unsigned int statusCode;
-                            if (HTTPAPIEX_SAS_ExecuteRequest(
-                                deviceData->sasObject,
-                                handleData->httpApiExHandle,
-                                HTTPAPI_REQUEST_POST,
-                                STRING_c_str(deviceData->eventHTTPrelativePath),
-                                deviceData->eventHTTPrequestHeaders,
-                                temp,
-                                &statusCode,
-                                NULL,
-                                NULL
-                                ) != HTTPAPIEX_OK)
-                            {
-                                LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                //items go back to waitingToSend
-                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                            }
-                            else
-                            {
-                                if (statusCode < 300)
-                                {
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
-                                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK);
-                                }
-                                else
-                                {
-                                    //items go back to waitingToSend
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                    LogError("unexpected HTTP status code (%u)", statusCode);
-                                    reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                                }
-                            }
+                            //items go back to waitingToSend
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
+                            LogError("unexpected HTTP status code (%u)", statusCode);
+                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                         }
-                        BUFFER_delete(temp);
                     }
-                    STRING_delete(payload);
+                    BUFFER_delete(payload);
                     break;
                 }
                 case MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT:
@@ -1605,9 +1762,9 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                             else
                                             {
                                                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_080: [If a deviceSasToken does not exist, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters] */
-                                                if ((r = HTTPAPIEX_SAS_ExecuteRequest(
-                                                    deviceData->sasObject,
-                                                    handleData->httpApiExHandle,
+                                                if ((r = executeDeviceRequest(
+                                                    handleData,
+                                                    deviceData,
                                                     HTTPAPI_REQUEST_POST,
                                                     STRING_c_str(deviceData->eventHTTPrelativePath),
                                                     clonedEventHTTPrequestHeaders,
@@ -1628,6 +1785,8 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                                     PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
                                                     DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
                                                     IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK); /*takes care of emptying the list too*/
+                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_21_014: [ If option "PollAfterEvent" is true, every successful event POST shall allow the next GET regardless of the polling interval. ]*/
+                                                    deviceData->isPollAfterEventDue = handleData->doPollAfterEvent;
                                                 }
                                                 else
                                                 {
@@ -1771,9 +1930,9 @@ static void abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                                 LogError("Unable to HTTPAPIEX_ExecuteRequest.");
                             }
                         }
-                        else if ((r = HTTPAPIEX_SAS_ExecuteRequest(
-                            deviceData->sasObject,
-                            handleData->httpApiExHandle,
+                        else if ((r = executeDeviceRequest(
+                            handleData,
+                            deviceData,
                             (action == ABANDON) ? HTTPAPI_REQUEST_POST : HTTPAPI_REQUEST_DELETE,                               /*-requestType: POST                                                                                                       */
                             STRING_c_str(fullAbandonRelativePath),              /*-relativePath: abandon relative path begin (as created by _Create) + value of ETag + "/abandon?api-version=2016-11-14"   */
                             abandonRequestHttpHeaders,                          /*- requestHttpHeadersHandle: an HTTP headers instance containing the following                                            */
@@ -1815,6 +1974,29 @@ static void abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
     }
 }
 
+static unsigned int getPollingInterval(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    return handleData->doAdaptivePolling ? deviceData->pollingInterval : handleData->getMinimumPollingTime;
+}
+
+/*Codes_SRS_TRANSPORTMULTITHTTP_21_012: [ With adaptive polling, a GET that returns a message shall bring the polling interval down to 2 seconds (or getMinimumPollingTime if smaller). ]*/
+/*Codes_SRS_TRANSPORTMULTITHTTP_21_013: [ With adaptive polling, a GET that returns no message shall double the polling interval, up to getMinimumPollingTime. ]*/
+static void adaptPollingInterval(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, bool messageReceived)
+{
+    if (messageReceived || (deviceData->pollingInterval > handleData->getMinimumPollingTime / 2))
+    {
+        deviceData->pollingInterval = messageReceived ? ADAPTIVE_POLLING_MINIMUM_INTERVAL : handleData->getMinimumPollingTime;
+        if (deviceData->pollingInterval > handleData->getMinimumPollingTime)
+        {
+            deviceData->pollingInterval = handleData->getMinimumPollingTime;
+        }
+    }
+    else
+    {
+        deviceData->pollingInterval *= 2;
+    }
+}
+
 static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_083: [ If device is not subscribed then _DoWork shall advance to the next action. ] */
@@ -1823,10 +2005,17 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_123: [After client creation, the first GET shall be allowed no matter what the value of GetMinimumPollingTime.] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_124: [If time is not available then all calls shall be treated as if they are the first one.] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_122: [A GET request that happens earlier than GetMinimumPollingTime shall be ignored.] */
+        /*Codes_SRS_TRANSPORTMULTITHTTP_21_011: [ If option "AdaptivePolling" is true, the polling interval shall be the per device adaptive interval instead of getMinimumPollingTime. ]*/
         time_t timeNow = get_time(NULL);
-        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > handleData->getMinimumPollingTime);
+        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || deviceData->isPollAfterEventDue || (get_difftime(timeNow, deviceData->lastPollTime) > getPollingInterval(handleData, deviceData));
         if (isPollingAllowed)
         {
+            if (deviceData->isPollAfterEventDue)
+            {
+                deviceData->isPollAfterEventDue = false;
+                deviceData->pollStatistics.pollsAfterEvent++;
+            }
+
             HTTP_HEADERS_HANDLE responseHTTPHeaders = HTTPHeaders_Alloc();
             if (responseHTTPHeaders == NULL)
             {
@@ -1879,9 +2068,9 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                     responseHeadearsHandle: a new instance of HTTP headers
                     responseContent: a new instance of buffer]
                     */
-                    else if ((r = HTTPAPIEX_SAS_ExecuteRequest(
-                        deviceData->sasObject,
-                        handleData->httpApiExHandle,
+                    else if ((r = executeDeviceRequest(
+                        handleData,
+                        deviceData,
                         HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
                         STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
                         deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
@@ -1906,6 +2095,20 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                             deviceData->isFirstPoll = false;
                             deviceData->lastPollTime = timeNow;
                         }
+                        deviceData->pollStatistics.polls++;
+                        if (statusCode == 200)
+                        {
+                            deviceData->pollStatistics.messagesReceived++;
+                        }
+                        else if (statusCode == 204)
+                        {
+                            deviceData->pollStatistics.emptyPolls++;
+                        }
+                        if (handleData->doAdaptivePolling && ((statusCode == 200) || (statusCode == 204)))
+                        {
+                            adaptPollingInterval(handleData, deviceData, (statusCode == 200));
+                        }
+
                         if (statusCode == 204)
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
@@ -2090,7 +2293,6 @@ static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
             HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
             DoEvent(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
             DoMessages(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
-
         }
     }
     else
@@ -2175,6 +2377,54 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             handleData->getMinimumPollingTime = *(unsigned int*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_21_019: [ "BatchPreserveOrder" ]*/
+        else if (strcmp(OPTION_BATCH_PRESERVE_ORDER, option) == 0)
+        {
+            handleData->doBatchPreserveOrder = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_21_022: [ "sas_token_lifetime" ]*/
+        else if (strcmp(OPTION_SAS_TOKEN_LIFETIME, option) == 0)
+        {
+            if (*(size_t*)value <= handleData->sasTokenRefreshTime)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_21_026: [ If the SAS token refresh time would be 0 or not shorter than the SAS token lifetime, IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG and keep both values. ]*/
+                LogError("sas_token_lifetime (%lu) shall be longer than sas_token_refresh_time (%lu)", (unsigned long)*(size_t*)value, (unsigned long)handleData->sasTokenRefreshTime);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                handleData->sasTokenLifetime = *(size_t*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_21_022: [ "sas_token_refresh_time" ]*/
+        else if (strcmp(OPTION_SAS_TOKEN_REFRESH_TIME, option) == 0)
+        {
+            if ((*(size_t*)value == 0) || (*(size_t*)value >= handleData->sasTokenLifetime))
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_21_026: [ If the SAS token refresh time would be 0 or not shorter than the SAS token lifetime, IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG and keep both values. ]*/
+                LogError("sas_token_refresh_time (%lu) shall be between 1 and sas_token_lifetime (%lu) excluded", (unsigned long)*(size_t*)value, (unsigned long)handleData->sasTokenLifetime);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                handleData->sasTokenRefreshTime = *(size_t*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_21_011: [ "AdaptivePolling" ]*/
+        else if (strcmp(OPTION_ADAPTIVE_POLLING, option) == 0)
+        {
+            handleData->doAdaptivePolling = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_21_014: [ "PollAfterEvent" ]*/
+        else if (strcmp(OPTION_POLL_AFTER_EVENT, option) == 0)
+        {
+            handleData->doPollAfterEvent = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
         else
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_126: [ "TrustedCerts"] */
@@ -2233,6 +2483,70 @@ static int IoTHubTransportHttp_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetPollStatistics(TRANSPORT_LL_HANDLE handle, const char* deviceId, IOTHUB_HTTP_POLL_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((handle == NULL) || (deviceId == NULL) || (statistics == NULL))
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_21_015: [ If handle, deviceId or statistics is NULL, IoTHubTransportHttp_GetPollStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("invalid arg (handle=%p, deviceId=%p, statistics=%p)", handle, deviceId, statistics);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
+        IOTHUB_DEVICE_HANDLE* listItem = (IOTHUB_DEVICE_HANDLE*)VECTOR_find_if(handleData->perDeviceList, findDeviceById, deviceId);
+        if (listItem == NULL)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_21_016: [ If no device with deviceId is registered, IoTHubTransportHttp_GetPollStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+            LogError("device [%s] is not registered with this transport", deviceId);
+            result = IOTHUB_CLIENT_INVALID_ARG;
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_21_017: [ Otherwise IoTHubTransportHttp_GetPollStatistics shall copy the poll counters of the device and its current polling interval into statistics and return IOTHUB_CLIENT_OK. ]*/
+            HTTPTRANSPORT_PERDEVICE_DATA* deviceData = (HTTPTRANSPORT_PERDEVICE_DATA*)(*listItem);
+            *statistics = deviceData->pollStatistics;
+            statistics->pollingInterval = getPollingInterval(handleData, deviceData);
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetSasTokenCount(TRANSPORT_LL_HANDLE handle, const char* deviceId, size_t* generatedCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((handle == NULL) || (deviceId == NULL) || (generatedCount == NULL))
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_21_023: [ If handle, deviceId or generatedCount is NULL, IoTHubTransportHttp_GetSasTokenCount shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        LogError("invalid arg (handle=%p, deviceId=%p, generatedCount=%p)", handle, deviceId, generatedCount);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
+        IOTHUB_DEVICE_HANDLE* listItem = (IOTHUB_DEVICE_HANDLE*)VECTOR_find_if(handleData->perDeviceList, findDeviceById, deviceId);
+        if (listItem == NULL)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_21_024: [ If no device with deviceId is registered, IoTHubTransportHttp_GetSasTokenCount shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+            LogError("device [%s] is not registered with this transport", deviceId);
+            result = IOTHUB_CLIENT_INVALID_ARG;
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_21_025: [ Otherwise IoTHubTransportHttp_GetSasTokenCount shall set generatedCount to the number of SAS tokens generated for the device and return IOTHUB_CLIENT_OK. ]*/
+            *generatedCount = ((HTTPTRANSPORT_PERDEVICE_DATA*)(*listItem))->sasTokensGenerated;
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
 /*Codes_SRS_TRANSPORTMULTITHTTP_17_125: [This function shall return a pointer to a structure of type TRANSPORT_PROVIDER having the following values for its fields:] */
 static TRANSPORT_PROVIDER thisTransportProvider =
 {
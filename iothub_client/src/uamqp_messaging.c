@@ -1,8 +1,12 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include "uamqp_messaging.h"
 #include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_uamqp_c/message.h"
 #include "azure_uamqp_c/amqpvalue.h"
@@ -11,6 +15,17 @@
 #define RESULT_OK 0
 #endif
 
+#define AMQP_DATA_SECTION_DESCRIPTOR_CODE  0x75
+#define AMQP_DATA_SECTION_DESCRIPTOR_SIZE  3
+#define AMQP_VBIN8_HEADER_SIZE             2
+#define AMQP_VBIN32_HEADER_SIZE            5
+
+typedef struct ENCODED_SECTIONS_TAG
+{
+	unsigned char* bytes;
+	size_t length;
+} ENCODED_SECTIONS;
+
 static int addPropertiesTouAMQPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, MESSAGE_HANDLE uamqp_message)
 {
 	int result = RESULT_OK;
@@ -390,7 +405,7 @@ static int readApplicationPropertiesFromuAMQPMessage(IOTHUB_MESSAGE_HANDLE iothu
 	return result;
 }
 
-int IoTHubMessage_CreateFromUamqpMessage(MESSAGE_HANDLE uamqp_message, IOTHUB_MESSAGE_HANDLE* iothubclient_message)
+static int create_iothub_message_from_uamqp_message(MESSAGE_HANDLE uamqp_message, bool as_view, IOTHUB_MESSAGE_HANDLE* iothubclient_message)
 {
 	int result = __FAILURE__;
 
@@ -418,7 +433,10 @@ int IoTHubMessage_CreateFromUamqpMessage(MESSAGE_HANDLE uamqp_message, IOTHUB_ME
 				result = __FAILURE__;
 			}
 			// Codes_SRS_UAMQP_MESSAGING_09_006: [The IOTHUB_MESSAGE instance shall be created using IoTHubMessage_CreateFromByteArray(), passing the uAMQP body bytes as parameter.]
-			else if ((iothub_message = IoTHubMessage_CreateFromByteArray(binary_data.bytes, binary_data.length)) == NULL)
+			// Codes_SRS_UAMQP_MESSAGING_09_120: [IoTHubMessage_CreateViewFromUamqpMessage shall create the IOTHUB_MESSAGE instance using IoTHubMessage_CreateFromByteArrayView(), referencing the uAMQP body bytes instead of copying them.]
+			else if ((iothub_message = (as_view ?
+				IoTHubMessage_CreateFromByteArrayView(binary_data.bytes, binary_data.length) :
+				IoTHubMessage_CreateFromByteArray(binary_data.bytes, binary_data.length))) == NULL)
 			{
 				// Codes_SRS_UAMQP_MESSAGING_09_007: [If IoTHubMessage_CreateFromByteArray() fails, IoTHubMessage_CreateFromuAMQPMessage shall fail and return immediately.]
 				LogError("Failed creating the IOTHUB_MESSAGE_HANDLE instance (IoTHubMessage_CreateFromByteArray failed).");
@@ -451,14 +469,24 @@ int IoTHubMessage_CreateFromUamqpMessage(MESSAGE_HANDLE uamqp_message, IOTHUB_ME
 	return result;
 }
 
-int message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MESSAGE_HANDLE* uamqp_message)
+int IoTHubMessage_CreateFromUamqpMessage(MESSAGE_HANDLE uamqp_message, IOTHUB_MESSAGE_HANDLE* iothubclient_message)
 {
-	int result = __FAILURE__;
+	return create_iothub_message_from_uamqp_message(uamqp_message, false, iothubclient_message);
+}
+
+int IoTHubMessage_CreateViewFromUamqpMessage(MESSAGE_HANDLE uamqp_message, IOTHUB_MESSAGE_HANDLE* iothubclient_message)
+{
+	// Codes_SRS_UAMQP_MESSAGING_09_119: [IoTHubMessage_CreateViewFromUamqpMessage shall read the uAMQP message exactly as IoTHubMessage_CreateFromUamqpMessage does, except for how the body is stored.]
+	return create_iothub_message_from_uamqp_message(uamqp_message, true, iothubclient_message);
+}
+
+static int get_message_content(IOTHUB_MESSAGE_HANDLE iothub_message, const unsigned char** content, size_t* content_size)
+{
+	int result;
 	// Codes_SRS_UAMQP_MESSAGING_09_047: [The content type of the IOTHUB_MESSAGE_HANDLE instance shall be obtained using IoTHubMessage_GetContentType().]
 	IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(iothub_message);
 	const char* messageContent = NULL;
 	size_t messageContentSize = 0;
-	MESSAGE_HANDLE uamqp_message_tmp = NULL;
 
 	// Codes_SRS_UAMQP_MESSAGING_09_048: [If the content type of the IOTHUB_MESSAGE_HANDLE instance is IOTHUBMESSAGE_BYTEARRAY, the content shall be obtained using IoTHubMessage_GetByteArray().]
 	if (contentType == IOTHUBMESSAGE_BYTEARRAY &&
@@ -482,6 +510,33 @@ int message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MES
 		LogError("Cannot parse IOTHUB_MESSAGE_HANDLE with content type IOTHUBMESSAGE_UNKNOWN.");
 		result = __FAILURE__;
 	}
+	else
+	{
+		if (contentType == IOTHUBMESSAGE_STRING)
+		{
+			messageContentSize = strlen(messageContent);
+		}
+
+		*content = (const unsigned char*)messageContent;
+		*content_size = messageContentSize;
+		result = RESULT_OK;
+	}
+
+	return result;
+}
+
+int message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MESSAGE_HANDLE* uamqp_message)
+{
+	int result = __FAILURE__;
+	const unsigned char* messageContent = NULL;
+	size_t messageContentSize = 0;
+	MESSAGE_HANDLE uamqp_message_tmp = NULL;
+
+	if (get_message_content(iothub_message, &messageContent, &messageContentSize) != RESULT_OK)
+	{
+		LogError("Failed getting the content of the IOTHUB_MESSAGE_HANDLE instance.");
+		result = __FAILURE__;
+	}
 	// Codes_SRS_UAMQP_MESSAGING_09_053: [A uAMQP MESSAGE_HANDLE shall be created using message_create().]
 	else if ((uamqp_message_tmp = message_create()) == NULL)
 	{
@@ -494,12 +549,7 @@ int message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MES
 		// Codes_SRS_UAMQP_MESSAGING_09_055: [The IOTHUB_MESSAGE instance content bytes and size shall be stored on a BINARY_DATA structure.]
 		BINARY_DATA binary_data;
 
-		if (contentType == IOTHUBMESSAGE_STRING)
-		{
-			messageContentSize = strlen(messageContent);
-		}
-
-		binary_data.bytes = (const unsigned char *)messageContent;
+		binary_data.bytes = messageContent;
 		binary_data.length = messageContentSize;
 
 		// Codes_SRS_UAMQP_MESSAGING_09_056: [The BINARY_DATA instance shall be set as the uAMQP message body using message_add_body_amqp_data().]
@@ -535,3 +585,243 @@ int message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_message, MES
 
 	return result;
 }
+
+static int encode_callback(void* context, const unsigned char* bytes, size_t length)
+{
+	ENCODED_SECTIONS* encoded_sections = (ENCODED_SECTIONS*)context;
+	(void)memcpy(encoded_sections->bytes + encoded_sections->length, bytes, length);
+	encoded_sections->length += length;
+	return RESULT_OK;
+}
+
+static int create_message_sections(MESSAGE_HANDLE uamqp_message, AMQP_VALUE* sections, size_t* section_count)
+{
+	int result;
+	PROPERTIES_HANDLE uamqp_message_properties = NULL;
+	AMQP_VALUE uamqp_app_properties = NULL;
+
+	*section_count = 0;
+
+	// Codes_SRS_UAMQP_MESSAGING_09_103: [The properties of the uAMQP message shall be encoded as a properties section, using message_get_properties() and amqpvalue_create_properties()]
+	if (message_get_properties(uamqp_message, &uamqp_message_properties) != 0)
+	{
+		LogError("Failed getting the properties of the uAMQP message.");
+		result = __FAILURE__;
+	}
+	else if (uamqp_message_properties != NULL &&
+		(sections[(*section_count)++] = amqpvalue_create_properties(uamqp_message_properties)) == NULL)
+	{
+		LogError("Failed creating the properties section of the uAMQP message.");
+		result = __FAILURE__;
+	}
+	// Codes_SRS_UAMQP_MESSAGING_09_104: [The application properties of the uAMQP message, if any, shall be encoded as an application-properties section, using message_get_application_properties() and amqpvalue_create_application_properties()]
+	else if (message_get_application_properties(uamqp_message, &uamqp_app_properties) != 0)
+	{
+		LogError("Failed getting the application properties of the uAMQP message.");
+		result = __FAILURE__;
+	}
+	else if (uamqp_app_properties != NULL &&
+		(sections[(*section_count)++] = amqpvalue_create_application_properties(uamqp_app_properties)) == NULL)
+	{
+		LogError("Failed creating the application-properties section of the uAMQP message.");
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = RESULT_OK;
+	}
+
+	// A section that failed to be created is not counted.
+	if (result != RESULT_OK && *section_count > 0 && sections[*section_count - 1] == NULL)
+	{
+		(*section_count)--;
+	}
+
+	if (uamqp_app_properties != NULL)
+	{
+		amqpvalue_destroy(uamqp_app_properties);
+	}
+
+	if (uamqp_message_properties != NULL)
+	{
+		properties_destroy(uamqp_message_properties);
+	}
+
+	return result;
+}
+
+static size_t get_data_section_header_size(size_t content_size)
+{
+	return AMQP_DATA_SECTION_DESCRIPTOR_SIZE + (content_size <= UINT8_MAX ? AMQP_VBIN8_HEADER_SIZE : AMQP_VBIN32_HEADER_SIZE);
+}
+
+// Writes the data section descriptor and the binary constructor and length, in AMQP 1.0 wire format, for a payload of `content_size` bytes; fails if the payload does not fit in a vbin32.
+static int encode_data_section_header(ENCODED_SECTIONS* encoded_sections, size_t content_size)
+{
+	int result;
+
+	// The length of a vbin32 is a uint32, a larger payload cannot be encoded without truncating it.
+	if ((uint64_t)content_size > UINT32_MAX)
+	{
+		LogError("Failed encoding message (content size %lu does not fit in a vbin32)", (unsigned long)content_size);
+		result = __FAILURE__;
+	}
+	else
+	{
+		unsigned char* position = encoded_sections->bytes + encoded_sections->length;
+
+		*position++ = 0x00; // described type
+		*position++ = 0x53; // smallulong
+		*position++ = AMQP_DATA_SECTION_DESCRIPTOR_CODE;
+
+		if (content_size <= UINT8_MAX)
+		{
+			*position++ = 0xA0; // vbin8
+			*position++ = (unsigned char)content_size;
+		}
+		else
+		{
+			*position++ = 0xB0; // vbin32
+			*position++ = (unsigned char)((content_size >> 24) & 0xFF);
+			*position++ = (unsigned char)((content_size >> 16) & 0xFF);
+			*position++ = (unsigned char)((content_size >> 8) & 0xFF);
+			*position++ = (unsigned char)(content_size & 0xFF);
+		}
+
+		encoded_sections->length = (size_t)(position - encoded_sections->bytes);
+		result = RESULT_OK;
+	}
+
+	return result;
+}
+
+int message_create_uamqp_encoding_from_iothub_message(IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+{
+	int result;
+	const unsigned char* message_content;
+	size_t message_content_size;
+	MESSAGE_HANDLE uamqp_message;
+
+	if (message_handle == NULL || body_binary_data == NULL)
+	{
+		// Codes_SRS_UAMQP_MESSAGING_09_100: [If `message_handle` or `body_binary_data` are NULL, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+		LogError("Invalid argument (message_handle=%p, body_binary_data=%p)", message_handle, body_binary_data);
+		result = __FAILURE__;
+	}
+	// Codes_SRS_UAMQP_MESSAGING_09_115: [The content of `message_handle` shall be obtained the same way as in message_create_from_iothub_message(), without being copied]
+	else if (get_message_content(message_handle, &message_content, &message_content_size) != RESULT_OK)
+	{
+		// Codes_SRS_UAMQP_MESSAGING_09_116: [If the content cannot be obtained, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+		LogError("Failed encoding message (could not get the message content)");
+		result = __FAILURE__;
+	}
+	// Codes_SRS_UAMQP_MESSAGING_09_101: [A uAMQP message without body shall be created using message_create() to hold the properties and application properties of `message_handle`]
+	else if ((uamqp_message = message_create()) == NULL)
+	{
+		// Codes_SRS_UAMQP_MESSAGING_09_102: [If message_create() fails, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+		LogError("Failed encoding message (message_create failed)");
+		result = __FAILURE__;
+	}
+	else
+	{
+		AMQP_VALUE sections[2];
+		size_t section_count = 0;
+		size_t i;
+
+		// Codes_SRS_UAMQP_MESSAGING_09_117: [The properties and application properties of `message_handle` shall be set on the uAMQP message the same way as in message_create_from_iothub_message()]
+		if (addPropertiesTouAMQPMessage(message_handle, uamqp_message) != RESULT_OK ||
+			addApplicationPropertiesTouAMQPMessage(message_handle, uamqp_message) != RESULT_OK)
+		{
+			// Codes_SRS_UAMQP_MESSAGING_09_118: [If setting the properties or application properties fails, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+			LogError("Failed encoding message (could not set the message properties)");
+			result = __FAILURE__;
+		}
+		else if (create_message_sections(uamqp_message, sections, &section_count) != RESULT_OK)
+		{
+			// Codes_SRS_UAMQP_MESSAGING_09_106: [If any of the sections fails to be created, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+			LogError("Failed encoding message (could not create the message sections)");
+			result = __FAILURE__;
+		}
+		else
+		{
+			// Codes_SRS_UAMQP_MESSAGING_09_107: [The size of the encoding shall be the sum of the sizes of each section, obtained using amqpvalue_get_encoded_size(), and of the data section holding the content]
+			size_t encoded_size = get_data_section_header_size(message_content_size) + message_content_size;
+
+			result = RESULT_OK;
+
+			for (i = 0; result == RESULT_OK && i < section_count; i++)
+			{
+				size_t section_size;
+
+				if (amqpvalue_get_encoded_size(sections[i], &section_size) != 0)
+				{
+					// Codes_SRS_UAMQP_MESSAGING_09_108: [If amqpvalue_get_encoded_size() fails, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+					LogError("Failed encoding message (amqpvalue_get_encoded_size failed)");
+					result = __FAILURE__;
+				}
+				else
+				{
+					encoded_size += section_size;
+				}
+			}
+
+			if (result == RESULT_OK)
+			{
+				ENCODED_SECTIONS encoded_sections;
+
+				encoded_sections.length = 0;
+
+				// Codes_SRS_UAMQP_MESSAGING_09_109: [A buffer of that size shall be allocated using malloc()]
+				if ((encoded_sections.bytes = (unsigned char*)malloc(encoded_size)) == NULL)
+				{
+					// Codes_SRS_UAMQP_MESSAGING_09_110: [If malloc() fails, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+					LogError("Failed encoding message (malloc failed)");
+					result = __FAILURE__;
+				}
+				else
+				{
+					// Codes_SRS_UAMQP_MESSAGING_09_111: [Each section shall be encoded into the buffer, in order, using amqpvalue_encode()]
+					for (i = 0; result == RESULT_OK && i < section_count; i++)
+					{
+						if (amqpvalue_encode(sections[i], encode_callback, &encoded_sections) != 0)
+						{
+							// Codes_SRS_UAMQP_MESSAGING_09_112: [If amqpvalue_encode() fails, message_create_uamqp_encoding_from_iothub_message() shall free the buffer, fail and return a non-zero value.]
+							LogError("Failed encoding message (amqpvalue_encode failed)");
+							result = __FAILURE__;
+						}
+					}
+
+					// Codes_SRS_UAMQP_MESSAGING_09_105: [The content shall be encoded as a data section written directly into the buffer, copying the content bytes only once]
+					if (result == RESULT_OK && encode_data_section_header(&encoded_sections, message_content_size) != RESULT_OK)
+					{
+						// Codes_SRS_UAMQP_MESSAGING_09_121: [If the content is larger than UINT32_MAX bytes, message_create_uamqp_encoding_from_iothub_message() shall free the buffer, fail and return a non-zero value.]
+						result = __FAILURE__;
+					}
+
+					if (result != RESULT_OK)
+					{
+						free(encoded_sections.bytes);
+					}
+					else
+					{
+						(void)encode_callback(&encoded_sections, message_content, message_content_size);
+
+						// Codes_SRS_UAMQP_MESSAGING_09_113: [The buffer and its length shall be returned in `body_binary_data`; the caller owns the buffer and shall free it]
+						body_binary_data->bytes = encoded_sections.bytes;
+						body_binary_data->length = encoded_sections.length;
+					}
+				}
+			}
+		}
+
+		// Codes_SRS_UAMQP_MESSAGING_09_114: [The sections and the uAMQP message shall be destroyed before message_create_uamqp_encoding_from_iothub_message() returns]
+		for (i = 0; i < section_count; i++)
+		{
+			amqpvalue_destroy(sections[i]);
+		}
+
+		message_destroy(uamqp_message);
+	}
+
+	return result;
+}
@@ -16,6 +16,11 @@ static void* my_gballoc_malloc(size_t size)
     return malloc(size);
 }
 
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
 static void my_gballoc_free(void* s)
 {
     free(s);
@@ -29,6 +34,8 @@ static void my_gballoc_free(void* s)
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #undef ENABLE_MOCKS
 
 #include "blob.h"
@@ -51,6 +58,8 @@ IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT_VALUES);
 TEST_DEFINE_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
 
+IMPLEMENT_UMOCK_C_ENUM_TYPE(THREADAPI_RESULT, THREADAPI_RESULT_VALUES);
+
 static HTTPAPIEX_HANDLE my_HTTPAPIEX_Create(const char* hostName)
 {
     (void)hostName;
@@ -69,6 +78,11 @@ static BUFFER_HANDLE my_BUFFER_create(const unsigned char* source, size_t size)
     return (BUFFER_HANDLE)my_gballoc_malloc(1);
 }
 
+static BUFFER_HANDLE my_BUFFER_new(void)
+{
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
 static void my_BUFFER_delete(BUFFER_HANDLE h)
 {
     my_gballoc_free(h);
@@ -97,13 +111,129 @@ static void my_STRING_delete(STRING_HANDLE h)
     my_gballoc_free((void*)h);
 }
 
+static TICK_COUNTER_HANDLE my_tickcounter_create(void)
+{
+    return (TICK_COUNTER_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_tickcounter_destroy(TICK_COUNTER_HANDLE tick_counter)
+{
+    my_gballoc_free(tick_counter);
+}
+
+#define TEST_MAX_ENCODED_BLOCK_IDS 16
+static char testEncodedBlockIds[TEST_MAX_ENCODED_BLOCK_IDS][7]; /*the block IDs given to Base64_Encode_Bytes, in call order*/
+static size_t testEncodedBlockIdCount;
+
 static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t size)
 {
-    (void)source;
-    (void)size;
+    if ((size == 6) && (testEncodedBlockIdCount < TEST_MAX_ENCODED_BLOCK_IDS))
+    {
+        (void)memcpy(testEncodedBlockIds[testEncodedBlockIdCount], source, 6);
+        testEncodedBlockIds[testEncodedBlockIdCount][6] = '\0';
+        testEncodedBlockIdCount++;
+    }
     return (STRING_HANDLE)my_gballoc_malloc(1);
 }
 
+/*BUFFER_u_char and BUFFER_length of every buffer answer testResponseContent (the body received from storage), except for the buffer decoded last by Base64_Decoder*/
+static const char* testResponseContent;
+static unsigned char testDecodedName[16];
+static size_t testDecodedNameLength;
+static BUFFER_HANDLE testDecodedNameHandle;
+
+static BUFFER_HANDLE my_Base64_Decoder(const char* source)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    unsigned int bits = 0;
+    size_t bitCount = 0;
+    testDecodedNameLength = 0;
+    while ((*source != '\0') && (*source != '=') && (testDecodedNameLength < sizeof(testDecodedName)))
+    {
+        const char* position = strchr(alphabet, *source++);
+        ASSERT_IS_NOT_NULL(position);
+        bits = (bits << 6) | (unsigned int)(position - alphabet);
+        bitCount += 6;
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            testDecodedName[testDecodedNameLength++] = (unsigned char)(bits >> bitCount);
+        }
+    }
+    testDecodedNameHandle = (BUFFER_HANDLE)my_gballoc_malloc(1);
+    return testDecodedNameHandle;
+}
+
+static unsigned char* my_BUFFER_u_char(BUFFER_HANDLE handle)
+{
+    return (handle == testDecodedNameHandle) ? testDecodedName : (unsigned char*)testResponseContent;
+}
+
+static size_t my_BUFFER_length(BUFFER_HANDLE handle)
+{
+    return (handle == testDecodedNameHandle) ? testDecodedNameLength : ((testResponseContent == NULL) ? 0 : strlen(testResponseContent));
+}
+
+/*every call moves the clock by testBlockUploadTime, so every block takes exactly testBlockUploadTime to upload*/
+static tickcounter_ms_t testCurrentMs;
+static tickcounter_ms_t testBlockUploadTime;
+
+/*the tick counters read by the uploads, in call order*/
+#define TEST_MAX_TICK_COUNTER_READS 16
+static TICK_COUNTER_HANDLE testTickCounterReads[TEST_MAX_TICK_COUNTER_READS];
+static size_t testTickCounterReadCount;
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    if (testTickCounterReadCount < TEST_MAX_TICK_COUNTER_READS)
+    {
+        testTickCounterReads[testTickCounterReadCount++] = tick_counter;
+    }
+    testCurrentMs += testBlockUploadTime;
+    *current_ms = testCurrentMs;
+    return 0;
+}
+
+/*threads do not run when they are created, they run when one of them is joined, the last started first. This way the blocks complete out of order*/
+#define TEST_MAX_THREADS 16
+typedef struct TEST_THREAD_TAG
+{
+    THREAD_START_FUNC func;
+    void* arg;
+    int hasRun;
+} TEST_THREAD;
+
+static TEST_THREAD testThreads[TEST_MAX_THREADS];
+static size_t testThreadCount;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    ASSERT_IS_TRUE(testThreadCount < TEST_MAX_THREADS);
+    testThreads[testThreadCount].func = func;
+    testThreads[testThreadCount].arg = arg;
+    testThreads[testThreadCount].hasRun = 0;
+    *threadHandle = (THREAD_HANDLE)&testThreads[testThreadCount];
+    testThreadCount++;
+    return THREADAPI_OK;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    size_t i = testThreadCount;
+    (void)threadHandle;
+    while (i > 0)
+    {
+        i--;
+        if (!testThreads[i].hasRun)
+        {
+            testThreads[i].hasRun = 1;
+            (void)testThreads[i].func(testThreads[i].arg);
+        }
+    }
+    *res = 0;
+    return THREADAPI_OK;
+}
+
 TEST_DEFINE_ENUM_TYPE(BLOB_RESULT, BLOB_RESULT_VALUES);
 
 static TEST_MUTEX_HANDLE g_dllByDll;
@@ -125,11 +255,159 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
     ASSERT_FAIL(temp_str);
 }
 
+typedef struct TEST_READ_CONTEXT_TAG
+{
+    const unsigned char* source;
+    size_t size;
+    size_t position;
+    int failAfterBytes; /*-1 means never fail*/
+} TEST_READ_CONTEXT;
+
+static int testReadCallback(void* context, unsigned char* buffer, size_t size, size_t* bytesRead)
+{
+    int result;
+    TEST_READ_CONTEXT* readContext = (TEST_READ_CONTEXT*)context;
+    if ((readContext->failAfterBytes >= 0) && (readContext->position >= (size_t)readContext->failAfterBytes))
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        size_t left = readContext->size - readContext->position;
+        *bytesRead = (left < size) ? left : size;
+        (void)memcpy(buffer, readContext->source + readContext->position, *bytesRead);
+        readContext->position += *bytesRead;
+        result = 0;
+    }
+    return result;
+}
+
 static BUFFER_HANDLE testValidBufferHandle; /*assigned in TEST_SUITE_INITIALIZE*/
 static unsigned int httpResponse; /*used as out parameter in every call to Blob_....*/
 static const unsigned int TwoHundred = 200;
 static const unsigned int FourHundredFour = 404;
 
+#define TEST_MINIMUM_BLOCK_SIZE (1024 * 1024)
+#define TEST_STEADY_BLOCK_UPLOAD_TIME_MS 5000 /*between 2 and 8 seconds the block size does not change*/
+#define TEST_SLOW_BLOCK_UPLOAD_TIME_MS 9000
+#define TEST_FAST_BLOCK_UPLOAD_TIME_MS 1000
+
+#define TEST_MAX_PROGRESS 16
+typedef struct TEST_PROGRESS_TAG
+{
+    size_t callCount;
+    unsigned int blockCount[TEST_MAX_PROGRESS];
+    size_t uploadedSize[TEST_MAX_PROGRESS];
+} TEST_PROGRESS;
+
+static void testProgressCallback(void* context, unsigned int blockCount, size_t uploadedSize)
+{
+    TEST_PROGRESS* progress = (TEST_PROGRESS*)context;
+    ASSERT_IS_TRUE(progress->callCount < TEST_MAX_PROGRESS);
+    progress->blockCount[progress->callCount] = blockCount;
+    progress->uploadedSize[progress->callCount] = uploadedSize;
+    progress->callCount++;
+}
+
+/*Put Block of a block uploaded on the calling thread (concurrency 1)*/
+static void setupPutBlock(size_t blockSize)
+{
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
+        .IgnoreArgument_source();
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_RELATIVE_PATH_1)); /*this is building the relativePath*/
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded)*/
+        .IgnoreArgument_s1()
+        .IgnoreArgument_s2();
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, blockSize)) /*this is the content to be uploaded by this call*/
+        .IgnoreArgument_source();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, testValidBufferHandle))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_relativePath()
+        .IgnoreArgument_requestContent()
+        .IgnoreArgument_statusCode()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
+        .SetReturn(HTTPAPIEX_OK);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+}
+
+/*Put Block List of blocks 0...blockCount-1*/
+static void setupPutBlockList(unsigned int blockCount)
+{
+    unsigned int blockID;
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+    for (blockID = 0; blockID < blockCount; blockID++)
+    {
+        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6))
+            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>"))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_s1()
+            .IgnoreArgument_s2();
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>"))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+    }
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>"))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_RELATIVE_PATH_1));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist"))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the XML as const char* */
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 1)) /*STRING_c_str returns "a"*/
+        .IgnoreArgument_source();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_relativePath()
+        .IgnoreArgument_requestContent()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
+        .SetReturn(HTTPAPIEX_OK);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is the relativePath of Put Block List*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is the XML*/
+        .IgnoreArgument_handle();
+}
+
+/*answers 200 to the next requestCount requests, whatever block they upload; the other calls are not checked*/
+static void setupRequestsAnswered(size_t requestCount)
+{
+    size_t i;
+    for (i = 0; i < requestCount; i++)
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+            .IgnoreAllArguments()
+            .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
+            .SetReturn(HTTPAPIEX_OK);
+    }
+}
+
+static unsigned char* createTestContent(size_t size)
+{
+    unsigned char* result = (unsigned char*)my_gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(result);
+    (void)memset(result, '3', size);
+    return result;
+}
+
 
 BEGIN_TEST_SUITE(blob_ut)
 
@@ -142,6 +420,8 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
 
     REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Create, my_HTTPAPIEX_Create);
@@ -151,7 +431,11 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
 
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_create, my_BUFFER_create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_new, my_BUFFER_new);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_new, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, my_BUFFER_length);
 
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Alloc, my_HTTPHeaders_Alloc);
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Free, my_HTTPHeaders_Free);
@@ -160,6 +444,8 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(Base64_Encode_Bytes, my_Base64_Encode_Bytes);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Encode_Bytes, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Base64_Decoder, my_Base64_Decoder);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Decoder, NULL);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat, __FAILURE__);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat_with_STRING, __FAILURE__);
@@ -171,15 +457,28 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
 
 
 
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_create, my_tickcounter_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_destroy, my_tickcounter_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
+
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
 
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
 
     REGISTER_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE);
     REGISTER_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT);
     REGISTER_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT);
+    REGISTER_TYPE(THREADAPI_RESULT, THREADAPI_RESULT);
 
     testValidBufferHandle = BUFFER_create((const unsigned char*)"a", 1);
     ASSERT_IS_NOT_NULL(testValidBufferHandle);
@@ -199,6 +498,13 @@ TEST_SUITE_CLEANUP(TestClassCleanup)
 TEST_FUNCTION_INITIALIZE(Setup)
 {
     umock_c_reset_all_calls();
+    testEncodedBlockIdCount = 0;
+    testCurrentMs = 0;
+    testTickCounterReadCount = 0;
+    testBlockUploadTime = TEST_STEADY_BLOCK_UPLOAD_TIME_MS;
+    testThreadCount = 0;
+    testResponseContent = NULL;
+    testDecodedNameHandle = NULL;
 }
 
 /*Tests_SRS_BLOB_02_001: [ If SASURI is NULL then Blob_UploadFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
@@ -1056,4 +1362,596 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
 }
 
 
+/*Tests_SRS_BLOB_21_001: [ If SASURI, readCallback or httpStatus is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_NULL_SasUri_fails)
+{
+    ///arrange
+    TEST_READ_CONTEXT readContext = { (const unsigned char*)"3", 1, 0, -1 };
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(NULL, testReadCallback, &readContext, 1, 0, 0, NULL, NULL, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_001: [ If SASURI, readCallback or httpStatus is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_NULL_readCallback_fails)
+{
+    ///arrange
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, NULL, NULL, 1, 0, 0, NULL, NULL, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_002: [ Blob_UploadMultipleBlocksFromSasUri shall parse SASURI and create the HTTPAPIEX_HANDLE the same way Blob_UploadFromSasUri does. ]*/
+/*Tests_SRS_BLOB_21_003: [ Blob_UploadMultipleBlocksFromSasUri shall read the data into a single block buffer of 4MB that is reused for every block. ]*/
+/*Tests_SRS_BLOB_21_004: [ If the data ends before the first block is full, Blob_UploadMultipleBlocksFromSasUri shall upload it with a single request, as Blob_UploadFromSasUri does for sizes below 64MB. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_less_than_one_block_happy_path)
+{
+    ///arrange
+    TEST_READ_CONTEXT readContext = { (const unsigned char*)"3", 1, 0, -1 };
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_HOSTNAME_1) + 1));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME_1));
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the array of block uploads*/
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(gballoc_malloc(4 * 1024 * 1024)); /*this is the block buffer*/
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 1))
+        .IgnoreArgument_source();
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, X_MS_BLOB_TYPE, BLOCK_BLOB))
+        .IgnoreArgument_httpHeadersHandle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, TEST_RELATIVE_PATH_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_requestHttpHeadersHandle()
+        .IgnoreArgument_requestContent()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
+        .SetReturn(HTTPAPIEX_OK);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
+        .IgnoreArgument_httpHeadersHandle();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the block buffer*/
+        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the array of block uploads*/
+        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, testReadCallback, &readContext, 1, 0, 0, NULL, NULL, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_006: [ If readCallback returns non-zero then Blob_UploadMultipleBlocksFromSasUri shall stop, shall not commit the block list and shall return BLOB_ERROR. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_readCallback_fails)
+{
+    ///arrange
+    TEST_READ_CONTEXT readContext = { (const unsigned char*)"3", 1, 0, 0 };
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_HOSTNAME_1) + 1));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME_1));
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the array of block uploads*/
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(gballoc_malloc(4 * 1024 * 1024)); /*this is the block buffer*/
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the block buffer*/
+        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the array of block uploads*/
+        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, testReadCallback, &readContext, 1, 0, 0, NULL, NULL, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_009: [ If concurrency is 0 or greater than 8 then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_0_concurrency_fails)
+{
+    ///arrange
+    TEST_READ_CONTEXT readContext = { (const unsigned char*)"3", 1, 0, -1 };
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, testReadCallback, &readContext, 0, 0, 0, NULL, NULL, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_009: [ If concurrency is 0 or greater than 8 then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_too_big_concurrency_fails)
+{
+    ///arrange
+    TEST_READ_CONTEXT readContext = { (const unsigned char*)"3", 1, 0, -1 };
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, testReadCallback, &readContext, 9, 0, 0, NULL, NULL, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_005: [ Otherwise Blob_UploadMultipleBlocksFromSasUri shall upload every block as it is read with Put Block, up to concurrency blocks at a time, and commit the block list with Put Block List once readCallback reports the end of the data and every block has completed. ]*/
+/*Tests_SRS_BLOB_21_013: [ Every time a block completes and all the blocks before it have completed, Blob_UploadMultipleBlocksFromSasUri shall call progressCallback, if not NULL, from the calling thread with the number of blocks uploaded so far and the number of bytes uploaded by this call. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_streams_every_block_and_commits_the_block_list)
+{
+    ///arrange
+    size_t size = 2 * TEST_MINIMUM_BLOCK_SIZE + 1;
+    unsigned char* content = createTestContent(size);
+    TEST_READ_CONTEXT readContext = { content, size, 0, -1 };
+    TEST_PROGRESS progress;
+    progress.callCount = 0;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_HOSTNAME_1) + 1));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME_1));
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the array of block uploads*/
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(gballoc_malloc(4 * 1024 * 1024)); /*this is the block buffer*/
+    setupPutBlock(TEST_MINIMUM_BLOCK_SIZE);
+    setupPutBlock(TEST_MINIMUM_BLOCK_SIZE);
+    setupPutBlock(1);
+    setupPutBlockList(3);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the block buffer*/
+        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the array of block uploads*/
+        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, testReadCallback, &readContext, 1, 1 /*1MB blocks*/, 0, testProgressCallback, &progress, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 200, (int)httpResponse);
+    ASSERT_ARE_EQUAL(size_t, 3, progress.callCount);
+    ASSERT_ARE_EQUAL(int, 1, (int)progress.blockCount[0]);
+    ASSERT_ARE_EQUAL(size_t, TEST_MINIMUM_BLOCK_SIZE, progress.uploadedSize[0]);
+    ASSERT_ARE_EQUAL(int, 2, (int)progress.blockCount[1]);
+    ASSERT_ARE_EQUAL(size_t, 2 * TEST_MINIMUM_BLOCK_SIZE, progress.uploadedSize[1]);
+    ASSERT_ARE_EQUAL(int, 3, (int)progress.blockCount[2]);
+    ASSERT_ARE_EQUAL(size_t, size, progress.uploadedSize[2]);
+
+    ///cleanup
+    my_gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_21_005: [ Otherwise Blob_UploadMultipleBlocksFromSasUri shall upload every block as it is read with Put Block, up to concurrency blocks at a time, and commit the block list with Put Block List once readCallback reports the end of the data and every block has completed. ]*/
+/*Tests_SRS_BLOB_21_013: [ Every time a block completes and all the blocks before it have completed, Blob_UploadMultipleBlocksFromSasUri shall call progressCallback, if not NULL, from the calling thread with the number of blocks uploaded so far and the number of bytes uploaded by this call. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_commits_the_blocks_in_order_when_they_complete_out_of_order)
+{
+    ///arrange
+    size_t size = 3 * TEST_MINIMUM_BLOCK_SIZE + 1;
+    unsigned char* content = createTestContent(size);
+    TEST_READ_CONTEXT readContext = { content, size, 0, -1 };
+    TEST_PROGRESS progress;
+    size_t i;
+    progress.callCount = 0;
+
+    setupRequestsAnswered(4 + 1); /*4 blocks and the block list*/
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, testReadCallback, &readContext, 2, 1 /*1MB blocks*/, 0, testProgressCallback, &progress, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_ARE_EQUAL(int, 200, (int)httpResponse);
+    ASSERT_ARE_EQUAL(size_t, 4, testThreadCount);
+
+    /*block 1 is uploaded before block 0...*/
+    ASSERT_ARE_EQUAL(size_t, 4 + 4, testEncodedBlockIdCount);
+    ASSERT_ARE_EQUAL(char_ptr, "     1", testEncodedBlockIds[0]);
+    ASSERT_ARE_EQUAL(char_ptr, "     0", testEncodedBlockIds[1]);
+    ASSERT_ARE_EQUAL(char_ptr, "     2", testEncodedBlockIds[2]);
+    ASSERT_ARE_EQUAL(char_ptr, "     3", testEncodedBlockIds[3]);
+    /*...but the block list is in block order*/
+    ASSERT_ARE_EQUAL(char_ptr, "     0", testEncodedBlockIds[4]);
+    ASSERT_ARE_EQUAL(char_ptr, "     1", testEncodedBlockIds[5]);
+    ASSERT_ARE_EQUAL(char_ptr, "     2", testEncodedBlockIds[6]);
+    ASSERT_ARE_EQUAL(char_ptr, "     3", testEncodedBlockIds[7]);
+
+    /*and so is the progress*/
+    ASSERT_ARE_EQUAL(size_t, 4, progress.callCount);
+    for (i = 0; i < 3; i++)
+    {
+        ASSERT_ARE_EQUAL(int, (int)i + 1, (int)progress.blockCount[i]);
+        ASSERT_ARE_EQUAL(size_t, (i + 1) * TEST_MINIMUM_BLOCK_SIZE, progress.uploadedSize[i]);
+    }
+    ASSERT_ARE_EQUAL(int, 4, (int)progress.blockCount[3]);
+    ASSERT_ARE_EQUAL(size_t, size, progress.uploadedSize[3]);
+
+    ///cleanup
+    my_gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_21_020: [ Every concurrent block shall time its uploads with its own tick counter, created on first use, so no tick counter is used by two threads at once. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_times_every_concurrent_block_with_its_own_tick_counter)
+{
+    ///arrange
+    size_t size = 3 * TEST_MINIMUM_BLOCK_SIZE + 1;
+    unsigned char* content = createTestContent(size);
+    TEST_READ_CONTEXT readContext = { content, size, 0, -1 };
+    size_t i;
+
+    setupRequestsAnswered(4 + 1); /*4 blocks and the block list*/
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, testReadCallback, &readContext, 2, 1 /*1MB blocks*/, 0, NULL, NULL, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_ARE_EQUAL(size_t, 4, testThreadCount);
+
+    /*every block reads the same tick counter before and after its Put Block...*/
+    ASSERT_ARE_EQUAL(size_t, 4 * 2, testTickCounterReadCount);
+    for (i = 0; i < testTickCounterReadCount; i += 2)
+    {
+        ASSERT_ARE_EQUAL(void_ptr, testTickCounterReads[i], testTickCounterReads[i + 1]);
+    }
+    /*...and the blocks of the two slots (block 1 runs first, then 0, 2, 3) use different tick counters*/
+    ASSERT_ARE_NOT_EQUAL(void_ptr, testTickCounterReads[0], testTickCounterReads[2]);
+    ASSERT_ARE_EQUAL(void_ptr, testTickCounterReads[2], testTickCounterReads[4]);
+    ASSERT_ARE_EQUAL(void_ptr, testTickCounterReads[0], testTickCounterReads[6]);
+
+    ///cleanup
+    my_gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_21_012: [ Blob_UploadMultipleBlocksFromSasUri shall halve the size of the next blocks when a full block took longer than 8 seconds to upload, and double it when it took less than 2 seconds, keeping it between 1MB and 4MB. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_halves_the_block_size_after_a_slow_block)
+{
+    ///arrange
+    size_t size = 3 * TEST_MINIMUM_BLOCK_SIZE + 1;
+    unsigned char* content = createTestContent(size);
+    TEST_READ_CONTEXT readContext = { content, size, 0, -1 };
+    TEST_PROGRESS progress;
+    progress.callCount = 0;
+    testBlockUploadTime = TEST_SLOW_BLOCK_UPLOAD_TIME_MS;
+
+    setupRequestsAnswered(3 + 1); /*3 blocks and the block list*/
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, testReadCallback, &readContext, 1, 3 * TEST_MINIMUM_BLOCK_SIZE /*2MB first block*/, 0, testProgressCallback, &progress, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_ARE_EQUAL(size_t, 3, progress.callCount);
+    ASSERT_ARE_EQUAL(size_t, 2 * TEST_MINIMUM_BLOCK_SIZE, progress.uploadedSize[0]); /*2MB*/
+    ASSERT_ARE_EQUAL(size_t, 3 * TEST_MINIMUM_BLOCK_SIZE, progress.uploadedSize[1]); /*halved to 1MB*/
+    ASSERT_ARE_EQUAL(size_t, size, progress.uploadedSize[2]); /*never below 1MB, the rest fits*/
+
+    ///cleanup
+    my_gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_21_012: [ Blob_UploadMultipleBlocksFromSasUri shall halve the size of the next blocks when a full block took longer than 8 seconds to upload, and double it when it took less than 2 seconds, keeping it between 1MB and 4MB. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_doubles_the_block_size_after_a_fast_block_up_to_4MB)
+{
+    ///arrange
+    size_t size = 11 * TEST_MINIMUM_BLOCK_SIZE + 1;
+    unsigned char* content = createTestContent(size);
+    TEST_READ_CONTEXT readContext = { content, size, 0, -1 };
+    TEST_PROGRESS progress;
+    progress.callCount = 0;
+    testBlockUploadTime = TEST_FAST_BLOCK_UPLOAD_TIME_MS;
+
+    setupRequestsAnswered(5 + 1); /*5 blocks and the block list*/
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, testReadCallback, &readContext, 1, 1 /*1MB first block*/, 0, testProgressCallback, &progress, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_ARE_EQUAL(size_t, 5, progress.callCount);
+    ASSERT_ARE_EQUAL(size_t, 1 * TEST_MINIMUM_BLOCK_SIZE, progress.uploadedSize[0]); /*1MB*/
+    ASSERT_ARE_EQUAL(size_t, 3 * TEST_MINIMUM_BLOCK_SIZE, progress.uploadedSize[1]); /*doubled to 2MB*/
+    ASSERT_ARE_EQUAL(size_t, 7 * TEST_MINIMUM_BLOCK_SIZE, progress.uploadedSize[2]); /*doubled to 4MB*/
+    ASSERT_ARE_EQUAL(size_t, 11 * TEST_MINIMUM_BLOCK_SIZE, progress.uploadedSize[3]); /*never above 4MB*/
+    ASSERT_ARE_EQUAL(size_t, size, progress.uploadedSize[4]);
+
+    ///cleanup
+    my_gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_21_011: [ If a thread cannot be started, the block shall be uploaded on the calling thread. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_uploads_on_the_calling_thread_when_ThreadAPI_Create_fails)
+{
+    ///arrange
+    size_t size = 2 * TEST_MINIMUM_BLOCK_SIZE + 1;
+    unsigned char* content = createTestContent(size);
+    TEST_READ_CONTEXT readContext = { content, size, 0, -1 };
+    TEST_PROGRESS progress;
+    size_t i;
+    progress.callCount = 0;
+
+    for (i = 0; i < 3; i++)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments()
+            .SetReturn(THREADAPI_ERROR);
+        setupRequestsAnswered(1); /*the block is uploaded before the next one is read*/
+    }
+    setupRequestsAnswered(1); /*the block list*/
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, testReadCallback, &readContext, 2, 1 /*1MB blocks*/, 0, testProgressCallback, &progress, &httpResponse, testValidBufferHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "ThreadAPI_Join"));
+    ASSERT_ARE_EQUAL(int, 200, (int)httpResponse);
+    ASSERT_ARE_EQUAL(size_t, 3, progress.callCount);
+    ASSERT_ARE_EQUAL(size_t, size, progress.uploadedSize[2]);
+
+    ///cleanup
+    my_gballoc_free(content);
+}
+
+/*Tests_SRS_BLOB_21_015: [ If SASURI, blockCount or uploadedSize is NULL then Blob_GetUploadedBlocks shall fail and return BLOB_INVALID_ARG. ]*/
+TEST_FUNCTION(Blob_GetUploadedBlocks_with_NULL_SasUri_fails)
+{
+    ///arrange
+    unsigned int blockCount;
+    size_t uploadedSize;
+
+    ///act
+    BLOB_RESULT result = Blob_GetUploadedBlocks(NULL, &blockCount, &uploadedSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_015: [ If SASURI, blockCount or uploadedSize is NULL then Blob_GetUploadedBlocks shall fail and return BLOB_INVALID_ARG. ]*/
+TEST_FUNCTION(Blob_GetUploadedBlocks_with_NULL_blockCount_fails)
+{
+    ///arrange
+    size_t uploadedSize;
+
+    ///act
+    BLOB_RESULT result = Blob_GetUploadedBlocks(TEST_VALID_SASURI_1, NULL, &uploadedSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_016: [ Blob_GetUploadedBlocks shall execute a GET request on base relativePath + "&comp=blocklist&blocklisttype=uncommitted" (Get Block List). ]*/
+/*Tests_SRS_BLOB_21_018: [ If storage answers 404 (no block has been uploaded) then Blob_GetUploadedBlocks shall return 0 blocks and BLOB_OK. ]*/
+TEST_FUNCTION(Blob_GetUploadedBlocks_when_blob_does_not_exist_returns_0_blocks)
+{
+    ///arrange
+    unsigned int blockCount = 1;
+    size_t uploadedSize = 1;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_HOSTNAME_1) + 1));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME_1));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_RELATIVE_PATH_1));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist&blocklisttype=uncommitted"))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, NULL, NULL, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_relativePath()
+        .IgnoreArgument_statusCode()
+        .IgnoreArgument_responseContent()
+        .CopyOutArgumentBuffer_statusCode(&FourHundredFour, sizeof(FourHundredFour))
+        .SetReturn(HTTPAPIEX_OK);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_GetUploadedBlocks(TEST_VALID_SASURI_1, &blockCount, &uploadedSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 0, (int)blockCount);
+    ASSERT_ARE_EQUAL(size_t, 0, uploadedSize);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_017: [ Blob_GetUploadedBlocks shall return in blockCount the number of consecutive uncommitted blocks starting at block 0 and in uploadedSize their total size. ]*/
+TEST_FUNCTION(Blob_GetUploadedBlocks_returns_the_uncommitted_blocks_in_any_order)
+{
+    ///arrange
+    unsigned int blockCount = 0;
+    size_t uploadedSize = 0;
+    testResponseContent =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList><CommittedBlocks />"
+        "<UncommittedBlocks>"
+        "<Block><Name>ICAgICAx</Name><Size>200</Size></Block>" /*block 1*/
+        "<Block><Name>ICAgICAw</Name><Size>100</Size></Block>" /*block 0*/
+        "<Block><Name>ICAgICAy</Name><Size>50</Size></Block>" /*block 2*/
+        "</UncommittedBlocks></BlockList>";
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, NULL, NULL, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
+        .SetReturn(HTTPAPIEX_OK);
+
+    ///act
+    BLOB_RESULT result = Blob_GetUploadedBlocks(TEST_VALID_SASURI_1, &blockCount, &uploadedSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_ARE_EQUAL(int, 3, (int)blockCount);
+    ASSERT_ARE_EQUAL(size_t, 350, uploadedSize);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_017: [ Blob_GetUploadedBlocks shall return in blockCount the number of consecutive uncommitted blocks starting at block 0 and in uploadedSize their total size. ]*/
+TEST_FUNCTION(Blob_GetUploadedBlocks_stops_at_the_first_missing_block)
+{
+    ///arrange
+    unsigned int blockCount = 0;
+    size_t uploadedSize = 0;
+    testResponseContent =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList><CommittedBlocks />"
+        "<UncommittedBlocks>"
+        "<Block><Name>ICAgICAw</Name><Size>100</Size></Block>" /*block 0*/
+        "<Block><Name>ICAgICAy</Name><Size>50</Size></Block>" /*block 2, block 1 never made it*/
+        "<Block><Name>ICAgICAz</Name><Size>50</Size></Block>" /*block 3*/
+        "</UncommittedBlocks></BlockList>";
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, NULL, NULL, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
+        .SetReturn(HTTPAPIEX_OK);
+
+    ///act
+    BLOB_RESULT result = Blob_GetUploadedBlocks(TEST_VALID_SASURI_1, &blockCount, &uploadedSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_ARE_EQUAL(int, 1, (int)blockCount);
+    ASSERT_ARE_EQUAL(size_t, 100, uploadedSize);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_017: [ Blob_GetUploadedBlocks shall return in blockCount the number of consecutive uncommitted blocks starting at block 0 and in uploadedSize their total size. ]*/
+TEST_FUNCTION(Blob_GetUploadedBlocks_ignores_committed_blocks_and_blocks_not_named_by_this_module)
+{
+    ///arrange
+    unsigned int blockCount = 0;
+    size_t uploadedSize = 0;
+    testResponseContent =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList>"
+        "<CommittedBlocks><Block><Name>ICAgICAx</Name><Size>999</Size></Block></CommittedBlocks>" /*block 1 of a previous blob*/
+        "<UncommittedBlocks>"
+        "<Block><Name>YmxvY2stMDAwMQ==</Name><Size>999</Size></Block>" /*"block-0001" is not a block ID of this module*/
+        "<Block><Name>ICAgICAw</Name><Size>100</Size></Block>" /*block 0*/
+        "</UncommittedBlocks></BlockList>";
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, NULL, NULL, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
+        .SetReturn(HTTPAPIEX_OK);
+
+    ///act
+    BLOB_RESULT result = Blob_GetUploadedBlocks(TEST_VALID_SASURI_1, &blockCount, &uploadedSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_ARE_EQUAL(int, 1, (int)blockCount);
+    ASSERT_ARE_EQUAL(size_t, 100, uploadedSize);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_017: [ Blob_GetUploadedBlocks shall return in blockCount the number of consecutive uncommitted blocks starting at block 0 and in uploadedSize their total size. ]*/
+TEST_FUNCTION(Blob_GetUploadedBlocks_fails_when_the_block_list_is_malformed)
+{
+    ///arrange
+    unsigned int blockCount = 0;
+    size_t uploadedSize = 0;
+    testResponseContent =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList><CommittedBlocks />"
+        "<UncommittedBlocks>"
+        "<Block><Name>ICAgICAw</Name></Block>" /*no size*/
+        "</UncommittedBlocks></BlockList>";
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, NULL, NULL, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred))
+        .SetReturn(HTTPAPIEX_OK);
+
+    ///act
+    BLOB_RESULT result = Blob_GetUploadedBlocks(TEST_VALID_SASURI_1, &blockCount, &uploadedSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_21_019: [ If any other HTTP status >= 300 is returned then Blob_GetUploadedBlocks shall fail and return BLOB_HTTP_ERROR. ]*/
+TEST_FUNCTION(Blob_GetUploadedBlocks_fails_when_storage_answers_an_error)
+{
+    ///arrange
+    unsigned int blockCount = 0;
+    size_t uploadedSize = 0;
+    const unsigned int FourHundredThree = 403;
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, NULL, NULL, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .CopyOutArgumentBuffer_statusCode(&FourHundredThree, sizeof(FourHundredThree))
+        .SetReturn(HTTPAPIEX_OK);
+
+    ///act
+    BLOB_RESULT result = Blob_GetUploadedBlocks(TEST_VALID_SASURI_1, &blockCount, &uploadedSize);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_HTTP_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+
+    ///cleanup
+}
+
 END_TEST_SUITE(blob_ut);
@@ -0,0 +1,143 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+#include "iothub_client_submission_queue.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothub_client_submission_queue_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_001: [ If queue is NULL, submission_queue_init shall do nothing. ]
+// Tests_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_003: [ If queue or node are NULL, submission_queue_push shall do nothing. ]
+// Tests_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_005: [ If queue is NULL, submission_queue_take_all shall return NULL. ]
+TEST_FUNCTION(submission_queue_NULL_arguments_do_nothing)
+{
+    // arrange
+    SUBMISSION_QUEUE queue;
+    SUBMISSION_QUEUE_NODE node;
+    submission_queue_init(&queue);
+
+    // act
+    submission_queue_init(NULL);
+    submission_queue_push(NULL, &node);
+    submission_queue_push(&queue, NULL);
+    SUBMISSION_QUEUE_NODE* result = submission_queue_take_all(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_IS_NULL(submission_queue_take_all(&queue));
+}
+
+// Tests_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_002: [ submission_queue_init shall make the queue empty. ]
+// Tests_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_007: [ submission_queue_take_all shall return the detached nodes oldest first, or NULL if the queue was empty. ]
+TEST_FUNCTION(submission_queue_take_all_empty_queue_returns_NULL)
+{
+    // arrange
+    SUBMISSION_QUEUE queue;
+    submission_queue_init(&queue);
+
+    // act
+    SUBMISSION_QUEUE_NODE* result = submission_queue_take_all(&queue);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_004: [ submission_queue_push shall link node in front of the last pushed node and publish it with an atomic compare and swap, retrying if another producer pushed in between. ]
+// Tests_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_007: [ submission_queue_take_all shall return the detached nodes oldest first, or NULL if the queue was empty. ]
+TEST_FUNCTION(submission_queue_take_all_returns_nodes_oldest_first)
+{
+    // arrange
+    SUBMISSION_QUEUE queue;
+    SUBMISSION_QUEUE_NODE nodes[3];
+    submission_queue_init(&queue);
+    submission_queue_push(&queue, &nodes[0]);
+    submission_queue_push(&queue, &nodes[1]);
+    submission_queue_push(&queue, &nodes[2]);
+
+    // act
+    SUBMISSION_QUEUE_NODE* result = submission_queue_take_all(&queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, &nodes[0], result);
+    ASSERT_ARE_EQUAL(void_ptr, &nodes[1], result->next);
+    ASSERT_ARE_EQUAL(void_ptr, &nodes[2], result->next->next);
+    ASSERT_IS_NULL(result->next->next->next);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_SUBMISSION_QUEUE_21_006: [ submission_queue_take_all shall detach all the queued nodes at once with an atomic compare and swap. ]
+TEST_FUNCTION(submission_queue_take_all_empties_the_queue)
+{
+    // arrange
+    SUBMISSION_QUEUE queue;
+    SUBMISSION_QUEUE_NODE first;
+    SUBMISSION_QUEUE_NODE second;
+    submission_queue_init(&queue);
+    submission_queue_push(&queue, &first);
+    (void)submission_queue_take_all(&queue);
+
+    // act
+    SUBMISSION_QUEUE_NODE* empty = submission_queue_take_all(&queue);
+    submission_queue_push(&queue, &second);
+    SUBMISSION_QUEUE_NODE* result = submission_queue_take_all(&queue);
+
+    // assert
+    ASSERT_IS_NULL(empty);
+    ASSERT_ARE_EQUAL(void_ptr, &second, result);
+    ASSERT_IS_NULL(result->next);
+}
+
+END_TEST_SUITE(iothub_client_submission_queue_ut)
@@ -8,8 +8,10 @@
 
 #ifdef __cplusplus
 #include <cstdlib>
+#include <ctime>
 #else
 #include <stdlib.h>
+#include <time.h>
 #endif
 
 void* my_gballoc_malloc(size_t size)
@@ -47,6 +49,11 @@ MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char *, string);
 MOCKABLE_FUNCTION(, const char*, json_object_get_string, const JSON_Object *, object, const char *, name);
 MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value *, value);
 MOCKABLE_FUNCTION(, JSON_Object*, json_value_get_object, const JSON_Value *, value);
+MOCKABLE_FUNCTION(, JSON_Value*, json_value_init_object);
+MOCKABLE_FUNCTION(, JSON_Status, json_object_set_string, JSON_Object *, object, const char *, name, const char *, string);
+MOCKABLE_FUNCTION(, JSON_Status, json_object_set_number, JSON_Object *, object, const char *, name, double, number);
+MOCKABLE_FUNCTION(, char*, json_serialize_to_string, const JSON_Value *, value);
+MOCKABLE_FUNCTION(, void, json_free_serialized_string, char *, string);
 
 static STRING_HANDLE my_STRING_construct(const char* psz)
 {
@@ -140,6 +147,54 @@ static void my_json_value_free(JSON_Value *value)
     free(value);
 }
 
+static JSON_Value* my_json_value_init_object(void)
+{
+    return (JSON_Value*)malloc(1);
+}
+
+static char* my_json_serialize_to_string(const JSON_Value *value)
+{
+    (void)value;
+    return (char*)malloc(1);
+}
+
+static void my_json_free_serialized_string(char *string)
+{
+    free(string);
+}
+
+/*reads all the data through readCallback (3 bytes at a time) and reports it as one block. It always fails, so the upload stops after step 2 and stays resumable*/
+static unsigned int testFirstBlockID;
+static char testUploadedData[32];
+static size_t testUploadedSize;
+static int testReadResult;
+
+static BLOB_RESULT my_Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, BLOB_UPLOAD_READ_CALLBACK readCallback, void* context, size_t concurrency, size_t sizeHint, unsigned int firstBlockID, BLOB_UPLOAD_PROGRESS_CALLBACK progressCallback, void* progressContext, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+{
+    size_t bytesRead;
+    (void)SASURI;
+    (void)concurrency;
+    (void)sizeHint;
+    (void)httpResponse;
+    testFirstBlockID = firstBlockID;
+    testUploadedSize = 0;
+    do
+    {
+        size_t left = sizeof(testUploadedData) - 1 - testUploadedSize;
+        bytesRead = 0;
+        testReadResult = readCallback(context, (unsigned char*)testUploadedData + testUploadedSize, (left < 3) ? left : 3, &bytesRead);
+        testUploadedSize += bytesRead;
+    } while ((testReadResult == 0) && (bytesRead > 0));
+    testUploadedData[testUploadedSize] = '\0';
+
+    if ((testReadResult == 0) && (progressCallback != NULL))
+    {
+        progressCallback(progressContext, firstBlockID + 1, testUploadedSize);
+    }
+    *httpStatus = 200;
+    return BLOB_ERROR;
+}
+
 static HTTPAPIEX_RESULT my_HTTPAPIEX_ExecuteRequest(HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath,
     HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode,
     HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
@@ -274,6 +329,77 @@ static unsigned char TestValid_BUFFER_u_char[] = { '3', '\0' };
 
 static char TEST_DEFAULT_STRING_VALUE[2] = { '3', '\0' };
 
+#define TEST_DESTINATION_FILE_NAME "theFile.txt"
+#define TEST_JOURNAL "the journal"
+#define TEST_JOURNAL_CORRELATION_ID "theCorrelationIdOfTheJournal"
+#define TEST_JOURNAL_SAS_URI "https://theaccount.blob.core.windows.net/thecontainer/theblob?sv=2016-05-31&sr=b&sig=abc%2Bdef%3D&se=2017%2D05-01T10%3a20%3A30Z&sp=rw"
+#define TEST_JOURNAL_SAS_URI_EXPIRY "2017-05-01T10:20:30Z"
+#define TEST_DATA "0123456789"
+
+typedef struct TEST_READ_CONTEXT_TAG
+{
+    const char* source;
+    size_t position;
+} TEST_READ_CONTEXT;
+
+static int testReadFromString(void* context, unsigned char* buffer, size_t size, size_t* bytesRead)
+{
+    TEST_READ_CONTEXT* readContext = (TEST_READ_CONTEXT*)context;
+    size_t left = strlen(readContext->source) - readContext->position;
+    *bytesRead = (left < size) ? left : size;
+    (void)memcpy(buffer, readContext->source + readContext->position, *bytesRead);
+    readContext->position += *bytesRead;
+    return 0;
+}
+
+static void testJournalCallback(const char* journal, void* context)
+{
+    (void)journal;
+    (*(size_t*)context)++;
+}
+
+/*formats the time secondsFromNow from now as the service formats SAS URI expiries*/
+static void formatExpiry(char* expiry, size_t expirySize, time_t secondsFromNow)
+{
+    time_t when = time(NULL) + secondsFromNow;
+    ASSERT_ARE_NOT_EQUAL(size_t, 0, strftime(expiry, expirySize, "%Y-%m-%dT%H:%M:%SZ", gmtime(&when)));
+}
+
+/*the fields of the previous journal, as read by json_object_get_string*/
+static void setupJournalFields(const char* destinationFileName, const char* sasUriExpiry)
+{
+    STRICT_EXPECTED_CALL(json_object_get_string(IGNORED_PTR_ARG, "destinationFileName"))
+        .IgnoreArgument_object()
+        .SetReturn(destinationFileName);
+    STRICT_EXPECTED_CALL(json_object_get_string(IGNORED_PTR_ARG, "correlationId"))
+        .IgnoreArgument_object()
+        .SetReturn(TEST_JOURNAL_CORRELATION_ID);
+    STRICT_EXPECTED_CALL(json_object_get_string(IGNORED_PTR_ARG, "sasUri"))
+        .IgnoreArgument_object()
+        .SetReturn(TEST_JOURNAL_SAS_URI);
+    STRICT_EXPECTED_CALL(json_object_get_string(IGNORED_PTR_ARG, "sasUriExpiry"))
+        .IgnoreArgument_object()
+        .SetReturn(sasUriExpiry);
+}
+
+/*a journal that can be resumed, storage already has blockCount blocks holding uploadedSize bytes*/
+static void setupResume(unsigned int blockCount, size_t uploadedSize)
+{
+    char expiry[32];
+    formatExpiry(expiry, sizeof(expiry), 3600);
+    setupJournalFields(TEST_DESTINATION_FILE_NAME, expiry);
+    STRICT_EXPECTED_CALL(Blob_GetUploadedBlocks(TEST_JOURNAL_SAS_URI, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_blockCount()
+        .IgnoreArgument_uploadedSize()
+        .CopyOutArgumentBuffer_blockCount(&blockCount, sizeof(blockCount))
+        .CopyOutArgumentBuffer_uploadedSize(&uploadedSize, sizeof(uploadedSize))
+        .SetReturn(BLOB_OK);
+    STRICT_EXPECTED_CALL(STRING_copy(IGNORED_PTR_ARG, TEST_JOURNAL_CORRELATION_ID))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(STRING_copy(IGNORED_PTR_ARG, TEST_JOURNAL_SAS_URI))
+        .IgnoreArgument(1);
+}
+
 BEGIN_TEST_SUITE(iothubclient_ll_uploadtoblob_ut)
 
 TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -300,6 +426,9 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(const unsigned char*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BLOB_UPLOAD_READ_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BLOB_UPLOAD_PROGRESS_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(JSON_Status, int);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
@@ -339,6 +468,15 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(json_value_get_object, (JSON_Object*)1);
     REGISTER_GLOBAL_MOCK_RETURN(json_object_get_string, "a");
     REGISTER_GLOBAL_MOCK_HOOK(json_value_free, my_json_value_free);
+    REGISTER_GLOBAL_MOCK_HOOK(json_value_init_object, my_json_value_init_object);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_init_object, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(json_object_set_string, JSONSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_set_string, JSONFailure);
+    REGISTER_GLOBAL_MOCK_RETURN(json_object_set_number, JSONSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_set_number, JSONFailure);
+    REGISTER_GLOBAL_MOCK_HOOK(json_serialize_to_string, my_json_serialize_to_string);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_serialize_to_string, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(json_free_serialized_string, my_json_free_serialized_string);
     
 
     REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_OK);
@@ -353,6 +491,9 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SetOption, HTTPAPIEX_ERROR);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_UploadFromSasUri, BLOB_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(Blob_UploadMultipleBlocksFromSasUri, my_Blob_UploadMultipleBlocksFromSasUri);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_UploadMultipleBlocksFromSasUri, BLOB_ERROR);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_GetUploadedBlocks, BLOB_ERROR);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __FAILURE__);
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
@@ -3918,5 +4059,222 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_x509privatekey_fails_when_s
 }
 
 
+/*Tests_SRS_IOTHUBCLIENT_LL_21_018: [ Otherwise IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall skip step 1, reuse the correlationId and sasUri of journal, and call Blob_GetUploadedBlocks to find the block to resume from. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_21_019: [ When resuming, IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall read and discard the bytes already in storage before uploading the rest of the data produced by readCallback. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_21_020: [ If step 2 fails, IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall not notify IoTHub, so the upload can be resumed, and shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_resumes_after_the_uploaded_blocks)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    TEST_READ_CONTEXT readContext = { TEST_DATA, 0 };
+    size_t journalCount = 0;
+    umock_c_reset_all_calls();
+
+    setupResume(2, 4); /*"0123" is in storage already*/
+    STRICT_EXPECTED_CALL(json_object_set_number(IGNORED_PTR_ARG, "uploadedSize", 10.0)) /*the journal counts the resumed bytes too*/
+        .IgnoreArgument_object();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_Impl(h, TEST_DESTINATION_FILE_NAME, testReadFromString, &readContext, TEST_JOURNAL, testJournalCallback, &journalCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "/devices/")); /*step 1 was skipped*/
+    ASSERT_ARE_EQUAL(int, 2, (int)testFirstBlockID);
+    ASSERT_ARE_EQUAL(int, 0, testReadResult);
+    ASSERT_ARE_EQUAL(char_ptr, "456789", testUploadedData);
+    ASSERT_ARE_EQUAL(size_t, 1, journalCount);
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_21_019: [ When resuming, IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall read and discard the bytes already in storage before uploading the rest of the data produced by readCallback. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_fails_when_the_data_is_shorter_than_what_was_uploaded)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    TEST_READ_CONTEXT readContext = { TEST_DATA, 0 };
+    size_t journalCount = 0;
+    umock_c_reset_all_calls();
+
+    setupResume(5, 20); /*20 bytes are in storage, the data has only 10*/
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_Impl(h, TEST_DESTINATION_FILE_NAME, testReadFromString, &readContext, TEST_JOURNAL, testJournalCallback, &journalCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, testReadResult);
+    ASSERT_ARE_EQUAL(size_t, 0, journalCount);
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_21_017: [ IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall call journalCallback with a JSON journal carrying destinationFileName, correlationId, sasUri, sasUriExpiry, blockCount and uploadedSize after step 1 and every time more blocks have been uploaded. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_journals_the_URL_decoded_SAS_URI_expiry)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    TEST_READ_CONTEXT readContext = { TEST_DATA, 0 };
+    size_t journalCount = 0;
+    umock_c_reset_all_calls();
+
+    setupResume(0, 0);
+    STRICT_EXPECTED_CALL(json_value_init_object());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is the SAS URI the expiry is taken from*/
+        .IgnoreArgument_handle()
+        .SetReturn(TEST_JOURNAL_SAS_URI);
+    STRICT_EXPECTED_CALL(json_object_set_string(IGNORED_PTR_ARG, "sasUriExpiry", TEST_JOURNAL_SAS_URI_EXPIRY)) /*%2D, %3a and %3A are decoded*/
+        .IgnoreArgument_object();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_Impl(h, TEST_DESTINATION_FILE_NAME, testReadFromString, &readContext, TEST_JOURNAL, testJournalCallback, &journalCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, journalCount);
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_21_017: [ IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall call journalCallback with a JSON journal carrying destinationFileName, correlationId, sasUri, sasUriExpiry, blockCount and uploadedSize after step 1 and every time more blocks have been uploaded. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_journals_an_empty_expiry_when_the_SAS_URI_expiry_is_not_URL_encoded_correctly)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    TEST_READ_CONTEXT readContext = { TEST_DATA, 0 };
+    size_t journalCount = 0;
+    umock_c_reset_all_calls();
+
+    setupResume(0, 0);
+    STRICT_EXPECTED_CALL(json_value_init_object());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .SetReturn("https://theaccount.blob.core.windows.net/thecontainer/theblob?sv=2016-05-31&se=2017-05-01T10%3");
+    STRICT_EXPECTED_CALL(json_object_set_string(IGNORED_PTR_ARG, "sasUriExpiry", "")) /*such a journal cannot be resumed*/
+        .IgnoreArgument_object();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_Impl(h, TEST_DESTINATION_FILE_NAME, testReadFromString, &readContext, TEST_JOURNAL, testJournalCallback, &journalCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_21_016: [ If journal is not valid, is for another destinationFileName or its SAS URI expires in less than 5 minutes then IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall start a new upload. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_starts_a_new_upload_when_the_SAS_URI_expires_in_less_than_5_minutes)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    TEST_READ_CONTEXT readContext = { TEST_DATA, 0 };
+    size_t journalCount = 0;
+    char expiry[32];
+    formatExpiry(expiry, sizeof(expiry), 60);
+    umock_c_reset_all_calls();
+
+    setupJournalFields(TEST_DESTINATION_FILE_NAME, expiry);
+    STRICT_EXPECTED_CALL(STRING_construct("/devices/")) /*this is step 1, it fails to keep the test short*/
+        .SetReturn(NULL);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_Impl(h, TEST_DESTINATION_FILE_NAME, testReadFromString, &readContext, TEST_JOURNAL, testJournalCallback, &journalCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Blob_GetUploadedBlocks"));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_21_016: [ If journal is not valid, is for another destinationFileName or its SAS URI expires in less than 5 minutes then IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall start a new upload. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_starts_a_new_upload_when_the_SAS_URI_expiry_is_not_a_time)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    TEST_READ_CONTEXT readContext = { TEST_DATA, 0 };
+    size_t journalCount = 0;
+    umock_c_reset_all_calls();
+
+    setupJournalFields(TEST_DESTINATION_FILE_NAME, "tomorrow"); /*"tomorrow" sorts after any ISO 8601 time*/
+    STRICT_EXPECTED_CALL(STRING_construct("/devices/")) /*this is step 1, it fails to keep the test short*/
+        .SetReturn(NULL);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_Impl(h, TEST_DESTINATION_FILE_NAME, testReadFromString, &readContext, TEST_JOURNAL, testJournalCallback, &journalCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Blob_GetUploadedBlocks"));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_21_016: [ If journal is not valid, is for another destinationFileName or its SAS URI expires in less than 5 minutes then IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall start a new upload. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_starts_a_new_upload_when_the_journal_is_for_another_file)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    TEST_READ_CONTEXT readContext = { TEST_DATA, 0 };
+    size_t journalCount = 0;
+    umock_c_reset_all_calls();
+
+    setupJournalFields("anotherFile.txt", "2099-12-31");
+    STRICT_EXPECTED_CALL(STRING_construct("/devices/")) /*this is step 1, it fails to keep the test short*/
+        .SetReturn(NULL);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_Impl(h, TEST_DESTINATION_FILE_NAME, testReadFromString, &readContext, TEST_JOURNAL, testJournalCallback, &journalCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Blob_GetUploadedBlocks"));
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_21_018: [ Otherwise IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal shall skip step 1, reuse the correlationId and sasUri of journal, and call Blob_GetUploadedBlocks to find the block to resume from. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_accepts_a_SAS_URI_expiry_without_time)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS);
+    TEST_READ_CONTEXT readContext = { TEST_DATA, 0 };
+    size_t journalCount = 0;
+    umock_c_reset_all_calls();
+
+    setupJournalFields(TEST_DESTINATION_FILE_NAME, "2099-12-31");
+    STRICT_EXPECTED_CALL(Blob_GetUploadedBlocks(TEST_JOURNAL_SAS_URI, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*the journal is accepted...*/
+        .IgnoreArgument_blockCount()
+        .IgnoreArgument_uploadedSize()
+        .SetReturn(BLOB_ERROR);
+    STRICT_EXPECTED_CALL(STRING_construct("/devices/")) /*...but storage cannot be reached, so a new upload starts*/
+        .SetReturn(NULL);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadMultipleBlocksToBlobWithJournal_Impl(h, TEST_DESTINATION_FILE_NAME, testReadFromString, &readContext, TEST_JOURNAL, testJournalCallback, &journalCount);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+
+    ///cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
 END_TEST_SUITE(iothubclient_ll_uploadtoblob_ut)
 #endif /*DONT_USE_UPLOADTOBLOB*/
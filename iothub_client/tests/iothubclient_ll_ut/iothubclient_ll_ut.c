@@ -4,9 +4,11 @@
 #ifdef __cplusplus
 #include <cstdlib>
 #include <cstddef>
+#include <cstring>
 #else
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #endif
 
 static void* my_gballoc_malloc(size_t size)
@@ -1451,6 +1453,55 @@ TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_succeeds)
     IoTHubClient_LL_Destroy(handle);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_02_111: [ IoTHubClient_LL_SendEventAsyncTakeOwnership shall behave as IoTHubClient_LL_SendEventAsync, except that the new record shall hold eventMessageHandle itself instead of a clone of it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsyncTakeOwnership_does_not_clone_the_message)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsyncTakeOwnership(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    umock_c_reset_all_calls();
+    IoTHubClient_LL_Destroy(handle);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "IoTHubMessage_Destroy"));
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_02_112: [ If IoTHubClient_LL_SendEventAsyncTakeOwnership fails, the ownership of eventMessageHandle shall remain with the caller. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsyncTakeOwnership_fails_without_destroying_the_message)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsyncTakeOwnership(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
 /*Tests_SRS_IOTHUBCLIENT_LL_02_010: [IoTHubClient_LL_Destroy shall call the underlaying layer's _Destroy function and shall free the resources allocated by IoTHubClient (if any).] */
 /*Tests_SRS_IOTHUBCLIENT_LL_02_033: [Otherwise, IoTHubClient_LL_Destroy shall complete all the event message callbacks that are in the waitingToSend list with the result IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.] */
 TEST_FUNCTION(IoTHubClient_LL_Destroy_after_sendEvent_succeeds)
@@ -3763,6 +3814,153 @@ TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_Ex_succeed)
     IoTHubClient_LL_Destroy(h);
 }
 
+/* Tests_SRS_IOTHUBCLIENT_LL_21_001: [ If iotHubClientHandle or method_name is NULL then IoTHubClient_LL_RegisterMethodHandler shall return IOTHUB_CLIENT_INVALID_ARG. ] */
+TEST_FUNCTION(IoTHubClient_LL_RegisterMethodHandler_handle_NULL_fail)
+{
+    //arrange
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_RegisterMethodHandler(NULL, TEST_METHOD_NAME, deviceMethodCallback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_21_002: [ When registering the first handler, IoTHubClient_LL_RegisterMethodHandler shall call the underlying layer's IoTHubTransport_Subscribe_DeviceMethod function. ] */
+/* Tests_SRS_IOTHUBCLIENT_LL_21_003: [ If a handler is already registered for method_name, IoTHubClient_LL_RegisterMethodHandler shall replace it. ] */
+TEST_FUNCTION(IoTHubClient_LL_RegisterMethodHandler_subscribes_once_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubClient_LL_RegisterMethodHandler(h, TEST_METHOD_NAME, deviceMethodCallback, (void*)1);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_RegisterMethodHandler(h, "reboot", deviceMethodCallback, (void*)1);
+    IOTHUB_CLIENT_RESULT result3 = IoTHubClient_LL_RegisterMethodHandler(h, TEST_METHOD_NAME, deviceMethodCallback, (void*)2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_21_007: [ If any error is encountered then IoTHubClient_LL_RegisterMethodHandler shall return IOTHUB_CLIENT_ERROR. ] */
+TEST_FUNCTION(IoTHubClient_LL_RegisterMethodHandler_subscribe_fail)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(__FAILURE__);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_RegisterMethodHandler(h, TEST_METHOD_NAME, deviceMethodCallback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_21_004: [ If methodCallback is NULL, IoTHubClient_LL_RegisterMethodHandler shall remove the handler for method_name, and call IoTHubTransport_Unsubscribe_DeviceMethod when no handler or device method callback remains. ] */
+TEST_FUNCTION(IoTHubClient_LL_RegisterMethodHandler_remove_last_unsubscribes_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_RegisterMethodHandler(h, TEST_METHOD_NAME, deviceMethodCallback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe_DeviceMethod(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_RegisterMethodHandler(h, TEST_METHOD_NAME, NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_21_005: [ If a handler is registered for method_name, IoTHubClient_LL_DeviceMethodComplete shall execute it instead of deviceMethodCallback and send its response. ] */
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_registered_handler_succeed)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_RegisterMethodHandler(h, TEST_METHOD_NAME, deviceMethodCallback, (void*)2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    umock_c_reset_all_calls();
+
+    size_t len = 1;
+    unsigned char* resp = (unsigned char*)my_gballoc_malloc(len);
+    resp[0] = 0xa;
+
+    STRICT_EXPECTED_CALL(deviceMethodCallback(TEST_METHOD_NAME, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, (void*)2))
+        .IgnoreArgument_payload()
+        .IgnoreArgument_size()
+        .CopyOutArgumentBuffer_response(&resp, sizeof(unsigned char**))
+        .CopyOutArgumentBuffer_resp_size(&len, sizeof(size_t));
+    EXPECTED_CALL(FAKE_IoTHubTransport_DeviceMethod_Response(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    int status = IoTHubClient_LL_DeviceMethodComplete(h, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, status);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_LL_21_006: [ If handlers are registered but none matches method_name and no device method callback is set, IoTHubClient_LL_DeviceMethodComplete shall answer with status 501 without calling the application. ] */
+TEST_FUNCTION(IoTHubClient_LL_DeviceMethodComplete_unregistered_method_returns_501)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_RegisterMethodHandler(h, "reboot", deviceMethodCallback, (void*)2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DeviceMethod_Response(IGNORED_PTR_ARG, TEST_METHOD_ID, IGNORED_PTR_ARG, IGNORED_NUM_ARG, 501))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_response()
+        .IgnoreArgument_resp_size();
+
+    //act
+    int status = IoTHubClient_LL_DeviceMethodComplete(h, TEST_METHOD_NAME, (const unsigned char*)TEST_STRING_VALUE, strlen(TEST_STRING_VALUE), TEST_METHOD_ID);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, status);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
 /* Tests_SRS_IOTHUBCLIENT_LL_07_026: [ If handle or methodId is NULL then IoTHubClient_LL_DeviceMethodResponse shall return IOTHUB_CLIENT_INVALID_ARG.] */
 TEST_FUNCTION(IoTHubClient_LL_DeviceMethodResponse_handle_NULL_fail)
 {
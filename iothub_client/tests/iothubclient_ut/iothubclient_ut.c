@@ -4,9 +4,11 @@
 #ifdef __cplusplus
 #include <cstdlib>
 #include <cstddef>
+#include <cstring>
 #else
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #endif
 
 static void* my_gballoc_malloc(size_t size)
@@ -33,6 +35,7 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 
 #define ENABLE_MOCKS
 #include "iothubtransport.h"
+#include "iothubtransport_pool.h"
 #undef ENABLE_MOCKS
 
 #include "iothub_client.h"
@@ -54,6 +57,7 @@ static void my_test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_RESUL
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/condition.h"
 
 #include "iothub_client_ll.h"
 
@@ -87,6 +91,14 @@ extern "C" const size_t IoTHubClient_ThreadTerminationOffset;
 extern const size_t IoTHubClient_ThreadTerminationOffset;
 #endif
 
+#ifndef DONT_USE_UPLOADTOBLOB
+#ifdef __cplusplus
+extern "C" const size_t IoTHubClient_UploadWorkersTerminationOffset;
+#else
+extern const size_t IoTHubClient_UploadWorkersTerminationOffset;
+#endif
+#endif
+
 typedef struct LOCK_TEST_INFO_TAG
 {
     void* lock_taken;
@@ -105,6 +117,8 @@ static IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK g_inboundDeviceCallback;
 
 static size_t g_how_thread_loops = 0;
 static size_t g_thread_loop_count = 0;
+static void* g_saved_upload_data;
+static IOTHUB_CLIENT_FILE_UPLOAD_RESULT g_file_upload_result;
 static size_t g_queue_element_size = 0;
 static void* g_queue_element;
 
@@ -118,10 +132,12 @@ static IOTHUB_MESSAGE_HANDLE TEST_MESSAGE_HANDLE = (IOTHUB_MESSAGE_HANDLE)0x1116
 static THREAD_HANDLE TEST_THREAD_HANDLE = (THREAD_HANDLE)0x1117;
 static LIST_ITEM_HANDLE TEST_LIST_HANDLE = (LIST_ITEM_HANDLE)0x1118;
 static TRANSPORT_HANDLE TEST_TRANSPORT_HANDLE = (TRANSPORT_HANDLE)0x1119;
+static TRANSPORT_POOL_HANDLE TEST_TRANSPORT_POOL_HANDLE = (TRANSPORT_POOL_HANDLE)0x111A;
 static IOTHUB_CLIENT_DEVICE_CONFIG* TEST_CLIENT_DEVICE_CONFIG = (IOTHUB_CLIENT_DEVICE_CONFIG*)0x111A;
 static METHOD_HANDLE TEST_METHOD_ID = (METHOD_HANDLE)0x111B;
 static STRING_HANDLE TEST_STRING_HANDLE = (STRING_HANDLE)0x111C;
 static BUFFER_HANDLE TEST_BUFFER_HANDLE = (BUFFER_HANDLE)0x111D;
+static COND_HANDLE TEST_COND_HANDLE = (COND_HANDLE)0x111E;
 
 static const char* TEST_CONNECTION_STRING = "Test_connection_string";
 static const char* TEST_DEVICE_ID = "theidofTheDevice";
@@ -195,6 +211,31 @@ static void my_ThreadAPI_Sleep(unsigned int milliseconds)
     }
 }
 
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+#ifndef DONT_USE_UPLOADTOBLOB
+    /*only the upload workers wait on a condition, tell the worker to stop*/
+    *(sig_atomic_t*)(((char*)g_thread_func_arg) + IoTHubClient_UploadWorkersTerminationOffset) = 1;
+#endif
+    return COND_OK;
+}
+
+static LIST_ITEM_HANDLE my_singlylinkedlist_add(SINGLYLINKEDLIST_HANDLE list, const void* item)
+{
+    (void)list;
+    g_saved_upload_data = (void*)item;
+    return TEST_LIST_HANDLE;
+}
+
+static void my_test_file_upload_callback(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, void* userContextCallback)
+{
+    (void)userContextCallback;
+    g_file_upload_result = result;
+}
+
 static IOTHUB_CLIENT_RESULT my_IoTHubClient_LL_GetSendStatus(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
 {
     (void)iotHubClientHandle;
@@ -393,12 +434,15 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(VECTOR_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(const VECTOR_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(TRANSPORT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSPORT_POOL_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_STATUS, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(METHOD_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -412,6 +456,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_CreateWithTransport, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SendEventAsync, my_IoTHubClient_LL_SendEventAsync);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_SendEventAsync, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_LL_SendEventAsyncTakeOwnership, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_SendEventAsyncTakeOwnership, IOTHUB_CLIENT_ERROR);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_GetSendStatus, my_IoTHubClient_LL_GetSendStatus);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_GetSendStatus, IOTHUB_CLIENT_ERROR);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_GetLastMessageReceiveTime, my_IoTHubClient_LL_GetLastMessageReceiveTime);
@@ -437,6 +483,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_LL_GetRetryPolicy, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_Destroy, my_IoTHubClient_LL_Destroy);
     REGISTER_GLOBAL_MOCK_HOOK(test_event_confirmation_callback, my_test_event_confirmation_callback);
+    REGISTER_GLOBAL_MOCK_HOOK(test_file_upload_callback, my_test_file_upload_callback);
     
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_LL_GetRetryPolicy, IOTHUB_CLIENT_ERROR);
 
@@ -470,6 +517,11 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
 
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_create, my_VECTOR_create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_create, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_push_back, my_VECTOR_push_back);
@@ -483,7 +535,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_create, TEST_SLL_HANDLE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_create, NULL);
     REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_get_head_item, NULL);
-    REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_add, TEST_LIST_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, my_singlylinkedlist_add);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_add, NULL);
 
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_SignalEndWorkerThread, true);
@@ -506,6 +558,8 @@ TEST_FUNCTION_INITIALIZE(method_init)
     g_userContextCallback = NULL;
     g_how_thread_loops = 0;
     g_thread_loop_count = 0;
+    g_saved_upload_data = NULL;
+    g_file_upload_result = FILE_UPLOAD_ERROR;
     g_queue_element = NULL;
     g_queue_element_size = 0;
     g_queue_number_items = 0;
@@ -570,6 +624,30 @@ static void setup_iothubclient_createwithtransport()
         .IgnoreArgument_handle();
 }
 
+static IOTHUB_CLIENT_CONFIRMATION_RESULT g_captured_confirmation_result;
+static size_t g_captured_confirmation_count;
+
+static void capture_event_confirmation(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    (void)userContextCallback;
+    g_captured_confirmation_result = result;
+    g_captured_confirmation_count++;
+}
+
+static IOTHUB_CLIENT_HANDLE create_shared_transport_client(void)
+{
+    IOTHUB_CLIENT_CONFIG client_config;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS;
+    client_config.protocol = TEST_TRANSPORT_PROVIDER;
+
+    IOTHUB_CLIENT_HANDLE result = IoTHubClient_CreateWithTransport(TEST_TRANSPORT_HANDLE, &client_config);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
 static void setup_iothubclient_sendeventasync(bool use_threads)
 {
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
@@ -600,25 +678,55 @@ static void setup_iothubclient_uploadtoblobasync()
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init()); /*this is the upload lock*/
+    STRICT_EXPECTED_CALL(Condition_Init());
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*these are the upload workers*/
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is adding UPLOADTOBLOB_SAVED_DATA to the list of UPLOADTOBLOB_SAVED_DATAs to be cleaned*/
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(Lock_Init());
-    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument_handle();
+}
 
-    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob(TEST_IOTHUB_CLIENT_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1)) /*this is the thread calling into _LL layer*/
+static void setup_iothubclient_upload_worker()
+{
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob(TEST_IOTHUB_CLIENT_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1)) /*this is the worker calling into _LL layer*/
         .IgnoreArgument(2)
         .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(test_file_upload_callback(FILE_UPLOAD_OK, (void*)1))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
         .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, IGNORED_PTR_ARG, IGNORED_NUM_ARG)) /*the queue is empty, the worker is told to stop while waiting*/
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument_handle();
 }
 
+/*destroys a client that has one finished (or cancelled) upload in its list*/
+static void destroy_with_one_finished_upload(IOTHUB_CLIENT_HANDLE iothub_handle)
+{
+    umock_c_reset_all_calls();
+    EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .SetReturn((LIST_ITEM_HANDLE)0x1111);
+    EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .SetReturn((LIST_ITEM_HANDLE)0x1112);
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .SetReturn(g_saved_upload_data);
+    IoTHubClient_Destroy(iothub_handle);
+}
+
 /* Tests_SRS_IOTHUBCLIENT_12_003: [IoTHubClient_CreateFromConnectionString shall verify the input parameters and if any of them NULL then return NULL] */
 TEST_FUNCTION(IoTHubClient_CreateFromConnectionString_connection_string_NULL_fail)
 {
@@ -877,6 +985,96 @@ TEST_FUNCTION(IoTHubClient_CreateWithTransport_fail)
     umock_c_negative_tests_deinit();
 }
 
+/*Tests_SRS_IOTHUBCLIENT_02_084: [ IoTHubClient_CreateWithTransportPool shall return NULL if transportPoolHandle or config are NULL. ]*/
+TEST_FUNCTION(IoTHubClient_CreateWithTransportPool_transport_pool_handle_NULL_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS;
+    client_config.protocol = TEST_TRANSPORT_PROVIDER;
+
+    // act
+    IOTHUB_CLIENT_HANDLE result = IoTHubClient_CreateWithTransportPool(NULL, &client_config);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_085: [ IoTHubClient_CreateWithTransportPool shall get the transport of the new client by calling IoTHubTransportPool_AcquireTransport and fail if it returns NULL. ]*/
+TEST_FUNCTION(IoTHubClient_CreateWithTransportPool_acquire_transport_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS;
+    client_config.protocol = TEST_TRANSPORT_PROVIDER;
+
+    STRICT_EXPECTED_CALL(IoTHubTransportPool_AcquireTransport(TEST_TRANSPORT_POOL_HANDLE))
+        .SetReturn(NULL);
+
+    // act
+    IOTHUB_CLIENT_HANDLE result = IoTHubClient_CreateWithTransportPool(TEST_TRANSPORT_POOL_HANDLE, &client_config);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_086: [ IoTHubClient_CreateWithTransportPool shall then create the client the same way IoTHubClient_CreateWithTransport does. ]*/
+/*Tests_SRS_IOTHUBCLIENT_02_088: [ If the client was created with IoTHubClient_CreateWithTransportPool, IoTHubClient_Destroy shall give its transport back by calling IoTHubTransportPool_ReleaseTransport. ]*/
+TEST_FUNCTION(IoTHubClient_CreateWithTransportPool_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS;
+    client_config.protocol = TEST_TRANSPORT_PROVIDER;
+
+    STRICT_EXPECTED_CALL(IoTHubTransportPool_AcquireTransport(TEST_TRANSPORT_POOL_HANDLE))
+        .SetReturn(TEST_TRANSPORT_HANDLE);
+    setup_iothubclient_createwithtransport();
+
+    // act
+    IOTHUB_CLIENT_HANDLE result = IoTHubClient_CreateWithTransportPool(TEST_TRANSPORT_POOL_HANDLE, &client_config);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    umock_c_reset_all_calls();
+    IoTHubClient_Destroy(result);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "IoTHubTransportPool_ReleaseTransport"));
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_087: [ If creating the client fails, IoTHubClient_CreateWithTransportPool shall call IoTHubTransportPool_ReleaseTransport and return NULL. ]*/
+TEST_FUNCTION(IoTHubClient_CreateWithTransportPool_create_fails_releases_transport)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS;
+    client_config.protocol = TEST_TRANSPORT_PROVIDER;
+
+    STRICT_EXPECTED_CALL(IoTHubTransportPool_AcquireTransport(TEST_TRANSPORT_POOL_HANDLE))
+        .SetReturn(TEST_TRANSPORT_HANDLE);
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubTransportPool_ReleaseTransport(TEST_TRANSPORT_POOL_HANDLE, TEST_TRANSPORT_HANDLE));
+
+    // act
+    IOTHUB_CLIENT_HANDLE result = IoTHubClient_CreateWithTransportPool(TEST_TRANSPORT_POOL_HANDLE, &client_config);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 /* Tests_SRS_IOTHUBCLIENT_01_008: [IoTHubClient_Destroy shall do nothing if parameter iotHubClientHandle is NULL.] */
 TEST_FUNCTION(IoTHubClient_Destroy_iothub_client_handle_NULL_fail)
 {
@@ -896,7 +1094,7 @@ TEST_FUNCTION(IoTHubClient_Destroy_iothub_client_handle_NULL_fail)
 /* Tests_SRS_IOTHUBCLIENT_01_007: [The thread created as part of executing IoTHubClient_SendEventAsync or IoTHubClient_SetMessageCallback shall be joined.] */
 /* Tests_SRS_IOTHUBCLIENT_01_032: [The lock allocated in IoTHubClient_Create shall be also freed.] */
 /* Tests_SRS_IOTHUBCLIENT_02_069: [ IoTHubClient_Destroy shall free all data created by IoTHubClient_UploadToBlobAsync ]*/
-/* Tests_SRS_IOTHUBCLIENT_02_072: [ All threads marked as disposable (upon completion of a file upload) shall be joined and the data structures build for them shall be freed. ]*/
+/* Tests_SRS_IOTHUBCLIENT_02_072: [ All uploads marked as disposable (upon completion of a file upload) shall have the data structures build for them freed. ]*/
 /* Tests_SRS_IOTHUBCLIENT_02_043: [IoTHubClient_Destroy shall lock the serializing lock.]*/
 /* Tests_SRS_IOTHUBCLIENT_02_045: [ IoTHubClient_Destroy shall unlock the serializing lock. ]*/
 TEST_FUNCTION(IoTHubClient_Destroy_succeed)
@@ -1111,6 +1309,186 @@ TEST_FUNCTION(IoTHubClient_SendEventAsync_event_confirm_callback_succeed)
     IoTHubClient_Destroy(iothub_handle);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_02_089: [ If the client uses a shared transport, IoTHubClient_SendEventAsync shall clone eventMessageHandle with IoTHubMessage_Clone, push it with eventConfirmationCallback and userContextCallback to the submission queue of the client without taking the transport lock and return IOTHUB_CLIENT_OK. ]*/
+/*Tests_SRS_IOTHUBCLIENT_02_090: [ Only while the worker thread was not started for the client, IoTHubClient_SendEventAsync shall lock the transport lock and start it with IoTHubTransport_StartWorkerThread. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_shared_transport_first_event_starts_worker)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = create_shared_transport_client();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubTransport_StartWorkerThread(TEST_TRANSPORT_HANDLE, iothub_handle));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn((IOTHUB_MESSAGE_HANDLE)0x4201);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_089: [ If the client uses a shared transport, IoTHubClient_SendEventAsync shall clone eventMessageHandle with IoTHubMessage_Clone, push it with eventConfirmationCallback and userContextCallback to the submission queue of the client without taking the transport lock and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_shared_transport_does_not_lock)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = create_shared_transport_client();
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn((IOTHUB_MESSAGE_HANDLE)0x4201);
+    (void)IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn((IOTHUB_MESSAGE_HANDLE)0x4202);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_091: [ If eventMessageHandle is NULL, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_INVALID_ARG; if starting the worker thread, allocating the queued event or cloning the message fails, it shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_shared_transport_NULL_message_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = create_shared_transport_client();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync(iothub_handle, NULL, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_091: [ If eventMessageHandle is NULL, IoTHubClient_SendEventAsync shall return IOTHUB_CLIENT_INVALID_ARG; if starting the worker thread, allocating the queued event or cloning the message fails, it shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_SendEventAsync_shared_transport_clone_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = create_shared_transport_client();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(IoTHubTransport_StartWorkerThread(TEST_TRANSPORT_HANDLE, iothub_handle));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn(NULL);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_094: [ If iotHubClientHandle is NULL, IoTHubClient_ProcessSubmissions shall do nothing. ]*/
+TEST_FUNCTION(IoTHubClient_ProcessSubmissions_handle_NULL_does_nothing)
+{
+    // act
+    IoTHubClient_ProcessSubmissions(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_092: [ IoTHubClient_ProcessSubmissions shall pass the queued events, oldest first, to IoTHubClient_LL_SendEventAsyncTakeOwnership, handing over the message clones instead of cloning them again. ]*/
+TEST_FUNCTION(IoTHubClient_ProcessSubmissions_sends_events_oldest_first)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = create_shared_transport_client();
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn((IOTHUB_MESSAGE_HANDLE)0x4201);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn((IOTHUB_MESSAGE_HANDLE)0x4202);
+    (void)IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)0x01);
+    (void)IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)0x02);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsyncTakeOwnership(TEST_IOTHUB_CLIENT_HANDLE, (IOTHUB_MESSAGE_HANDLE)0x4201, test_event_confirmation_callback, (void*)0x01));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsyncTakeOwnership(TEST_IOTHUB_CLIENT_HANDLE, (IOTHUB_MESSAGE_HANDLE)0x4202, test_event_confirmation_callback, (void*)0x02));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_ProcessSubmissions(iothub_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_093: [ If IoTHubClient_LL_SendEventAsyncTakeOwnership fails, IoTHubClient_ProcessSubmissions shall destroy the message clone and call the event confirmation callback with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_ProcessSubmissions_send_fails_reports_error)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = create_shared_transport_client();
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn((IOTHUB_MESSAGE_HANDLE)0x4201);
+    (void)IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)0x01);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendEventAsyncTakeOwnership(TEST_IOTHUB_CLIENT_HANDLE, (IOTHUB_MESSAGE_HANDLE)0x4201, test_event_confirmation_callback, (void*)0x01))
+        .SetReturn(IOTHUB_CLIENT_ERROR);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)0x4201));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)0x01));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_ProcessSubmissions(iothub_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_095: [ IoTHubClient_Destroy shall call the event confirmation callback of the events still in the submission queue with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY and free them. ]*/
+TEST_FUNCTION(IoTHubClient_Destroy_reports_queued_events_because_destroy)
+{
+    // arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = create_shared_transport_client();
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn((IOTHUB_MESSAGE_HANDLE)0x4201);
+    (void)IoTHubClient_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, capture_event_confirmation, NULL);
+    g_captured_confirmation_count = 0;
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubClient_Destroy(iothub_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_captured_confirmation_count);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (int)g_captured_confirmation_result);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "IoTHubMessage_Destroy"));
+}
+
 TEST_FUNCTION(IoTHubClient_GetSendStatus_iothub_handle_NULL_fail)
 {
     // arrange
@@ -2324,10 +2702,13 @@ TEST_FUNCTION(IoTHubClient_UploadToBlobAsync_with_NULL_source_and_size_1_fails)
 
 /*Tests_SRS_IOTHUBCLIENT_02_051: [ IoTHubClient_UploadToBlobAsync shall copy the souce, size, iotHubClientFileUploadCallback, context and a non-initialized(1) THREAD_HANDLE parameters into a structure. ]*/
 /*Tests_SRS_IOTHUBCLIENT_02_058: [ IoTHubClient_UploadToBlobAsync shall add the structure to the list of structures that need to be cleaned once file upload finishes. ]*/
-/*Tests_SRS_IOTHUBCLIENT_02_052: [ IoTHubClient_UploadToBlobAsync shall spawn a thread passing the structure build in SRS IOTHUBCLIENT 02 051 as thread data.]*/
+/*Tests_SRS_IOTHUBCLIENT_02_075: [ The first call to IoTHubClient_UploadToBlobAsync shall create an upload lock, an upload condition and UPLOADTOBLOB_WORKER_COUNT upload workers. ]*/
+/*Tests_SRS_IOTHUBCLIENT_02_052: [ IoTHubClient_UploadToBlobAsync shall append the structure build in SRS IOTHUBCLIENT 02 051 to the upload queue and signal the upload condition. ]*/
+/*Tests_SRS_IOTHUBCLIENT_02_078: [ The upload worker shall take the oldest queued upload. If there is none, it shall wait on the upload condition. ]*/
+/*Tests_SRS_IOTHUBCLIENT_02_079: [ The upload worker shall exit when IoTHubClient_Destroy signals it to end. ]*/
 /*Tests_SRS_IOTHUBCLIENT_02_054: [ The thread shall call IoTHubClient_LL_UploadToBlob passing the information packed in the structure. ]*/
 /*Tests_SRS_IOTHUBCLIENT_02_056: [ Otherwise the thread iotHubClientFileUploadCallbackInternal passing as result FILE_UPLOAD_OK and the structure from SRS IOTHUBCLIENT 02 051. ]*/
-/*Tests_SRS_IOTHUBCLIENT_02_071: [ The thread shall mark itself as disposable. ]*/
+/*Tests_SRS_IOTHUBCLIENT_02_071: [ The thread shall mark the upload as disposable. ]*/
 TEST_FUNCTION(IoTHubClient_UploadToBlobAsync_succeeds)
 {
     //arrange
@@ -2335,28 +2716,149 @@ TEST_FUNCTION(IoTHubClient_UploadToBlobAsync_succeeds)
     umock_c_reset_all_calls();
 
     setup_iothubclient_uploadtoblobasync();
+    setup_iothubclient_upload_worker();
 
     //act
     IOTHUB_CLIENT_RESULT result = IoTHubClient_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1);
 
-    g_thread_func(g_thread_func_arg); /*this is the thread uploading function*/
+    g_thread_func(g_thread_func_arg); /*this is the upload worker*/
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
+    destroy_with_one_finished_upload(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_076: [ If creating the lock, the condition or all of the upload workers fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_UploadToBlobAsync_when_Condition_Init_fails_it_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
     umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "someFileName.txt"))
+        .IgnoreArgument_destination()
+        .IgnoreArgument_source();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init())
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument_handle();
-    EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
-        .SetReturn((LIST_ITEM_HANDLE)0x1111);
-    EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
-        .SetReturn((LIST_ITEM_HANDLE)0x1112);
-    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-        .SetReturn((void*)g_thread_func_arg);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
     IoTHubClient_Destroy(iothub_handle);
 }
+
+/*Tests_SRS_IOTHUBCLIENT_02_081: [ If iotHubClientHandle or destinationFileName is NULL then IoTHubClient_CancelUploadToBlobAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_CancelUploadToBlobAsync_with_NULL_iotHubClientHandle_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_CancelUploadToBlobAsync(NULL, "someFileName.txt");
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_081: [ If iotHubClientHandle or destinationFileName is NULL then IoTHubClient_CancelUploadToBlobAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_CancelUploadToBlobAsync_with_NULL_destinationFileName_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_CancelUploadToBlobAsync(iothub_handle, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_083: [ If no upload was removed then IoTHubClient_CancelUploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR, otherwise it shall return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_CancelUploadToBlobAsync_without_queued_upload_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_CancelUploadToBlobAsync(iothub_handle, "someFileName.txt");
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_Destroy(iothub_handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_02_082: [ IoTHubClient_CancelUploadToBlobAsync shall remove from the upload queue all the uploads to destinationFileName that no worker has started and shall call their callbacks with FILE_UPLOAD_CANCELLED. ]*/
+/*Tests_SRS_IOTHUBCLIENT_02_083: [ If no upload was removed then IoTHubClient_CancelUploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR, otherwise it shall return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_CancelUploadToBlobAsync_cancels_queued_upload)
+{
+    //arrange
+    IOTHUB_CLIENT_HANDLE iothub_handle = IoTHubClient_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClient_UploadToBlobAsync(iothub_handle, "someFileName.txt", (const unsigned char*)"a", 1, test_file_upload_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(test_file_upload_callback(FILE_UPLOAD_CANCELLED, (void*)1))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_CancelUploadToBlobAsync(iothub_handle, "someFileName.txt");
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(int, FILE_UPLOAD_CANCELLED, g_file_upload_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    destroy_with_one_finished_upload(iothub_handle);
+}
 #endif
 
 TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_incoming_method_callback_succeed)
@@ -736,6 +736,127 @@ BEGIN_TEST_SUITE(iothubmessage_ut)
         ///cleanup
     }
 
+    /*Tests_SRS_IOTHUBMESSAGE_09_001: [IoTHubMessage_CreateFromByteArrayView shall reference byteArray and size as the content of the message, without copying the bytes.]*/
+    /*Tests_SRS_IOTHUBMESSAGE_09_003: [IoTHubMessage_CreateFromByteArrayView shall call Map_Create to create the message properties.]*/
+    /*Tests_SRS_IOTHUBMESSAGE_09_004: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.]*/
+    /*Tests_SRS_IOTHUBMESSAGE_09_007: [If iotHubMessageHandle is a view, IoTHubMessage_GetByteArray shall return the referenced bytes and size without copying them.]*/
+    TEST_FUNCTION(IoTHubMessage_CreateFromByteArrayView_happy_path)
+    {
+        ///arrange
+        CIoTHubMessageMocks mocks;
+        const unsigned char* byteArray;
+        size_t size;
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        auto h = IoTHubMessage_CreateFromByteArrayView(c, 1);
+        auto r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(h);
+        mocks.AssertActualAndExpectedCalls();
+        ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+        ASSERT_IS_TRUE(byteArray == c);
+        ASSERT_ARE_EQUAL(size_t, 1, size);
+
+        ///cleanup
+        IoTHubMessage_Destroy(h);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGE_09_002: [If size is NOT zero and byteArray is NULL, IoTHubMessage_CreateFromByteArrayView shall return NULL.]*/
+    TEST_FUNCTION(IoTHubMessage_CreateFromByteArrayView_fails_when_size_non_zero_buffer_NULL)
+    {
+        ///arrange
+        CIoTHubMessageMocks mocks;
+
+        ///act
+        auto h = IoTHubMessage_CreateFromByteArrayView(NULL, 1);
+
+        ///assert
+        ASSERT_IS_NULL(h);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGE_09_005: [If there are any errors then IoTHubMessage_CreateFromByteArrayView shall return NULL.]*/
+    TEST_FUNCTION(IoTHubMessage_CreateFromByteArrayView_fails_when_Map_Create_fails)
+    {
+        ///arrange
+        CIoTHubMessageMocks mocks;
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        whenShallMap_Create_fail = currentMap_Create_call + 1;
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        auto h = IoTHubMessage_CreateFromByteArrayView(c, 1);
+
+        ///assert
+        ASSERT_IS_NULL(h);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGE_09_008: [IoTHubMessage_Destroy shall not free the bytes referenced by a view.]*/
+    TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_view_IoTHubMessage_without_BUFFER_delete)
+    {
+        ///arrange
+        CIoTHubMessageMocks mocks;
+        auto h = IoTHubMessage_CreateFromByteArrayView(c, 1);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(h));
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+        ///act
+        IoTHubMessage_Destroy(h);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGE_09_006: [If iotHubMessageHandle is a view, IoTHubMessage_Clone shall copy the referenced bytes by calling BUFFER_create, so the clone owns its content and outlives the view.]*/
+    TEST_FUNCTION(IoTHubMessage_Clone_with_view_copies_the_content)
+    {
+        ///arrange
+        CIoTHubMessageMocks mocks;
+        auto h = IoTHubMessage_CreateFromByteArrayView(c, 1);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, BUFFER_create(c, 1));
+        STRICT_EXPECTED_CALL(mocks, Map_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        auto r = IoTHubMessage_Clone(h);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(r);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        IoTHubMessage_Destroy(h);
+        IoTHubMessage_Destroy(r);
+    }
+
     /*Tests_SRS_IOTHUBMESSAGE_01_004: [If iotHubMessageHandle is NULL, IoTHubMessage_Destroy shall do nothing.] */
     TEST_FUNCTION(IoTHubMessage_Destroy_With_NULL_handle_does_nothing)
     {
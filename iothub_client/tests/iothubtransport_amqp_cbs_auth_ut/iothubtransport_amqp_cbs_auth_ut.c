@@ -51,6 +51,7 @@ static int real_strcmp(const char* str1, const char* str2)
 #include "azure_c_shared_utility/agenttime.h" 
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/sastoken.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #undef ENABLE_MOCKS
 
 #include "iothubtransport_amqp_cbs_auth.h"
@@ -98,6 +99,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_DEVICES_PATH                                 "some.fqdn.com/devices/my_device"
 #define TEST_DEVICES_PATH_STRING_HANDLE                   (STRING_HANDLE)0x4453
 #define SAS_TOKEN_TYPE                                    "servicebus.windows.net:sastoken"
+#define TEST_TICK_COUNTER_HANDLE                          (TICK_COUNTER_HANDLE)0x4454
 #define TEST_SAS_TOKEN_KEY_NAME_STRING_HANDLE             (STRING_HANDLE)0x4454
 #define TEST_OPTIONHANDLER_HANDLE                         (OPTIONHANDLER_HANDLE)0x4455
 
@@ -193,6 +195,7 @@ static void register_umock_alias_types()
 	REGISTER_UMOCK_ALIAS_TYPE(CBS_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(ON_CBS_OPERATION_COMPLETE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(time_t, long long);
+	REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(AUTHENTICATION_ERROR_CODE, int);
 	REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_RESULT, int);
@@ -222,6 +225,9 @@ static void register_global_mock_returns()
 
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, INDEFINITE_TIME);
 
+	REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_Create, NULL);
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_AddOption, OPTIONHANDLER_ERROR);
 }
@@ -335,6 +341,7 @@ static void set_expected_calls_for_authentication_create(AUTHENTICATION_CONFIG*
 	}
 
 	STRICT_EXPECTED_CALL(STRING_construct(TEST_IOTHUB_HOST_FQDN)).SetReturn(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE);
+	EXPECTED_CALL(tickcounter_create());
 }
 
 static void set_expected_calls_for_authentication_destroy(AUTHENTICATION_CONFIG* config, AUTHENTICATION_HANDLE handle)
@@ -355,6 +362,7 @@ static void set_expected_calls_for_authentication_destroy(AUTHENTICATION_CONFIG*
 	}
 
 	STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
+	STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
 
 	STRICT_EXPECTED_CALL(free(handle));
 }
@@ -367,6 +375,15 @@ static void set_expected_calls_for_create_devices_path()
 	// STRING_sprintf
 }
 
+// The tick counter is made to advance together with the wall clock, in milliseconds.
+static void set_expected_calls_for_tickcounter_get_current_ms(time_t current_time)
+{
+	tickcounter_ms_t current_ms = (tickcounter_ms_t)current_time * 1000;
+
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &current_ms, sizeof(current_ms));
+}
+
 static void set_expected_calls_for_put_SAS_token_to_cbs(AUTHENTICATION_HANDLE handle, time_t current_time, STRING_HANDLE sas_token)
 {
 	char* sas_token_char_ptr;
@@ -383,7 +400,7 @@ static void set_expected_calls_for_put_SAS_token_to_cbs(AUTHENTICATION_HANDLE ha
 	STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH);
 	STRICT_EXPECTED_CALL(cbs_put_token(TEST_CBS_HANDLE, SAS_TOKEN_TYPE, TEST_DEVICES_PATH, sas_token_char_ptr, IGNORED_PTR_ARG, handle))
 		.IgnoreArgument(5);
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+	set_expected_calls_for_tickcounter_get_current_ms(current_time);
 }
 
 static void set_expected_calls_for_create_and_put_sas_token(AUTHENTICATION_HANDLE handle, time_t current_time, AUTHENTICATION_DO_WORK_EXPECTED_STATE* exp_context)
@@ -412,9 +429,7 @@ static void set_expected_calls_for_authentication_do_work(AUTHENTICATION_CONFIG*
 		}
 		else
 		{
-			STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
-			double actual_difftime_result = difftime(current_time, exp_context->current_sas_token_put_time);
-			STRICT_EXPECTED_CALL(get_difftime(current_time, exp_context->current_sas_token_put_time)).SetReturn(actual_difftime_result);
+			set_expected_calls_for_tickcounter_get_current_ms(current_time);
 		}
 	}
 	else if (exp_context->current_state == AUTHENTICATION_STATE_STARTING)
@@ -434,9 +449,8 @@ static void set_expected_calls_for_authentication_do_work(AUTHENTICATION_CONFIG*
 	{
 		if (config->device_sas_token == NULL) //, device keys are being used
 		{
-			STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
 			double actual_difftime_result = difftime(current_time, exp_context->current_sas_token_put_time);
-			STRICT_EXPECTED_CALL(get_difftime(current_time, exp_context->current_sas_token_put_time)).SetReturn(actual_difftime_result);
+			set_expected_calls_for_tickcounter_get_current_ms(current_time);
 
 			if (actual_difftime_result >= exp_context->sas_token_refresh_time_in_seconds)
 			{
@@ -646,6 +660,7 @@ TEST_FUNCTION(authentication_create_NULL_on_state_changed_callback)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_012: [If provided, authentication_create() shall save a copy of `config->device_primary_key` into the `instance->device_primary_key`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_014: [If provided, authentication_create() shall save a copy of `config->device_secondary_key` into `instance->device_secondary_key`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_016: [If provided, authentication_create() shall save a copy of `config->iothub_host_fqdn` into `instance->iothub_host_fqdn`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_129: [authentication_create() shall create `instance->tick_counter` using tickcounter_create()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_024: [If no failure occurs, authentication_create() shall return a reference to the AUTHENTICATION_INSTANCE handle]
 TEST_FUNCTION(authentication_create_DEVICE_KEYS_succeeds)
 {
@@ -671,6 +686,7 @@ TEST_FUNCTION(authentication_create_DEVICE_KEYS_succeeds)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_013: [If STRING_construct() fails to copy `config->device_primary_key`, authentication_create() shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_015: [If STRING_construct() fails to copy `config->device_secondary_key`, authentication_create() shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_017: [If STRING_clone() fails to copy `config->iothub_host_fqdn`, authentication_create() shall fail and return NULL]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_130: [If tickcounter_create() fails, authentication_create() shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_020: [If any failure occurs, authentication_create() shall free any memory it allocated previously]
 TEST_FUNCTION(authentication_create_DEVICE_KEYS_failure_checks)
 {
@@ -949,6 +965,7 @@ TEST_FUNCTION(authentication_destroy_NULL_handle)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_110: [authentication_destroy() shall destroy `instance->device_primary_key` using STRING_delete()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_111: [authentication_destroy() shall destroy `instance->device_secondary_key` using STRING_delete()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_112: [authentication_destroy() shall destroy `instance->iothub_host_fqdn` using STRING_delete()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_131: [authentication_destroy() shall destroy `instance->tick_counter` using tickcounter_destroy()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_113: [authentication_destroy() shall destroy `instance` using free()]
 TEST_FUNCTION(authentication_destroy_succeeds)
 {
@@ -6,11 +6,13 @@
 #include <cstdlib>
 #include <cstddef>
 #include <ctime>
+#include <cstring>
 #else
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <time.h>
+#include <string.h>
 #endif
 
 void* real_malloc(size_t size)
@@ -70,6 +72,7 @@ extern "C"
 #include "azure_c_shared_utility/tlsio.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/tickcounter.h"
 
 #include "azure_uamqp_c/cbs.h"
 #include "azure_uamqp_c/link.h"
@@ -216,6 +219,15 @@ MOCKABLE_FUNCTION(, time_t, get_time, time_t*, currentTime);
 MOCKABLE_FUNCTION(, double, get_difftime, time_t, stopTime, time_t, startTime);
 
 
+static tickcounter_ms_t g_current_ms;
+
+static int TEST_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
 
@@ -253,6 +265,7 @@ static TEST_MUTEX_HANDLE g_dllByDll;
 #define TEST_AMQP_MAP                       ((AMQP_VALUE)0x4258)
 #define TEST_MESSAGE_SENDER                 ((MESSAGE_SENDER_HANDLE)0x4259)
 #define TEST_AMQP_VALUE                     ((AMQP_VALUE)0x4260)
+#define TEST_TICK_COUNTER_HANDLE            ((TICK_COUNTER_HANDLE)0x4262)
 
 #define TEST_UNDERLYING_IO_TRANSPORT        ((XIO_HANDLE)0x4261)
 #define TEST_TRANSPORT_PROVIDER             ((TRANSPORT_PROVIDER*)0x4263)
@@ -372,6 +385,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_SENDER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(fields, void*);
     REGISTER_UMOCK_ALIAS_TYPE(METHOD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
@@ -401,6 +415,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_symbol, TEST_AMQP_VALUE);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_string, TEST_AMQP_VALUE);
     REGISTER_GLOBAL_MOCK_RETURN(messagesender_create, TEST_MESSAGE_SENDER);
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, TEST_tickcounter_get_current_ms);
 
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_create, my_VECTOR_create);
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_destroy, my_VECTOR_destroy);
@@ -435,6 +451,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
         ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
     }
 
+    g_current_ms = 0;
     umock_c_reset_all_calls();
 }
 
@@ -515,6 +532,103 @@ TEST_FUNCTION(AMQP_Create_upperConfig_iotHubName_NULL)
     ASSERT_IS_NULL(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_285: [IoTHubTransport_AMQP_Common_Create shall create a TICK_COUNTER_HANDLE using tickcounter_create(), used to measure the adaptive send window, the idle device sweep and the link idle timeout]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_286: [If tickcounter_create fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL.]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_236: [If IoTHubTransport_AMQP_Common_Create fails it shall free any memory it allocated (iotHubHostFqdn, registered device list, transport state).]
+TEST_FUNCTION(AMQP_Create_tickcounter_create_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create())
+        .SetReturn(NULL);
+    EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+
+    // act
+    TRANSPORT_LL_HANDLE handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+
+    // assert
+    ASSERT_IS_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_291: [IoTHubTransport_AMQP_Common_Create shall seed the random number generator with the current time using srand(), so the SAS token refresh jitter is not the same on every run]
+TEST_FUNCTION(AMQP_Create_seeds_the_random_number_generator_with_the_current_time)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(get_time(NULL));
+
+    // act
+    TRANSPORT_LL_HANDLE handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+
+    // assert
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_287: [IoTHubTransport_AMQP_Common_Destroy shall destroy the tick counter using tickcounter_destroy()]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_Destroy_destroys_the_tick_counter)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "", umock_c_get_expected_calls());
+}
+
 /* IoTHubTransport_AMQP_Common_Register */
 
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_010: [ `IoTHubTransport_AMQP_Common_Register` shall create a new iothubtransportamqp_methods instance by calling `iothubtransportamqp_methods_create` while passing to it the the fully qualified domain name and the device Id. ]*/
@@ -575,6 +689,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_Register_creates_a_new_methods_handler
     EXPECTED_CALL(authentication_create(IGNORED_PTR_ARG));
     EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
     EXPECTED_CALL(authentication_get_credential(IGNORED_PTR_ARG));
+    EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     // act
     device_handle = IoTHubTransport_AMQP_Common_Register(handle, &device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
@@ -587,6 +702,408 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_Register_creates_a_new_methods_handler
     IoTHubTransport_AMQP_Common_Destroy(handle);
 }
 
+/* IoTHubTransport_AMQP_Common_SetOption */
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_257: [If `optionName` is `amqp_incoming_window` or `amqp_outgoing_window`, the uint32_t value shall be saved on the transport instance, applied to the current AMQP session if it exists, and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK] */
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_amqp_windows_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+    uint32_t incoming_window = 1000;
+    uint32_t outgoing_window = 500;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_INCOMING_WINDOW, &incoming_window);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_OUTGOING_WINDOW, &outgoing_window);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_258: [If `optionName` is `amqp_incoming_window` or `amqp_outgoing_window` and the value is zero, IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG] */
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_amqp_outgoing_window_zero_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+    uint32_t outgoing_window = 0;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_OUTGOING_WINDOW, &outgoing_window);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_258: [If `optionName` is `amqp_incoming_window` or `amqp_outgoing_window` and the value is zero, IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG] */
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_amqp_incoming_window_zero_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+    uint32_t incoming_window = 0;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_INCOMING_WINDOW, &incoming_window);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_265: [If `optionName` is `amqp_receiver_max_message_size`, the uint64_t value shall be saved on the transport instance, to be applied to message receiver links created afterwards, and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK] */
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_266: [If `optionName` is `amqp_adaptive_outgoing_window`, the bool value shall be saved on the transport instance and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK] */
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_amqp_receiver_max_message_size_and_adaptive_window_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+    uint64_t max_message_size = 262144;
+    bool adaptive = true;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_RECEIVER_MAX_MESSAGE_SIZE, &max_message_size);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_ADAPTIVE_OUTGOING_WINDOW, &adaptive);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_272: [If `optionName` is `amqp_link_idle_timeout`, the size_t value (in seconds) shall be saved on the transport instance and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK] */
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_amqp_link_idle_timeout_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+    size_t idle_timeout_secs = 300;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_LINK_IDLE_TIMEOUT, &idle_timeout_secs);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_302: [If `optionName` is `amqp_event_batching`, the bool value shall be saved on the transport instance and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK] */
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_amqp_event_batching_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+    bool event_batching = true;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_EVENT_BATCHING, &event_batching);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_280: [If `optionName` is `sas_token_refresh_jitter_percent`, the size_t value shall be saved on the transport instance, to be applied to SAS tokens created afterwards, and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_sas_token_refresh_jitter_percent_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+    size_t jitter_percent = 50;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_SAS_TOKEN_REFRESH_JITTER_PERCENT, &jitter_percent);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_281: [If `optionName` is `sas_token_refresh_jitter_percent` and the value is 100 or more, IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_sas_token_refresh_jitter_percent_100_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+    size_t jitter_percent = 100;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_SAS_TOKEN_REFRESH_JITTER_PERCENT, &jitter_percent);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_282: [If `optionName` is `cbs_max_pending_put_tokens`, the size_t value shall be saved on the transport instance and IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetOption_cbs_max_pending_put_tokens_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+    size_t max_pending_put_tokens = 4;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_CBS_MAX_PENDING_PUT_TOKENS, &max_pending_put_tokens);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_283: [If `handle` or `statistics` are NULL, IoTHubTransport_AMQP_Common_GetCbsStatistics shall return IOTHUB_CLIENT_INVALID_ARG]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_GetCbsStatistics_NULL_handle_fails)
+{
+    // arrange
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_GetCbsStatistics(NULL, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_283: [If `handle` or `statistics` are NULL, IoTHubTransport_AMQP_Common_GetCbsStatistics shall return IOTHUB_CLIENT_INVALID_ARG]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_GetCbsStatistics_NULL_statistics_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_GetCbsStatistics(handle, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_279: [IoTHubTransport_AMQP_Common_Create shall set `sas_token_refresh_jitter_percent` to 20 and `cbs_max_pending_put_tokens` to 10, and zero the CBS statistics.]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_284: [Otherwise IoTHubTransport_AMQP_Common_GetCbsStatistics shall copy the put-token counters and latencies of the CBS connection into `statistics` and return IOTHUB_CLIENT_OK]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_GetCbsStatistics_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_GetCbsStatistics(handle, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.putTokensSent);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.putTokensCompleted);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.putTokensFailed);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.putTokensPending);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.putTokensDeferred);
+    ASSERT_ARE_EQUAL(size_t, 0, (size_t)statistics.maxLatencyMs);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_011: [ If `iothubtransportamqp_methods_create` fails, `IoTHubTransport_AMQP_Common_Register` shall fail and return NULL. ]*/
 TEST_FUNCTION(when_creating_the_methods_handler_fails_then_IoTHubTransport_AMQP_Common_Register_fails)
@@ -703,6 +1220,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_Unregister_destroys_the_methods_handle
 #endif
 
     EXPECTED_CALL(VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     // act
@@ -945,6 +1463,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_subscribes_for_methods)
     device_config.deviceKey = "cucu";
     device_config.deviceSasToken = NULL;
 
+    DList_InitializeListHead(&waitingToSend);
     handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
     device_handle = IoTHubTransport_AMQP_Common_Register(handle, &device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
     (void)IoTHubTransport_AMQP_Common_Subscribe_DeviceMethod(device_handle);
@@ -960,7 +1479,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_subscribes_for_methods)
     EXPECTED_CALL(session_set_outgoing_window(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(connection_set_trace(IGNORED_PTR_ARG, false));
     EXPECTED_CALL(xio_setoption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     EXPECTED_CALL(authentication_get_status(IGNORED_PTR_ARG));
 
     /* this is the call we're reall interested in */
@@ -972,32 +1491,12 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_subscribes_for_methods)
         .IgnoreArgument_on_methods_unsubscribed()
         .IgnoreArgument_on_methods_unsubscribed_context();
 
-    /* more uninteresting calls */
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    EXPECTED_CALL(messaging_create_source(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    EXPECTED_CALL(messaging_create_target(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    EXPECTED_CALL(link_create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, role_sender, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(link_set_max_message_size(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    EXPECTED_CALL(amqpvalue_create_map());
-    EXPECTED_CALL(amqpvalue_create_symbol(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_create_string(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_set_map_value(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(link_set_attach_properties(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
-    EXPECTED_CALL(messagesender_create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(messagesender_open(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
+    /* no events waiting, so no event sender is created and the device becomes idle */
+    EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     EXPECTED_CALL(connection_dowork(IGNORED_PTR_ARG));
 
     // act
@@ -1036,6 +1535,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_does_not_subscribe_if_SubScribe
     device_config.deviceKey = "cucu";
     device_config.deviceSasToken = NULL;
 
+    DList_InitializeListHead(&waitingToSend);
     handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
     device_handle = IoTHubTransport_AMQP_Common_Register(handle, &device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
     umock_c_reset_all_calls();
@@ -1049,33 +1549,14 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_does_not_subscribe_if_SubScribe
     EXPECTED_CALL(session_set_outgoing_window(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(connection_set_trace(IGNORED_PTR_ARG, false));
     EXPECTED_CALL(xio_setoption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     EXPECTED_CALL(authentication_get_status(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_construct(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    EXPECTED_CALL(messaging_create_source(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    EXPECTED_CALL(messaging_create_target(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    EXPECTED_CALL(link_create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, role_sender, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(link_set_max_message_size(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    EXPECTED_CALL(amqpvalue_create_map());
-    EXPECTED_CALL(amqpvalue_create_symbol(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_create_string(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_set_map_value(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(link_set_attach_properties(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
-    EXPECTED_CALL(messagesender_create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(messagesender_open(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
-    EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
+    /* no events waiting, so no event sender is created and the device becomes idle */
+    EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     EXPECTED_CALL(connection_dowork(IGNORED_PTR_ARG));
 
     // act
@@ -1114,17 +1595,17 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_does_not_subscribe_if_already_s
     device_config.deviceKey = "cucu";
     device_config.deviceSasToken = NULL;
 
+    DList_InitializeListHead(&waitingToSend);
     handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
     device_handle = IoTHubTransport_AMQP_Common_Register(handle, &device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
     (void)IoTHubTransport_AMQP_Common_Subscribe_DeviceMethod(device_handle);
     IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
     umock_c_reset_all_calls();
 
-    /* EXPECTED call because we don't really care about the arguments for simply testing that the methods subscribe happened */
+    /* the device went idle after subscribing, so it is only checked for events waiting to be sent */
     EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument_handle();
-    STRICT_EXPECTED_CALL(authentication_get_status(TEST_AUTHENTICATION_STATE_HANDLE));
+    EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
     STRICT_EXPECTED_CALL(connection_dowork(TEST_CONNECTION_HANDLE));
 
     // act
@@ -1358,4 +1839,54 @@ TEST_FUNCTION(on_methods_unsubscribed_calls_iothubtransportamqp_methods_unsubscr
 }
 #endif
 
+/* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_268: [Every IDLE_DEVICES_SWEEP_INTERVAL_MS, IoTHubTransport_AMQP_Common_DoWork shall move all idle devices to the active device list, so their authentication gets refreshed and idle links detached] */
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_activates_idle_devices_every_sweep_interval)
+{
+    // arrange
+    IOTHUB_CLIENT_CONFIG client_config;
+    IOTHUBTRANSPORT_CONFIG config;
+    IOTHUB_DEVICE_CONFIG device_config;
+    DLIST_ENTRY waitingToSend;
+    TRANSPORT_LL_HANDLE handle;
+
+    client_config.protocol = TEST_get_iothub_client_transport_provider;
+    client_config.deviceId = TEST_DEVICE_ID;
+    client_config.deviceKey = TEST_DEVICE_KEY;
+    client_config.deviceSasToken = TEST_DEVICE_SAS_TOKEN;
+    client_config.iotHubName = TEST_IOT_HUB_NAME;
+    client_config.iotHubSuffix = TEST_IOT_HUB_SUFFIX;
+    client_config.protocolGatewayHostName = TEST_PROT_GW_HOSTNAME;
+
+    config.upperConfig = &client_config;
+    config.waitingToSend = TEST_WAIT_TO_SEND_LIST;
+
+    device_config.deviceId = "blah";
+    device_config.deviceKey = "cucu";
+    device_config.deviceSasToken = NULL;
+
+    DList_InitializeListHead(&waitingToSend);
+    handle = IoTHubTransport_AMQP_Common_Create(&config, TEST_amqp_get_io_transport);
+    (void)IoTHubTransport_AMQP_Common_Register(handle, &device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+    // The device has nothing to do, so it goes idle.
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    g_current_ms = 4999;
+    umock_c_reset_all_calls();
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    bool checked_before_interval = (strstr(umock_c_get_actual_calls(), "authentication_get_status") != NULL);
+
+    g_current_ms = 5000;
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_IS_FALSE(checked_before_interval);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "authentication_get_status"));
+
+    // cleanup
+    IoTHubTransport_AMQP_Common_Destroy(handle);
+}
+
 END_TEST_SUITE(iothubtransport_amqp_common_ut)
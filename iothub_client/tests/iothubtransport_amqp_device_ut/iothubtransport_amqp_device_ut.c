@@ -39,7 +39,6 @@ void real_free(void* ptr)
 
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/gballoc.h"
-#include "azure_c_shared_utility/agenttime.h" 
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/uniqueid.h"
@@ -81,7 +80,7 @@ static const char* DEVICE_OPTION_SAVED_MESSENGER_OPTIONS = "saved_device_messeng
 #define DEFAULT_AUTH_STATE_CHANGED_TIMEOUT_SECS    60
 #define DEFAULT_MSGR_STATE_CHANGED_TIMEOUT_SECS    60
 
-#define INDEFINITE_TIME                                   ((time_t)-1)
+#define INDEFINITE_TIME                                   ((tickcounter_ms_t)(-1))
 #define TEST_DEVICE_ID_CHAR_PTR                           "bogus-device"
 #define TEST_IOTHUB_HOST_FQDN_CHAR_PTR                    "thisisabogus.azure-devices.net"
 #define TEST_ON_STATE_CHANGED_CONTEXT                     (void*)0x7710
@@ -104,28 +103,16 @@ static const char* DEVICE_OPTION_SAVED_MESSENGER_OPTIONS = "saved_device_messeng
 #define TEST_MSGR_OPTIONHANDLER_HANDLE                    (OPTIONHANDLER_HANDLE)0x7723
 #define TEST_ON_DEVICE_EVENT_SEND_COMPLETE_CONTEXT        (void*)0x7724
 #define TEST_IOTHUB_MESSAGE_LIST                          (IOTHUB_MESSAGE_LIST*)0x7725
+#define TEST_TICK_COUNTER_HANDLE                          (TICK_COUNTER_HANDLE)0x7726
 
-static time_t TEST_current_time;
+static tickcounter_ms_t TEST_current_time;
 
 
 // ---------- Time-related Test Helpers ---------- //
 
-static time_t add_seconds(time_t base_time, unsigned int seconds)
+static tickcounter_ms_t add_seconds(tickcounter_ms_t base_time, unsigned int seconds)
 {
-	time_t new_time;
-	struct tm *bd_new_time;
-
-	if ((bd_new_time = localtime(&base_time)) == NULL)
-	{
-		new_time = INDEFINITE_TIME;
-	}
-	else
-	{
-		bd_new_time->tm_sec += seconds;
-		new_time = mktime(bd_new_time);
-	}
-
-	return new_time;
+	return base_time + (tickcounter_ms_t)seconds * 1000;
 }
 
 
@@ -178,11 +165,6 @@ static int TEST_messenger_subscribe_for_messages(MESSENGER_HANDLE messenger_hand
 	return TEST_messenger_subscribe_for_messages_return;
 }
 
-static double TEST_get_difftime(time_t end_time, time_t start_time)
-{
-	return difftime(end_time, start_time);
-}
-
 static ON_AUTHENTICATION_STATE_CHANGED_CALLBACK TEST_authentication_create_saved_on_authentication_changed_callback;
 static void* TEST_authentication_create_saved_on_authentication_changed_context;
 static ON_AUTHENTICATION_ERROR_CALLBACK TEST_authentication_create_saved_on_error_callback;
@@ -289,7 +271,7 @@ static void initialize_test_variables()
 	TEST_on_state_changed_callback_saved_previous_state = DEVICE_STATE_STOPPED;
 	TEST_on_state_changed_callback_saved_new_state = DEVICE_STATE_STOPPED;
 
-	TEST_current_time = time(NULL);
+	TEST_current_time = 3600000;
 
 	TEST_on_message_received_saved_message = NULL;
 	TEST_on_message_received_saved_context = NULL;
@@ -333,7 +315,7 @@ static void register_umock_alias_types()
 	REGISTER_UMOCK_ALIAS_TYPE(const CBS_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(const SESSION_HANDLE, void*);
-	REGISTER_UMOCK_ALIAS_TYPE(time_t, long long);
+	REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(AUTHENTICATION_ERROR_CODE, int);
 	REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_RESULT, int);
@@ -350,7 +332,6 @@ static void register_global_mock_hooks()
 	REGISTER_GLOBAL_MOCK_HOOK(free, TEST_free);
 	REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, TEST_mallocAndStrcpy_s);
 	REGISTER_GLOBAL_MOCK_HOOK(messenger_subscribe_for_messages, TEST_messenger_subscribe_for_messages);
-	REGISTER_GLOBAL_MOCK_HOOK(get_difftime, TEST_get_difftime);
 	REGISTER_GLOBAL_MOCK_HOOK(authentication_create, TEST_authentication_create);
 	REGISTER_GLOBAL_MOCK_HOOK(messenger_create, TEST_messenger_create);
 	REGISTER_GLOBAL_MOCK_HOOK(messenger_send_async, TEST_messenger_send_async);
@@ -368,7 +349,11 @@ static void register_global_mock_returns()
 
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
 
-	REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, INDEFINITE_TIME);
+	REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+
+	REGISTER_GLOBAL_MOCK_RETURN(tickcounter_get_current_ms, 0);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, 1);
 
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_Create, NULL);
 
@@ -407,15 +392,15 @@ static void register_global_mock_returns()
 
 // ---------- Expected Call Helpers ---------- //
 
-static void set_expected_calls_for_is_timeout_reached(time_t current_time)
+static void set_expected_calls_for_get_current_time(tickcounter_ms_t current_time)
 {
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &current_time, sizeof(current_time));
+}
 
-	if (current_time != INDEFINITE_TIME)
-	{
-		STRICT_EXPECTED_CALL(get_difftime(current_time, IGNORED_NUM_ARG))
-			.IgnoreArgument(2); // let the function hook calculate the actual difftime.
-	}
+static void set_expected_calls_for_is_timeout_reached(tickcounter_ms_t current_time)
+{
+	set_expected_calls_for_get_current_time(current_time);
 }
 
 static void set_expected_calls_for_clone_device_config(DEVICE_CONFIG *config)
@@ -457,7 +442,7 @@ static void set_expected_calls_for_create_messenger_instance(DEVICE_CONFIG *conf
 	EXPECTED_CALL(messenger_create(IGNORED_PTR_ARG));
 }
 
-static void set_expected_calls_for_device_create(DEVICE_CONFIG *config, time_t current_time)
+static void set_expected_calls_for_device_create(DEVICE_CONFIG *config, tickcounter_ms_t current_time)
 {
 	(void)current_time;
 
@@ -471,16 +456,18 @@ static void set_expected_calls_for_device_create(DEVICE_CONFIG *config, time_t c
 	}
 
 	set_expected_calls_for_create_messenger_instance(config);
+
+	EXPECTED_CALL(tickcounter_create());
 }
 
-static void set_expected_calls_for_device_start_async(DEVICE_CONFIG* config, time_t current_time)
+static void set_expected_calls_for_device_start_async(DEVICE_CONFIG* config, tickcounter_ms_t current_time)
 {
 	(void)config;
 	(void)current_time;
 	// Nothing to expect from this function.
 }
 
-static void set_expected_calls_for_device_stop(DEVICE_CONFIG* config, time_t current_time, AUTHENTICATION_STATE auth_state, MESSENGER_STATE messenger_state)
+static void set_expected_calls_for_device_stop(DEVICE_CONFIG* config, tickcounter_ms_t current_time, AUTHENTICATION_STATE auth_state, MESSENGER_STATE messenger_state)
 {
 	(void)current_time;
 
@@ -495,7 +482,7 @@ static void set_expected_calls_for_device_stop(DEVICE_CONFIG* config, time_t cur
 	}
 }
 
-static void set_expected_calls_for_device_do_work(DEVICE_CONFIG* config, time_t current_time, DEVICE_STATE device_state, AUTHENTICATION_STATE auth_state, MESSENGER_STATE msgr_state)
+static void set_expected_calls_for_device_do_work(DEVICE_CONFIG* config, tickcounter_ms_t current_time, DEVICE_STATE device_state, AUTHENTICATION_STATE auth_state, MESSENGER_STATE msgr_state)
 {
 	if (device_state == DEVICE_STATE_STARTING)
 	{
@@ -538,7 +525,7 @@ static void set_expected_calls_for_device_do_work(DEVICE_CONFIG* config, time_t
 	}
 }
 
-static void set_expected_calls_for_device_destroy(DEVICE_HANDLE handle, DEVICE_CONFIG *config, time_t current_time, DEVICE_STATE device_state, AUTHENTICATION_STATE auth_state, MESSENGER_STATE msgr_state)
+static void set_expected_calls_for_device_destroy(DEVICE_HANDLE handle, DEVICE_CONFIG *config, tickcounter_ms_t current_time, DEVICE_STATE device_state, AUTHENTICATION_STATE auth_state, MESSENGER_STATE msgr_state)
 {
 	if (device_state == DEVICE_STATE_STARTED || device_state == DEVICE_STATE_STARTING)
 	{
@@ -555,6 +542,8 @@ static void set_expected_calls_for_device_destroy(DEVICE_HANDLE handle, DEVICE_C
 		STRICT_EXPECTED_CALL(authentication_destroy(TEST_AUTHENTICATION_HANDLE));
 	}
 
+	STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+
 	// destroy config
 	STRICT_EXPECTED_CALL(free(config->device_id));
 	STRICT_EXPECTED_CALL(free(config->iothub_host_fqdn));
@@ -601,7 +590,10 @@ static void set_expected_calls_for_device_set_option(DEVICE_HANDLE handle, DEVIC
 		}
 	}
 
-	if (strcmp(DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, option_name) == 0)
+	if (strcmp(DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, option_name) == 0 ||
+		strcmp(DEVICE_OPTION_EVENT_BATCHING, option_name) == 0 ||
+		strcmp(DEVICE_OPTION_C2D_ZERO_COPY, option_name) == 0 ||
+		strcmp(DEVICE_OPTION_RECEIVER_MAX_MESSAGE_SIZE, option_name) == 0)
 	{
 		STRICT_EXPECTED_CALL(messenger_set_option(TEST_MESSENGER_HANDLE, option_name, option_value));
 	}
@@ -627,14 +619,14 @@ static void set_expected_calls_for_device_send_async(DEVICE_CONFIG *config)
 
 // ---------- set_expected*-dependent Test Helpers ---------- //
 
-static DEVICE_HANDLE create_device(DEVICE_CONFIG* config, time_t current_time)
+static DEVICE_HANDLE create_device(DEVICE_CONFIG* config, tickcounter_ms_t current_time)
 {
 	umock_c_reset_all_calls();
 	set_expected_calls_for_device_create(config, current_time);
 	return device_create(config);
 }
 
-static DEVICE_HANDLE create_and_start_device(DEVICE_CONFIG* config, time_t current_time)
+static DEVICE_HANDLE create_and_start_device(DEVICE_CONFIG* config, tickcounter_ms_t current_time)
 {
 	DEVICE_HANDLE handle = create_device(config, current_time);
 
@@ -652,16 +644,16 @@ static DEVICE_HANDLE create_and_start_device(DEVICE_CONFIG* config, time_t curre
 	return handle;
 }
 
-static void crank_device_do_work(DEVICE_HANDLE handle, DEVICE_CONFIG* config, time_t current_time, DEVICE_STATE device_state, AUTHENTICATION_STATE auth_state, MESSENGER_STATE msgr_state)
+static void crank_device_do_work(DEVICE_HANDLE handle, DEVICE_CONFIG* config, tickcounter_ms_t current_time, DEVICE_STATE device_state, AUTHENTICATION_STATE auth_state, MESSENGER_STATE msgr_state)
 {
 	umock_c_reset_all_calls();
 	set_expected_calls_for_device_do_work(config, current_time, device_state, auth_state, msgr_state);
 	device_do_work(handle);
 }
 
-static void set_authentication_state(AUTHENTICATION_STATE previous_state, AUTHENTICATION_STATE new_state, time_t current_time)
+static void set_authentication_state(AUTHENTICATION_STATE previous_state, AUTHENTICATION_STATE new_state, tickcounter_ms_t current_time)
 {
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+	set_expected_calls_for_get_current_time(current_time);
 
 	TEST_authentication_create_saved_on_authentication_changed_callback(
 		TEST_authentication_create_saved_on_authentication_changed_context, 
@@ -669,9 +661,9 @@ static void set_authentication_state(AUTHENTICATION_STATE previous_state, AUTHEN
 		new_state);
 }
 
-static void set_messenger_state(MESSENGER_STATE previous_state, MESSENGER_STATE new_state, time_t current_time)
+static void set_messenger_state(MESSENGER_STATE previous_state, MESSENGER_STATE new_state, tickcounter_ms_t current_time)
 {
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+	set_expected_calls_for_get_current_time(current_time);
 
 	TEST_messenger_create_saved_on_state_changed_callback(
 		TEST_messenger_create_saved_on_state_changed_context, 
@@ -679,7 +671,7 @@ static void set_messenger_state(MESSENGER_STATE previous_state, MESSENGER_STATE
 		new_state);
 }
 
-static DEVICE_HANDLE create_and_start_and_crank_device(DEVICE_CONFIG* config, time_t current_time)
+static DEVICE_HANDLE create_and_start_and_crank_device(DEVICE_CONFIG* config, tickcounter_ms_t current_time)
 {
 	DEVICE_HANDLE handle = create_and_start_device(config, current_time);
 
@@ -813,6 +805,7 @@ TEST_FUNCTION(device_create_NULL_config_on_state_changed_callback)
 // Tests_SRS_DEVICE_09_004: [All `config` parameters shall be saved into `instance`]
 // Tests_SRS_DEVICE_09_006: [If `instance->authentication_mode` is DEVICE_AUTH_MODE_CBS, `instance->authentication_handle` shall be set using authentication_create()]
 // Tests_SRS_DEVICE_09_008: [`instance->messenger_handle` shall be set using messenger_create()]
+// Tests_SRS_DEVICE_09_111: [`instance->tick_counter` shall be set using tickcounter_create()]
 // Tests_SRS_DEVICE_09_011: [If device_create succeeds it shall return a handle to its `instance` structure]
 TEST_FUNCTION(device_create_succeeds)
 {
@@ -837,6 +830,7 @@ TEST_FUNCTION(device_create_succeeds)
 // Tests_SRS_DEVICE_09_005: [If any `config` parameters fail to be saved into `instance`, device_create shall fail and return NULL]
 // Tests_SRS_DEVICE_09_007: [If the AUTHENTICATION_HANDLE fails to be created, device_create shall fail and return NULL]
 // Tests_SRS_DEVICE_09_009: [If the MESSENGER_HANDLE fails to be created, device_create shall fail and return NULL]
+// Tests_SRS_DEVICE_09_112: [If tickcounter_create() fails, device_create shall fail and return NULL]
 // Tests_SRS_DEVICE_09_010: [If device_create fails it shall release all memory it has allocated]
 TEST_FUNCTION(device_create_failure_checks)
 {
@@ -1169,6 +1163,7 @@ TEST_FUNCTION(device_destroy_NULL_handle)
 // Tests_SRS_DEVICE_09_013: [If the device is in state DEVICE_STATE_STARTED or DEVICE_STATE_STARTING, device_stop() shall be invoked]
 // Tests_SRS_DEVICE_09_014: [`instance->messenger_handle shall be destroyed using messenger_destroy()`]
 // Tests_SRS_DEVICE_09_015: [If created, `instance->authentication_handle` shall be destroyed using authentication_destroy()`]
+// Tests_SRS_DEVICE_09_113: [`instance->tick_counter` shall be destroyed using tickcounter_destroy()]
 // Tests_SRS_DEVICE_09_016: [The contents of `instance->config` shall be detroyed and then it shall be freed]
 TEST_FUNCTION(device_destroy_DEVICE_STATE_STARTED_succeeds)
 {
@@ -1744,6 +1739,84 @@ TEST_FUNCTION(device_set_option_MSGR_succeeds)
 	device_destroy(handle);
 }
 
+// Tests_SRS_DEVICE_09_086: [If `name` refers to messenger module, it shall be passed along with `value` to messenger_set_option]
+TEST_FUNCTION(device_set_option_MSGR_EVENT_BATCHING_succeeds)
+{
+	// arrange
+	ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
+
+	DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS, true);
+	DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
+
+	bool value = true;
+
+	umock_c_reset_all_calls();
+	set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_EVENT_BATCHING, &value);
+
+	// act
+	int result = device_set_option(handle, DEVICE_OPTION_EVENT_BATCHING, &value);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_IS_NOT_NULL(handle);
+
+	// cleanup
+	device_destroy(handle);
+}
+
+// Tests_SRS_DEVICE_09_086: [If `name` refers to messenger module, it shall be passed along with `value` to messenger_set_option]
+TEST_FUNCTION(device_set_option_MSGR_C2D_ZERO_COPY_succeeds)
+{
+	// arrange
+	ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
+
+	DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS, true);
+	DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
+
+	bool value = true;
+
+	umock_c_reset_all_calls();
+	set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_C2D_ZERO_COPY, &value);
+
+	// act
+	int result = device_set_option(handle, DEVICE_OPTION_C2D_ZERO_COPY, &value);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_IS_NOT_NULL(handle);
+
+	// cleanup
+	device_destroy(handle);
+}
+
+// Tests_SRS_DEVICE_09_086: [If `name` refers to messenger module, it shall be passed along with `value` to messenger_set_option]
+TEST_FUNCTION(device_set_option_MSGR_RECEIVER_MAX_MESSAGE_SIZE_succeeds)
+{
+	// arrange
+	ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
+
+	DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS, true);
+	DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
+
+	uint64_t value = 1024 * 1024;
+
+	umock_c_reset_all_calls();
+	set_expected_calls_for_device_set_option(handle, config, DEVICE_OPTION_RECEIVER_MAX_MESSAGE_SIZE, &value);
+
+	// act
+	int result = device_set_option(handle, DEVICE_OPTION_RECEIVER_MAX_MESSAGE_SIZE, &value);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_IS_NOT_NULL(handle);
+
+	// cleanup
+	device_destroy(handle);
+}
+
 // Tests_SRS_DEVICE_09_088: [If `name` is DEVICE_OPTION_SAVED_AUTH_OPTIONS but CBS authentication is not being used, device_set_option shall return a non-zero result]
 TEST_FUNCTION(device_set_option_X509_saved_auth_options)
 {
@@ -2117,7 +2190,7 @@ TEST_FUNCTION(device_do_work_authentication_start_times_out)
 	DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS, true);
 	DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
 
-	time_t next_time = add_seconds(TEST_current_time, DEFAULT_AUTH_STATE_CHANGED_TIMEOUT_SECS + 1);
+	tickcounter_ms_t next_time = add_seconds(TEST_current_time, DEFAULT_AUTH_STATE_CHANGED_TIMEOUT_SECS + 1);
 
 	umock_c_reset_all_calls();
 	set_expected_calls_for_device_do_work(config, TEST_current_time, DEVICE_STATE_STARTING, AUTHENTICATION_STATE_STOPPED, MESSENGER_STATE_STOPPED);
@@ -2252,7 +2325,7 @@ TEST_FUNCTION(device_do_work_messenger_start_timeout)
 	DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS, true);
 	DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
 
-	time_t next_time = add_seconds(TEST_current_time, DEFAULT_MSGR_STATE_CHANGED_TIMEOUT_SECS + 1);
+	tickcounter_ms_t next_time = add_seconds(TEST_current_time, DEFAULT_MSGR_STATE_CHANGED_TIMEOUT_SECS + 1);
 
 	umock_c_reset_all_calls();
 	crank_device_do_work(handle, config, TEST_current_time, DEVICE_STATE_STARTING, AUTHENTICATION_STATE_STOPPED, MESSENGER_STATE_STOPPED);
@@ -2291,11 +2364,11 @@ TEST_FUNCTION(device_do_work_succeeds)
 	DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS, true);
 	DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
 
-	time_t t0 = TEST_current_time;
-	time_t t1 = add_seconds(t0, DEFAULT_AUTH_STATE_CHANGED_TIMEOUT_SECS - 1);
-	time_t t2 = add_seconds(t1, DEFAULT_MSGR_STATE_CHANGED_TIMEOUT_SECS - 2);
-	time_t t3 = add_seconds(t2, DEFAULT_MSGR_STATE_CHANGED_TIMEOUT_SECS - 1);
-	time_t t4 = add_seconds(t3, DEFAULT_MSGR_STATE_CHANGED_TIMEOUT_SECS + 1);
+	tickcounter_ms_t t0 = TEST_current_time;
+	tickcounter_ms_t t1 = add_seconds(t0, DEFAULT_AUTH_STATE_CHANGED_TIMEOUT_SECS - 1);
+	tickcounter_ms_t t2 = add_seconds(t1, DEFAULT_MSGR_STATE_CHANGED_TIMEOUT_SECS - 2);
+	tickcounter_ms_t t3 = add_seconds(t2, DEFAULT_MSGR_STATE_CHANGED_TIMEOUT_SECS - 1);
+	tickcounter_ms_t t4 = add_seconds(t3, DEFAULT_MSGR_STATE_CHANGED_TIMEOUT_SECS + 1);
 
 	umock_c_reset_all_calls();
 	crank_device_do_work(handle, config, t0, DEVICE_STATE_STARTING, AUTHENTICATION_STATE_STOPPED, MESSENGER_STATE_STOPPED);
@@ -41,7 +41,7 @@ void real_free(void* ptr)
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/optionhandler.h"
 #include "azure_uamqp_c/session.h"
@@ -132,19 +132,11 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_MESSAGE_DISPOSITION_ACCEPTED_AMQP_VALUE      (AMQP_VALUE)0x4471
 #define TEST_MESSAGE_DISPOSITION_ABANDONED_AMQP_VALUE     (AMQP_VALUE)0x4472
 #define TEST_MESSAGE_DISPOSITION_REJECTED_AMQP_VALUE      (AMQP_VALUE)0x4473
-#define TEST_SINGLYLINKEDLIST_HANDLE                      (SINGLYLINKEDLIST_HANDLE)0x4476
-#define TEST_LIST_ITEM_HANDLE                             (LIST_ITEM_HANDLE)0x4477
 #define TEST_SEND_EVENT_TASK                              (const void*)0x4478
 #define TEST_IOTHUB_CLIENT_HANDLE                         (void*)0x4479
 static IOTHUB_MESSAGE_LIST* TEST_IOTHUB_MESSAGE_LIST_HANDLE;
-static SINGLYLINKEDLIST_HANDLE TEST_WAIT_TO_SEND_LIST;
-static SINGLYLINKEDLIST_HANDLE TEST_IN_PROGRESS_LIST;
-#define TEST_WAIT_TO_SEND_LIST1                           (SINGLYLINKEDLIST_HANDLE)0x4481
-#define TEST_WAIT_TO_SEND_LIST2                           (SINGLYLINKEDLIST_HANDLE)0x4482
-#define TEST_IN_PROGRESS_LIST1                            (SINGLYLINKEDLIST_HANDLE)0x4483
-#define TEST_IN_PROGRESS_LIST2                            (SINGLYLINKEDLIST_HANDLE)0x4484
 #define TEST_OPTIONHANDLER_HANDLE                         (OPTIONHANDLER_HANDLE)0x4485
-#define INDEFINITE_TIME                                   ((time_t)-1)
+#define TEST_TICK_COUNTER_HANDLE                          (TICK_COUNTER_HANDLE)0x4486
 
 // Helpers
 
@@ -153,7 +145,16 @@ extern "C"
 {
 #endif
 
+void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+
 static int TEST_link_set_max_message_size_result;
+static uint64_t TEST_receiver_max_message_size;
 int TEST_amqpvalue_set_map_value_result;
 int TEST_link_set_attach_properties_result;
 
@@ -186,6 +187,15 @@ int STRING_sprintf(STRING_HANDLE handle, const char* format, ...)
 #endif
 
 
+static tickcounter_ms_t g_current_ms;
+
+static int TEST_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+	(void)tick_counter;
+	*current_ms = g_current_ms;
+	return 0;
+}
+
 static int saved_malloc_returns_count = 0;
 static void* saved_malloc_returns[20];
 
@@ -212,18 +222,6 @@ static void TEST_free(void* ptr)
 }
 
 
-static int saved_wait_to_send_list_count;
-static const void* saved_wait_to_send_list[20];
-
-static int saved_wait_to_send_list_count2;
-static const void* saved_wait_to_send_list2[20];
-
-static int saved_in_progress_list_count;
-static const void* saved_in_progress_list[20];
-
-static int saved_in_progress_list_count2;
-static const void* saved_in_progress_list2[20];
-
 static void* saved_on_state_changed_callback_context;
 static MESSENGER_STATE saved_on_state_changed_callback_previous_state;
 static MESSENGER_STATE saved_on_state_changed_callback_new_state;
@@ -312,12 +310,12 @@ typedef struct MESSENGER_DO_WORK_EXP_CALL_PROFILE_STRUCT
 	int wait_to_send_list_length;
 	int in_progress_list_length;
 	size_t send_event_timeout_secs;
-	time_t current_time;
+	tickcounter_ms_t current_time;
 } MESSENGER_DO_WORK_EXP_CALL_PROFILE;
 
 static MESSENGER_DO_WORK_EXP_CALL_PROFILE g_do_work_profile;
 
-static MESSENGER_DO_WORK_EXP_CALL_PROFILE* get_msgr_do_work_exp_call_profile(MESSENGER_STATE current_state, bool is_subscribed_for_messages, bool is_msg_rcvr_created, int wts_list_length, int ip_list_length, time_t current_time, size_t event_send_timeout_secs)
+static MESSENGER_DO_WORK_EXP_CALL_PROFILE* get_msgr_do_work_exp_call_profile(MESSENGER_STATE current_state, bool is_subscribed_for_messages, bool is_msg_rcvr_created, int wts_list_length, int ip_list_length, tickcounter_ms_t current_time, size_t event_send_timeout_secs)
 {
 	memset(&g_do_work_profile, 0, sizeof(MESSENGER_DO_WORK_EXP_CALL_PROFILE));
 	g_do_work_profile.current_state = current_state;
@@ -368,6 +366,15 @@ static int TEST_message_create_from_iothub_message(IOTHUB_MESSAGE_HANDLE iothub_
     return TEST_message_create_from_iothub_message_return;
 }
 
+#define TEST_ENCODED_EVENT_SIZE 10
+static int TEST_message_create_uamqp_encoding_from_iothub_message(IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+{
+    (void)message_handle;
+    body_binary_data->bytes = (const unsigned char*)TEST_malloc(TEST_ENCODED_EVENT_SIZE);
+    body_binary_data->length = TEST_ENCODED_EVENT_SIZE;
+
+    return 0;
+}
 
 static MESSAGE_HANDLE saved_IoTHubMessage_CreateFromUamqpMessage_uamqp_message;
 static int TEST_IoTHubMessage_CreateFromUamqpMessage_return;
@@ -400,225 +407,15 @@ static int TEST_messagesender_send(MESSAGE_SENDER_HANDLE message_sender, MESSAGE
 }
 
 
-static bool TEST_singlylinkedlist_add_fail_return = false;
-static LIST_ITEM_HANDLE TEST_singlylinkedlist_add(SINGLYLINKEDLIST_HANDLE list, const void* item)
-{
-	if (list == TEST_WAIT_TO_SEND_LIST1)
-	{
-		saved_wait_to_send_list[saved_wait_to_send_list_count++] = item;
-	}
-	else if (list == TEST_WAIT_TO_SEND_LIST2)
-	{
-		saved_wait_to_send_list2[saved_wait_to_send_list_count2++] = item;
-	}
-	else if (list == TEST_IN_PROGRESS_LIST1)
-	{
-		saved_in_progress_list[saved_in_progress_list_count++] = item;
-	}
-	else if (list == TEST_IN_PROGRESS_LIST2)
-	{
-		saved_in_progress_list2[saved_in_progress_list_count2++] = item;
-	}
-
-	return TEST_singlylinkedlist_add_fail_return ? NULL : (LIST_ITEM_HANDLE)item;
-}
-
-static int TEST_singlylinkedlist_remove_return = 0;
-static int TEST_singlylinkedlist_remove(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE item)
-{
-	const void** TEST_list = NULL;
-	int* TEST_list_count = NULL;
-
-	if (list == TEST_WAIT_TO_SEND_LIST1)
-	{
-		TEST_list = saved_wait_to_send_list;
-		TEST_list_count = &saved_wait_to_send_list_count;
-	}
-	else if (list == TEST_WAIT_TO_SEND_LIST2)
-	{
-		TEST_list = saved_wait_to_send_list2;
-		TEST_list_count = &saved_wait_to_send_list_count2;
-	}
-	else if (list == TEST_IN_PROGRESS_LIST1)
-	{
-		TEST_list = saved_in_progress_list;
-		TEST_list_count = &saved_in_progress_list_count;
-	}
-	else // i.e., "if (list == TEST_IN_PROGRESS_LIST2)"
-	{
-		TEST_list = saved_in_progress_list2;
-		TEST_list_count = &saved_in_progress_list_count2;
-	}
-
-	int i;
-	int item_found = 0;
-	for (i = 0; i < *TEST_list_count; i++)
-	{
-		if (item_found)
-		{
-			TEST_list[i - 1] = TEST_list[i];
-		}
-		else if (TEST_list[i] == item)
-		{
-			item_found = 1;
-		}
-	}
-
-	if (item_found)
-	{
-		(*TEST_list_count)--;
-	}
-
-	return item_found == 1 ? 0 : 1;
-}
-
-static LIST_ITEM_HANDLE TEST_singlylinkedlist_find(SINGLYLINKEDLIST_HANDLE list, LIST_MATCH_FUNCTION match_function, const void* match_context)
-{
-	(void)list;
-	(void)match_function;
-	return (LIST_ITEM_HANDLE)match_context;
-}
-
-static const void* TEST_singlylinkedlist_item_get_value(LIST_ITEM_HANDLE item_handle)
-{
-	return (const void*)item_handle;
-}
-
-static LIST_ITEM_HANDLE TEST_singlylinkedlist_get_head_item(SINGLYLINKEDLIST_HANDLE list)
-{
-	LIST_ITEM_HANDLE list_item;
-
-	if (list == TEST_WAIT_TO_SEND_LIST1)
-	{
-		if (saved_wait_to_send_list_count <= 0)
-		{
-			list_item = NULL;
-		}
-		else
-		{
-			list_item = (LIST_ITEM_HANDLE)saved_wait_to_send_list[0];
-		}
-	}
-	else if (list == TEST_WAIT_TO_SEND_LIST2)
-	{
-		if (saved_wait_to_send_list_count2 <= 0)
-		{
-			list_item = NULL;
-		}
-		else
-		{
-			list_item = (LIST_ITEM_HANDLE)saved_wait_to_send_list2[0];
-		}
-	}
-	else if (list == TEST_IN_PROGRESS_LIST1)
-	{
-		if (saved_in_progress_list_count <= 0)
-		{
-			list_item = NULL;
-		}
-		else
-		{
-			list_item = (LIST_ITEM_HANDLE)saved_in_progress_list[0];
-		}
-	}
-	else if (list == TEST_IN_PROGRESS_LIST2)
-	{
-		if (saved_in_progress_list_count2 <= 0)
-		{
-			list_item = NULL;
-		}
-		else
-		{
-			list_item = (LIST_ITEM_HANDLE)saved_in_progress_list2[0];
-		}
-	}
-	else
-	{
-		list_item = NULL;
-	}
-
-	return list_item;
-}
-
-static LIST_ITEM_HANDLE TEST_singlylinkedlist_get_next_item(LIST_ITEM_HANDLE item_handle)
-{
-	LIST_ITEM_HANDLE next_item = NULL;
-
-	int i;
-	int item_found = 0;
-	for (i = 0; i < saved_in_progress_list_count; i++)
-	{
-		if (item_found)
-		{
-			next_item = (LIST_ITEM_HANDLE)saved_in_progress_list[i];
-			break;
-		}
-		else if (saved_in_progress_list[i] == (void*)item_handle)
-		{
-			item_found = 1;
-		}
-	}
-
-	if (item_found == 0)
-	{
-		for (i = 0; i < saved_in_progress_list_count2; i++)
-		{
-			if (item_found)
-			{
-				next_item = (LIST_ITEM_HANDLE)saved_in_progress_list2[i];
-				break;
-			}
-			else if (saved_in_progress_list2[i] == (void*)item_handle)
-			{
-				item_found = 1;
-			}
-		}
-	}
-
-	if (item_found == 0)
-	{
-		for (i = 0; i < saved_wait_to_send_list_count2; i++)
-		{
-			if (item_found)
-			{
-				next_item = (LIST_ITEM_HANDLE)saved_wait_to_send_list2[i];
-				break;
-			}
-			else if (saved_wait_to_send_list2[i] == (void*)item_handle)
-			{
-				item_found = 1;
-			}
-		}
-	}
-
-	if (item_found == 0)
-	{
-		for (i = 0; i < saved_wait_to_send_list_count; i++)
-		{
-			if (item_found)
-			{
-				next_item = (LIST_ITEM_HANDLE)saved_wait_to_send_list[i];
-				break;
-			}
-			else if (saved_wait_to_send_list[i] == (void*)item_handle)
-			{
-				item_found = 1;
-			}
-		}
-	}
-
-	return next_item;
-}
-
-
 static void set_expected_calls_for_messenger_create(MESSENGER_CONFIG* config)
 {
     EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
     // memset() - not mocked.
+    EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(STRING_construct(config->device_id)).SetReturn(TEST_DEVICE_ID_STRING_HANDLE);
     STRICT_EXPECTED_CALL(STRING_construct(config->iothub_host_fqdn)).SetReturn(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE);
-	STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(TEST_WAIT_TO_SEND_LIST);
-	STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(TEST_IN_PROGRESS_LIST);
+    STRICT_EXPECTED_CALL(tickcounter_create());
 }
 
 static void set_expected_calls_for_attach_device_client_type_to_link(LINK_HANDLE link_handle, int amqpvalue_set_map_value_result, int link_set_attach_properties_result)
@@ -678,7 +475,7 @@ static void set_expected_calls_for_message_receiver_create()
 
     STRICT_EXPECTED_CALL(link_set_rcv_settle_mode(TEST_MESSAGE_RECEIVER_LINK_HANDLE, receiver_settle_mode_first)).IgnoreArgument(2);
 
-    STRICT_EXPECTED_CALL(link_set_max_message_size(TEST_MESSAGE_RECEIVER_LINK_HANDLE, MESSAGE_RECEIVER_MAX_LINK_SIZE));
+    STRICT_EXPECTED_CALL(link_set_max_message_size(TEST_MESSAGE_RECEIVER_LINK_HANDLE, TEST_receiver_max_message_size));
 
     set_expected_calls_for_attach_device_client_type_to_link(TEST_MESSAGE_RECEIVER_LINK_HANDLE, 0, 0);
 
@@ -707,7 +504,7 @@ static void set_expected_calls_for_message_receiver_destroy()
 static void set_expected_calls_for_messenger_send_async()
 {
 	EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
-	EXPECTED_CALL(singlylinkedlist_add(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 }
 
 static IOTHUB_MESSAGE_LIST* TEST_on_event_send_complete_message;
@@ -813,149 +610,66 @@ static void set_expected_calls_for_messenger_stop(int wait_to_send_list_length,
 		set_expected_calls_for_message_receiver_destroy();
 	}
 
-	// remove timed out events
-	if (in_progress_list_length <= 0)
-	{
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
-	}
-	else
-	{
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-
-		int i;
-		for (i = 0; i < in_progress_list_length; i++)
-		{
-			EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-			// por fazer: adicionar codigo para remover items prescritos.
-
-			if (i < (in_progress_list_length - 1))
-			{
-				EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-			}
-			else
-			{
-				EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG)).SetReturn(NULL);
-			}
-		}
-	}
+	// remove timed out events: none are timed out, so in_progress_list is only traversed.
 
 	// Move events to wts list
-	if (in_progress_list_length <= 0)
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+	if (wait_to_send_list_length > 0)
 	{
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
+		EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+		EXPECTED_CALL(DList_AppendTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+		EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
 	}
-	else
-	{
-		SINGLYLINKEDLIST_HANDLE new_wts_list = (TEST_WAIT_TO_SEND_LIST == TEST_WAIT_TO_SEND_LIST1 ? TEST_WAIT_TO_SEND_LIST2 : TEST_WAIT_TO_SEND_LIST1);
-		SINGLYLINKEDLIST_HANDLE new_ip_list = (TEST_IN_PROGRESS_LIST == TEST_IN_PROGRESS_LIST1 ? TEST_IN_PROGRESS_LIST2 : TEST_IN_PROGRESS_LIST1);
-
-		// rest of function
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-		STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(new_wts_list);
-
-		// Moving in_progress_list items to the new wts list.
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-		int i;
-		for (i = 0; i < in_progress_list_length; i++)
-		{
-			EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-			EXPECTED_CALL(singlylinkedlist_add(new_wts_list, IGNORED_PTR_ARG));
-			EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-		}
 
-		// Moving wts (wait to send) list items to the new wts list.
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
-		for (i = 0; i < wait_to_send_list_length; i++)
-		{
-			EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-			EXPECTED_CALL(singlylinkedlist_add(new_wts_list, IGNORED_PTR_ARG));
-			EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-		}
-
-		STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(new_ip_list);
-		STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_WAIT_TO_SEND_LIST));
-		STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_IN_PROGRESS_LIST));
-		TEST_WAIT_TO_SEND_LIST = new_wts_list;
-		TEST_IN_PROGRESS_LIST = new_ip_list;
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+	if ((wait_to_send_list_length + in_progress_list_length) > 0)
+	{
+		EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+		EXPECTED_CALL(DList_AppendTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+		EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
 	}
 }
 
 static void set_expected_calls_for_on_message_send_complete()
 {
-	STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument_match_context()
-		.IgnoreArgument_match_function();
-	STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG)).IgnoreArgument_item_handle();
+	EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
 	EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
-static void set_expected_calls_for_message_do_work_send_pending_events(int number_of_events_pending, time_t current_time)
+static void set_expected_calls_for_message_do_work_send_pending_events(int number_of_events_pending)
 {
 	int i;
 	for (i = 0; i < number_of_events_pending; i++)
     {
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
-		EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-		STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG)).IgnoreArgument(2);
-		STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG)).IgnoreArgument(2);
+		EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+		EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+		EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
         STRICT_EXPECTED_CALL(message_create_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG))
             .IgnoreArgument(2);
 
         STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2).IgnoreArgument(3).IgnoreArgument(4);
-		STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
-
         EXPECTED_CALL(message_destroy(IGNORED_PTR_ARG));
+		STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
     }
 
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 }
 
-static time_t add_seconds(time_t base_time, int seconds)
+static void set_expected_calls_for_process_event_send_timeouts(size_t in_progress_list_length, size_t send_event_timeout_secs)
 {
-	time_t new_time;
-	struct tm *bd_new_time;
-
-	if ((bd_new_time = localtime(&base_time)) == NULL)
-	{
-		new_time = INDEFINITE_TIME;
-	}
-	else
-	{
-		bd_new_time->tm_sec += seconds;
-		new_time = mktime(bd_new_time);
-	}
-
-	return new_time;
-}
-
-static void set_expected_calls_for_process_event_send_timeouts(size_t in_progress_list_length, size_t send_event_timeout_secs, time_t current_time)
-{
-	if (in_progress_list_length <= 0)
-	{
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
-	}
-	else
+	// in_progress_list is traversed directly through its entries, and the current time is taken only once.
+	if (in_progress_list_length > 0 && send_event_timeout_secs > 0)
 	{
-		time_t send_time = add_seconds(current_time, -1 * (int)send_event_timeout_secs);
-
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-		
-		for (; in_progress_list_length > 0; in_progress_list_length--)
-		{
-			EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-			STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
-			EXPECTED_CALL(get_difftime(current_time, send_time)).SetReturn(difftime(current_time, send_time));
-			EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-		}
-
-		EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG)).SetReturn(NULL);
+		STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
 	}
 }
 
 static void set_expected_calls_for_messenger_do_work(MESSENGER_DO_WORK_EXP_CALL_PROFILE *profile)
 {
+	g_current_ms = profile->current_time;
+
 	if (profile->current_state == MESSENGER_STATE_STARTING)
 	{
 		set_expected_calls_for_message_sender_create();
@@ -971,9 +685,9 @@ static void set_expected_calls_for_messenger_do_work(MESSENGER_DO_WORK_EXP_CALL_
 			set_expected_calls_for_message_receiver_destroy();
 		}
 
-		set_expected_calls_for_process_event_send_timeouts(profile->in_progress_list_length, profile->send_event_timeout_secs, profile->current_time);
+		set_expected_calls_for_process_event_send_timeouts(profile->in_progress_list_length, profile->send_event_timeout_secs);
 
-		set_expected_calls_for_message_do_work_send_pending_events(profile->wait_to_send_list_length, profile->current_time);
+		set_expected_calls_for_message_do_work_send_pending_events(profile->wait_to_send_list_length);
 	}
 }
 
@@ -983,34 +697,31 @@ static void set_expected_calls_for_messenger_destroy(MESSENGER_CONFIG* config, M
 
 	set_expected_calls_for_messenger_stop(wait_to_send_list_length, in_progress_list_length, destroy_message_receiver);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STOPPING, false, false, wait_to_send_list_length, in_progress_list_length, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	do_work_profile->destroy_message_sender = destroy_message_sender;
 	do_work_profile->destroy_message_receiver = destroy_message_receiver;
 	set_expected_calls_for_messenger_do_work(do_work_profile);
 
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 
 	wait_to_send_list_length += in_progress_list_length; // all events from in_progress_list should have been moved to wts list.
 
 	while (wait_to_send_list_length > 0)
 	{
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST)); 
-		EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-		STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG)).IgnoreArgument(2);
+		EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+		EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
 		EXPECTED_CALL(free(IGNORED_PTR_ARG)); // Freeing the SEND_EVENT_TASK instance.
 
 		wait_to_send_list_length--;
 	}
 
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST)).SetReturn(NULL);
-
-	STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_WAIT_TO_SEND_LIST));
-	STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_IN_PROGRESS_LIST));
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 
 	STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
 	STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICE_ID_STRING_HANDLE));
+	STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
 	STRICT_EXPECTED_CALL(free(messenger_handle));
 }
 
@@ -1055,13 +766,13 @@ static void crank_messenger_do_work(MESSENGER_HANDLE handle, MESSENGER_DO_WORK_E
 
 	if (profile->create_message_sender && saved_messagesender_create_on_message_sender_state_changed != NULL)
 	{
-		STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(profile->current_time);
+		STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
 		saved_messagesender_create_on_message_sender_state_changed(saved_messagesender_create_context, MESSAGE_SENDER_STATE_OPEN, MESSAGE_SENDER_STATE_IDLE);
 	}
 
 	if (profile->create_message_receiver && saved_messagereceiver_create_on_message_receiver_state_changed != NULL)
 	{
-		STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(profile->current_time);
+		STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
 		saved_messagereceiver_create_on_message_receiver_state_changed(saved_messagereceiver_create_context, MESSAGE_RECEIVER_STATE_OPEN, MESSAGE_RECEIVER_STATE_IDLE);
 	}
 }
@@ -1070,7 +781,7 @@ static MESSENGER_HANDLE create_and_start_messenger2(MESSENGER_CONFIG* config, bo
 {
 	MESSENGER_HANDLE handle = create_and_start_messenger(config);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTING, false, false, 0, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	do_work_profile->create_message_sender = true;
@@ -1122,9 +833,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_RECEIVED, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_RECEIVER_STATE_CHANGED, void*);
     REGISTER_UMOCK_ALIAS_TYPE(receiver_settle_mode, int);
-	REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
-	REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
-	REGISTER_UMOCK_ALIAS_TYPE(LIST_MATCH_FUNCTION, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MESSENGER_SEND_STATUS, int);
 	REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_RESULT, int);
@@ -1132,6 +842,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(pfDestroyOption, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(pfSetOption, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(time_t, int);
+	REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(BINARY_DATA, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(malloc, TEST_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(free, TEST_free);
@@ -1140,20 +852,20 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_create, TEST_messagereceiver_create);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_open, TEST_messagereceiver_open);
     REGISTER_GLOBAL_MOCK_HOOK(message_create_from_iothub_message, TEST_message_create_from_iothub_message);
+    REGISTER_GLOBAL_MOCK_HOOK(message_create_uamqp_encoding_from_iothub_message, TEST_message_create_uamqp_encoding_from_iothub_message);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromUamqpMessage, TEST_IoTHubMessage_CreateFromUamqpMessage);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, TEST_singlylinkedlist_add);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, TEST_singlylinkedlist_remove);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, TEST_singlylinkedlist_item_get_value);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_next_item, TEST_singlylinkedlist_get_next_item);
-	REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, TEST_singlylinkedlist_find);
-	
-
-	REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_remove, 0);
-	REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_remove, 555);
-
-	REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_add, TEST_LIST_ITEM_HANDLE);
-	REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_add, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateViewFromUamqpMessage, TEST_IoTHubMessage_CreateFromUamqpMessage);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+	REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+	REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, TEST_tickcounter_get_current_ms);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
 
     REGISTER_GLOBAL_MOCK_RETURN(STRING_construct, TEST_STRING_HANDLE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct, NULL);
@@ -1188,6 +900,15 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(message_create_from_iothub_message, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_create_from_iothub_message, 1);
 
+    REGISTER_GLOBAL_MOCK_RETURN(message_create, TEST_MESSAGE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_create, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(message_set_message_format, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_set_message_format, 1);
+
+    REGISTER_GLOBAL_MOCK_RETURN(message_add_body_amqp_data, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_add_body_amqp_data, 1);
+
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_map, TEST_LINK_ATTACH_PROPERTIES);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_map, NULL);
 
@@ -1247,15 +968,6 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 
     saved_malloc_returns_count = 0;
 
-	TEST_WAIT_TO_SEND_LIST = TEST_WAIT_TO_SEND_LIST1;
-	TEST_IN_PROGRESS_LIST = TEST_IN_PROGRESS_LIST1;
-
-	TEST_singlylinkedlist_add_fail_return = false;
-	saved_wait_to_send_list_count = 0;
-	saved_wait_to_send_list_count2 = 0;
-	saved_in_progress_list_count = 0;
-	saved_in_progress_list_count2 = 0;
-	
     saved_messagesender_create_link = NULL;
     saved_messagesender_create_on_message_sender_state_changed = NULL;
     saved_messagesender_create_context = NULL;
@@ -1288,12 +1000,15 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     TEST_on_new_message_received_callback_result = MESSENGER_DISPOSITION_RESULT_ACCEPTED;
 
     TEST_link_set_max_message_size_result = 0;
+    TEST_receiver_max_message_size = MESSAGE_RECEIVER_MAX_LINK_SIZE;
     TEST_amqpvalue_set_map_value_result = 0;
     TEST_link_set_attach_properties_result = 0;
 
 	TEST_on_event_send_complete_message = NULL;
 	TEST_on_event_send_complete_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_OK;
 	TEST_on_event_send_complete_context = NULL;
+
+	g_current_ms = 0;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -1358,8 +1073,8 @@ TEST_FUNCTION(messenger_create_config_NULL_iothub_host_fqdn)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_006: [messenger_create() shall allocate memory for the messenger instance structure (aka `instance`)]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_008: [messenger_create() shall save a copy of `messenger_config->device_id` into `instance->device_id`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_010: [messenger_create() shall save a copy of `messenger_config->iothub_host_fqdn` into `instance->iothub_host_fqdn`]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_165: [`instance->wait_to_send_list` shall be set using singlylinkedlist_create()]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_132: [`instance->in_progress_list` shall be set using singlylinkedlist_create()]   
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_165: [`instance->wait_to_send_list` shall be initialized using DList_InitializeListHead()]  
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_132: [`instance->in_progress_list` shall be initialized using DList_InitializeListHead()]   
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_013: [`messenger_config->on_state_changed_callback` shall be saved into `instance->on_state_changed_callback`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_014: [`messenger_config->on_state_changed_context` shall be saved into `instance->on_state_changed_context`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_015: [If no failures occurr, messenger_create() shall return a handle to `instance`]
@@ -1385,8 +1100,6 @@ TEST_FUNCTION(messenger_create_success)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_007: [If malloc() fails, messenger_create() shall fail and return NULL]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_009: [If STRING_construct() fails, messenger_create() shall fail and return NULL]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_011: [If STRING_construct() fails, messenger_create() shall fail and return NULL] 
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_166: [If singlylinkedlist_create() fails, messenger_create() shall fail and return NULL]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_133: [If singlylinkedlist_create() fails, messenger_create() shall fail and return NULL]
 TEST_FUNCTION(messenger_create_failure_checks)
 {
     // arrange
@@ -1402,7 +1115,7 @@ TEST_FUNCTION(messenger_create_failure_checks)
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 3)
+        if (i == 1 || i == 2)
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -1512,7 +1225,7 @@ TEST_FUNCTION(messenger_state_on_event_sender_state_changed_callback_OPEN)
 	MESSENGER_CONFIG* config = get_messenger_config();
 	MESSENGER_HANDLE handle = create_and_start_messenger(config);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTING, false, false, 0, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	set_expected_calls_for_messenger_do_work(do_work_profile);
@@ -1539,7 +1252,7 @@ TEST_FUNCTION(messenger_state_on_event_sender_state_changed_callback_ERROR)
     MESSENGER_CONFIG* config = get_messenger_config();
     MESSENGER_HANDLE handle = create_and_start_messenger(config);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTING, false, false, 0, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	set_expected_calls_for_messenger_do_work(do_work_profile);
 	messenger_do_work(handle);
@@ -1640,10 +1353,9 @@ TEST_FUNCTION(messenger_destroy_NULL_handle)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_063: [`instance->sender_link` shall be destroyed using link_destroy()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_064: [`instance->receiver_link` shall be destroyed using link_destroy()] 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_162: [If `instance->state` is MESSENGER_STATE_STOPPING, messenger_do_work() shall move all items from `instance->in_progress_list` to the beginning of `instance->wait_to_send_list`]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_164: [If all items get successfuly moved back to `instance->wait_to_send_list`, `instance->state` shall be set to MESSENGER_STATE_STOPPED, and `instance->on_state_changed_callback` invoked]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_164: [`instance->state` shall be set to MESSENGER_STATE_STOPPED, and `instance->on_state_changed_callback` invoked]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_110: [If the `instance->state` is not MESSENGER_STATE_STOPPED, messenger_destroy() shall invoke messenger_stop() and messenger_do_work() once]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_111: [All elements of `instance->in_progress_list` and `instance->wait_to_send_list` shall be removed, invoking `task->on_event_send_complete_callback` for each with MESSENGER_EVENT_SEND_COMPLETE_RESULT_MESSENGER_DESTROYED]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_150: [`instance->in_progress_list` and `instance->wait_to_send_list` shall be destroyed using singlylinkedlist_destroy()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_112: [`instance->iothub_host_fqdn` shall be destroyed using STRING_delete()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_113: [`instance->device_id` shall be destroyed using STRING_delete()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_114: [messenger_destroy() shall destroy `instance` with free()] 
@@ -1655,7 +1367,7 @@ TEST_FUNCTION(messenger_destroy_succeeds)
 
 	ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE* mdecp = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, true, true, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	crank_messenger_do_work(handle, mdecp);
 
@@ -1673,37 +1385,6 @@ TEST_FUNCTION(messenger_destroy_succeeds)
     // cleanup
 }
 
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_163: [If not all items from `instance->in_progress_list` can be moved back to `instance->wait_to_send_list`, `instance->state` shall be set to MESSENGER_STATE_ERROR, and `instance->on_state_changed_callback` invoked]
-TEST_FUNCTION(messenger_destroy_FAIL_TO_ROLLBACK_EVENTS)
-{
-	// arrange
-	MESSENGER_CONFIG* config = get_messenger_config();
-	MESSENGER_HANDLE handle = create_and_start_messenger2(config, true);
-
-	ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
-
-	time_t current_time = time(NULL);
-	MESSENGER_DO_WORK_EXP_CALL_PROFILE* mdecp = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, true, true, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
-	crank_messenger_do_work(handle, mdecp);
-
-	ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
-
-	umock_c_reset_all_calls();
-	set_expected_calls_for_message_sender_destroy();
-	set_expected_calls_for_message_receiver_destroy();
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-	STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(NULL);
-
-	// act
-	messenger_destroy(handle);
-
-	// assert
-	ASSERT_ARE_EQUAL(int, MESSENGER_STATE_STOPPING, saved_on_state_changed_callback_previous_state);
-	ASSERT_ARE_EQUAL(int, MESSENGER_STATE_ERROR, saved_on_state_changed_callback_new_state);
-
-	// cleanup
-}
-
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_065: [If `messenger_handle` is NULL, messenger_do_work() shall fail and return]
 TEST_FUNCTION(messenger_do_work_NULL_handle)
 {
@@ -1766,7 +1447,7 @@ TEST_FUNCTION(messenger_do_work_send_events_success)
 	set_expected_calls_for_messenger_send_async();
 	int result = messenger_send_async(handle, TEST_IOTHUB_MESSAGE_LIST_HANDLE, TEST_on_event_send_complete, TEST_IOTHUB_CLIENT_HANDLE);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, false, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 
 	umock_c_reset_all_calls();
@@ -1783,6 +1464,150 @@ TEST_FUNCTION(messenger_do_work_send_events_success)
     messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_195: [messenger_do_work() shall get the current time only once per call to evaluate the event send timeouts, using tickcounter_get_current_ms()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_196: [messenger_do_work() shall stop evaluating event send timeouts at the first event in `instance->in_progress_list` that has not timed out]
+TEST_FUNCTION(messenger_do_work_event_send_timeouts_in_deadline_order)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+	tickcounter_ms_t first_send_time = g_current_ms;
+
+	ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+	crank_messenger_do_work(handle, get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, false, 1, 0, first_send_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS));
+
+	ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+	crank_messenger_do_work(handle, get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, false, 1, 1, first_send_time + 5000, DEFAULT_EVENT_SEND_TIMEOUT_SECS));
+
+	// Only the first event is past its deadline.
+	g_current_ms = first_send_time + DEFAULT_EVENT_SEND_TIMEOUT_SECS * 1000 + 1;
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+
+	// act
+	messenger_do_work(handle);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_TIMEOUT, TEST_on_event_send_complete_result);
+
+	// The first event is already flagged, the second one is still within its deadline.
+	TEST_on_event_send_complete_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_OK;
+	messenger_do_work(handle);
+	ASSERT_ARE_EQUAL(int, MESSENGER_EVENT_SEND_COMPLETE_RESULT_OK, TEST_on_event_send_complete_result);
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_154: [A MESSAGE_HANDLE shall be obtained out of the event's IOTHUB_MESSAGE_HANDLE instance by using message_create_from_iothub_message()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_159: [The MESSAGE_HANDLE shall be destroyed using message_destroy().]
+TEST_FUNCTION(messenger_do_work_send_events_retry_does_not_keep_the_message)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+	ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+
+	tickcounter_ms_t current_time = g_current_ms;
+	MESSENGER_DO_WORK_EXP_CALL_PROFILE *mdwp = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, false, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+	crank_messenger_do_work(handle, mdwp);
+
+	// The event in progress goes back to the wait-to-send list; no MESSAGE_HANDLE was kept for it.
+	(void)messenger_stop(handle);
+	(void)messenger_start(handle, TEST_SESSION_HANDLE);
+	mdwp = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTING, false, false, 0, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+	crank_messenger_do_work(handle, mdwp);
+
+	umock_c_reset_all_calls();
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(message_create_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_HANDLE));
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+
+	// act
+	messenger_do_work(handle);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_190: [If `instance->event_batching_enabled` is true, the pending events shall be sent packed in batched AMQP messages]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_181: [If `instance->event_batching_enabled` is true, each event not yet encoded shall be encoded using message_create_uamqp_encoding_from_iothub_message() and the encoding saved in the task for retries]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_192: [The encoding saved in the task shall be freed only when the task is destroyed]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_184: [A batched MESSAGE_HANDLE shall be created using message_create() and its format set to AMQP_BATCHING_FORMAT_CODE using message_set_message_format()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_185: [The encoded event shall be added to the batched MESSAGE_HANDLE as a data section using message_add_body_amqp_data()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_186: [The batched MESSAGE_HANDLE shall be submitted for sending using messagesender_send(), passing `internal_on_event_send_complete_callback` and the first event of the batch as context]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_188: [The batched MESSAGE_HANDLE shall be destroyed using message_destroy()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_180: [If the event was sent in a batched message, the following shall be done for each event packed in that message]
+TEST_FUNCTION(messenger_do_work_send_events_in_batch_success)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+	bool batching = true;
+	ASSERT_ARE_EQUAL(int, 0, messenger_set_option(handle, MESSENGER_OPTION_EVENT_BATCHING, &batching));
+	ASSERT_ARE_EQUAL(int, 2, send_events(handle, 2));
+
+	umock_c_reset_all_calls();
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(message_create());
+	STRICT_EXPECTED_CALL(message_set_message_format(TEST_MESSAGE_HANDLE, 0x80013700));
+	EXPECTED_CALL(message_add_body_amqp_data(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	EXPECTED_CALL(message_add_body_amqp_data(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_HANDLE));
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
+
+	// act
+	messenger_do_work(handle);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_NOT_NULL(saved_messagesender_send_on_message_send_complete);
+
+	umock_c_reset_all_calls();
+	EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+	EXPECTED_CALL(free(IGNORED_PTR_ARG)); // the cached encoding
+	EXPECTED_CALL(free(IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+	EXPECTED_CALL(free(IGNORED_PTR_ARG)); // the cached encoding
+	EXPECTED_CALL(free(IGNORED_PTR_ARG));
+	TEST_on_event_send_complete_result = MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING;
+
+	saved_messagesender_send_on_message_send_complete(saved_messagesender_send_callback_context, MESSAGE_SEND_OK);
+
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, MESSENGER_EVENT_SEND_COMPLETE_RESULT_OK, TEST_on_event_send_complete_result);
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_067: [If `instance->receive_messages` is true and `instance->message_receiver` is NULL, a message_receiver shall be created]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_068: [A variable, named `devices_path`, shall be created concatenating `instance->iothub_host_fqdn`, "/devices/" and `instance->device_id`]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_070: [A variable, named `message_receive_address`, shall be created concatenating "amqps://", `devices_path` and "/messages/devicebound"]  
@@ -1803,7 +1628,34 @@ TEST_FUNCTION(messenger_do_work_create_message_receiver)
 
     (void)messenger_subscribe_for_messages(handle, TEST_on_new_message_received_callback, TEST_ON_NEW_MESSAGE_RECEIVED_CB_CONTEXT);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
+	MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, true, false, 0, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+	umock_c_reset_all_calls();
+	set_expected_calls_for_messenger_do_work(do_work_profile);
+
+    // act
+    messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_200: [If MESSENGER_OPTION_RECEIVER_MAX_MESSAGE_SIZE was set, its value shall be used as the maximum message size of `instance->receiver_link` instead of 65536]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_201: [If name matches MESSENGER_OPTION_RECEIVER_MAX_MESSAGE_SIZE, the uint64_t `value` shall be saved on `instance->receiver_max_message_size`, to be applied to message receiver links created afterwards]
+TEST_FUNCTION(messenger_do_work_create_message_receiver_with_RECEIVER_MAX_MESSAGE_SIZE)
+{
+    // arrange
+    MESSENGER_CONFIG* config = get_messenger_config();
+    MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    TEST_receiver_max_message_size = 1024 * 1024;
+    ASSERT_ARE_EQUAL(int, 0, messenger_set_option(handle, MESSENGER_OPTION_RECEIVER_MAX_MESSAGE_SIZE, &TEST_receiver_max_message_size));
+    (void)messenger_subscribe_for_messages(handle, TEST_on_new_message_received_callback, TEST_ON_NEW_MESSAGE_RECEIVED_CB_CONTEXT);
+
+	tickcounter_ms_t current_time = g_current_ms;
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, true, false, 0, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	umock_c_reset_all_calls();
 	set_expected_calls_for_messenger_do_work(do_work_profile);
@@ -1941,7 +1793,7 @@ TEST_FUNCTION(messenger_state_on_message_receiver_state_changed_callback_ERROR)
     MESSENGER_CONFIG* config = get_messenger_config();
     MESSENGER_HANDLE handle = create_and_start_messenger2(config, true);
 
-	STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(time(NULL));
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
 
     // act
     ASSERT_IS_NOT_NULL(saved_messagereceiver_create_on_message_receiver_state_changed);
@@ -1975,7 +1827,7 @@ TEST_FUNCTION(messenger_do_work_destroy_message_receiver)
 
     (void)messenger_unsubscribe_for_messages(handle);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, true, 0, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	umock_c_reset_all_calls();
 	set_expected_calls_for_messenger_do_work(do_work_profile);
@@ -2001,7 +1853,7 @@ TEST_FUNCTION(messenger_do_work_on_event_send_complete_OK)
 
 	send_events(handle, 1);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *mdwp = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, false, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	crank_messenger_do_work(handle, mdwp);
 
@@ -2034,7 +1886,7 @@ TEST_FUNCTION(messenger_do_work_on_event_send_complete_ERROR)
 
 	send_events(handle, 1);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *mdwp = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, false, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	crank_messenger_do_work(handle, mdwp);
 
@@ -2067,22 +1919,14 @@ TEST_FUNCTION(messenger_do_work_send_events_message_create_from_iothub_message_f
 	ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
 
 	umock_c_reset_all_calls();
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
-	EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-	STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG))
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG))
-		.IgnoreArgument(2);
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+	EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 	STRICT_EXPECTED_CALL(message_create_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG))
 		.IgnoreArgument(2).SetReturn(1);
-	STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument_match_context()
-		.IgnoreArgument_match_function();
-	STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG))
-		.IgnoreArgument(2);
+	EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
 	EXPECTED_CALL(free(IGNORED_PTR_ARG));
-	STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST)).SetReturn(NULL);
+	EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
 
     // act
     messenger_do_work(handle);
@@ -2115,26 +1959,16 @@ TEST_FUNCTION(messenger_do_work_send_events_messagesender_send_fails)
 		ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
 
 		umock_c_reset_all_calls();
-		// timeout checks
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
-		
 		// send events
-		STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
-		EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-		STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG))
-			.IgnoreArgument(2);
-		STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG))
-			.IgnoreArgument(2);
+		EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+		EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+		EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 		STRICT_EXPECTED_CALL(message_create_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG))
 			.IgnoreArgument(2);
 		STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreArgument(2).IgnoreArgument(3).IgnoreArgument(4).SetReturn(1);
-		EXPECTED_CALL(get_time(NULL)).SetReturn(INDEFINITE_TIME);
 		EXPECTED_CALL(message_destroy(IGNORED_PTR_ARG));
-		STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreArgument_match_function()
-			.IgnoreArgument_match_context();
-		STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_IN_PROGRESS_LIST, IGNORED_PTR_ARG)).IgnoreArgument(2);
+		EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
 		EXPECTED_CALL(free(IGNORED_PTR_ARG));
 
         // act
@@ -2327,6 +2161,35 @@ TEST_FUNCTION(messenger_on_message_received_internal_callback_REJECTED)
     messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_193: [If `instance->c2d_zero_copy` is true, the IOTHUB_MESSAGE_HANDLE shall be obtained using IoTHubMessage_CreateViewFromUamqpMessage() instead]
+TEST_FUNCTION(messenger_on_message_received_internal_callback_C2D_ZERO_COPY)
+{
+    // arrange
+    MESSENGER_CONFIG* config = get_messenger_config();
+    MESSENGER_HANDLE handle = create_and_start_messenger2(config, true);
+
+    bool zero_copy = true;
+    ASSERT_ARE_EQUAL(int, 0, messenger_set_option(handle, MESSENGER_OPTION_C2D_ZERO_COPY, &zero_copy));
+
+    umock_c_reset_all_calls();
+    TEST_on_new_message_received_callback_result = MESSENGER_DISPOSITION_RESULT_ACCEPTED;
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateViewFromUamqpMessage(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_IOTHUB_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(messaging_delivery_accepted());
+
+    // act
+    ASSERT_IS_NOT_NULL(saved_messagereceiver_open_on_message_received);
+
+    AMQP_VALUE result = saved_messagereceiver_open_on_message_received(saved_messagereceiver_open_callback_context, TEST_MESSAGE_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, result, TEST_MESSAGE_DISPOSITION_ACCEPTED_AMQP_VALUE);
+
+    // cleanup
+    messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_122: [If IoTHubMessage_CreateFromUamqpMessage() fails, on_message_received_internal_callback shall return the result of messaging_delivery_rejected()]
 TEST_FUNCTION(messenger_on_message_received_internal_callback_IoTHubMessage_CreateFromUamqpMessage_fails)
 {
@@ -2369,7 +2232,7 @@ TEST_FUNCTION(messenger_unsubscribe_for_messages_success)
     // act
     int unsubscription_result = messenger_unsubscribe_for_messages(handle);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *do_work_profile = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, true, 0, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	crank_messenger_do_work(handle, do_work_profile);
 
@@ -2430,7 +2293,6 @@ TEST_FUNCTION(messenger_send_async_NULL_callback)
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_138: [If malloc() fails, messenger_send_async() shall fail and return a non-zero value]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_139: [If singlylinkedlist_add() fails, messenger_send_async() shall fail and return a non-zero value]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_142: [If any failure occurs, messenger_send_async() shall free any memory it has allocated]
 TEST_FUNCTION(messenger_send_async_failure_checks)
 {
@@ -2448,6 +2310,12 @@ TEST_FUNCTION(messenger_send_async_failure_checks)
 	size_t i;
 	for (i = 0; i < umock_c_negative_tests_call_count(); i++)
 	{
+		if (i == 1)
+		{
+			// DList_InsertTailList() does not cause the API to fail.
+			continue;
+		}
+
 		// arrange
 		char error_msg[64];
 
@@ -2528,7 +2396,7 @@ TEST_FUNCTION(messenger_get_send_status_BUSY_succeeds)
 	MESSENGER_SEND_STATUS send_status_wts;
 	int result_wts = messenger_get_send_status(handle, &send_status_wts);
 
-	time_t current_time = time(NULL);
+	tickcounter_ms_t current_time = g_current_ms;
 	MESSENGER_DO_WORK_EXP_CALL_PROFILE *mdwp = get_msgr_do_work_exp_call_profile(MESSENGER_STATE_STARTED, false, false, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
 	crank_messenger_do_work(handle, mdwp);
 
@@ -2621,6 +2489,44 @@ TEST_FUNCTION(messenger_set_option_EVENT_SEND_TIMEOUT_SECS)
 	messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_191: [If name matches MESSENGER_OPTION_EVENT_BATCHING, `value` shall be saved on `instance->event_batching_enabled`]
+TEST_FUNCTION(messenger_set_option_EVENT_BATCHING)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+	bool value = true;
+
+	// act
+	int result = messenger_set_option(handle, MESSENGER_OPTION_EVENT_BATCHING, &value);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_194: [If name matches MESSENGER_OPTION_C2D_ZERO_COPY, `value` shall be saved on `instance->c2d_zero_copy`]
+TEST_FUNCTION(messenger_set_option_C2D_ZERO_COPY)
+{
+	// arrange
+	MESSENGER_CONFIG* config = get_messenger_config();
+	MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+	bool value = true;
+
+	// act
+	int result = messenger_set_option(handle, MESSENGER_OPTION_C2D_ZERO_COPY, &value);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+
+	// cleanup
+	messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
 TEST_FUNCTION(messenger_set_option_SAVED_OPTIONS)
 {
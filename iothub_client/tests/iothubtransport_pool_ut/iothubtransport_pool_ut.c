@@ -0,0 +1,470 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+static void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
+#include "iothubtransport.h"
+#undef ENABLE_MOCKS
+
+#include "iothubtransport_pool.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_LOCK_HANDLE    (LOCK_HANDLE)0x4400
+#define TEST_IOTHUB_NAME    "theNameOfTheHub"
+#define TEST_IOTHUB_SUFFIX  "azure-devices.net"
+
+static const TRANSPORT_PROVIDER* TEST_PROTOCOL(void)
+{
+    return NULL;
+}
+
+static size_t g_transports_created;
+
+static TRANSPORT_HANDLE TEST_IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
+{
+    (void)protocol;
+    (void)iotHubName;
+    (void)iotHubSuffix;
+    g_transports_created++;
+    return (TRANSPORT_HANDLE)(0x5500 + g_transports_created);
+}
+
+static int TEST_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t length = strlen(source);
+    *destination = (char*)real_malloc(length + 1);
+    (void)memcpy(*destination, source, length + 1);
+    return 0;
+}
+
+static TRANSPORT_POOL_HANDLE create_pool(size_t devicesPerTransport, size_t maxTransports)
+{
+    TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, devicesPerTransport, maxTransports);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(iothubtransport_pool_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSPORT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_TRANSPORT_PROVIDER, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, TEST_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubTransport_Create, TEST_IoTHubTransport_Create);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Deinit, LOCK_OK);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    g_transports_created = 0;
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_001: [ If protocol, iotHubName or iotHubSuffix are NULL, or devicesPerTransport or maxTransports are 0, IoTHubTransportPool_Create shall return NULL. ]
+TEST_FUNCTION(IoTHubTransportPool_Create_invalid_arguments_fail)
+{
+    // act
+    TRANSPORT_POOL_HANDLE result1 = IoTHubTransportPool_Create(NULL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, 10, 2);
+    TRANSPORT_POOL_HANDLE result2 = IoTHubTransportPool_Create(TEST_PROTOCOL, NULL, TEST_IOTHUB_SUFFIX, 10, 2);
+    TRANSPORT_POOL_HANDLE result3 = IoTHubTransportPool_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, NULL, 10, 2);
+    TRANSPORT_POOL_HANDLE result4 = IoTHubTransportPool_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, 0, 2);
+    TRANSPORT_POOL_HANDLE result5 = IoTHubTransportPool_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, 10, 0);
+
+    // assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+    ASSERT_IS_NULL(result5);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_002: [ IoTHubTransportPool_Create shall allocate the pool, copy iotHubName and iotHubSuffix, allocate room for maxTransports transports and create the pool lock with Lock_Init. ]
+TEST_FUNCTION(IoTHubTransportPool_Create_succeeds)
+{
+    // arrange
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_IOTHUB_NAME))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_IOTHUB_SUFFIX))
+        .IgnoreArgument_destination();
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    // act
+    TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, 10, 2);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubTransportPool_GetTransportCount(result));
+
+    // cleanup
+    IoTHubTransportPool_Destroy(result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_003: [ If any of these fails, IoTHubTransportPool_Create shall free what it allocated and return NULL. ]
+TEST_FUNCTION(IoTHubTransportPool_Create_Lock_Init_fails)
+{
+    // arrange
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_IOTHUB_NAME))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_IOTHUB_SUFFIX))
+        .IgnoreArgument_destination();
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init())
+        .SetReturn(NULL);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, 10, 2);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_004: [ If poolHandle is NULL, IoTHubTransportPool_Destroy shall do nothing. ]
+TEST_FUNCTION(IoTHubTransportPool_Destroy_NULL_does_nothing)
+{
+    // act
+    IoTHubTransportPool_Destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_005: [ IoTHubTransportPool_Destroy shall destroy every transport of the pool with IoTHubTransport_Destroy, the lock and the pool. ]
+TEST_FUNCTION(IoTHubTransportPool_Destroy_destroys_all_transports)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE pool = create_pool(1, 2);
+    TRANSPORT_HANDLE transport1 = IoTHubTransportPool_AcquireTransport(pool);
+    TRANSPORT_HANDLE transport2 = IoTHubTransportPool_AcquireTransport(pool);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_Destroy(transport1));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Destroy(transport2));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubTransportPool_Destroy(pool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_006: [ If poolHandle is NULL, IoTHubTransportPool_AcquireTransport shall return NULL. ]
+TEST_FUNCTION(IoTHubTransportPool_AcquireTransport_NULL_fails)
+{
+    // act
+    TRANSPORT_HANDLE result = IoTHubTransportPool_AcquireTransport(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_007: [ If Lock fails, IoTHubTransportPool_AcquireTransport shall return NULL. ]
+TEST_FUNCTION(IoTHubTransportPool_AcquireTransport_Lock_fails)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE pool = create_pool(10, 2);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE))
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    TRANSPORT_HANDLE result = IoTHubTransportPool_AcquireTransport(pool);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_009: [ If there is no transport, or that transport has devicesPerTransport devices, and the pool has less than maxTransports transports, IoTHubTransportPool_AcquireTransport shall create a new one with IoTHubTransport_Create and pick it. ]
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_011: [ IoTHubTransportPool_AcquireTransport shall count one more device on the picked transport and return it. ]
+TEST_FUNCTION(IoTHubTransportPool_AcquireTransport_first_device_creates_transport)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE pool = create_pool(10, 2);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    TRANSPORT_HANDLE result = IoTHubTransportPool_AcquireTransport(pool);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, IoTHubTransportPool_GetTransportCount(pool));
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_008: [ IoTHubTransportPool_AcquireTransport shall pick the transport with the fewest devices. ]
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_009: [ If there is no transport, or that transport has devicesPerTransport devices, and the pool has less than maxTransports transports, IoTHubTransportPool_AcquireTransport shall create a new one with IoTHubTransport_Create and pick it. ]
+TEST_FUNCTION(IoTHubTransportPool_AcquireTransport_fills_transport_before_creating_another)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE pool = create_pool(2, 3);
+    TRANSPORT_HANDLE transport1 = IoTHubTransportPool_AcquireTransport(pool);
+
+    // act
+    TRANSPORT_HANDLE transport2 = IoTHubTransportPool_AcquireTransport(pool);
+    TRANSPORT_HANDLE transport3 = IoTHubTransportPool_AcquireTransport(pool);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, transport1, transport2);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, transport1, transport3);
+    ASSERT_ARE_EQUAL(size_t, 2, IoTHubTransportPool_GetTransportCount(pool));
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_008: [ IoTHubTransportPool_AcquireTransport shall pick the transport with the fewest devices. ]
+TEST_FUNCTION(IoTHubTransportPool_AcquireTransport_at_max_transports_picks_least_loaded)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE pool = create_pool(1, 2);
+    TRANSPORT_HANDLE transport1 = IoTHubTransportPool_AcquireTransport(pool);
+    TRANSPORT_HANDLE transport2 = IoTHubTransportPool_AcquireTransport(pool);
+    (void)IoTHubTransportPool_AcquireTransport(pool);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    TRANSPORT_HANDLE result = IoTHubTransportPool_AcquireTransport(pool);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(void_ptr, transport1, transport2);
+    ASSERT_ARE_EQUAL(void_ptr, transport2, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, IoTHubTransportPool_GetTransportCount(pool));
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_010: [ If IoTHubTransport_Create fails, IoTHubTransportPool_AcquireTransport shall pick the least loaded transport, or return NULL if there is none. ]
+TEST_FUNCTION(IoTHubTransportPool_AcquireTransport_create_fails_uses_least_loaded)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE pool = create_pool(1, 2);
+    TRANSPORT_HANDLE transport1 = IoTHubTransportPool_AcquireTransport(pool);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    TRANSPORT_HANDLE result = IoTHubTransportPool_AcquireTransport(pool);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, transport1, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, IoTHubTransportPool_GetTransportCount(pool));
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_010: [ If IoTHubTransport_Create fails, IoTHubTransportPool_AcquireTransport shall pick the least loaded transport, or return NULL if there is none. ]
+TEST_FUNCTION(IoTHubTransportPool_AcquireTransport_create_fails_without_transport_fails)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE pool = create_pool(10, 2);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Create(TEST_PROTOCOL, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    TRANSPORT_HANDLE result = IoTHubTransportPool_AcquireTransport(pool);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubTransportPool_GetTransportCount(pool));
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_012: [ If poolHandle or transportHandle are NULL, IoTHubTransportPool_ReleaseTransport shall do nothing. ]
+TEST_FUNCTION(IoTHubTransportPool_ReleaseTransport_NULL_does_nothing)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE pool = create_pool(10, 2);
+    TRANSPORT_HANDLE transport = IoTHubTransportPool_AcquireTransport(pool);
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubTransportPool_ReleaseTransport(NULL, transport);
+    IoTHubTransportPool_ReleaseTransport(pool, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_013: [ If transportHandle was not acquired from the pool, IoTHubTransportPool_ReleaseTransport shall do nothing. ]
+TEST_FUNCTION(IoTHubTransportPool_ReleaseTransport_unknown_transport_does_nothing)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE pool = create_pool(1, 1);
+    TRANSPORT_HANDLE transport = IoTHubTransportPool_AcquireTransport(pool);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IoTHubTransportPool_ReleaseTransport(pool, (TRANSPORT_HANDLE)0x6600);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, transport, IoTHubTransportPool_AcquireTransport(pool));
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_014: [ IoTHubTransportPool_ReleaseTransport shall count one device less on the transport, keeping the transport open. ]
+TEST_FUNCTION(IoTHubTransportPool_ReleaseTransport_frees_room_on_transport)
+{
+    // arrange
+    TRANSPORT_POOL_HANDLE pool = create_pool(1, 2);
+    TRANSPORT_HANDLE transport1 = IoTHubTransportPool_AcquireTransport(pool);
+    (void)IoTHubTransportPool_AcquireTransport(pool);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IoTHubTransportPool_ReleaseTransport(pool, transport1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, IoTHubTransportPool_GetTransportCount(pool));
+    ASSERT_ARE_EQUAL(void_ptr, transport1, IoTHubTransportPool_AcquireTransport(pool));
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_POOL_21_015: [ If poolHandle is NULL, IoTHubTransportPool_GetTransportCount shall return 0. ]
+TEST_FUNCTION(IoTHubTransportPool_GetTransportCount_NULL_returns_0)
+{
+    // act
+    size_t result = IoTHubTransportPool_GetTransportCount(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+}
+
+END_TEST_SUITE(iothubtransport_pool_ut)
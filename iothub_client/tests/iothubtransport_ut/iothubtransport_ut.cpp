@@ -295,6 +295,9 @@ public:
     MOCK_STATIC_METHOD_0(, const char*, IoTHubClient_GetVersionString)
     MOCK_METHOD_END(const char*, (const char*) NULL)
 
+    MOCK_STATIC_METHOD_1(, void, IoTHubClient_ProcessSubmissions, IOTHUB_CLIENT_HANDLE, iotHubClientHandle)
+    MOCK_VOID_METHOD_END()
+
     MOCK_STATIC_METHOD_0(, TICK_COUNTER_HANDLE, tickcounter_create);
     TICK_COUNTER_HANDLE result2 = (TICK_COUNTER_HANDLE )BASEIMPLEMENTATION::gballoc_malloc(1);
     MOCK_METHOD_END(TICK_COUNTER_HANDLE, result2)
@@ -418,6 +421,7 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , const char*, STRING_c_str,
 DECLARE_GLOBAL_MOCK_METHOD_0(CIotHubTransportMocks, , STRING_HANDLE, STRING_new);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CIotHubTransportMocks, , const char*, IoTHubClient_GetVersionString);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, IoTHubClient_ProcessSubmissions, IOTHUB_CLIENT_HANDLE, iotHubClientHandle);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CIotHubTransportMocks, ,TICK_COUNTER_HANDLE, tickcounter_create);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, tickcounter_destroy, TICK_COUNTER_HANDLE, tick_counter);
@@ -1288,11 +1292,21 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_ProcessSubmissions(TEST_IOTHUB_CLIENT_HANDLE1));
     STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
 
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_ProcessSubmissions(TEST_IOTHUB_CLIENT_HANDLE1));
     STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
 
@@ -1314,6 +1328,7 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
 
 //Tests_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]
 //Tests_SRS_IOTHUBTRANSPORT_17_030: [ All calls to lower layer transport DoWork shall be protected by the lock created in IoTHubTransport_Create. 
+//Tests_SRS_IOTHUBTRANSPORT_17_046: [ Before calling lower layer transport DoWork, the thread shall call IoTHubClient_ProcessSubmissions for each clientHandle in the list, so events queued without the lock are sent in this DoWork. ]
 TEST_FUNCTION(IoTHubTransport_worker_thread_runs_two_devices_once)
 {
     CIotHubTransportMocks mocks;
@@ -1328,6 +1343,14 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_two_devices_once)
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
 
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_ProcessSubmissions(TEST_IOTHUB_CLIENT_HANDLE1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_ProcessSubmissions(TEST_IOTHUB_CLIENT_HANDLE2));
     STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
 
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
@@ -1365,6 +1388,14 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
     /* DoWork needs to run at least once, so, the number of calls to DoWork increments. */
     STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
     STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_ProcessSubmissions(TEST_IOTHUB_CLIENT_HANDLE1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_ProcessSubmissions(TEST_IOTHUB_CLIENT_HANDLE2));
     STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_DoWork((TRANSPORT_LL_HANDLE)(0x42), NULL));
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Sleep(1));
 
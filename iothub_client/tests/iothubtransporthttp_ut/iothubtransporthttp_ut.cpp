@@ -25,6 +25,7 @@
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
+#include "azure_c_shared_utility/sastoken.h"
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/vector_types_internal.h"
@@ -103,6 +104,7 @@ static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
 #define TEST_IOTHUB_SUFFIX "thisIsIotHubSuffix"
 #define TEST_IOTHUB_GWHOSTNAME "thisIsGWHostname"
 #define TEST_BLANK_SAS_TOKEN " "
+#define TEST_CACHED_SAS_TOKEN "SharedAccessSignature sr=thisIsIotBuhName.thisIsIotHubSuffix%2fdevices%2fthisIsDeviceID&sig=thisIsSignature&se=384742833&skn="
 #define TEST_IOTHUB_CLIENT_LL_HANDLE (IOTHUB_CLIENT_LL_HANDLE)0x34333
 #define TEST_IOTHUB_CLIENT_LL_HANDLE2 (IOTHUB_CLIENT_LL_HANDLE)0x34344
 #define TEST_ETAG_VALUE_UNQUOTED "thisIsSomeETAGValueSomeGUIDMaybe"
@@ -264,6 +266,8 @@ static IOTHUBTRANSPORT_CONFIG TEST_CONFIG_NULL_IOTHUB_SUFFIX =
 #define TEST_IOTHUB_MESSAGE_HANDLE_10 ((IOTHUB_MESSAGE_HANDLE)0x01da)
 #define TEST_IOTHUB_MESSAGE_HANDLE_11 ((IOTHUB_MESSAGE_HANDLE)0x01db)
 #define TEST_IOTHUB_MESSAGE_HANDLE_12 ((IOTHUB_MESSAGE_HANDLE)0x01dc)
+#define TEST_IOTHUB_MESSAGE_HANDLE_13 ((IOTHUB_MESSAGE_HANDLE)0x01dd)
+#define TEST_IOTHUB_MESSAGE_HANDLE_14 ((IOTHUB_MESSAGE_HANDLE)0x01de)
 
 static IOTHUB_MESSAGE_LIST message1 =  /*this is the oldest message, always the first to be processed, send etc*/
 {
@@ -353,6 +357,22 @@ static IOTHUB_MESSAGE_LIST message12 = /*this is message of 255*1024 bytes - 384
     { NULL, NULL }                                  /*DLIST_ENTRY entry;                                          */
 };
 
+static IOTHUB_MESSAGE_LIST message13 = /*this is a message that, batched together with a property "a":"b", is exactly of the maximum size*/
+{
+    TEST_IOTHUB_MESSAGE_HANDLE_13,                  /*IOTHUB_MESSAGE_HANDLE messageHandle;                        */
+    NULL,                                           /*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;     */
+    NULL,                                           /*void* context;                                              */
+    { NULL, NULL }                                  /*DLIST_ENTRY entry;                                          */
+};
+
+static IOTHUB_MESSAGE_LIST message14 = /*this is the same message as message13, batched together with a property "aa":"b" it is 1 byte over the maximum size*/
+{
+    TEST_IOTHUB_MESSAGE_HANDLE_14,                  /*IOTHUB_MESSAGE_HANDLE messageHandle;                        */
+    NULL,                                           /*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;     */
+    NULL,                                           /*void* context;                                              */
+    { NULL, NULL }                                  /*DLIST_ENTRY entry;                                          */
+};
+
 #define TEST_MAP_EMPTY (MAP_HANDLE) 0xe0
 #define TEST_MAP_1_PROPERTY (MAP_HANDLE) 0xe1
 #define TEST_MAP_2_PROPERTY (MAP_HANDLE) 0xe2
@@ -400,9 +420,6 @@ static size_t whenShallmalloc_fail;
 static size_t currentSTRING_new_call;
 static size_t whenShallSTRING_new_fail;
 
-static size_t currentSTRING_new_JSON_call;
-static size_t whenShallSTRING_new_JSON_fail;
-
 static size_t currentSTRING_clone_call;
 static size_t whenShallSTRING_clone_fail;
 
@@ -435,9 +452,6 @@ static size_t whenShallBUFFER_new_fail;
 static size_t currentBUFFER_build_call;
 static size_t whenShallBUFFER_build_fail;
 
-static size_t currentBase64_Encode_Bytes_call;
-static size_t whenShallBase64_Encode_Bytes_fail;
-
 static size_t currentURL_Encode_String_call;
 static size_t whenShallURL_Encode_String_fail;
 
@@ -462,9 +476,21 @@ static size_t whenShallVECTOR_find_if_fail;
 #define TEST_MINIMAL_PAYLOAD [{"body":""}]
 #define TEST_MINIMAL_PAYLOAD_STRING TOSTRING(TEST_MINIMAL_PAYLOAD)
 
-#define TEST_BIG_BUFFER_1_SIZE          (MAXIMUM_MESSAGE_SIZE - PAYLOAD_OVERHEAD)
-#define TEST_BIG_BUFFER_1_OVERFLOW_SIZE (TEST_BIG_BUFFER_1_SIZE +1 )
-#define TEST_BIG_BUFFER_1_FIT_SIZE      (TEST_BIG_BUFFER_1_SIZE)
+/*a batch is measured exactly: [{"body":""}] plus the base64 encoding of the message, 4 characters for every 3 bytes*/
+#define TEST_BIG_BUFFER_1_FIT_SIZE      (((MAXIMUM_MESSAGE_SIZE - (sizeof(TEST_MINIMAL_PAYLOAD_STRING) - 1)) / 4) * 3)
+#define TEST_BIG_BUFFER_1_OVERFLOW_SIZE (TEST_BIG_BUFFER_1_FIT_SIZE + 1)
+
+/*a property "a":"b" adds exactly ,"properties":{"iothub-app-a":"b"} to the batch*/
+#define TEST_BATCH_PROPERTIES_A_B ",\"properties\":{\"iothub-app-a\":\"b\"}"
+#define TEST_BIG_BUFFER_13_SIZE         (((MAXIMUM_MESSAGE_SIZE - (sizeof(TEST_MINIMAL_PAYLOAD_STRING) - 1) - (sizeof(TEST_BATCH_PROPERTIES_A_B) - 1)) / 4) * 3)
+
+/*exact batched payloads of message1, message1 + message2 and message10*/
+#define TEST_BATCH_1_ITEM_PAYLOAD "[{\"body\":\"MQ==\"}]"
+#define TEST_BATCH_2_ITEMS_PAYLOAD "[{\"body\":\"MQ==\"},{\"body\":\"MjI=\"}]"
+#define TEST_BATCH_STRING_ITEM_PAYLOAD "[{\"body\":\"thisgoestoJ\\\\s\\/\\/on\\\"ToBeEn\\u000D\\u000A\\u0008coded\",\"base64Encoded\":false}]"
+
+/*how many items that do not fit a batch can be skipped when "BatchPreserveOrder" is false*/
+#define TEST_BATCH_LOOK_AHEAD 16
 
 #define TEST_BIG_BUFFER_9_OVERFLOW_SIZE (256*1024)
 
@@ -489,6 +515,9 @@ static const size_t buffer9_size = TEST_BIG_BUFFER_9_OVERFLOW_SIZE;
 static const unsigned char* buffer11;
 static const size_t buffer11_size = MAXIMUM_MESSAGE_SIZE - PAYLOAD_OVERHEAD - 2 - PROPERTY_OVERHEAD;
 
+static const unsigned char* buffer13;
+static const size_t buffer13_size = TEST_BIG_BUFFER_13_SIZE;
+
 static unsigned char* bigBufferOverflow; /*this is a buffer that contains just enough characters to go over the limit of 256K as a single message*/
 static unsigned char* bigBufferFit; /*this is a buffer that contains just enough characters to NOT go over the limit of 256K as a single message*/
 
@@ -511,6 +540,8 @@ static bool HTTPHeaders_GetHeaderCount_writes_to_its_outputs = true;
 /*for the purpose of this implementation, time_t represents the number of seconds since 1970, 1st jan, 0:0:0*/
 #define TEST_GET_TIME_VALUE 384739233
 #define TEST_DEFAULT_GETMINIMUMPOLLINGTIME 1500
+#define TEST_DEFAULT_SAS_TOKEN_LIFETIME 3600 /*seconds*/
+#define TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME 1800 /*seconds*/
 
 
 TYPED_MOCK_CLASS(CIoTHubTransportHttpMocks, CGlobalMock)
@@ -602,29 +633,6 @@ public:
     }
     MOCK_METHOD_END(STRING_HANDLE, result2)
 
-        MOCK_STATIC_METHOD_1(, STRING_HANDLE, STRING_new_JSON, const char*, source)
-        STRING_HANDLE result2;
-    currentSTRING_new_JSON_call++;
-    if (whenShallSTRING_new_JSON_fail > 0)
-    {
-        if (currentSTRING_new_JSON_call == whenShallSTRING_new_JSON_fail)
-        {
-            result2 = (STRING_HANDLE)NULL;
-        }
-        else
-        {
-            result2 = BASEIMPLEMENTATION::STRING_new_JSON(source);
-        }
-    }
-    else
-    {
-        result2 = BASEIMPLEMENTATION::STRING_new_JSON(source);
-    }
-    MOCK_METHOD_END(STRING_HANDLE, result2)
-
-        MOCK_STATIC_METHOD_1(, STRING_HANDLE, STRING_new_with_memory, const char*, memory)
-        MOCK_METHOD_END(STRING_HANDLE, BASEIMPLEMENTATION::STRING_new_with_memory(memory))
-
         MOCK_STATIC_METHOD_1(, STRING_HANDLE, STRING_clone, STRING_HANDLE, handle)
         STRING_HANDLE result2;
     currentSTRING_clone_call++;
@@ -813,6 +821,11 @@ public:
             *buffer = buffer11; /*this is not a copy&paste mistake, it is intended to use the same "to the limit" buffer as 11*/
             *size = buffer11_size;
         }
+        else if ((iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_13) || (iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_14)) /*these batch at the limit with their property*/
+        {
+            *buffer = buffer13;
+            *size = buffer13_size;
+        }
         else
         {
             /*not expected really*/
@@ -837,7 +850,9 @@ public:
             (handle == TEST_IOTHUB_MESSAGE_HANDLE_8) ||
             (handle == TEST_IOTHUB_MESSAGE_HANDLE_9) ||
             (handle == TEST_IOTHUB_MESSAGE_HANDLE_11) ||
-            (handle == TEST_IOTHUB_MESSAGE_HANDLE_12)
+            (handle == TEST_IOTHUB_MESSAGE_HANDLE_12) ||
+            (handle == TEST_IOTHUB_MESSAGE_HANDLE_13) ||
+            (handle == TEST_IOTHUB_MESSAGE_HANDLE_14)
         )
         {
             result2 = NULL;
@@ -904,6 +919,14 @@ public:
     {
         result2 = TEST_MAP_1_PROPERTY_AA_B;
     }
+    else if(iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_13)
+    {
+        result2 = TEST_MAP_1_PROPERTY_A_B;
+    }
+    else if(iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_14)
+    {
+        result2 = TEST_MAP_1_PROPERTY_AA_B;
+    }
     else
     {
         /*not expected really*/
@@ -937,7 +960,9 @@ public:
         (iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_8) ||
         (iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_9) ||
         (iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_11) ||
-        (iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_12)
+        (iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_12) ||
+        (iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_13) ||
+        (iotHubMessageHandle == TEST_IOTHUB_MESSAGE_HANDLE_14)
     )
     {
         result2 = IOTHUBMESSAGE_BYTEARRAY;
@@ -1011,10 +1036,6 @@ public:
     MOCK_STATIC_METHOD_2(, int, BUFFER_size, BUFFER_HANDLE, handle, size_t*, size);
     MOCK_METHOD_END(int, BASEIMPLEMENTATION::BUFFER_size(handle, size))
 
-    MOCK_STATIC_METHOD_2(, STRING_HANDLE, Base64_Encode_Bytes, const unsigned char*, source, size_t, size);
-        currentBase64_Encode_Bytes_call++;
-    MOCK_METHOD_END(STRING_HANDLE, (((currentBase64_Encode_Bytes_call > 0) && (currentBase64_Encode_Bytes_call == whenShallBase64_Encode_Bytes_fail)) ? ((STRING_HANDLE)NULL) : BASEIMPLEMENTATION::Base64_Encode_Bytes(source, size)));
-
     MOCK_STATIC_METHOD_4(, MAP_RESULT, Map_GetInternals, MAP_HANDLE, handle, const char*const**, keys, const char*const**, values, size_t*, count)
         if(handle == TEST_MAP_EMPTY)
         {
@@ -1113,6 +1134,9 @@ public:
         free(handle);
     MOCK_VOID_METHOD_END()
 
+        MOCK_STATIC_METHOD_4(, STRING_HANDLE, SASToken_Create, STRING_HANDLE, key, STRING_HANDLE, scope, STRING_HANDLE, keyName, size_t, expiry)
+        MOCK_METHOD_END(STRING_HANDLE, BASEIMPLEMENTATION::STRING_construct(TEST_CACHED_SAS_TOKEN))
+
         MOCK_STATIC_METHOD_8(, HTTPAPIEX_RESULT, HTTPAPIEX_ExecuteRequest2, HTTPAPIEX_HANDLE, handle, HTTPAPI_REQUEST_TYPE, requestType, const char*, relativePath, HTTP_HEADERS_HANDLE, requestHttpHeadersHandle, BUFFER_HANDLE, requestContent, unsigned int*, statusCode, HTTP_HEADERS_HANDLE, responseHttpHeadersHandle, BUFFER_HANDLE, responseContent)
         if (last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest != NULL)
         {
@@ -1219,7 +1243,6 @@ DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubTransportHttpMocks, , void, eventConfirmatio
 DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubTransportHttpMocks, , int, messageCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CIoTHubTransportHttpMocks, , STRING_HANDLE, STRING_new);
-DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportHttpMocks, , STRING_HANDLE, STRING_new_JSON, const char*, source);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportHttpMocks, , STRING_HANDLE, STRING_clone, STRING_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportHttpMocks, , STRING_HANDLE, STRING_construct, const char*, s);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportHttpMocks, , STRING_HANDLE, STRING_construct_n, const char*, s, size_t, size);
@@ -1229,7 +1252,6 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportHttpMocks, , int, STRING_concat_wit
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportHttpMocks, , int, STRING_empty, STRING_HANDLE, s1);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportHttpMocks, , const char*, STRING_c_str, STRING_HANDLE, s);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportHttpMocks, , size_t, STRING_length, STRING_HANDLE, handle);
-DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportHttpMocks, , STRING_HANDLE, STRING_new_with_memory, const char*, memory);
 
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CIoTHubTransportHttpMocks, , HTTP_HEADERS_HANDLE, HTTPHeaders_Alloc);
@@ -1274,12 +1296,12 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportHttpMocks, , int, BUFFER_content, B
 DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportHttpMocks, , int, BUFFER_size, BUFFER_HANDLE, handle, size_t*, size);
 
 
-DECLARE_GLOBAL_MOCK_METHOD_2(CIoTHubTransportHttpMocks, , STRING_HANDLE, Base64_Encode_Bytes, const unsigned char*, source, size_t, size);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportHttpMocks, , STRING_HANDLE, URL_EncodeString, const char*, textEncode);
 
 DECLARE_GLOBAL_MOCK_METHOD_3(CIoTHubTransportHttpMocks, , HTTPAPIEX_SAS_HANDLE, HTTPAPIEX_SAS_Create, STRING_HANDLE, key, STRING_HANDLE, uriResource, STRING_HANDLE, keyName);
 
+DECLARE_GLOBAL_MOCK_METHOD_4(CIoTHubTransportHttpMocks, , STRING_HANDLE, SASToken_Create, STRING_HANDLE, key, STRING_HANDLE, scope, STRING_HANDLE, keyName, size_t, expiry);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubTransportHttpMocks, , void, HTTPAPIEX_SAS_Destroy, HTTPAPIEX_SAS_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_9(CIoTHubTransportHttpMocks, , HTTPAPIEX_RESULT, HTTPAPIEX_SAS_ExecuteRequest2, HTTPAPIEX_SAS_HANDLE, sasHandle, HTTPAPIEX_HANDLE, handle, HTTPAPI_REQUEST_TYPE, requestType, const char*, relativePath, HTTP_HEADERS_HANDLE, requestHttpHeadersHandle, BUFFER_HANDLE, requestContent, unsigned int*, statusCode, HTTP_HEADERS_HANDLE, responseHttpHeadersHandle, BUFFER_HANDLE, responseContent);
 DECLARE_GLOBAL_MOCK_METHOD_8(CIoTHubTransportHttpMocks, , HTTPAPIEX_RESULT, HTTPAPIEX_ExecuteRequest2, HTTPAPIEX_HANDLE, handle, HTTPAPI_REQUEST_TYPE, requestType, const char*, relativePath, HTTP_HEADERS_HANDLE, requestHttpHeadersHandle, BUFFER_HANDLE, requestContent, unsigned int*, statusCode, HTTP_HEADERS_HANDLE, responseHttpHeadersHandle, BUFFER_HANDLE, responseContent);
@@ -1566,12 +1588,8 @@ static void setupRegisterHappyPathsasObject(CIoTHubTransportHttpMocks &mocks, bo
     if(is_x509_used==false)
     {
         STRICT_EXPECTED_CALL(mocks, URL_EncodeString(TEST_DEVICE_ID));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*encoded device id*/
-            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*uriResource*/
-            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "/devices/"))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -1590,6 +1608,12 @@ static void setupRegisterHappyPathsasObject(CIoTHubTransportHttpMocks &mocks, bo
         {
             STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
                 .IgnoreArgument(1);
+            STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*uriResource, kept as SAS token scope*/
+                .IgnoreArgument(1);
+            STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*encoded device id, kept as SAS token key name*/
+                .IgnoreArgument(1);
+            STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*cached SAS token*/
+                .IgnoreArgument(1);
         }
     }
 }
@@ -1666,7 +1690,12 @@ static void setupUnregisterOneDevice(CIoTHubTransportHttpMocks &mocks)
     //destroy_SASObject(perDeviceItem);
     STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*SAS token scope*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*SAS token key name*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*cached SAS token*/
+        .IgnoreArgument(1);
 }
 
 static void setupDoWorkLoopOnceForOneDevice(CIoTHubTransportHttpMocks &mocks)
@@ -1687,6 +1716,137 @@ static void setupDoWorkLoopForNextDevice(CIoTHubTransportHttpMocks &mocks, size_
         .IgnoreArgument(1);
 }
 
+static void setupSasTokenAuthorization(CIoTHubTransportHttpMocks &mocks)
+{
+    (void)mocks;
+
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*cached SAS token*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_CACHED_SAS_TOKEN))
+        .IgnoreArgument(1);
+}
+
+/*the first request of a device signs a new SAS token*/
+static void setupSasTokenCreate(CIoTHubTransportHttpMocks &mocks, time_t now = TEST_GET_TIME_VALUE)
+{
+    (void)mocks;
+
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL))
+        .SetReturn(now);
+    STRICT_EXPECTED_CALL(mocks, get_difftime(now, (time_t)0));
+    STRICT_EXPECTED_CALL(mocks, SASToken_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*previously cached SAS token*/
+        .IgnoreArgument(1);
+    setupSasTokenAuthorization(mocks);
+}
+
+/*the next requests reuse the cached SAS token until the refresh time*/
+static void setupSasTokenReuse(CIoTHubTransportHttpMocks &mocks, time_t now = TEST_GET_TIME_VALUE, time_t createdAt = TEST_GET_TIME_VALUE)
+{
+    (void)mocks;
+
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL))
+        .SetReturn(now);
+    STRICT_EXPECTED_CALL(mocks, get_difftime(now, createdAt));
+    setupSasTokenAuthorization(mocks);
+}
+
+/*without time no expiry can be computed, the request falls back to HTTPAPIEX_SAS_ExecuteRequest*/
+static void setupSasTokenTimeNotAvailable(CIoTHubTransportHttpMocks &mocks)
+{
+    (void)mocks;
+
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL))
+        .SetReturn((time_t)(-1));
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*cached SAS token*/
+        .IgnoreArgument(1);
+}
+
+/*a batched item is read twice from the message: once when it is measured and once when it is written into the payload*/
+static void setupBatchItemRead(CIoTHubTransportHttpMocks &mocks, IOTHUB_MESSAGE_HANDLE messageHandle, MAP_HANDLE properties)
+{
+    (void)mocks;
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(messageHandle));
+    if (messageHandle == TEST_IOTHUB_MESSAGE_HANDLE_10)
+    {
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(messageHandle));
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
+    }
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(messageHandle));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(properties, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+}
+
+/*the item fits, it is moved from waitingToSend to the list of messages to be confirmed*/
+static void setupBatchItemTaken(CIoTHubTransportHttpMocks &mocks, IOTHUB_MESSAGE_LIST* message, MAP_HANDLE properties)
+{
+    (void)mocks;
+
+    setupBatchItemRead(mocks, message->messageHandle, properties);
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(&(message->entry)));
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message->entry)))
+        .IgnoreArgument(1);
+}
+
+/*the payload is allocated once, at the exact size of the batch*/
+static void setupBatchPayloadAlloc(CIoTHubTransportHttpMocks &mocks, size_t payloadSize)
+{
+    (void)mocks;
+
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_pre_build(IGNORED_PTR_ARG, payloadSize))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+}
+
+/*the batched items go back to waitingToSend*/
+static void setupBatchPutBack(CIoTHubTransportHttpMocks &mocks)
+{
+    (void)mocks;
+
+    STRICT_EXPECTED_CALL(mocks, DList_AppendTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+}
+
+static void setupBatchPost(CIoTHubTransportHttpMocks &mocks, const char* relativePath, const unsigned int* httpStatus)
+{
+    (void)mocks;
+
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
+        .IgnoreArgument(1);
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,
+        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
+        relativePath,                                                                   /*const char* relativePath,                          */
+        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
+        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
+        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
+        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
+        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .CopyOutArgumentBuffer(6, httpStatus, sizeof(*httpStatus));
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG)) /*the payload*/
+        .IgnoreArgument(1);
+}
+
 //
 //static void setupInitHappyPathUpThroughHostName(CIoTHubTransportHttpMocks &mocks, bool deallocateCreated)
 //{
@@ -1766,11 +1926,11 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
     g_testByTest = MicroMockCreateMutex();
     ASSERT_IS_NOT_NULL(g_testByTest);
-    /*the size of bigBuffer needs to be such that it doesn't fit alone 1 payload of 256KB.*/ /*assume a limit of "less than 1 than 256"*/
-                                                                                             /*the payload already must have the following string: [{"body":""}], which is 13 characters. From (256*1024-1) - 13 =  262130 characters that can go in the base64 encoding.*/
-                                                                                             /*that means 2621301/4*3 = 196597.5 original characters. that means:
-                                                                                             1. 196597 original characters shall fit
-                                                                                             2. 196598 original characters shall not fit*/
+    /*the size of bigBuffer needs to be such that it doesn't fit alone 1 payload of 255KB - 1.*/
+    /*the payload already must have the following string: [{"body":""}], which is 13 characters. From (255*1024-1) - 13 = 261106 characters that can go in the base64 encoding.*/
+    /*base64 uses 4 characters for every 3 original bytes (padded), so 261104 characters carry 195828 original characters. that means:
+    1. 195828 original characters shall fit
+    2. 195829 original characters shall not fit*/
     bigBufferOverflow = (unsigned char*)malloc(TEST_BIG_BUFFER_1_OVERFLOW_SIZE);
     memset(bigBufferOverflow, '3', TEST_BIG_BUFFER_1_OVERFLOW_SIZE);
     bigBufferFit = (unsigned char*)malloc(TEST_BIG_BUFFER_1_FIT_SIZE);
@@ -1784,6 +1944,10 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     memset(temp, '3', buffer11_size);
     buffer11 = temp;
 
+    temp = (unsigned char*)malloc(buffer13_size);
+    memset(temp, '3', buffer13_size);
+    buffer13 = temp;
+
     IoTHubTransportHttp_Unsubscribe_DeviceTwin = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_Unsubscribe_DeviceTwin;
     IoTHubTransportHttp_Subscribe_DeviceTwin = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_Subscribe_DeviceTwin;
     IoTHubTransportHttp_GetHostname = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_GetHostname;
@@ -1803,6 +1967,7 @@ TEST_SUITE_CLEANUP(TestClassCleanup)
 {
     free((void*)buffer9);
     free((void*)buffer11);
+    free((void*)buffer13);
     free(bigBufferFit);
     free(bigBufferOverflow);
 
@@ -1823,9 +1988,6 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     currentSTRING_new_call = 0;
     whenShallSTRING_new_fail = 0;
 
-    currentSTRING_new_JSON_call = 0;
-    whenShallSTRING_new_JSON_fail = 0;
-
     currentSTRING_clone_call = 0;
     whenShallSTRING_clone_fail = 0;
 
@@ -1857,9 +2019,6 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     currentBUFFER_build_call = 0;
     whenShallBUFFER_build_fail = 0;
 
-    currentBase64_Encode_Bytes_call = 0;
-    whenShallBase64_Encode_Bytes_fail = 0;
-
     HTTPHeaders_GetHeaderCount_writes_to_its_outputs = true;
 
     whenShallHTTPHeaders_GetHeader_fail = 0;
@@ -4459,8 +4618,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -4471,12 +4630,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -4529,8 +4687,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
@@ -4541,10 +4699,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -4615,8 +4772,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_2device_with_2nd_empty_waiti
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID2 MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -4627,12 +4784,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_2device_with_2nd_empty_waiti
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -4685,8 +4841,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_2device_with_2nd_empty_waiti
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID2 MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
@@ -4697,10 +4853,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_2device_with_2nd_empty_waiti
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -4733,96 +4888,17 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2nd_has_1_event_item_as_string
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":"));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle));
-
-        STRICT_EXPECTED_CALL(mocks, STRING_new_JSON(string10));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"base64Encoded\":false")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message10.entry)))
-        .IgnoreArgument(1);
-
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    /*measuring the batch*/
+    setupBatchItemTaken(mocks, &message10, TEST_MAP_EMPTY);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
+    /*writing the batch*/
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_STRING_ITEM_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message10.messageHandle, TEST_MAP_EMPTY);
 
     /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID2 EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID2 EVENT_ENDPOINT API_VERSION, &httpStatus200);
 
     /*once the event has been succesfull...*/
-
     STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE2, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
         .IgnoreArgument(2);
 
@@ -4833,6 +4909,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2nd_has_1_event_item_as_string
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_BATCH_STRING_ITEM_PAYLOAD) - 1, BASEIMPLEMENTATION::BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_STRING_ITEM_PAYLOAD, sizeof(TEST_BATCH_STRING_ITEM_PAYLOAD) - 1));
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
@@ -4873,8 +4951,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2subscriptions_happy_path_succ
 
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
             .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-        STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-            IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+        setupSasTokenCreate(mocks);
+        STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
             IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
             HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
             "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -4885,12 +4963,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2subscriptions_happy_path_succ
             IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
             ))
             .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(5)
+            .IgnoreArgument(4)
+            .IgnoreArgument(6)
             .IgnoreArgument(7)
             .IgnoreArgument(8)
-            .IgnoreArgument(9)
-            .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+            .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
         STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
             .IgnoreArgument(1)
@@ -4943,8 +5020,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2subscriptions_happy_path_succ
 
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
             .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-        STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-            IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+        setupSasTokenReuse(mocks);
+        STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
             IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
             HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
             "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
@@ -4955,10 +5032,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2subscriptions_happy_path_succ
             NULL                                                /*BUFFER_HANDLE responseContent))                              */
             ))
             .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(5)
-            .IgnoreArgument(7)
-            .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+            .IgnoreArgument(4)
+            .IgnoreArgument(6)
+            .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
 
     }
@@ -4976,8 +5052,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2subscriptions_happy_path_succ
 
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
             .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-        STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-            IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+        setupSasTokenCreate(mocks);
+        STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
             IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
             HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
             "/devices/" TEST_DEVICE_ID2 MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -4988,12 +5064,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2subscriptions_happy_path_succ
             IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
             ))
             .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(5)
+            .IgnoreArgument(4)
+            .IgnoreArgument(6)
             .IgnoreArgument(7)
             .IgnoreArgument(8)
-            .IgnoreArgument(9)
-            .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+            .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
         STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
             .IgnoreArgument(1)
@@ -5046,8 +5121,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2subscriptions_happy_path_succ
 
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
             .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-        STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-            IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+        setupSasTokenReuse(mocks);
+        STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
             IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
             HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
             "/devices/" TEST_DEVICE_ID2 MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
@@ -5058,10 +5133,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2subscriptions_happy_path_succ
             NULL                                                /*BUFFER_HANDLE responseContent))                              */
             ))
             .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(5)
-            .IgnoreArgument(7)
-            .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+            .IgnoreArgument(4)
+            .IgnoreArgument(6)
+            .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
     }
 
     ///act
@@ -5105,6 +5179,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+    setupSasTokenTimeNotAvailable(mocks);
     STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
@@ -5175,6 +5250,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
+    setupSasTokenTimeNotAvailable(mocks);
     STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
@@ -5234,6 +5310,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
             .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+        setupSasTokenTimeNotAvailable(mocks);
         STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
             IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
             IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
@@ -5304,6 +5381,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
             .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
+        setupSasTokenTimeNotAvailable(mocks);
         STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
             IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
             IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
@@ -5369,8 +5447,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -5381,12 +5459,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -5439,8 +5516,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
@@ -5451,10 +5528,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -5532,8 +5608,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks, TEST_GET_TIME_VALUE + TEST_DEFAULT_GETMINIMUMPOLLINGTIME + 1, TEST_GET_TIME_VALUE);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -5544,12 +5620,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -5602,8 +5677,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks, TEST_GET_TIME_VALUE + TEST_DEFAULT_GETMINIMUMPOLLINGTIME + 1, TEST_GET_TIME_VALUE);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
@@ -5614,10 +5689,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
@@ -5656,8 +5730,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -5668,12 +5742,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -5725,8 +5798,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
@@ -5737,10 +5810,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode404, sizeof(statusCode404));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode404, sizeof(statusCode404));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -5778,8 +5850,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -5790,12 +5862,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -5848,8 +5919,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
@@ -5860,9 +5931,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .SetReturn(HTTPAPIEX_ERROR);
 
     ///act
@@ -5901,8 +5971,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -5913,12 +5983,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -6005,8 +6074,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -6017,12 +6086,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -6106,8 +6174,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -6118,12 +6186,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -6202,8 +6269,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -6214,12 +6281,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -6295,8 +6361,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -6307,12 +6373,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -6386,8 +6451,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -6398,12 +6463,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -6472,8 +6536,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -6484,12 +6548,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -6580,8 +6643,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -6592,12 +6655,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -6649,8 +6711,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_DELETE,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION REJECT_QUERY_PARAMETER,    /*const char* relativePath,                                    */
@@ -6661,10 +6723,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -6703,8 +6764,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -6715,12 +6776,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -6772,8 +6832,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_DELETE,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION REJECT_QUERY_PARAMETER,    /*const char* relativePath,                                    */
@@ -6784,10 +6844,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
+        .IgnoreArgument(3)
         .IgnoreArgument(4)
-        .IgnoreArgument(5)
-        .CopyOutArgumentBuffer(7, &statusCode404, sizeof(statusCode404));
+        .CopyOutArgumentBuffer(6, &statusCode404, sizeof(statusCode404));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -6826,8 +6885,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -6838,12 +6897,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -6895,8 +6953,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_DELETE,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION REJECT_QUERY_PARAMETER,    /*const char* relativePath,                                    */
@@ -6907,10 +6965,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode404, sizeof(statusCode404))
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode404, sizeof(statusCode404))
         .SetReturn(HTTPAPIEX_ERROR);
 
     ///act
@@ -6949,8 +7006,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -6961,12 +7018,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7053,8 +7109,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7065,12 +7121,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7155,8 +7210,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7167,12 +7222,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7250,8 +7304,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7262,12 +7316,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7343,8 +7396,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7355,12 +7408,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7434,8 +7486,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7446,12 +7498,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7520,8 +7571,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7532,12 +7583,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7604,8 +7654,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7616,12 +7666,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7664,8 +7713,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
@@ -7676,10 +7725,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -7717,8 +7765,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7729,12 +7777,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7776,8 +7823,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7788,12 +7835,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7835,8 +7881,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7847,12 +7893,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7894,8 +7939,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7906,12 +7951,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -7953,8 +7997,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -7965,12 +8009,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -8012,8 +8055,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -8024,12 +8067,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -8071,8 +8113,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -8083,12 +8125,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode500, sizeof(statusCode500));
+        .CopyOutArgumentBuffer(6, &statusCode500, sizeof(statusCode500));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -8126,8 +8167,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -8138,12 +8179,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200))
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200))
         .SetReturn(HTTPAPIEX_ERROR);
 
     ///act
@@ -8247,6 +8287,7 @@ TEST_FUNCTION(HTTP_Protocol_succeeds)
 //Tests_SRS_TRANSPORTMULTITHTTP_17_053: [ If option SetBatching is true then _DoWork shall send batched event message as specced below. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_117: [ If optionName is an option handled by IoTHubTransportHttp then it shall be set. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_120: [ "Batching" ]
+//Tests_SRS_TRANSPORTMULTITHTTP_21_001: [ The batch payload shall be allocated once, at its exact final size, and every item shall be encoded directly into it. ]
 TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_happy_path_succeeds)
 {
     ///arrange
@@ -8258,106 +8299,22 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_happy_path_succeeds)
     mocks.ResetAllCalls();
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
-        .IgnoreArgument(1);
-
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    /*measuring the batch*/
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
+    /*writing the batch*/
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
 
     /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
 
     /*once the event has been succesfull...*/
-
     STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
         .IgnoreArgument(2);
 
@@ -8368,6 +8325,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_happy_path_succeeds)
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1, BASEIMPLEMENTATION::BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_1_ITEM_PAYLOAD, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1));
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
@@ -8383,7 +8342,6 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_ht
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
@@ -8391,101 +8349,14 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_ht
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
-        .IgnoreArgument(1);
-
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
 
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus404, sizeof(httpStatus404));
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus404);
 
-    STRICT_EXPECTED_CALL(mocks, DList_AppendTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)).IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG)).IgnoreAllArguments();
+    /*the message goes back to waitingToSend*/
+    setupBatchPutBack(mocks);
 
     ENABLE_BATCHING();
 
@@ -8494,6 +8365,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_ht
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message1.entry), (void*)waitingToSend.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
@@ -8509,7 +8381,6 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_HT
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
@@ -8517,83 +8388,15 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_HT
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
-        .IgnoreArgument(1);
-
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
 
     /*executing HTTP goodies*/
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,
         HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
         "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
@@ -8604,15 +8407,15 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_HT
         NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
+        .IgnoreArgument(4)
         .IgnoreArgument(5)
         .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200))
         .SetReturn(HTTPAPIEX_ERROR);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(mocks, DList_AppendTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)).IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG)).IgnoreAllArguments();
+    /*the message goes back to waitingToSend*/
+    setupBatchPutBack(mocks);
 
     ENABLE_BATCHING();
 
@@ -8621,13 +8424,15 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_HT
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message1.entry), (void*)waitingToSend.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
+//Tests_SRS_TRANSPORTMULTITHTTP_21_001: [ The batch payload shall be allocated once, at its exact final size, and every item shall be encoded directly into it. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_BUFFER_build_fails)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_BUFFER_pre_build_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -8644,91 +8449,26 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_BU
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_pre_build(IGNORED_PTR_ARG, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1))
+        .IgnoreArgument(1)
+        .SetReturn(__FAILURE__);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
+    setupBatchPutBack(mocks);
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
-        .IgnoreArgument(1);
-
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        whenShallBUFFER_build_fail = 1;
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .SetReturn(__FAILURE__);
-    }
-
-    STRICT_EXPECTED_CALL(mocks, DList_AppendTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)).IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG)).IgnoreAllArguments();
-
-    ENABLE_BATCHING();
+    ENABLE_BATCHING();
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message1.entry), (void*)waitingToSend.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
@@ -8752,71 +8492,12 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_BU
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
-        .IgnoreArgument(1);
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
 
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        whenShallBUFFER_new_fail = 1;
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-    }
+    whenShallBUFFER_new_fail = currentBUFFER_new_call + 1;
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
 
-    STRICT_EXPECTED_CALL(mocks, DList_AppendTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveEntryList(IGNORED_PTR_ARG)).IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, DList_InitializeListHead(IGNORED_PTR_ARG)).IgnoreAllArguments();
+    setupBatchPutBack(mocks);
 
     ENABLE_BATCHING();
 
@@ -8825,13 +8506,15 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_BU
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message1.entry), (void*)waitingToSend.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_with_STRING_fails_it_fails)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_puts_it_back_when_IoTHubMessage_GetByteArray_fails_while_writing_the_payload)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -8848,50 +8531,20 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_wi
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+    /*measuring succeeds...*/
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
+    /*...but the message cannot be read a second time*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetReturn(IOTHUB_MESSAGE_ERROR);
 
-    {
-        /*adding the first payload to the "big" payload*/
-        whenShallSTRING_concat_with_STRING_fail = 7;
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-    }
+    setupBatchPutBack(mocks);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     ENABLE_BATCHING();
 
@@ -8900,13 +8553,15 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_wi
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message1.entry), (void*)waitingToSend.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_it_fails)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_IoTHubMessage_GetByteArray_it_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -8923,44 +8578,12 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_it
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        whenShallSTRING_concat_fail = currentSTRING_concat_call + 2;
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
+    /*measuring the first item fails, so there is no batch*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetReturn(IOTHUB_MESSAGE_ERROR);
 
     ENABLE_BATCHING();
 
@@ -8969,13 +8592,15 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_it
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message1.entry), (void*)waitingToSend.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_it_fails_2)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_055: [ If updating Content-Type fails for any reason, then _DoWork shall advance to the next action. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_HTTP_headers_fails_it_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -8990,39 +8615,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_it
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
-        .IgnoreArgument(1);
-
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-
-        whenShallSTRING_concat_fail = currentSTRING_concat_call + 1;
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
+        .IgnoreArgument(1)
+        .SetReturn(HTTP_HEADERS_ERROR);
 
     ENABLE_BATCHING();
 
@@ -9036,12 +8630,14 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_it
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_with_STRING_it_fails_2)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_065: [ If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_ERROR. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_061: [ The message size shall be limited to 255KB - 1 byte. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_21_018: [ The size of a batch shall be the exact length of its encoded payload, base64 and JSON escaping included. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_bigger_than_256K_path_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message4.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -9054,33 +8650,17 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_wi
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
+    /*measuring the first item finds it 100% fail (>255K)*/
+    setupBatchItemRead(mocks, message4.messageHandle, TEST_MAP_EMPTY);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    /*building the list of messages to be notified*/
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message4.entry)))
         .IgnoreArgument(1);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        whenShallSTRING_concat_with_STRING_fail = 6;
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        /*end of the first batched payload*/
-    }
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR))
+        .IgnoreArgument(2);
 
     ENABLE_BATCHING();
 
@@ -9089,17 +8669,19 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_wi
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_Base64_Encode_Bytes_it_fails)
+/*this is a test that wants to see that "almost" 255KB message still fits*/
+//Tests_SRS_TRANSPORTMULTITHTTP_21_018: [ The size of a batch shall be the exact length of its encoded payload, base64 and JSON escaping included. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_almost255_happy_path_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message5.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -9112,25 +8694,15 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_Base64_Encode_By
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    setupBatchItemTaken(mocks, &message5, TEST_MAP_EMPTY);
+    setupBatchPayloadAlloc(mocks, (sizeof(TEST_MINIMAL_PAYLOAD_STRING) - 1) + (TEST_BIG_BUFFER_1_FIT_SIZE / 3) * 4);
+    setupBatchItemRead(mocks, message5.messageHandle, TEST_MAP_EMPTY);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
 
-        whenShallBase64_Encode_Bytes_fail = 1;
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        /*end of the first batched payload*/
-    }
+    /*once the event has been succesfull...*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
 
     ENABLE_BATCHING();
 
@@ -9139,22 +8711,23 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_Base64_Encode_By
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_TRUE(BASEIMPLEMENTATION::BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest) <= MAXIMUM_MESSAGE_SIZE);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_IoTHubMessage_GetByteArray_it_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_056: [ IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...] ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_makes_1_batch_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
     DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message2.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
@@ -9162,24 +8735,20 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_IoTHubMessage_Ge
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    /*measuring the batch*/
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
+    setupBatchItemTaken(mocks, &message2, TEST_MAP_EMPTY);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .SetReturn(IOTHUB_MESSAGE_ERROR);
+    /*writing the batch*/
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_2_ITEMS_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
+    setupBatchItemRead(mocks, message2.messageHandle, TEST_MAP_EMPTY);
 
-        /*end of the first batched payload*/
-    }
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
+
+    /*once the event has been succesfull...*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
 
     ENABLE_BATCHING();
 
@@ -9188,22 +8757,24 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_IoTHubMessage_Ge
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_BATCH_2_ITEMS_PAYLOAD) - 1, BASEIMPLEMENTATION::BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_2_ITEMS_PAYLOAD, sizeof(TEST_BATCH_2_ITEMS_PAYLOAD) - 1));
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_construct_fails_it_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_066: [ If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_items_fails_the_first_one_still_makes_1_batch_succeeds_1)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
     DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message2.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
@@ -9211,18 +8782,23 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_construct
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    /*measuring the batch: the second item cannot be read*/
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message2.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetReturn(IOTHUB_MESSAGE_ERROR);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        whenShallSTRING_construct_fail = currentSTRING_construct_call + 2;
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        /*end of the first batched payload*/
-    }
+    /*writing the batch of the first item*/
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
+
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
+
+    /*once the event has been succesfull...*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
 
     ENABLE_BATCHING();
 
@@ -9231,22 +8807,24 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_construct
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_1_ITEM_PAYLOAD, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message2.entry), (void*)waitingToSend.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_construct_it_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_066: [ If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_items_fails_the_first_one_still_makes_1_batch_succeeds_2)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
     DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message2.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
@@ -9254,40 +8832,74 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_construct
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    whenShallSTRING_construct_fail = currentSTRING_construct_call + 1;
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-
-    ENABLE_BATCHING();
-
+    /*measuring the batch: the properties of the second item cannot be read*/
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message2.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message2.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .SetReturn(MAP_ERROR);
+
+    /*writing the batch of the first item*/
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
+
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
+
+    /*once the event has been succesfull...*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
+
+    ENABLE_BATCHING();
+
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_1_ITEM_PAYLOAD, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message2.entry), (void*)waitingToSend.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_055: [ If updating Content-Type fails for any reason, then _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_HTTP_headers_fails_it_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_066: [ If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_the_second_one_does_not_fit_256K_makes_1_batch_of_the_first_item_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
     DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message5.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
-        .IgnoreArgument(1)
-        .SetReturn(HTTP_HEADERS_ERROR);
+        .IgnoreArgument(1);
+
+    /*measuring the batch: message5 fits alone, but not after message1, so it stays in waitingToSend*/
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
+    setupBatchItemRead(mocks, message5.messageHandle, TEST_MAP_EMPTY);
+
+    /*writing the batch of the first item*/
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
+
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
+
+    /*once the event has been succesfull...*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
 
     ENABLE_BATCHING();
 
@@ -9296,24 +8908,26 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_HTTP_headers_fai
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_1_ITEM_PAYLOAD, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message5.entry), (void*)waitingToSend.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_065: [ If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_ERROR. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_061: [ The message size shall be limited to 255KB - 1 byte. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_062: [ The message size is computed from the length of the payload + 384. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_bigger_than_256K_path_succeeds)
+
+//Tests_SRS_TRANSPORTMULTITHTTP_21_019: [ If option "BatchPreserveOrder" is false, items that do not fit shall stay in waitingToSend and the following items shall be tried, up to 16 skipped items. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_BatchPreserveOrder_true_stops_the_batch_at_the_first_item_that_does_not_fit)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message4.entry));
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message5.entry));
+    DList_InsertTailList(&(waitingToSend), &(message2.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
@@ -9321,79 +8935,47 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_bigger_than_256K_path
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message4.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message4.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(bigBufferOverflow, TEST_BIG_BUFFER_1_OVERFLOW_SIZE));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+    /*measuring the batch: message5 does not fit after message1, message2 is not even looked at*/
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
+    setupBatchItemRead(mocks, message5.messageHandle, TEST_MAP_EMPTY);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message4.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
+    /*writing the batch*/
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
 
-    {
-        /*adding the first payload to the "big" payload*/
-        /*building the list of messages to be notified because this is 100% fail (>256K)*/
-        STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message4.entry)))
-            .IgnoreArgument(1);
-    }
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR))
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
         .IgnoreArgument(2);
 
     ENABLE_BATCHING();
+    (void)IoTHubTransportHttp_SetOption(handle, "BatchPreserveOrder", &thisIsTrue);
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_1_ITEM_PAYLOAD, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message5.entry), (void*)waitingToSend.Flink);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message2.entry), (void*)message5.entry.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-/*this is a test that wants to see that "almost" 255KB message still fits*/
-//Tests_SRS_TRANSPORTMULTITHTTP_17_062: [ The message size is computed from the length of the payload + 384. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_almost255_happy_path_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_019: [ If option "BatchPreserveOrder" is false, items that do not fit shall stay in waitingToSend and the following items shall be tried, up to 16 skipped items. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_BatchPreserveOrder_false_skips_the_item_that_does_not_fit_and_batches_the_next_one)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
     DList_InsertTailList(&(waitingToSend), &(message5.entry));
+    DList_InsertTailList(&(waitingToSend), &(message2.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
@@ -9401,128 +8983,53 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_almost255_happy_path_
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message5.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message5.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(bigBufferFit, TEST_BIG_BUFFER_1_FIT_SIZE));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message5.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message5.entry)))
-        .IgnoreArgument(1);
-
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
+    /*measuring the batch: message5 does not fit after message1 and stays in waitingToSend, message2 still makes it*/
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
+    setupBatchItemRead(mocks, message5.messageHandle, TEST_MAP_EMPTY);
+    setupBatchItemTaken(mocks, &message2, TEST_MAP_EMPTY);
 
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    /*writing the batch*/
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_2_ITEMS_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
+    setupBatchItemRead(mocks, message2.messageHandle, TEST_MAP_EMPTY);
 
-    /*once the event has been succesfull...*/
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
 
     STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
         .IgnoreArgument(2);
 
     ENABLE_BATCHING();
+    (void)IoTHubTransportHttp_SetOption(handle, "BatchPreserveOrder", &thisIsFalse);
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_BATCH_2_ITEMS_PAYLOAD) - 1, BASEIMPLEMENTATION::BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_2_ITEMS_PAYLOAD, sizeof(TEST_BATCH_2_ITEMS_PAYLOAD) - 1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message5.entry), (void*)waitingToSend.Flink);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&waitingToSend, (void*)message5.entry.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_056: [ IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...] ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_makes_1_batch_succeeds)
+/*message1 is taken, then skippedCount copies of message5 do not fit after it, then message2 comes*/
+static void setupBatchLookAhead(CIoTHubTransportHttpMocks &mocks, IOTHUB_MESSAGE_LIST* skipped, size_t skippedCount, bool isMessage2Tried)
 {
-    ///arrange
-    CIoTHubTransportHttpMocks mocks;
+    (void)mocks;
+
     DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    for (size_t i = 0; i < skippedCount; i++)
+    {
+        memset(&(skipped[i]), 0, sizeof(skipped[i]));
+        skipped[i].messageHandle = TEST_IOTHUB_MESSAGE_HANDLE_5;
+        DList_InsertTailList(&(waitingToSend), &(skipped[i].entry));
+    }
     DList_InsertTailList(&(waitingToSend), &(message2.entry));
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
@@ -9530,304 +9037,263 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_makes_1_batch_succee
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG))
-        .ExpectedAtLeastTimes(2);
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-    }
-
-    /*this is second batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message2.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer2, buffer2_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message2.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
+    setupBatchItemTaken(mocks, &message1, TEST_MAP_EMPTY);
+    for (size_t i = 0; i < skippedCount; i++)
     {
-        /*adding the second payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+        setupBatchItemRead(mocks, TEST_IOTHUB_MESSAGE_HANDLE_5, TEST_MAP_EMPTY);
     }
 
+    if (isMessage2Tried)
     {
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        setupBatchItemTaken(mocks, &message2, TEST_MAP_EMPTY);
+        setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_2_ITEMS_PAYLOAD) - 1);
+        setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
+        setupBatchItemRead(mocks, message2.messageHandle, TEST_MAP_EMPTY);
     }
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message2.entry)))
-        .IgnoreArgument(1);
-
+    else
     {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
+        setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1);
+        setupBatchItemRead(mocks, message1.messageHandle, TEST_MAP_EMPTY);
     }
 
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
-
-    /*once the event has been succesfull...*/
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
 
     STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
         .IgnoreArgument(2);
+}
 
+//Tests_SRS_TRANSPORTMULTITHTTP_21_019: [ If option "BatchPreserveOrder" is false, items that do not fit shall stay in waitingToSend and the following items shall be tried, up to 16 skipped items. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_BatchPreserveOrder_false_after_16_skipped_items_still_batches_the_next_one)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    IOTHUB_MESSAGE_LIST skipped[TEST_BATCH_LOOK_AHEAD];
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
     ENABLE_BATCHING();
+    (void)IoTHubTransportHttp_SetOption(handle, "BatchPreserveOrder", &thisIsFalse);
+
+    setupBatchLookAhead(mocks, skipped, TEST_BATCH_LOOK_AHEAD, true);
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_2_ITEMS_PAYLOAD, sizeof(TEST_BATCH_2_ITEMS_PAYLOAD) - 1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(skipped[0].entry), (void*)waitingToSend.Flink);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(skipped[TEST_BATCH_LOOK_AHEAD - 1].entry), (void*)waitingToSend.Blink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_066: [ If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_items_fails_the_first_one_still_makes_1_batch_succeeds_1)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_019: [ If option "BatchPreserveOrder" is false, items that do not fit shall stay in waitingToSend and the following items shall be tried, up to 16 skipped items. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_BatchPreserveOrder_false_stops_looking_ahead_at_the_17th_skipped_item)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message1.entry));
-    DList_InsertTailList(&(waitingToSend), &(message2.entry));
+    IOTHUB_MESSAGE_LIST skipped[TEST_BATCH_LOOK_AHEAD + 1];
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    ENABLE_BATCHING();
+    (void)IoTHubTransportHttp_SetOption(handle, "BatchPreserveOrder", &thisIsFalse);
+
+    setupBatchLookAhead(mocks, skipped, TEST_BATCH_LOOK_AHEAD + 1, false);
+
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_1_ITEM_PAYLOAD, sizeof(TEST_BATCH_1_ITEM_PAYLOAD) - 1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(skipped[0].entry), (void*)waitingToSend.Flink);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message2.entry), (void*)waitingToSend.Blink);
+
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+/*** IoTHubTransportHttp_GetSendStatus ***/
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_111: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_InvalidHandleArgument_fail)
+{
+    // arrange
+    CIoTHubTransportHttpMocks mocks;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
 
     mocks.ResetAllCalls();
-    setupDoWorkLoopOnceForOneDevice(mocks);
+
+    IOTHUB_CLIENT_STATUS status;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetSendStatus(NULL, &status);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+
+    mocks.AssertActualAndExpectedCalls();
+
+    // cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_111: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_InvalidStatusArgument_fail)
+{
+    // arrange
+    CIoTHubTransportHttpMocks mocks;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+
+    mocks.ResetAllCalls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetSendStatus(devHandle, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+
+    mocks.AssertActualAndExpectedCalls();
+
+    // cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_112: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there are currently no event items to be sent or being sent. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list by calling VECTOR_find_if. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_empty_waitingToSend_and_empty_eventConfirmations_success)
+{
+    // arrange
+    CIoTHubTransportHttpMocks mocks;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
-        .IgnoreArgument(1);
+    IOTHUB_CLIENT_STATUS status;
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetSendStatus(devHandle, &status);
 
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG))
-        .ExpectedAtLeastTimes(2);
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, status, IOTHUB_CLIENT_SEND_STATUS_IDLE);
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    mocks.AssertActualAndExpectedCalls();
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+    // cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
+//Tests_SRS_TRANSPORTMULTITHTTP_17_113: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently event items to be sent or being sent. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list by calling VECTOR_find_if. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_waitingToSend_not_empty_success)
+{
+    // arrange
+    CIoTHubTransportHttpMocks mocks;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-    }
+    IOTHUB_MESSAGE_HANDLE eventMessageHandle = IoTHubMessage_CreateFromByteArray(contains3, 1);
+    IOTHUB_MESSAGE_LIST newEntry;
+    newEntry.messageHandle = eventMessageHandle;
+    DList_InsertTailList(&(waitingToSend), &(newEntry.entry));
 
-    /*this is second batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message2.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
+    mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer2, buffer2_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+    IOTHUB_CLIENT_STATUS status;
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message2.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        whenShallSTRING_concat_fail = currentSTRING_concat_call + 4;
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the second batched payload*/
-    }
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetSendStatus(devHandle, &status);
 
-    {
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, status, IOTHUB_CLIENT_SEND_STATUS_BUSY);
 
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
-        .IgnoreArgument(1);
+    mocks.AssertActualAndExpectedCalls();
 
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    // cleanup
+    IoTHubTransportHttp_Destroy(handle);
+    IoTHubMessage_Destroy(eventMessageHandle);
+}
 
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
+//Tests_SRS_TRANSPORTMULTITHTTP_17_139: [ If the device structure is not found, then this function shall fail and return with IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_deviceData_is_not_found_fails)
+{
+    // arrange
+    CIoTHubTransportHttpMocks mocks;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
+    IOTHUB_MESSAGE_HANDLE eventMessageHandle = IoTHubMessage_CreateFromByteArray(contains3, 1);
+    IOTHUB_MESSAGE_LIST newEntry;
+    newEntry.messageHandle = eventMessageHandle;
+    DList_InsertTailList(&(waitingToSend), &(newEntry.entry));
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+        .SetFailReturn((void_ptr)NULL);
 
-    /*once the event has been succesfull...*/
+    IOTHUB_CLIENT_STATUS status;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetSendStatus(devHandle, &status);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+
+    mocks.AssertActualAndExpectedCalls();
+
+    // cleanup
+    IoTHubTransportHttp_Destroy(handle);
+    IoTHubMessage_Destroy(eventMessageHandle);
+}
+
+#define TEST_2_ITEM_STRING "[{\"body\":\"MTIzNDU2\",\"properties\":{" TEST_RED_KEY_STRING_WITH_IOTHUBAPP ":" TEST_RED_VALUE_STRING "}},{\"body\":\"MTIzNDU2Nw==\",\"properties\":{" TEST_BLUE_KEY_STRING_WITH_IOTHUBAPP ":" TEST_BLUE_VALUE_STRING "," TEST_YELLOW_KEY_STRING_WITH_IOTHUBAPP ":" TEST_YELLOW_VALUE_STRING "}}]"
+#define TEST_1_ITEM_STRING "[{\"body\":\"MTIzNDU2\",\"properties\":{" TEST_RED_KEY_STRING_WITH_IOTHUBAPP ":" TEST_RED_VALUE_STRING "}}]"
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_064: [ If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_059: [ It shall inspect the "waitingToSend" DLIST passed in config structure. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_with_properties_succeeds)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+
+    mocks.ResetAllCalls();
+
+    setupDoWorkLoopOnceForOneDevice(mocks);
+
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
+
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
+        .IgnoreArgument(1);
+
+    setupBatchItemTaken(mocks, &message6, TEST_MAP_1_PROPERTY);
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_1_ITEM_STRING) - 1);
+    setupBatchItemRead(mocks, message6.messageHandle, TEST_MAP_1_PROPERTY);
+
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
 
+    /*once the event has been succesfull...*/
     STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
         .IgnoreArgument(2);
 
@@ -9838,22 +9304,26 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_item
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_1_ITEM_STRING, sizeof(TEST_1_ITEM_STRING) - 1));
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_066: [ If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_items_fails_the_first_one_still_makes_1_batch_succeeds_2)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_018: [ The size of a batch shall be the exact length of its encoded payload, base64 and JSON escaping included. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_with_1_properties_at_maximum_message_size_succeeds)
 {
+    /*this test shall use a message that, base64 encoded and batched, leaves exactly room for ,"properties":{"iothub-app-a":"b"}*/
+    /*therefore reaching the MAXIMUM_MESSAGE_SIZE*/
+    /*the next test will increase the property name by 1 character as the message is expected to fail*/
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message1.entry));
-    DList_InsertTailList(&(waitingToSend), &(message2.entry));
+    DList_InsertTailList(&(waitingToSend), &(message13.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
+
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
@@ -9861,303 +9331,124 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_item
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG))
-        .ExpectedAtLeastTimes(2);
+    setupBatchItemTaken(mocks, &message13, TEST_MAP_1_PROPERTY_A_B);
+    setupBatchPayloadAlloc(mocks, MAXIMUM_MESSAGE_SIZE);
+    setupBatchItemRead(mocks, message13.messageHandle, TEST_MAP_1_PROPERTY_A_B);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);;
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-    }
-
-    /*this is second batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message2.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
+    /*once the event has been succesfull...*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer2, buffer2_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    ENABLE_BATCHING();
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message2.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the second batched payload*/
-    }
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    {
-        /*adding the second payload to the "big" payload*/
-        whenShallSTRING_concat_with_STRING_fail = currentSTRING_concat_with_STRING_call + 4;
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-    }
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, MAXIMUM_MESSAGE_SIZE, BASEIMPLEMENTATION::BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest) + MAXIMUM_MESSAGE_SIZE - (sizeof(TEST_BATCH_PROPERTIES_A_B "}]") - 1), TEST_BATCH_PROPERTIES_A_B "}]", sizeof(TEST_BATCH_PROPERTIES_A_B "}]") - 1));
 
-    {
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
-        .IgnoreArgument(1);
+//Tests_SRS_TRANSPORTMULTITHTTP_21_018: [ The size of a batch shall be the exact length of its encoded payload, base64 and JSON escaping included. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_with_1_properties_past_maximum_message_size_fails)
+{
+    /*this test shall use the same message as the previous test*/
+    /*it will have a property of "aa":"b", therefore reaching 1 byte past the MAXIMUM_MESSAGE_SIZE*/
+    /*this is done in a very e2e manner*/
+    ///arrange
+    CNiceCallComparer<CIoTHubTransportHttpMocks>mocks;
+    DList_InsertTailList(&(waitingToSend), &(message14.entry));
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    ENABLE_BATCHING();
 
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
 
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    mocks.ResetAllCalls();
 
-    /*once the event has been succesfull...*/
+    setupDoWorkLoopOnceForOneDevice(mocks);
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR))
         .IgnoreArgument(2);
 
-    ENABLE_BATCHING();
-
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_066: [ If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_the_second_one_does_not_fit_256K_makes_1_batch_of_the_first_item_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_064: [ If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_fails_when_Map_GetInternals_fails)
 {
     ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message1.entry));
-    DList_InsertTailList(&(waitingToSend), &(message5.entry));
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-    setupDoWorkLoopOnceForOneDevice(mocks);
-
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
-
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
-        .IgnoreArgument(1);
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG))
-        .ExpectedAtLeastTimes(2);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
+    setupDoWorkLoopOnceForOneDevice(mocks);
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(buffer1, buffer1_size));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .SetReturn(MAP_ERROR);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+    ENABLE_BATCHING();
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message1.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-    }
+    ///assert
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+    mocks.AssertActualAndExpectedCalls();
 
-    /*this is second batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message5.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(message5.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
 
-        STRICT_EXPECTED_CALL(mocks, Base64_Encode_Bytes(bigBufferFit, TEST_BIG_BUFFER_1_FIT_SIZE));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+//Tests_SRS_TRANSPORTMULTITHTTP_17_064: [ If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_with_properties_succeeds)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    DList_InsertTailList(&(waitingToSend), &(message7.entry));
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message5.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
+    mocks.ResetAllCalls();
 
-    {
-        /*adding the second payload to the "big" payload*/
-    }
+    setupDoWorkLoopOnceForOneDevice(mocks);
 
-    {
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
+    setupBatchItemTaken(mocks, &message6, TEST_MAP_1_PROPERTY);
+    setupBatchItemTaken(mocks, &message7, TEST_MAP_2_PROPERTY);
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_2_ITEM_STRING) - 1);
+    setupBatchItemRead(mocks, message6.messageHandle, TEST_MAP_1_PROPERTY);
+    setupBatchItemRead(mocks, message7.messageHandle, TEST_MAP_2_PROPERTY);
 
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
 
     /*once the event has been succesfull...*/
-
     STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
         .IgnoreArgument(2);
 
@@ -10168,674 +9459,501 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_the_second_one_does_
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_2_ITEM_STRING, sizeof(TEST_2_ITEM_STRING) - 1));
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
 
-/*** IoTHubTransportHttp_GetSendStatus ***/
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_111: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter. ]
-TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_InvalidHandleArgument_fail)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_058: [ If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2"} ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items)
 {
-    // arrange
-    CIoTHubTransportHttpMocks mocks;
+    ///arrange
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks; /*a very e2e test... */
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    DList_InsertTailList(&(waitingToSend), &(message7.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
 
-    IOTHUB_CLIENT_STATUS status;
+    setupDoWorkLoopOnceForOneDevice(mocks);
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetSendStatus(NULL, &status);
+    ENABLE_BATCHING();
 
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_2_ITEM_STRING, sizeof(TEST_2_ITEM_STRING) - 1));
     mocks.AssertActualAndExpectedCalls();
 
-    // cleanup
+    ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_111: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter. ]
-TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_InvalidStatusArgument_fail)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_066: [ If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_send_only_1_when_properties_for_second_fail)
 {
-    // arrange
-    CIoTHubTransportHttpMocks mocks;
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    ///arrange
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks; /*a very e2e test... */
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    DList_InsertTailList(&(waitingToSend), &(message7.entry));
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetSendStatus(devHandle, NULL);
+    setupDoWorkLoopOnceForOneDevice(mocks);
 
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_2_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .SetReturn(MAP_ERROR);
+
+    ENABLE_BATCHING();
+
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_1_ITEM_STRING) - 1, BASEIMPLEMENTATION::BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_1_ITEM_STRING, sizeof(TEST_1_ITEM_STRING) - 1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message7.entry), (void*)waitingToSend.Flink);
     mocks.AssertActualAndExpectedCalls();
 
-    // cleanup
+    ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_112: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there are currently no event items to be sent or being sent. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list by calling VECTOR_find_if. ]
-TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_empty_waitingToSend_and_empty_eventConfirmations_success)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_send_nothing)
 {
-    // arrange
-    CIoTHubTransportHttpMocks mocks;
+    ///arrange
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks; /*a very e2e test... */
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    DList_InsertTailList(&(waitingToSend), &(message7.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
+    setupDoWorkLoopOnceForOneDevice(mocks);
 
-    IOTHUB_CLIENT_STATUS status;
+    STRICT_EXPECTED_CALL(mocks, BUFFER_pre_build(IGNORED_PTR_ARG, sizeof(TEST_2_ITEM_STRING) - 1))
+        .IgnoreArgument(1)
+        .SetReturn(__FAILURE__);
 
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetSendStatus(devHandle, &status);
+    ENABLE_BATCHING();
 
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_OK);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, status, IOTHUB_CLIENT_SEND_STATUS_IDLE);
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
+    ///assert
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+    /*both items are back in waitingToSend, in their original order*/
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message6.entry), (void*)waitingToSend.Flink);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message7.entry), (void*)waitingToSend.Flink->Flink);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&waitingToSend, (void*)waitingToSend.Flink->Flink->Flink);
     mocks.AssertActualAndExpectedCalls();
 
-    // cleanup
+    ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_113: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently event items to be sent or being sent. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list by calling VECTOR_find_if. ]
-TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_waitingToSend_not_empty_success)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_114: [ If handle parameter is NULL then IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_with_NULL_handle_fails)
 {
-    // arrange
-    CIoTHubTransportHttpMocks mocks;
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
-    IOTHUB_MESSAGE_HANDLE eventMessageHandle = IoTHubMessage_CreateFromByteArray(contains3, 1);
-    IOTHUB_MESSAGE_LIST newEntry;
-    newEntry.messageHandle = eventMessageHandle;
-    DList_InsertTailList(&(waitingToSend), &(newEntry.entry));
-
-    mocks.ResetAllCalls();
-
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
-
-    IOTHUB_CLIENT_STATUS status;
-
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetSendStatus(devHandle, &status);
+    ///arrange
 
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_OK);
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, status, IOTHUB_CLIENT_SEND_STATUS_BUSY);
+    ///act
+    auto result = IoTHubTransportHttp_SetOption(NULL, "someOption", "someValue");
 
-    mocks.AssertActualAndExpectedCalls();
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
 
-    // cleanup
-    IoTHubTransportHttp_Destroy(handle);
-    IoTHubMessage_Destroy(eventMessageHandle);
+    ///cleanup
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_139: [ If the device structure is not found, then this function shall fail and return with IOTHUB_CLIENT_INVALID_ARG. ]
-TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_deviceData_is_not_found_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_115: [ If option parameter is NULL then IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_with_NULL_optionName_fails)
 {
-    // arrange
+    ///arrange
     CIoTHubTransportHttpMocks mocks;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
-    IOTHUB_MESSAGE_HANDLE eventMessageHandle = IoTHubMessage_CreateFromByteArray(contains3, 1);
-    IOTHUB_MESSAGE_LIST newEntry;
-    newEntry.messageHandle = eventMessageHandle;
-    DList_InsertTailList(&(waitingToSend), &(newEntry.entry));
-
     mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn((void_ptr)NULL);
-
-    IOTHUB_CLIENT_STATUS status;
-
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetSendStatus(devHandle, &status);
-
-    // assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+    ///act
+    auto result = IoTHubTransportHttp_SetOption(handle, NULL, "someValue");
 
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 
-    // cleanup
+    ///cleanup
     IoTHubTransportHttp_Destroy(handle);
-    IoTHubMessage_Destroy(eventMessageHandle);
 }
 
-void setupIrrelevantMocksForProperties(CIoTHubTransportHttpMocks *mocks, IOTHUB_MESSAGE_HANDLE messageHandle) /*these are copy pasted from TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items))*/
+//Tests_SRS_TRANSPORTMULTITHTTP_17_116: [ If value parameter is NULL then IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_with_NULL_value_fails)
 {
-    (void)(*mocks);
-    STRICT_EXPECTED_CALL((*mocks), DList_IsListEmpty(&waitingToSend));
-
-    STRICT_EXPECTED_CALL((*mocks), HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
-        .IgnoreArgument(1);
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL((*mocks), STRING_construct("["));
-    STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetContentType(messageHandle));
-        STRICT_EXPECTED_CALL((*mocks), STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetByteArray(messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        if(messageHandle == TEST_IOTHUB_MESSAGE_HANDLE_11)
-        {
-            STRICT_EXPECTED_CALL((*mocks), Base64_Encode_Bytes(buffer11, buffer11_size));
-
-        }
-        else
-        {
-            STRICT_EXPECTED_CALL((*mocks), Base64_Encode_Bytes(buffer6, buffer6_size));
-        }
-
-        STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL((*mocks), STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL((*mocks), DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    if(messageHandle == TEST_IOTHUB_MESSAGE_HANDLE_11)
-    {
-        STRICT_EXPECTED_CALL((*mocks), DList_InsertTailList(IGNORED_PTR_ARG, &(message11.entry)))
-            .IgnoreArgument(1);
-    }
-    else
-    {
-        STRICT_EXPECTED_CALL((*mocks), DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)))
-            .IgnoreArgument(1);
-    }
-
-
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL((*mocks), BUFFER_new());
-        STRICT_EXPECTED_CALL((*mocks), BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL((*mocks), STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
 
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL((*mocks), STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL((*mocks), HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    ///act
+    auto result = IoTHubTransportHttp_SetOption(handle, "someOption", NULL);
 
-    /*once the event has been succesfull...*/
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
 
-    STRICT_EXPECTED_CALL((*mocks), IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
-        .IgnoreArgument(2);
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_064: [ If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_059: [ It shall inspect the "waitingToSend" DLIST passed in config structure. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_with_properties_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_119: [ The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes: ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_118: [ Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_succeeds_when_HTTPAPIEX_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message6.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
     mocks.ResetAllCalls();
 
-    setupDoWorkLoopOnceForOneDevice(mocks);
-
-    setupIrrelevantMocksForProperties(&mocks, message6.messageHandle);
-
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message6.messageHandle));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .IgnoreArgument(4);
-
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"properties\":"))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "{"))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"iothub-app-"))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_VALUES1[0]))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\":\""))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_KEYS1[0]))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\""))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "}"))
-        .IgnoreArgument(1);
-
-    ENABLE_BATCHING();
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SetOption(TEST_HTTPAPIEX_HANDLE, "someOption", (void*)42));
 
     ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    auto result = IoTHubTransportHttp_SetOption(handle, "someOption", (void*)42);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_063: [ Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_with_1_properties_at_maximum_message_size_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_119: [ The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes: ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_118: [ Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_fails_when_HTTPAPIEX_returns_HTTPAPIEX_INVALID_ARG)
 {
-    /*this test shall use a message that has a payload of MAXIMUM_MESSAGE_SIZE - PAYLOAD_OVERHEAD - PROPERTY_OVERHEAD - 2*/
-    /*it will also have a property of "a":"b", therefore reaching the MAXIMUM_MESSAGE_SIZE*/
-    /*the next test will increase either the propertyname or value by 1 character as the message is expected to fail*/
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message11.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
     mocks.ResetAllCalls();
 
-    setupDoWorkLoopOnceForOneDevice(mocks);
-
-    setupIrrelevantMocksForProperties(&mocks, message11.messageHandle);
-
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message11.messageHandle));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY_A_B, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .IgnoreArgument(4);
-
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG));
-
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"properties\":"))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "{"))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"iothub-app-"))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_VALUES1_A_B[0]))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\":\""))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_KEYS1_A_B[0]))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\""))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "}"))
-        .IgnoreArgument(1);
-
-    ENABLE_BATCHING();
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SetOption(TEST_HTTPAPIEX_HANDLE, "someOption", (void*)42))
+        .SetReturn(HTTPAPIEX_INVALID_ARG);
 
     ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    auto result = IoTHubTransportHttp_SetOption(handle, "someOption", (void*)42);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_063: [ Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_with_1_properties_past_maximum_message_size_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_119: [ The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes: ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_118: [ Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_fails_when_HTTPAPIEX_returns_HTTPAPIEX_ERROR)
 {
-    /*this test shall use a message that has a payload of MAXIMUM_MESSAGE_SIZE - PAYLOAD_OVERHEAD - PROPERTY_OVERHEAD - 2*/
-    /*it will also have a property of "aa":"b", therefore reaching 1 byte past the MAXIMUM_MESSAGE_SIZE*/
-    /*this is done in a very e2e manner*/
     ///arrange
-    CNiceCallComparer<CIoTHubTransportHttpMocks>mocks;
-    DList_InsertTailList(&(waitingToSend), &(message12.entry));
+    CIoTHubTransportHttpMocks mocks;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
-    ENABLE_BATCHING();
-
-
     mocks.ResetAllCalls();
 
-    setupDoWorkLoopOnceForOneDevice(mocks);
-
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR))
-        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SetOption(TEST_HTTPAPIEX_HANDLE, "someOption", (void*)42))
+        .SetReturn(HTTPAPIEX_ERROR);
 
     ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    auto result = IoTHubTransportHttp_SetOption(handle, "someOption", (void*)42);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_064: [ If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_fails_when_Map_GetInternals_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_119: [ The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes: ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_118: [ Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_fails_when_HTTPAPIEX_returns_any_other_error)
 {
     ///arrange
-    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
-    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    CIoTHubTransportHttpMocks mocks;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
     mocks.ResetAllCalls();
 
-    setupDoWorkLoopOnceForOneDevice(mocks);
-
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .IgnoreArgument(4)
-        .SetReturn(MAP_ERROR);
-
-    ENABLE_BATCHING();
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SetOption(TEST_HTTPAPIEX_HANDLE, "someOption", (void*)42))
+        .SetReturn(HTTPAPIEX_RECOVERYFAILED);
 
     ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    auto result = IoTHubTransportHttp_SetOption(handle, "someOption", (void*)42);
 
     ///assert
-    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
     mocks.AssertActualAndExpectedCalls();
 
-
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-void setupIrrelevantMocksForProperties2(CIoTHubTransportHttpMocks *mocks, IOTHUB_MESSAGE_HANDLE h1, IOTHUB_MESSAGE_HANDLE h2) /*these are copy pasted from TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items))*/
+//Tests_SRS_TRANSPORTMULTITHTTP_17_096: [ If IoTHubClient_LL_MessageCallback returns IOTHUBMESSAGE_ABANDONED then _DoWork shall "abandon" the message. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_abandon_succeeds)
 {
-    (void)(*mocks);
-    STRICT_EXPECTED_CALL((*mocks), DList_IsListEmpty(&waitingToSend));
-
-    STRICT_EXPECTED_CALL((*mocks), HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
-        .IgnoreArgument(1);
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL((*mocks), STRING_construct("["));
-    STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetContentType(h1));
-        STRICT_EXPECTED_CALL((*mocks), STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetByteArray(message6.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL((*mocks), Base64_Encode_Bytes(buffer6, buffer6_size));
-        STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    unsigned int statusCode200 = 200;
+    unsigned int statusCode204 = 204;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-    }
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    mocks.ResetAllCalls();
+    setupDoWorkLoopOnceForOneDevice(mocks);
 
-    /*this is second batched payload*/
-    {
-        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetContentType(h2));
-        STRICT_EXPECTED_CALL((*mocks), STRING_construct("{\"body\":\""));
-        STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetByteArray(message7.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
 
-        STRICT_EXPECTED_CALL((*mocks), Base64_Encode_Bytes(buffer7, buffer7_size));
-        STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
-            .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .IgnoreArgument(8)
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .IgnoreArgument(1)
+        .SetReturn(TEST_ETAG_VALUE);
 
-    {
-        /*adding the second payload to the "big" payload*/
-        STRICT_EXPECTED_CALL((*mocks), STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
 
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL((*mocks), STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_MessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(IOTHUBMESSAGE_ABANDONED);
 
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL((*mocks), DList_RemoveHeadList(IGNORED_PTR_ARG))
+    /*this is "abandon"*/
+    STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL((*mocks), DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)))
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL((*mocks), DList_RemoveHeadList(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
+        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL((*mocks), DList_InsertTailList(IGNORED_PTR_ARG, &(message7.entry)))
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION))
         .IgnoreArgument(1);
 
-
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL((*mocks), BUFFER_new());
-        STRICT_EXPECTED_CALL((*mocks), BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL((*mocks), STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
-
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL((*mocks), STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL((*mocks), HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
         .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
-    /*once the event has been succesfull...*/
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    STRICT_EXPECTED_CALL((*mocks), IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
-        .IgnoreArgument(2);
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_064: [ If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_with_properties_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_090: [ All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_1_property_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message6.entry));
-    DList_InsertTailList(&(waitingToSend), &(message7.entry));
+    unsigned int statusCode200 = 200;
+    unsigned int statusCode204 = 204;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    size_t nHeaders = 1;
     mocks.ResetAllCalls();
 
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-    setupIrrelevantMocksForProperties2(&mocks, message6.messageHandle, message7.messageHandle);
-
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message6.messageHandle));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .IgnoreArgument(4);
-
-    EXPECTED_CALL(mocks, STRING_new_with_memory(IGNORED_PTR_ARG))
-        .ExpectedAtLeastTimes(2);
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
 
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"properties\":"))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "{")) /*opening of the properties*/
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"iothub-app-"))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_VALUES1[0]))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\":\""))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_KEYS1[0]))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\""))
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "}"))/*closing of the properties*/
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .IgnoreArgument(8)
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message7.messageHandle));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_2_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .IgnoreArgument(1)
+        .SetReturn(TEST_ETAG_VALUE);
 
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"properties\":"))
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "{")) /*opening of the properties*/
+    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\"iothub-app-"))
+    STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_VALUES2[0]))
+    {
+        /*this scope is for is properties code*/
+
+        HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
+
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
+    }
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_MessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+
+    /*this returns "0" so the message needs to be "accepted"*/
+    /*this is "accepting"*/
+    STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\":\""))
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_KEYS2[0]))
+    STRICT_EXPECTED_CALL(mocks, STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
+        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\""))
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, API_VERSION))
         .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"iothub-app-"))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_VALUES2[1]))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\":\""))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_KEYS2[1]))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "\""))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
         .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "}"))/*closing of the properties*/
-        .IgnoreArgument(1);
 
-    ENABLE_BATCHING();
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        NULL                                                /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -10847,302 +9965,161 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_with_properties_succ
     IoTHubTransportHttp_Destroy(handle);
 }
 
-
-#define TEST_2_ITEM_STRING "[{\"body\":\"MTIzNDU2\",\"properties\":{" TEST_RED_KEY_STRING_WITH_IOTHUBAPP ":" TEST_RED_VALUE_STRING "}},{\"body\":\"MTIzNDU2Nw==\",\"properties\":{" TEST_BLUE_KEY_STRING_WITH_IOTHUBAPP ":" TEST_BLUE_VALUE_STRING "," TEST_YELLOW_KEY_STRING_WITH_IOTHUBAPP ":" TEST_YELLOW_VALUE_STRING "}}]"
-#define TEST_1_ITEM_STRING "[{\"body\":\"MTIzNDU2\",\"properties\":{" TEST_RED_KEY_STRING_WITH_IOTHUBAPP ":" TEST_RED_VALUE_STRING "}}]"
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_058: [ If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2"} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_090: [ All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_succeeds)
 {
     ///arrange
-    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks; /*a very e2e test... */
-    DList_InsertTailList(&(waitingToSend), &(message6.entry));
-    DList_InsertTailList(&(waitingToSend), &(message7.entry));
+    CIoTHubTransportHttpMocks mocks;
+    unsigned int statusCode200 = 200;
+    unsigned int statusCode204 = 204;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    size_t nHeaders = 3;
     mocks.ResetAllCalls();
 
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-    ENABLE_BATCHING();
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
 
-    ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    ///assert
-    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_2_ITEM_STRING, sizeof(TEST_2_ITEM_STRING) - 1));
-    mocks.AssertActualAndExpectedCalls();
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
-}
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .IgnoreArgument(8)
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
-#define THRESHOLD1 32 /*between THRESHOLD1 and THRESHOLD2 of STRING_concat fails there still is produced a payload, consisting of only REDKEY, REDVALUE*/
-#define THRESHOLD2 17
-#define THRESHOLD3 7 /*below 7, STRING_concat would fail not in producing properties*/
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .IgnoreArgument(1)
+        .SetReturn(TEST_ETAG_VALUE);
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_058: [ If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2"} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_THRESHOLD1_succeeds)
-{
-    for (size_t i = THRESHOLD1 + 1; i > THRESHOLD1; i--)
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     {
-        ///arrange
-        currentSTRING_concat_call = 0;
-        whenShallSTRING_concat_fail = 0;
-        BASEIMPLEMENTATION::DList_InitializeListHead(&waitingToSend);
-        CNiceCallComparer<CIoTHubTransportHttpMocks> mocks; /*a very e2e test... */
-        DList_InsertTailList(&(waitingToSend), &(message6.entry));
-        DList_InsertTailList(&(waitingToSend), &(message7.entry));
-        auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-        (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
-        mocks.ResetAllCalls();
-
-        setupDoWorkLoopOnceForOneDevice(mocks);
+        /*this scope is for is properties code*/
 
-        whenShallSTRING_concat_fail = i;
+        HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
 
-        ENABLE_BATCHING();
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
 
-        ///act
-        IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
 
-        ///assert
-        ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_2_ITEM_STRING, sizeof(TEST_2_ITEM_STRING) - 1));
-        mocks.AssertActualAndExpectedCalls();
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
 
-        ///cleanup
-        IoTHubTransportHttp_Destroy(handle);
-        if (last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest != NULL)
-        {
-            BASEIMPLEMENTATION::BUFFER_delete(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
-            last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest = NULL;
-        }
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME2", "VALUE2"));
     }
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_058: [ If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2"} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_send_only_1_when_properties_for_second_fail)
-{
-    for (size_t i = THRESHOLD1; i > THRESHOLD2; i--)
-    {
-        ///arrange
-        currentSTRING_concat_call = 0;
-        whenShallSTRING_concat_fail = 0;
-        BASEIMPLEMENTATION::DList_InitializeListHead(&waitingToSend);
-        CNiceCallComparer<CIoTHubTransportHttpMocks> mocks; /*a very e2e test... */
-        DList_InsertTailList(&(waitingToSend), &(message6.entry));
-        DList_InsertTailList(&(waitingToSend), &(message7.entry));
-        auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-        (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
-        mocks.ResetAllCalls();
 
-        setupDoWorkLoopOnceForOneDevice(mocks);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_MessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
 
-        whenShallSTRING_concat_fail = i;
 
-        ENABLE_BATCHING();
+    /*this returns "0" so the message needs to be "accepted"*/
+    /*this is "accepting"*/
+    STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
+        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, API_VERSION))
+        .IgnoreArgument(1);
 
-        ///act
-        IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
+        .IgnoreArgument(1);
 
-        ///assert
-        ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_1_ITEM_STRING, sizeof(TEST_1_ITEM_STRING) - 1));
-        mocks.AssertActualAndExpectedCalls();
 
-        ///cleanup
-        IoTHubTransportHttp_Destroy(handle);
-        if (last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest != NULL)
-        {
-            BASEIMPLEMENTATION::BUFFER_delete(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
-            last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest = NULL;
-        }
-    }
-}
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        NULL                                                /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_058: [ If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2"} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_send_nothing)
-{
-    for (size_t i = THRESHOLD2; i > THRESHOLD3; i--)
-    {
-        ///arrange
-        currentSTRING_concat_call = 0;
-        whenShallSTRING_concat_fail = 0;
-        BASEIMPLEMENTATION::DList_InitializeListHead(&waitingToSend);
-        CNiceCallComparer<CIoTHubTransportHttpMocks> mocks; /*a very e2e test... */
-        DList_InsertTailList(&(waitingToSend), &(message6.entry));
-        DList_InsertTailList(&(waitingToSend), &(message7.entry));
-        auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-        mocks.ResetAllCalls();
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-        whenShallSTRING_concat_fail = i;
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
 
-        ENABLE_BATCHING();
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-        ///act
-        IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
-
-        ///assert
-        ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
-        mocks.AssertActualAndExpectedCalls();
-
-        ///cleanup
-        IoTHubTransportHttp_Destroy(handle);
-        if (last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest != NULL)
-        {
-            BASEIMPLEMENTATION::BUFFER_delete(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
-            last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest = NULL;
-        }
-    }
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_114: [ If handle parameter is NULL then IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]
-TEST_FUNCTION(IoTHubTransportHttp_SetOption_with_NULL_handle_fails)
-{
-    ///arrange
-
-    ///act
-    auto result = IoTHubTransportHttp_SetOption(NULL, "someOption", "someValue");
-
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
-
-    ///cleanup
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_115: [ If option parameter is NULL then IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]
-TEST_FUNCTION(IoTHubTransportHttp_SetOption_with_NULL_optionName_fails)
-{
-    ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    mocks.ResetAllCalls();
-
-    ///act
-    auto result = IoTHubTransportHttp_SetOption(handle, NULL, "someValue");
-
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_116: [ If value parameter is NULL then IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]
-TEST_FUNCTION(IoTHubTransportHttp_SetOption_with_NULL_value_fails)
-{
-    ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    mocks.ResetAllCalls();
-
-    ///act
-    auto result = IoTHubTransportHttp_SetOption(handle, "someOption", NULL);
-
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_119: [ The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes: ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_118: [ Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code. ]
-TEST_FUNCTION(IoTHubTransportHttp_SetOption_succeeds_when_HTTPAPIEX_succeeds)
-{
-    ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    mocks.ResetAllCalls();
-
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SetOption(TEST_HTTPAPIEX_HANDLE, "someOption", (void*)42));
-
-    ///act
-    auto result = IoTHubTransportHttp_SetOption(handle, "someOption", (void*)42);
-
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_119: [ The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes: ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_118: [ Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code. ]
-TEST_FUNCTION(IoTHubTransportHttp_SetOption_fails_when_HTTPAPIEX_returns_HTTPAPIEX_INVALID_ARG)
-{
-    ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    mocks.ResetAllCalls();
-
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SetOption(TEST_HTTPAPIEX_HANDLE, "someOption", (void*)42))
-        .SetReturn(HTTPAPIEX_INVALID_ARG);
-
-    ///act
-    auto result = IoTHubTransportHttp_SetOption(handle, "someOption", (void*)42);
-
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_119: [ The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes: ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_118: [ Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code. ]
-TEST_FUNCTION(IoTHubTransportHttp_SetOption_fails_when_HTTPAPIEX_returns_HTTPAPIEX_ERROR)
-{
-    ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    mocks.ResetAllCalls();
-
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SetOption(TEST_HTTPAPIEX_HANDLE, "someOption", (void*)42))
-        .SetReturn(HTTPAPIEX_ERROR);
-
-    ///act
-    auto result = IoTHubTransportHttp_SetOption(handle, "someOption", (void*)42);
-
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_119: [ The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes: ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_118: [ Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code. ]
-TEST_FUNCTION(IoTHubTransportHttp_SetOption_fails_when_HTTPAPIEX_returns_any_other_error)
-{
-    ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    mocks.ResetAllCalls();
-
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SetOption(TEST_HTTPAPIEX_HANDLE, "someOption", (void*)42))
-        .SetReturn(HTTPAPIEX_RECOVERYFAILED);
-
-    ///act
-    auto result = IoTHubTransportHttp_SetOption(handle, "someOption", (void*)42);
-
-    ///assert
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_096: [ If IoTHubClient_LL_MessageCallback returns IOTHUBMESSAGE_ABANDONED then _DoWork shall "abandon" the message. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_abandon_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_090: [ All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_092: [ If assembling the message fails in any way, then _DoWork shall "abandon" the message. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_when_properties_fails_it_abandons_1)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -11152,7 +10129,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
     auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     (void)IoTHubTransportHttp_Subscribe(devHandle);
+    size_t nHeaders = 3;
     mocks.ResetAllCalls();
+
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
@@ -11168,8 +10147,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -11180,12 +10159,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -11193,21 +10171,45 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
     STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+    {
+        /*this scope is for is properties code*/
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_MessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetReturn(IOTHUBMESSAGE_ABANDONED);
+        HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
+
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
+
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME2", "VALUE2"))
+            .SetReturn(MAP_ERROR);
+    }
 
     /*this is "abandon"*/
     STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
@@ -11234,10 +10236,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
         .IgnoreArgument(1);
 
+
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
@@ -11248,10 +10251,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -11263,8 +10265,10 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
     IoTHubTransportHttp_Destroy(handle);
 }
 
+
 //Tests_SRS_TRANSPORTMULTITHTTP_17_090: [ All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_1_property_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_092: [ If assembling the message fails in any way, then _DoWork shall "abandon" the message. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_when_properties_fails_it_abandons_2)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -11274,7 +10278,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
     auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     (void)IoTHubTransportHttp_Subscribe(devHandle);
-    size_t nHeaders = 1;
+    size_t nHeaders = 3;
     mocks.ResetAllCalls();
 
     setupDoWorkLoopOnceForOneDevice(mocks);
@@ -11292,8 +10296,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -11304,12 +10308,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -11341,15 +10344,20 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
-    }
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_MessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
 
+        whenShallHTTPHeaders_GetHeader_fail = currentHTTPHeaders_GetHeader_call + 3;
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+    }
 
-    /*this returns "0" so the message needs to be "accepted"*/
-    /*this is "accepting"*/
+    /*this is "abandon"*/
     STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
@@ -11361,7 +10369,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
     STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, API_VERSION))
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION))
         .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
@@ -11377,22 +10385,21 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
         NULL,                                               /*BUFFER_HANDLE requestContent,                                */
         IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
         NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -11405,7 +10412,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_090: [ All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_092: [ If assembling the message fails in any way, then _DoWork shall "abandon" the message. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_when_properties_fails_it_abandons_3)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -11433,8 +10441,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -11445,12 +10453,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -11483,27 +10490,13 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
 
+        whenShallHTTPHeaders_GetHeader_fail = currentHTTPHeaders_GetHeader_call + 2;
         STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
             .IgnoreArgument(1)
             .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME2", "VALUE2"));
     }
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_MessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-
-
-    /*this returns "0" so the message needs to be "accepted"*/
-    /*this is "accepting"*/
+    /*this is "abandon"*/
     STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
@@ -11515,7 +10508,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
     STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, API_VERSION))
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION))
         .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
@@ -11531,11 +10524,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
+        HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
         IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
         NULL,                                               /*BUFFER_HANDLE requestContent,                                */
         IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
@@ -11543,10 +10536,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -11560,7 +10552,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_090: [ All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_092: [ If assembling the message fails in any way, then _DoWork shall "abandon" the message. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_when_properties_fails_it_abandons_1)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_when_properties_fails_it_abandons_4)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -11588,8 +10580,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -11600,12 +10592,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -11636,20 +10627,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
             .IgnoreArgument(3);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
-
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME2", "VALUE2"))
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"))
             .SetReturn(MAP_ERROR);
     }
 
@@ -11681,8 +10659,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
@@ -11693,10 +10671,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -11708,10 +10685,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
     IoTHubTransportHttp_Destroy(handle);
 }
 
-
 //Tests_SRS_TRANSPORTMULTITHTTP_17_090: [ All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_092: [ If assembling the message fails in any way, then _DoWork shall "abandon" the message. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_when_properties_fails_it_abandons_2)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_when_properties_fails_it_abandons_5)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -11739,8 +10715,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -11751,12 +10727,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
         .IgnoreArgument(1)
@@ -11778,27 +10753,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
         STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
-
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
-
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
-
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        whenShallHTTPHeaders_GetHeader_fail = currentHTTPHeaders_GetHeader_call + 3;
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
+            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders))
+            .SetReturn(HTTP_HEADERS_ERROR);
     }
 
     /*this is "abandon"*/
@@ -11829,8 +10785,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
@@ -11841,10 +10797,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
         NULL                                                /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -11856,401 +10811,314 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_090: [ All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_092: [ If assembling the message fails in any way, then _DoWork shall "abandon" the message. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_when_properties_fails_it_abandons_3)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_071: [ If option SetBatching is false then _DoWork shall send individual event message as specced below. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_076: [ A clone of the event HTTP request headers shall be created. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_077: [ The cloned HTTP headers shall have the HTTP header "Content-Type" set to "application/octet-stream". ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_078: [ Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value". ] /*well - this tests that no "phantom" properties are added when there are no properties to add*/
+//Tests_SRS_TRANSPORTMULTITHTTP_17_080: [ IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest2 passing the following parameters ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_082: [ If HTTPAPIEX_SAS_ExecuteRequest2 does not fail and http status code < 300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_117: [ If optionName is an option handled by IoTHubTransportHttp then it shall be set. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_120: [ "Batching" ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_unbatched_happy_path_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    unsigned int statusCode200 = 200;
-    unsigned int statusCode204 = 204;
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
-    (void)IoTHubTransportHttp_Subscribe(devHandle);
-    size_t nHeaders = 3;
     mocks.ResetAllCalls();
 
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
+        .IgnoreArgument(1);
+
+    /*no properties, so no more headers*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+
     STRICT_EXPECTED_CALL(mocks, BUFFER_new());
     STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
 
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
+    /*executing HTTP goodies*/
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
+        .IgnoreArgument(1);
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
+        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
+        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
+        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
+        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
+        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
+        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
+        .IgnoreArgument(4)
         .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .CopyOutArgumentBuffer(6, &httpStatus200, sizeof(httpStatus200));
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
-        .IgnoreArgument(1)
-        .SetReturn(TEST_ETAG_VALUE);
+    /*once the event has been succesfull...*/
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
+    /*building the list of messages to be notified if HTTP is fine*/
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
         .IgnoreArgument(1);
-    {
-        /*this scope is for is properties code*/
-
-        HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
 
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
+    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
 
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
+    DISABLE_BATCHING();
 
-        whenShallHTTPHeaders_GetHeader_fail = currentHTTPHeaders_GetHeader_call + 2;
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-    }
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    /*this is "abandon"*/
-    STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
-        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
-        .IgnoreArgument(1);
-
-
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        NULL                                                /*BUFFER_HANDLE responseContent))                              */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
-
-    ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
-
-    ///assert
-    mocks.AssertActualAndExpectedCalls();
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer1, buffer1_size));
+    mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_090: [ All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_092: [ If assembling the message fails in any way, then _DoWork shall "abandon" the message. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_when_properties_fails_it_abandons_4)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_071: [ If option SetBatching is false then _DoWork shall send individual event message as specced below. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_076: [ A clone of the event HTTP request headers shall be created. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_077: [ The cloned HTTP headers shall have the HTTP header "Content-Type" set to "application/octet-stream". ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_078: [ Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value". ] /*well - this tests that no "phantom" properties are added when there are no properties to add*/
+//Tests_SRS_TRANSPORTMULTITHTTP_17_080: [ IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest2 passing the following parameters ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_082: [ If HTTPAPIEX_SAS_ExecuteRequest2 does not fail and http status code < 300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_117: [ If optionName is an option handled by IoTHubTransportHttp then it shall be set. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_120: [ "Batching" ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_type_unbatched_happy_path_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    unsigned int statusCode200 = 200;
-    unsigned int statusCode204 = 204;
+    DList_InsertTailList(&(waitingToSend), &(message10.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
-    (void)IoTHubTransportHttp_Subscribe(devHandle);
-    size_t nHeaders = 3;
     mocks.ResetAllCalls();
 
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_10));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(TEST_IOTHUB_MESSAGE_HANDLE_10));
+
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
+        .IgnoreArgument(1);
+
+    /*no properties, so no more headers*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_10));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+
     STRICT_EXPECTED_CALL(mocks, BUFFER_new());
     STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
 
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
+    /*executing HTTP goodies*/
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
+        .IgnoreArgument(1);
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
+        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
+        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
+        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
+        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
+        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
+        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
+        .IgnoreArgument(4)
         .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
-
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
-        .IgnoreArgument(1)
-        .SetReturn(TEST_ETAG_VALUE);
-
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    {
-        /*this scope is for is properties code*/
-
-        HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
-
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
+        .CopyOutArgumentBuffer(6, &httpStatus200, sizeof(httpStatus200));
 
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"))
-            .SetReturn(MAP_ERROR);
-    }
+    /*once the event has been succesfull...*/
 
-    /*this is "abandon"*/
-    STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    /*building the list of messages to be notified if HTTP is fine*/
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
-        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message10.entry)))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
-        .IgnoreArgument(1);
 
+    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
 
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        NULL                                                /*BUFFER_HANDLE responseContent))                              */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+    DISABLE_BATCHING();
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), string10, strlen(string10)));
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_090: [ All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_092: [ If assembling the message fails in any way, then _DoWork shall "abandon" the message. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_2_property_when_properties_fails_it_abandons_5)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_072: [ The message size shall be limited to 255KB -1 bytes. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_unbatched_happy_path_at_the_message_limit_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    unsigned int statusCode200 = 200;
-    unsigned int statusCode204 = 204;
+    DList_InsertTailList(&(waitingToSend), &(message11.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
-    (void)IoTHubTransportHttp_Subscribe(devHandle);
-    size_t nHeaders = 3;
     mocks.ResetAllCalls();
 
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_11));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_11, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
         .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
-        ))
-        .IgnoreArgument(1)
+    /*1 property*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_11));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY_A_B, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
-        .IgnoreArgument(1)
-        .SetReturn(TEST_ETAG_VALUE);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_KEYS1_A_B[0]))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-a", TEST_VALUES1_A_B[0]))
         .IgnoreArgument(1);
-    {
-        /*this scope is for is properties code*/
 
-        HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders))
-            .SetReturn(HTTP_HEADERS_ERROR);
-    }
 
-    /*this is "abandon"*/
-    STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
-        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION))
-        .IgnoreArgument(1);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION))
+    /*executing HTTP goodies*/
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,
+        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
+        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
+        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
+        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
+        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
+        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
+        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .CopyOutArgumentBuffer(6, &httpStatus200, sizeof(httpStatus200));
+
+    /*once the event has been succesfull...*/
+
+    /*building the list of messages to be notified if HTTP is fine*/
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message11.entry)))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
 
+    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
 
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        NULL                                                /*BUFFER_HANDLE responseContent))                              */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+    DISABLE_BATCHING();
+
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer11, buffer11_size));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_072: [ The message size shall be limited to 255KB -1 bytes. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_073: [ The message size is computed from the length of the payload + 384. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_074: [ Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_type_unbatched_happy_path_at_the_message_limit_succeeds)
+{
+    ///arrange
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
+    DList_InsertTailList(&(waitingToSend), &(message12.entry));
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+
+    mocks.ResetAllCalls();
+
+    setupDoWorkLoopOnceForOneDevice(mocks);
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR))
+        .IgnoreArgument(2);
+
+    DISABLE_BATCHING();
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -12270,11 +11138,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
 //Tests_SRS_TRANSPORTMULTITHTTP_17_082: [ If HTTPAPIEX_SAS_ExecuteRequest2 does not fail and http status code < 300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_117: [ If optionName is an option handled by IoTHubTransportHttp then it shall be set. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_120: [ "Batching" ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_unbatched_happy_path_succeeds)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_type_unbatched_fails_when_getString_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message10.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -12284,8 +11152,45 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_unbatch
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_1));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_10));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(TEST_IOTHUB_MESSAGE_HANDLE_10))
+        .SetReturn((const char*)NULL);
+
+    DISABLE_BATCHING();
+
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_071: [ If option SetBatching is false then _DoWork shall send individual event message as specced below. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_076: [ A clone of the event HTTP request headers shall be created. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_077: [ The cloned HTTP headers shall have the HTTP header "Content-Type" set to "application/octet-stream". ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_078: [ Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value". ] /*well - this tests that no "phantom" properties are added when there are no properties to add*/
+//Tests_SRS_TRANSPORTMULTITHTTP_17_080: [ IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest2 passing the following parameters ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_082: [ If HTTPAPIEX_SAS_ExecuteRequest2 does not fail and http status code < 300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_happy_path_succeeds)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+
+    mocks.ResetAllCalls();
+
+    setupDoWorkLoopOnceForOneDevice(mocks);
+
+
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12298,12 +11203,23 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_unbatch
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_1));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
         .IgnoreArgument(4);
 
+    /*this is making http headers*/
+    STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
+        .IgnoreArgument(1);
+
     STRICT_EXPECTED_CALL(mocks, BUFFER_new());
     STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -12315,8 +11231,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_unbatch
     /*executing HTTP goodies*/
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,
         HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
         "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
@@ -12327,17 +11243,16 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_unbatch
         NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
+        .IgnoreArgument(4)
         .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+        .CopyOutArgumentBuffer(6, &httpStatus200, sizeof(httpStatus200));
 
     /*once the event has been succesfull...*/
 
     /*building the list of messages to be notified if HTTP is fine*/
     STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)))
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
         .IgnoreArgument(2);
@@ -12351,26 +11266,20 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_unbatch
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
-    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer1, buffer1_size));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer6, buffer6_size));
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_071: [ If option SetBatching is false then _DoWork shall send individual event message as specced below. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_076: [ A clone of the event HTTP request headers shall be created. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_077: [ The cloned HTTP headers shall have the HTTP header "Content-Type" set to "application/octet-stream". ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_078: [ Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value". ] /*well - this tests that no "phantom" properties are added when there are no properties to add*/
-//Tests_SRS_TRANSPORTMULTITHTTP_17_080: [ IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest2 passing the following parameters ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_082: [ If HTTPAPIEX_SAS_ExecuteRequest2 does not fail and http status code < 300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_117: [ If optionName is an option handled by IoTHubTransportHttp then it shall be set. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_120: [ "Batching" ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_type_unbatched_happy_path_succeeds)
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_069: [ If HTTPAPIEX_SAS_ExecuteRequest2 fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried). ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_httpStatusCode_is_not_succeess)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message10.entry));
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -12380,8 +11289,10 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_10));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(TEST_IOTHUB_MESSAGE_HANDLE_10));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -12392,12 +11303,23 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_10));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
         .IgnoreArgument(4);
 
+    /*this is making http headers*/
+    STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
+        .IgnoreArgument(1);
+
     STRICT_EXPECTED_CALL(mocks, BUFFER_new());
     STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -12409,8 +11331,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_
     /*executing HTTP goodies*/
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,
         HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
         "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
@@ -12421,20 +11343,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_
         NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
+        .IgnoreArgument(4)
         .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
-
-    /*once the event has been succesfull...*/
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message10.entry)))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
-        .IgnoreArgument(2);
+        .CopyOutArgumentBuffer(6, &httpStatus404, sizeof(httpStatus404));
 
     EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
@@ -12445,19 +11356,19 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
-    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), string10, strlen(string10)));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer6, buffer6_size));
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_072: [ The message size shall be limited to 255KB -1 bytes. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_unbatched_happy_path_at_the_message_limit_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_081: [ If HTTPAPIEX_SAS_ExecuteRequest2 fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried). ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_HTTPAPIEXSAS_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message11.entry));
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -12467,8 +11378,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_unbatched_happy_path_at_th
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_11));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_11, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12480,25 +11391,24 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_unbatched_happy_path_at_th
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
         .IgnoreArgument(1);
 
-    /*1 property*/
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_11));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY_A_B, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    /*no properties, so no more headers*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
         .IgnoreArgument(4);
 
+    /*this is making http headers*/
     STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_KEYS1_A_B[0]))
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-a", TEST_VALUES1_A_B[0]))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
         .IgnoreArgument(1);
 
-
     STRICT_EXPECTED_CALL(mocks, BUFFER_new());
     STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -12510,8 +11420,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_unbatched_happy_path_at_th
     /*executing HTTP goodies*/
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,
         HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
         "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
@@ -12522,93 +11432,13 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_unbatched_happy_path_at_th
         NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
+        .IgnoreArgument(4)
         .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+        .CopyOutArgumentBuffer(6, &httpStatus200, sizeof(httpStatus200))
+        .SetReturn(HTTPAPIEX_ERROR);
 
-    /*once the event has been succesfull...*/
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message11.entry)))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
-        .IgnoreArgument(2);
-
-    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
-
-    DISABLE_BATCHING();
-
-    ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
-
-    ///assert
-    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer11, buffer11_size));
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_072: [ The message size shall be limited to 255KB -1 bytes. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_073: [ The message size is computed from the length of the payload + 384. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_074: [ Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_type_unbatched_happy_path_at_the_message_limit_succeeds)
-{
-    ///arrange
-    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
-    DList_InsertTailList(&(waitingToSend), &(message12.entry));
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
-    mocks.ResetAllCalls();
-
-    setupDoWorkLoopOnceForOneDevice(mocks);
-
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR))
-        .IgnoreArgument(2);
-
-    DISABLE_BATCHING();
-
-    ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
-
-    ///assert
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_071: [ If option SetBatching is false then _DoWork shall send individual event message as specced below. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_076: [ A clone of the event HTTP request headers shall be created. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_077: [ The cloned HTTP headers shall have the HTTP header "Content-Type" set to "application/octet-stream". ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_078: [ Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value". ] /*well - this tests that no "phantom" properties are added when there are no properties to add*/
-//Tests_SRS_TRANSPORTMULTITHTTP_17_080: [ IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest2 passing the following parameters ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_082: [ If HTTPAPIEX_SAS_ExecuteRequest2 does not fail and http status code < 300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_117: [ If optionName is an option handled by IoTHubTransportHttp then it shall be set. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_120: [ "Batching" ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_type_unbatched_fails_when_getString_fails)
-{
-    ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message10.entry));
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
-    mocks.ResetAllCalls();
-
-    setupDoWorkLoopOnceForOneDevice(mocks);
-
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
-
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_10));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(TEST_IOTHUB_MESSAGE_HANDLE_10))
-        .SetReturn((const char*)NULL);
+    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
 
     DISABLE_BATCHING();
 
@@ -12616,19 +11446,15 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer6, buffer6_size));
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_071: [ If option SetBatching is false then _DoWork shall send individual event message as specced below. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_076: [ A clone of the event HTTP request headers shall be created. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_077: [ The cloned HTTP headers shall have the HTTP header "Content-Type" set to "application/octet-stream". ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_078: [ Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value". ] /*well - this tests that no "phantom" properties are added when there are no properties to add*/
-//Tests_SRS_TRANSPORTMULTITHTTP_17_080: [ IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest2 passing the following parameters ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_082: [ If HTTPAPIEX_SAS_ExecuteRequest2 does not fail and http status code < 300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_happy_path_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_buffer_fails_1)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -12637,10 +11463,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
@@ -12677,40 +11501,12 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(mocks, BUFFER_new());
     STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
 
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
+    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
-
-    /*once the event has been succesfull...*/
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
-        .IgnoreArgument(2);
+        .IgnoreArgument(3)
+        .SetReturn(1);
 
     EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
@@ -12721,16 +11517,14 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
-    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer6, buffer6_size));
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_069: [ If HTTPAPIEX_SAS_ExecuteRequest2 fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried). ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_httpStatusCode_is_not_succeess)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_buffer_fails_2)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -12775,33 +11569,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
         .IgnoreArgument(1);
 
+    whenShallBUFFER_new_fail = currentBUFFER_new_call + 1;
     STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus404, sizeof(httpStatus404));
 
     EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
@@ -12812,15 +11581,14 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
-    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer6, buffer6_size));
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_081: [ If HTTPAPIEX_SAS_ExecuteRequest2 fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried). ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_HTTPAPIEXSAS_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_http_headers_fail_1)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -12863,36 +11631,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200))
-        .SetReturn(HTTPAPIEX_ERROR);
+        .SetReturn(HTTP_HEADERS_ERROR);
 
     EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
@@ -12903,7 +11643,6 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
-    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer6, buffer6_size));
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
@@ -12911,7 +11650,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_buffer_fails_1)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_http_headers_fail_2)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -12920,6 +11659,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     mocks.ResetAllCalls();
+
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
@@ -12949,21 +11689,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn(1);
+        .SetReturn(1111); /*unpredictable value which is an error*/
 
     EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
@@ -12981,7 +11708,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_buffer_fails_2)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_http_headers_fail_3)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -13016,18 +11743,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(4);
 
     /*this is making http headers*/
+    whenShallSTRING_construct_fail = currentSTRING_construct_call + 1;
     STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
-        .IgnoreArgument(1);
-
-    whenShallBUFFER_new_fail = currentBUFFER_new_call + 1;
-    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
 
     EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
@@ -13045,7 +11762,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_http_headers_fail_1)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_map_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -13077,22 +11794,8 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
-        .IgnoreArgument(4);
-
-    /*this is making http headers*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
-        .IgnoreArgument(1)
-        .SetReturn(HTTP_HEADERS_ERROR);
-
-    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
+        .IgnoreArgument(4)
+        .SetReturn(MAP_ERROR);
 
     DISABLE_BATCHING();
 
@@ -13107,7 +11810,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_http_headers_fail_2)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_http_fails_4)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -13132,27 +11835,10 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
-        .IgnoreArgument(1);
+        .IgnoreArgument(1)
+        .SetReturn(HTTP_HEADERS_ERROR);
 
-    /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .IgnoreArgument(4);
-
-    /*this is making http headers*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
-        .IgnoreArgument(1)
-        .SetReturn(1111); /*unpredictable value which is an error*/
-
-    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
-
-    DISABLE_BATCHING();
+    DISABLE_BATCHING();
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -13165,7 +11851,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_http_headers_fail_3)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_http_fails_5)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -13184,27 +11870,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
+    whenShallHTTPHeaders_Clone_fail = currentHTTPHeaders_Clone_call + 1;
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
-        .IgnoreArgument(1);
-
-    /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .IgnoreArgument(4);
-
-    /*this is making http headers*/
-    whenShallSTRING_construct_fail = currentSTRING_construct_call + 1;
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
-
-    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
 
     DISABLE_BATCHING();
 
@@ -13219,7 +11887,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_map_fails)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_IoTHubMessage_GetByteArray_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -13235,24 +11903,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 
     STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
-        .IgnoreArgument(1);
-
-    /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
-        .IgnoreArgument(4)
-        .SetReturn(MAP_ERROR);
+        .SetReturn(IOTHUB_MESSAGE_ERROR);
 
     DISABLE_BATCHING();
 
@@ -13266,12 +11919,12 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_http_fails_4)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_075: [ If the oldest message in waitingToSend causes the message to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_ERROR. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_overlimit_calls_SendComplete_with_BATCHSTATE_FAILED)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    DList_InsertTailList(&(waitingToSend), &(message9.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -13279,21 +11932,23 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 
     setupDoWorkLoopOnceForOneDevice(mocks);
 
+
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_9));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_9, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
+    /*ooops - over 256K*/
+
+    /*building the list of messages to be notified if HTTP is fine*/
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message9.entry)))
         .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
-        .IgnoreArgument(1)
-        .SetReturn(HTTP_HEADERS_ERROR);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR))
+        .IgnoreArgument(2);
 
     DISABLE_BATCHING();
 
@@ -13307,12 +11962,12 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_http_fails_5)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_happy_path_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    DList_InsertTailList(&(waitingToSend), &(message10.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -13322,33 +11977,39 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-
-    whenShallHTTPHeaders_Clone_fail = currentHTTPHeaders_Clone_call + 1;
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    DISABLE_BATCHING();
+    setupBatchItemTaken(mocks, &message10, TEST_MAP_EMPTY);
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_STRING_ITEM_PAYLOAD) - 1);
+    setupBatchItemRead(mocks, message10.messageHandle, TEST_MAP_EMPTY);
+
+    setupBatchPost(mocks, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, &httpStatus200);
+
+    /*once the event has been succesfull...*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
+
+    ENABLE_BATCHING();
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_BATCH_STRING_ITEM_PAYLOAD) - 1, BASEIMPLEMENTATION::BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_BATCH_STRING_ITEM_PAYLOAD, sizeof(TEST_BATCH_STRING_ITEM_PAYLOAD) - 1));
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_IoTHubMessage_GetByteArray_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_Map_GetInternals_fails_it_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    DList_InsertTailList(&(waitingToSend), &(message10.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -13358,30 +12019,37 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message10.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
-        .SetReturn(IOTHUB_MESSAGE_ERROR);
+        .IgnoreArgument(4)
+        .SetReturn(MAP_ERROR);
 
-    DISABLE_BATCHING();
+    ENABLE_BATCHING();
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_075: [ If the oldest message in waitingToSend causes the message to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_BATCHSTATE result shall be set to IOTHUB_CLIENT_CONFIRMATION_ERROR. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_overlimit_calls_SendComplete_with_BATCHSTATE_FAILED)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_puts_it_back_when_IoTHubMessage_GetString_fails_while_writing_the_payload)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message9.entry));
+    DList_InsertTailList(&(waitingToSend), &(message10.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -13389,38 +12057,40 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_9));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_9, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
+        .IgnoreArgument(1);
 
-    /*ooops - over 256K*/
+    /*measuring succeeds...*/
+    setupBatchItemTaken(mocks, &message10, TEST_MAP_EMPTY);
+    setupBatchPayloadAlloc(mocks, sizeof(TEST_BATCH_STRING_ITEM_PAYLOAD) - 1);
 
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message9.entry)))
+    /*...but the message cannot be read a second time*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle))
+        .SetReturn((const char*)NULL);
+
+    setupBatchPutBack(mocks);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR))
-        .IgnoreArgument(2);
 
-    DISABLE_BATCHING();
+    ENABLE_BATCHING();
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&(message10.entry), (void*)waitingToSend.Flink);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_happy_path_succeeds)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_IoTHubMessage_GetString_it_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
@@ -13437,98 +12107,9 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_happy_path_
     STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":"));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle));
-
-        STRICT_EXPECTED_CALL(mocks, STRING_new_JSON(string10));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"base64Encoded\":false")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    {
-        /*adding the first payload to the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        /*closing the "big" payload*/
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-    }
-
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message10.entry)))
-        .IgnoreArgument(1);
-
-    {
-        /*this is building the HTTP payload... from a STRING_HANDLE (as it comes as "big payload"), into an array of bytes*/
-        STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-    }
-
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
-
-    /*once the event has been succesfull...*/
-
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
-        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle))
+        .SetReturn((const char*)NULL);
 
     ENABLE_BATCHING();
 
@@ -13537,64 +12118,158 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_happy_path_
 
     ///assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_string_concat_fails_it_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_091: [ The HTTP header value of iothub-messageid shall be set in the IoTHub_SetMessageId. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetMessageId_SUCCEED)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message10.entry));
+    size_t nHeaders = 4;
+    unsigned int statusCode200 = 200;
+    unsigned int statusCode204 = 204;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":"));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .IgnoreArgument(8)
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
 
-        STRICT_EXPECTED_CALL(mocks, STRING_new_JSON(string10));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .IgnoreArgument(1)
+        .SetReturn(TEST_ETAG_VALUE);
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    {
+        /*this scope is for is properties code*/
+
+        HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
+
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
             .IgnoreArgument(1)
-            .IgnoreArgument(2);
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME2", "VALUE2"));
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"base64Encoded\":false")) /*closing the value of the body*/
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 3, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4);
-        whenShallSTRING_concat_fail = currentSTRING_concat_call + 2;
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "},")) /* this extra "," is going to be harshly overwritten by a "]"*/
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_SetMessageId(IGNORED_PTR_ARG, "VALUE3"))
             .IgnoreArgument(1);
-        /*end of the first batched payload*/
     }
 
-    ENABLE_BATCHING();
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_MessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    /*this returns "0" so the message needs to be "accepted"*/
+    /*this is "accepting"*/
+    STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
+        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, API_VERSION))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        NULL                                                /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -13606,57 +12281,148 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_string
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_Map_GetInternals_fails_it_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_091: [ The HTTP header value of iothub-messageid shall be set in the IoTHub_SetMessageId. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetMessageId_FAILED)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message10.entry));
+    size_t nHeaders = 4;
+    unsigned int statusCode200 = 200;
+    unsigned int statusCode204 = 204;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
     mocks.ResetAllCalls();
-
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    /*this is first batched payload*/
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .IgnoreArgument(8)
+        .CopyOutArgumentBuffer(6, &statusCode200, sizeof(statusCode200));
+
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .IgnoreArgument(1)
+        .SetReturn(TEST_ETAG_VALUE);
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":"));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        /*this scope is for is properties code*/
+
+        HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
+
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
+
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle));
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
 
-        STRICT_EXPECTED_CALL(mocks, STRING_new_JSON(string10));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
             .IgnoreArgument(1)
-            .IgnoreArgument(2);
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME2", "VALUE2"));
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"base64Encoded\":false")) /*closing the value of the body*/
+        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 3, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3)
-            .IgnoreArgument(4)
-            .SetReturn(MAP_ERROR);
-        /*end of the first batched payload*/
+        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_SetMessageId(IGNORED_PTR_ARG, "VALUE3"))
+            .IgnoreArgument(1)
+            .SetReturn(IOTHUB_MESSAGE_ERROR);
     }
 
-    ENABLE_BATCHING();
+    /*this is "abandon"*/
+    STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
+        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
+    setupSasTokenReuse(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        NULL                                                /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &statusCode204, sizeof(statusCode204));
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -13668,12 +12434,12 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_Map_Ge
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_STRING_concat_fails_it_fails_2)
+//Tests_SRS_TRANSPORTMULTITHTTP_17_091: [ The HTTP header value of iothub-messageid shall be set in the IoTHub_SetMessageId. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetMessageId_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message10.entry));
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -13683,108 +12449,98 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_STRING
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":"));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle));
-
-        STRICT_EXPECTED_CALL(mocks, STRING_new_JSON(string10));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
+        .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+    /*no properties, so no more headers*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
 
-        whenShallSTRING_concat_fail = currentSTRING_concat_call + 1;
-        STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, ",\"base64Encoded\":false")) /*closing the value of the body*/
-            .IgnoreArgument(1);
-        /*end of the first batched payload*/
-    }
-
-    ENABLE_BATCHING();
-
-    ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
-
-    ///assert
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
-}
-
-//Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_STRING_concat_with_STRING_fails_it_fails)
-{
-    ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message10.entry));
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    /*this is making http headers*/
+    STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
+        .IgnoreArgument(1);
 
-    mocks.ResetAllCalls();
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
 
-    setupDoWorkLoopOnceForOneDevice(mocks);
+    /*executing HTTP goodies*/
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
+        .IgnoreArgument(1);
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,
+        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
+        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
+        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
+        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
+        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
+        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
+        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .CopyOutArgumentBuffer(6, &httpStatus200, sizeof(httpStatus200));
 
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
+    /*once the event has been succesfull...*/
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
+    /*building the list of messages to be notified if HTTP is fine*/
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":"));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle));
-
-        STRICT_EXPECTED_CALL(mocks, STRING_new_JSON(string10));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG)).SetReturn(TEST_MESSAGE_ID);
+    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
 
-        whenShallSTRING_concat_with_STRING_fail = currentSTRING_concat_with_STRING_call + 1;
-        STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-        /*end of the first batched payload*/
-    }
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-messageid", TEST_MESSAGE_ID))
+        .IgnoreArgument(1);
 
-    ENABLE_BATCHING();
+    DISABLE_BATCHING();
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer6, buffer6_size));
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_STRING_new_JSON_fails_it_fails)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetCorrelationId_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message10.entry));
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
@@ -13794,161 +12550,200 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_STRING
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
         .IgnoreArgument(1);
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
+    /*no properties, so no more headers*/
+    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+
+    /*this is making http headers*/
+    STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
+        .IgnoreArgument(1);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":"));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle));
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    /*executing HTTP goodies*/
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
+        .IgnoreArgument(1);
+    setupSasTokenCreate(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,
+        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
+        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
+        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
+        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
+        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
+        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
+        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .CopyOutArgumentBuffer(6, &httpStatus200, sizeof(httpStatus200));
 
-        whenShallSTRING_new_JSON_fail = currentSTRING_new_JSON_call + 1;
-        STRICT_EXPECTED_CALL(mocks, STRING_new_JSON(string10));
+    /*once the event has been succesfull...*/
 
-        /*end of the first batched payload*/
-    }
+    /*building the list of messages to be notified if HTTP is fine*/
+    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+        .IgnoreArgument(2);
 
-    ENABLE_BATCHING();
+    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG)).SetReturn(TEST_MESSAGE_ID);
+
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-correlationid", TEST_MESSAGE_ID))
+        .IgnoreArgument(1);
+
+    DISABLE_BATCHING();
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer6, buffer6_size));
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_IoTHubMessage_GetString_it_fails)
+/*a second poll of a subscribed device with no message waiting, the service answers the GET with 204*/
+static void setupDoWorkSecondEmptyPoll(CIoTHubTransportHttpMocks &mocks, time_t now)
 {
-    ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message10.entry));
-    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
-    mocks.ResetAllCalls();
+    (void)mocks;
 
     setupDoWorkLoopOnceForOneDevice(mocks);
 
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL))
+        .SetReturn(now);
+    STRICT_EXPECTED_CALL(mocks, get_difftime(now, TEST_GET_TIME_VALUE));
 
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":"));
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetString(message10.messageHandle))
-            .SetReturn((const char*)NULL);
-
-        /*end of the first batched payload*/
-    }
-
-    ENABLE_BATCHING();
+    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
+    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+}
 
-    ///assert
-    mocks.AssertActualAndExpectedCalls();
+static void setupGetSasTokenCountForOneDevice(CIoTHubTransportHttpMocks &mocks)
+{
+    (void)mocks;
 
-    ///cleanup
-    IoTHubTransportHttp_Destroy(handle);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*findDeviceById*/
+        .IgnoreArgument(1);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_STRING_construct_it_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_020: [ For a device authenticated with a device key, the SAS token shall be generated once and reused by every request until it is older than the "sas_token_refresh_time" option. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_21_025: [ Otherwise IoTHubTransportHttp_GetSasTokenCount shall set generatedCount to the number of SAS tokens generated for the device and return IOTHUB_CLIENT_OK. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_reuses_the_cached_sas_token_before_the_refresh_time_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message10.entry));
+    size_t generatedCount = 0;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE); /*signs the first SAS token at TEST_GET_TIME_VALUE*/
     mocks.ResetAllCalls();
 
-    setupDoWorkLoopOnceForOneDevice(mocks);
-
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
-
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"))
-        .IgnoreArgument(1);
-
-    /*starting to prepare the "big" payload*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("["));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    /*this is first batched payload*/
-    {
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(message10.messageHandle));
-        whenShallSTRING_construct_fail = currentSTRING_construct_call + 2;
-        STRICT_EXPECTED_CALL(mocks, STRING_construct("{\"body\":"));
-
-        /*end of the first batched payload*/
-    }
-
-    ENABLE_BATCHING();
+    setupDoWorkSecondEmptyPoll(mocks, TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME - 1);
+    setupSasTokenReuse(mocks, TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME - 1, TEST_GET_TIME_VALUE);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .IgnoreArgument(8);
+    setupGetSasTokenCountForOneDevice(mocks);
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    auto result = IoTHubTransportHttp_GetSasTokenCount(handle, TEST_DEVICE_ID, &generatedCount);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, generatedCount);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_091: [ The HTTP header value of iothub-messageid shall be set in the IoTHub_SetMessageId. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetMessageId_SUCCEED)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_020: [ For a device authenticated with a device key, the SAS token shall be generated once and reused by every request until it is older than the "sas_token_refresh_time" option. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_signs_a_new_sas_token_at_the_refresh_time_succeeds)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    size_t nHeaders = 4;
-    unsigned int statusCode200 = 200;
-    unsigned int statusCode204 = 204;
+    size_t generatedCount = 0;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE); /*signs the first SAS token at TEST_GET_TIME_VALUE*/
     mocks.ResetAllCalls();
-    setupDoWorkLoopOnceForOneDevice(mocks);
-
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
 
-    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
+    setupDoWorkSecondEmptyPoll(mocks, TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME);
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME);
+    STRICT_EXPECTED_CALL(mocks, get_difftime(TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME, TEST_GET_TIME_VALUE));
+    STRICT_EXPECTED_CALL(mocks, get_difftime(TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME, (time_t)0));
+    STRICT_EXPECTED_CALL(mocks, SASToken_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME + TEST_DEFAULT_SAS_TOKEN_LIFETIME))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG)) /*the previous SAS token*/
         .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupSasTokenAuthorization(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
         HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
         "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
@@ -13959,114 +12754,62 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetMessageId_SUCCEED)
         IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
-        .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
-
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
-        .IgnoreArgument(1)
-        .SetReturn(TEST_ETAG_VALUE);
-
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    {
-        /*this scope is for is properties code*/
-
-        HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
-
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
-
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
-
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        .IgnoreArgument(8);
+    setupGetSasTokenCountForOneDevice(mocks);
 
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME2", "VALUE2"));
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    auto result = IoTHubTransportHttp_GetSasTokenCount(handle, TEST_DEVICE_ID, &generatedCount);
 
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 3, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_SetMessageId(IGNORED_PTR_ARG, "VALUE3"))
-            .IgnoreArgument(1);
-    }
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, generatedCount);
+    mocks.AssertActualAndExpectedCalls();
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_MessageCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-    /*this returns "0" so the message needs to be "accepted"*/
-    /*this is "accepting"*/
-    STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
-        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, API_VERSION))
-        .IgnoreArgument(1);
+//Tests_SRS_TRANSPORTMULTITHTTP_21_021: [ If a new token cannot be generated, the cached token shall be used while it has not expired, and the request shall be signed by HTTPAPIEX_SAS_ExecuteRequest otherwise. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_keeps_the_cached_sas_token_when_SASToken_Create_fails_before_the_lifetime)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
-        .IgnoreArgument(1);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE); /*signs the first SAS token at TEST_GET_TIME_VALUE*/
+    mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+    setupDoWorkSecondEmptyPoll(mocks, TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME);
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME);
+    STRICT_EXPECTED_CALL(mocks, get_difftime(TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME, TEST_GET_TIME_VALUE)); /*refresh time reached*/
+    STRICT_EXPECTED_CALL(mocks, get_difftime(TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME, (time_t)0));
+    STRICT_EXPECTED_CALL(mocks, SASToken_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments()
+        .SetReturn((STRING_HANDLE)NULL);
+    STRICT_EXPECTED_CALL(mocks, get_difftime(TEST_GET_TIME_VALUE + TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME, TEST_GET_TIME_VALUE)); /*lifetime not reached*/
+    setupSasTokenAuthorization(mocks);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_DELETE,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION,    /*const char* relativePath,                                    */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
         IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
         NULL,                                               /*BUFFER_HANDLE requestContent,                                */
         IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        NULL                                                /*BUFFER_HANDLE responseContent))                              */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
         .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+        .IgnoreArgument(8);
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
@@ -14078,19 +12821,17 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetMessageId_SUCCEED)
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_091: [ The HTTP header value of iothub-messageid shall be set in the IoTHub_SetMessageId. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetMessageId_FAILED)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_021: [ If a new token cannot be generated, the cached token shall be used while it has not expired, and the request shall be signed by HTTPAPIEX_SAS_ExecuteRequest otherwise. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_uses_HTTPAPIEX_SAS_when_SASToken_Create_fails_and_no_token_is_cached)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    size_t nHeaders = 4;
-    unsigned int statusCode200 = 200;
-    unsigned int statusCode204 = 204;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
 
     (void)IoTHubTransportHttp_Subscribe(devHandle);
     mocks.ResetAllCalls();
+
     setupDoWorkLoopOnceForOneDevice(mocks);
 
     STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
@@ -14106,6 +12847,11 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetMessageId_FAILED)
 
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL));
+    STRICT_EXPECTED_CALL(mocks, get_difftime(TEST_GET_TIME_VALUE, (time_t)0));
+    STRICT_EXPECTED_CALL(mocks, SASToken_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments()
+        .SetReturn((STRING_HANDLE)NULL);
     STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
         IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
         IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
@@ -14122,389 +12868,558 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetMessageId_FAILED)
         .IgnoreArgument(5)
         .IgnoreArgument(7)
         .IgnoreArgument(8)
-        .IgnoreArgument(9)
-        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+        .IgnoreArgument(9);
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
-        .IgnoreArgument(1)
-        .SetReturn(TEST_ETAG_VALUE);
+    ///act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetReturn(TEST_IOTHUB_MESSAGE_HANDLE_8);
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    {
-        /*this scope is for is properties code*/
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
 
-        HTTPHeaders_GetHeaderCount_writes_to_its_outputs = false;
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
+//Tests_SRS_TRANSPORTMULTITHTTP_21_023: [ If handle, deviceId or generatedCount is NULL, IoTHubTransportHttp_GetSasTokenCount shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetSasTokenCount_with_NULL_handle_fails)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    size_t generatedCount = 0;
 
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
+    ///act
+    auto result = IoTHubTransportHttp_GetSasTokenCount(NULL, TEST_DEVICE_ID, &generatedCount);
 
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
 
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 2, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME2", "VALUE2"));
+//Tests_SRS_TRANSPORTMULTITHTTP_21_024: [ If no device with deviceId is registered, IoTHubTransportHttp_GetSasTokenCount shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetSasTokenCount_with_unknown_device_fails)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    size_t generatedCount = 0;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 3, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, IoTHubMessage_SetMessageId(IGNORED_PTR_ARG, "VALUE3"))
-            .IgnoreArgument(1)
-            .SetReturn(IOTHUB_MESSAGE_ERROR);
-    }
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
-    /*this is "abandon"*/
-    STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct_n(TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1))
-        .ValidateArgumentBuffer(1, TEST_ETAG_VALUE_UNQUOTED, sizeof(TEST_ETAG_VALUE_UNQUOTED) - 1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, "/abandon" API_VERSION))
-        .IgnoreArgument(1);
+    ///act
+    auto result = IoTHubTransportHttp_GetSasTokenCount(handle, TEST_DEVICE_ID, &generatedCount);
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Alloc());
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "If-Match", TEST_ETAG_VALUE))
-        .IgnoreArgument(1);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
 
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); /*because abandon relativePath is a STRING_HANDLE*/
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,
-        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
-        HTTPAPI_REQUEST_POST,                               /*HTTPAPI_REQUEST_TYPE requestType,                            */
-        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION,    /*const char* relativePath,                                    */
-        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
-        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
-        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
-        NULL,                                               /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
-        NULL                                                /*BUFFER_HANDLE responseContent))                              */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(7)
-        .CopyOutArgumentBuffer(7, &statusCode204, sizeof(statusCode204));
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_21_026: [ If the SAS token refresh time would be 0 or not shorter than the SAS token lifetime, IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG and keep both values. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_sas_token_refresh_time_equal_to_the_lifetime_fails)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    size_t refreshTime = TEST_DEFAULT_SAS_TOKEN_LIFETIME * 1000;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
 
     ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    auto result = IoTHubTransportHttp_SetOption(handle, OPTION_SAS_TOKEN_REFRESH_TIME, &refreshTime);
 
     ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_091: [ The HTTP header value of iothub-messageid shall be set in the IoTHub_SetMessageId. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetMessageId_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_026: [ If the SAS token refresh time would be 0 or not shorter than the SAS token lifetime, IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG and keep both values. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_sas_token_refresh_time_0_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    size_t refreshTime = 0;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
-    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = IoTHubTransportHttp_SetOption(handle, OPTION_SAS_TOKEN_REFRESH_TIME, &refreshTime);
 
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_21_026: [ If the SAS token refresh time would be 0 or not shorter than the SAS token lifetime, IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG and keep both values. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_sas_token_lifetime_not_longer_than_the_refresh_time_fails)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    size_t lifetime = TEST_DEFAULT_SAS_TOKEN_REFRESH_TIME * 1000;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     mocks.ResetAllCalls();
 
-    setupDoWorkLoopOnceForOneDevice(mocks);
+    ///act
+    auto result = IoTHubTransportHttp_SetOption(handle, OPTION_SAS_TOKEN_LIFETIME, &lifetime);
 
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+//Tests_SRS_TRANSPORTMULTITHTTP_21_022: [ "sas_token_lifetime" ]
+//Tests_SRS_TRANSPORTMULTITHTTP_21_022: [ "sas_token_refresh_time" ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_sas_token_refresh_time_then_a_shorter_lifetime_succeeds)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    size_t refreshTime = 60000;
+    size_t lifetime = 120000;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
-        .IgnoreArgument(1);
+    ///act
+    auto result1 = IoTHubTransportHttp_SetOption(handle, OPTION_SAS_TOKEN_REFRESH_TIME, &refreshTime);
+    auto result2 = IoTHubTransportHttp_SetOption(handle, OPTION_SAS_TOKEN_LIFETIME, &lifetime);
 
-    /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .IgnoreArgument(4);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    mocks.AssertActualAndExpectedCalls();
 
-    /*this is making http headers*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
-        .IgnoreArgument(1);
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+/*Tests_SRS_TRANSPORTMULTITHTTP_02_001: [ If handle is NULL then IoTHubTransportHttp_GetHostname shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportHttp_GetHostname_with_NULL_handle_fails)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
 
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
+    ///act
+    STRING_HANDLE hostname = IoTHubTransportHttp_GetHostname(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(hostname);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+/*Tests_SRS_TRANSPORTMULTITHTTP_02_001: [ If handle is NULL then IoTHubTransportHttp_GetHostname shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportHttp_GetHostname_with_non_NULL_handle_succeeds)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    ///act
+    STRING_HANDLE hostname = IoTHubTransportHttp_GetHostname(handle);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(hostname);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(char_ptr, TEST_IOTHUB_NAME "." TEST_IOTHUB_SUFFIX, STRING_c_str(hostname));
+
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTMULTITHTTP_02_004: [ IoTHubTransportHttp_Unsubscribe_DeviceTwin shall return ]*/
+TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_DeviceTwin_returns)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    ///act
+    IoTHubTransportHttp_Unsubscribe_DeviceTwin(handle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTMULTITHTTP_02_003: [ IoTHubTransportHttp_Subscribe_DeviceTwin shall return. ]*/
+TEST_FUNCTION(IoTHubTransportHttp_Subscribe_DeviceTwin_returns)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
+
+    ///act
+    int res = IoTHubTransportHttp_Subscribe_DeviceTwin(handle);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, res);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+/*** IoTHubTransportHttp_GetPollStatistics ***/
+
+/*DoWork polls the subscribed device at "now" and the service answers the GET with httpStatus*/
+static void setupPollAnswered(CIoTHubTransportHttpMocks &mocks, time_t now, const unsigned int* httpStatus)
+{
+    (void)mocks;
+
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL))
+        .SetReturn(now);
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
         ))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
+        .IgnoreArgument(4)
         .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+        .IgnoreArgument(7)
+        .IgnoreArgument(8)
+        .CopyOutArgumentBuffer(6, httpStatus, sizeof(*httpStatus));
+}
 
-    /*once the event has been succesfull...*/
+//Tests_SRS_TRANSPORTMULTITHTTP_21_015: [ If handle, deviceId or statistics is NULL, IoTHubTransportHttp_GetPollStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetPollStatistics_with_NULL_handle_fails)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    IOTHUB_HTTP_POLL_STATISTICS statistics;
 
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
-        .IgnoreArgument(2);
+    ///act
+    auto result = IoTHubTransportHttp_GetPollStatistics(NULL, TEST_DEVICE_ID, &statistics);
 
-    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG)).SetReturn(TEST_MESSAGE_ID);
-    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG));
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-messageid", TEST_MESSAGE_ID))
-        .IgnoreArgument(1);
+//Tests_SRS_TRANSPORTMULTITHTTP_21_015: [ If handle, deviceId or statistics is NULL, IoTHubTransportHttp_GetPollStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetPollStatistics_with_NULL_deviceId_fails)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    IOTHUB_HTTP_POLL_STATISTICS statistics;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
 
-    DISABLE_BATCHING();
+    ///act
+    auto result = IoTHubTransportHttp_GetPollStatistics(handle, NULL, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_21_015: [ If handle, deviceId or statistics is NULL, IoTHubTransportHttp_GetPollStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetPollStatistics_with_NULL_statistics_fails)
+{
+    ///arrange
+    CIoTHubTransportHttpMocks mocks;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    mocks.ResetAllCalls();
 
     ///act
-    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    auto result = IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, NULL);
 
     ///assert
-    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer6, buffer6_size));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetCorrelationId_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_016: [ If no device with deviceId is registered, IoTHubTransportHttp_GetPollStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetPollStatistics_with_unknown_device_fails)
 {
     ///arrange
     CIoTHubTransportHttpMocks mocks;
-    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    IOTHUB_HTTP_POLL_STATISTICS statistics;
     auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
-
     mocks.ResetAllCalls();
 
-    setupDoWorkLoopOnceForOneDevice(mocks);
+    setupGetSasTokenCountForOneDevice(mocks);
 
-    STRICT_EXPECTED_CALL(mocks, DList_IsListEmpty(&waitingToSend));
+    ///act
+    auto result = IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID2, &statistics);
 
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    mocks.AssertActualAndExpectedCalls();
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_Free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"))
-        .IgnoreArgument(1);
+//Tests_SRS_TRANSPORTMULTITHTTP_21_017: [ Otherwise IoTHubTransportHttp_GetPollStatistics shall copy the poll counters of the device and its current polling interval into statistics and return IOTHUB_CLIENT_OK. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetPollStatistics_counts_the_answered_polls_succeeds)
+{
+    ///arrange
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
+    IOTHUB_HTTP_POLL_STATISTICS statistics;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    mocks.ResetAllCalls();
 
-    /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(mocks, IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(mocks, Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .IgnoreArgument(4);
+    setupPollAnswered(mocks, TEST_GET_TIME_VALUE, &httpStatus200);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    setupPollAnswered(mocks, TEST_GET_TIME_VALUE + TEST_DEFAULT_GETMINIMUMPOLLINGTIME + 1, &httpStatus204);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    /*this is making http headers*/
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("iothub-app-"));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, TEST_RED_KEY))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-app-" TEST_RED_KEY, TEST_RED_VALUE))
-        .IgnoreArgument(1);
+    ///act
+    auto result = IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, &statistics);
 
-    STRICT_EXPECTED_CALL(mocks, BUFFER_new());
-    STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, statistics.polls);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.emptyPolls);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.messagesReceived);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.pollsAfterEvent);
+    ASSERT_ARE_EQUAL(int, TEST_DEFAULT_GETMINIMUMPOLLINGTIME, (int)statistics.pollingInterval);
+    mocks.AssertActualAndExpectedCalls();
 
-    /*executing HTTP goodies*/
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG)) /*because relativePath*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_SAS_ExecuteRequest2(
-        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
-        IGNORED_PTR_ARG,
-        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
-        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                 /*const char* relativePath,                          */
-        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
-        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
-        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
-        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
-        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
-        ))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(5)
-        .IgnoreArgument(6)
-        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
 
-    /*once the event has been succesfull...*/
+//Tests_SRS_TRANSPORTMULTITHTTP_21_011: [ If option "AdaptivePolling" is true, the polling interval shall be the per device adaptive interval instead of getMinimumPollingTime. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_21_013: [ With adaptive polling, a GET that returns no message shall double the polling interval, up to getMinimumPollingTime. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_AdaptivePolling_doubles_the_polling_interval_up_to_minimumPollingTime_on_empty_polls)
+{
+    ///arrange
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
+    IOTHUB_HTTP_POLL_STATISTICS statistics;
+    unsigned int thisIs20Seconds = 20;
+    const unsigned int expectedIntervals[] = { 4, 8, 16, 20, 20 };
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &thisIs20Seconds);
+    (void)IoTHubTransportHttp_SetOption(handle, "AdaptivePolling", &thisIsTrue);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    mocks.ResetAllCalls();
 
-    /*building the list of messages to be notified if HTTP is fine*/
-    STRICT_EXPECTED_CALL(mocks, DList_RemoveHeadList(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
-        .IgnoreArgument(2);
+    (void)IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, &statistics);
+    ASSERT_ARE_EQUAL(int, 2, (int)statistics.pollingInterval);
 
-    EXPECTED_CALL(mocks, IoTHubMessage_GetMessageId(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, IoTHubMessage_GetCorrelationId(IGNORED_PTR_ARG)).SetReturn(TEST_MESSAGE_ID);
+    for (size_t i = 0; i < sizeof(expectedIntervals) / sizeof(expectedIntervals[0]); i++)
+    {
+        setupPollAnswered(mocks, TEST_GET_TIME_VALUE + (time_t)(100 * i), &httpStatus204);
 
-    STRICT_EXPECTED_CALL(mocks, HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-correlationid", TEST_MESSAGE_ID))
-        .IgnoreArgument(1);
+        ///act
+        IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    DISABLE_BATCHING();
+        ///assert
+        (void)IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, &statistics);
+        ASSERT_ARE_EQUAL(int, (int)expectedIntervals[i], (int)statistics.pollingInterval);
+    }
+    ASSERT_ARE_EQUAL(size_t, 5, statistics.emptyPolls);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_21_012: [ With adaptive polling, a GET that returns a message shall bring the polling interval down to 2 seconds (or getMinimumPollingTime if smaller). ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_AdaptivePolling_a_message_brings_the_polling_interval_back_to_2_seconds)
+{
+    ///arrange
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
+    IOTHUB_HTTP_POLL_STATISTICS statistics;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_SetOption(handle, "AdaptivePolling", &thisIsTrue);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    mocks.ResetAllCalls();
+
+    setupPollAnswered(mocks, TEST_GET_TIME_VALUE, &httpStatus204);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    setupPollAnswered(mocks, TEST_GET_TIME_VALUE + 100, &httpStatus204);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    (void)IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, &statistics);
+    ASSERT_ARE_EQUAL(int, 8, (int)statistics.pollingInterval);
+
+    setupPollAnswered(mocks, TEST_GET_TIME_VALUE + 200, &httpStatus200);
 
     ///act
     IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
-    ASSERT_ARE_EQUAL(int, 0, memcmp(BASEIMPLEMENTATION::BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), buffer6, buffer6_size));
+    (void)IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, &statistics);
+    ASSERT_ARE_EQUAL(int, 2, (int)statistics.pollingInterval);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.messagesReceived);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-/*Tests_SRS_TRANSPORTMULTITHTTP_02_001: [ If handle is NULL then IoTHubTransportHttp_GetHostname shall fail and return NULL. ]*/
-TEST_FUNCTION(IoTHubTransportHttp_GetHostname_with_NULL_handle_fails)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_012: [ With adaptive polling, a GET that returns a message shall bring the polling interval down to 2 seconds (or getMinimumPollingTime if smaller). ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_AdaptivePolling_a_message_brings_the_polling_interval_to_a_smaller_minimumPollingTime)
 {
     ///arrange
-    CIoTHubTransportHttpMocks mocks;
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
+    IOTHUB_HTTP_POLL_STATISTICS statistics;
+    unsigned int thisIs1Second = 1;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &thisIs1Second);
+    (void)IoTHubTransportHttp_SetOption(handle, "AdaptivePolling", &thisIsTrue);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    mocks.ResetAllCalls();
+
+    setupPollAnswered(mocks, TEST_GET_TIME_VALUE, &httpStatus200);
 
     ///act
-    STRING_HANDLE hostname = IoTHubTransportHttp_GetHostname(NULL);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
-    ASSERT_IS_NULL(hostname);
+    (void)IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, &statistics);
+    ASSERT_ARE_EQUAL(int, 1, (int)statistics.pollingInterval);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    IoTHubTransportHttp_Destroy(handle);
 }
 
-/*Tests_SRS_TRANSPORTMULTITHTTP_02_001: [ If handle is NULL then IoTHubTransportHttp_GetHostname shall fail and return NULL. ]*/
-TEST_FUNCTION(IoTHubTransportHttp_GetHostname_with_non_NULL_handle_succeeds)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_011: [ If option "AdaptivePolling" is true, the polling interval shall be the per device adaptive interval instead of getMinimumPollingTime. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_AdaptivePolling_does_not_poll_before_the_adaptive_interval)
 {
     ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
+    IOTHUB_HTTP_POLL_STATISTICS statistics;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_SetOption(handle, "AdaptivePolling", &thisIsTrue);
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
     mocks.ResetAllCalls();
 
+    setupPollAnswered(mocks, TEST_GET_TIME_VALUE, &httpStatus204); /*the polling interval becomes 4 seconds*/
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    STRICT_EXPECTED_CALL(mocks, get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 4); /*right on the verge of the adaptive interval*/
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    (void)IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, &statistics);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.polls);
+
+    setupPollAnswered(mocks, TEST_GET_TIME_VALUE + 5, &httpStatus204);
+
     ///act
-    STRING_HANDLE hostname = IoTHubTransportHttp_GetHostname(handle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
-    ASSERT_IS_NOT_NULL(hostname);
+    (void)IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, &statistics);
+    ASSERT_ARE_EQUAL(size_t, 2, statistics.polls);
     mocks.AssertActualAndExpectedCalls();
-    ASSERT_ARE_EQUAL(char_ptr, TEST_IOTHUB_NAME "." TEST_IOTHUB_SUFFIX, STRING_c_str(hostname));
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-/*Tests_SRS_TRANSPORTMULTITHTTP_02_004: [ IoTHubTransportHttp_Unsubscribe_DeviceTwin shall return ]*/
-TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_DeviceTwin_returns)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_014: [ If option "PollAfterEvent" is true, every successful event POST shall allow the next GET regardless of the polling interval. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_PollAfterEvent_polls_right_after_a_successful_event_POST)
 {
     ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
+    IOTHUB_HTTP_POLL_STATISTICS statistics;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_SetOption(handle, "PollAfterEvent", &thisIsTrue);
+    ENABLE_BATCHING();
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE); /*the first poll, at TEST_GET_TIME_VALUE*/
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
     mocks.ResetAllCalls();
 
+    /*no time passes, only the event POST allows the next GET*/
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &httpStatus204, sizeof(httpStatus204));
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .IgnoreArgument(8)
+        .CopyOutArgumentBuffer(6, &httpStatus204, sizeof(httpStatus204));
+
     ///act
-    IoTHubTransportHttp_Unsubscribe_DeviceTwin(handle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
+    (void)IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, &statistics);
+    ASSERT_ARE_EQUAL(size_t, 2, statistics.polls);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.pollsAfterEvent);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
     IoTHubTransportHttp_Destroy(handle);
 }
 
-/*Tests_SRS_TRANSPORTMULTITHTTP_02_003: [ IoTHubTransportHttp_Subscribe_DeviceTwin shall return. ]*/
-TEST_FUNCTION(IoTHubTransportHttp_Subscribe_DeviceTwin_returns)
+//Tests_SRS_TRANSPORTMULTITHTTP_21_014: [ If option "PollAfterEvent" is true, every successful event POST shall allow the next GET regardless of the polling interval. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_without_PollAfterEvent_waits_for_the_polling_interval_after_an_event_POST)
 {
     ///arrange
-    CIoTHubTransportHttpMocks mocks;
-    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    CNiceCallComparer<CIoTHubTransportHttpMocks> mocks;
+    IOTHUB_HTTP_POLL_STATISTICS statistics;
+    auto handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    ENABLE_BATCHING();
+    auto devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE); /*the first poll, at TEST_GET_TIME_VALUE*/
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
     mocks.ResetAllCalls();
 
+    STRICT_EXPECTED_CALL(mocks, HTTPAPIEX_ExecuteRequest2(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .IgnoreArgument(6)
+        .CopyOutArgumentBuffer(6, &httpStatus204, sizeof(httpStatus204));
+
     ///act
-    int res = IoTHubTransportHttp_Subscribe_DeviceTwin(handle);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
     ///assert
-    ASSERT_ARE_NOT_EQUAL(int, 0, res);
+    (void)IoTHubTransportHttp_GetPollStatistics(handle, TEST_DEVICE_ID, &statistics);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.polls);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.pollsAfterEvent);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&waitingToSend, (void*)waitingToSend.Flink);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
@@ -99,6 +99,18 @@ int test_amqpvalue_get_string(AMQP_VALUE value, const char** string_value)
 	return saved_amqpvalue_get_string_return;
 }
 
+#define TEST_ENCODED_SECTION_SIZE 2
+static size_t TEST_ENCODED_SECTION_SIZE_VALUE = TEST_ENCODED_SECTION_SIZE;
+// properties and application-properties sections, plus the data section header (descriptor and vbin8 constructor) and the content.
+#define TEST_DATA_SECTION_HEADER_SIZE 5
+#define TEST_ENCODING_SIZE (2 * TEST_ENCODED_SECTION_SIZE + TEST_DATA_SECTION_HEADER_SIZE + sizeof(TEST_STRING) - 1)
+
+int test_amqpvalue_encode(AMQP_VALUE value, AMQPVALUE_ENCODER_OUTPUT encoder_output, void* context)
+{
+	(void)value;
+	return encoder_output(context, (const unsigned char*)TEST_STRING, TEST_ENCODED_SECTION_SIZE);
+}
+
 
 // Helpers to set EXPECTED_CALLS
 void set_exp_calls_for_addPropertiesTouAMQPMessage(bool has_message_id, bool has_correlation_id, bool message_handle_has_properties)
@@ -198,7 +210,46 @@ static void set_exp_calls_for_message_create_from_iothub_message(size_t number_o
 	set_exp_calls_for_addApplicationPropertiesTouAMQPMessage(number_of_app_properties);
 }
 
-static void set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(size_t number_of_properties, bool has_message_id, bool has_correlation_id, bool has_properties)
+// The calls message_create_uamqp_encoding_from_iothub_message() makes between getting the content and allocating the encoding buffer.
+static void set_exp_calls_for_message_encoding_sections()
+{
+	STRICT_EXPECTED_CALL(message_create()).SetReturn(TEST_MESSAGE_HANDLE);
+
+	set_exp_calls_for_addPropertiesTouAMQPMessage(true, true, true);
+	set_exp_calls_for_addApplicationPropertiesTouAMQPMessage(1);
+
+	// create_message_sections
+	STRICT_EXPECTED_CALL(message_get_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+		.IgnoreArgument_properties()
+		.CopyOutArgumentBuffer_properties(&TEST_PROPERTIES_HANDLE_PTR, sizeof(PROPERTIES_HANDLE));
+	STRICT_EXPECTED_CALL(amqpvalue_create_properties(TEST_PROPERTIES_HANDLE));
+	STRICT_EXPECTED_CALL(message_get_application_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+		.IgnoreArgument(2)
+		.CopyOutArgumentBuffer_application_properties(&TEST_AMQP_VALUE2, sizeof(AMQP_VALUE));
+	STRICT_EXPECTED_CALL(amqpvalue_create_application_properties(TEST_AMQP_VALUE));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+	STRICT_EXPECTED_CALL(properties_destroy(TEST_PROPERTIES_HANDLE));
+
+	STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).CopyOutArgumentBuffer_encoded_size(&TEST_ENCODED_SECTION_SIZE_VALUE, sizeof(size_t));
+	STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).CopyOutArgumentBuffer_encoded_size(&TEST_ENCODED_SECTION_SIZE_VALUE, sizeof(size_t));
+}
+
+static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message()
+{
+	STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(IOTHUBMESSAGE_STRING);
+	STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(TEST_STRING);
+	set_exp_calls_for_message_encoding_sections();
+	STRICT_EXPECTED_CALL(malloc(TEST_ENCODING_SIZE));
+	STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreArgument(2).IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreArgument(2).IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+	STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_HANDLE));
+}
+
+static void set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(bool as_view, size_t number_of_properties, bool has_message_id, bool has_correlation_id, bool has_properties)
 {
 	static BINARY_DATA test_binary_data;
 	test_binary_data.bytes = (const unsigned char*)&TEST_STRING;
@@ -212,7 +263,14 @@ static void set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(size_t number
 	STRICT_EXPECTED_CALL(message_get_body_amqp_data(TEST_MESSAGE_HANDLE, 0, IGNORED_PTR_ARG))
 		.IgnoreArgument(3)
 		.CopyOutArgumentBuffer_binary_data(&test_binary_data, sizeof (BINARY_DATA));
-	STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments();
+	if (as_view)
+	{
+		STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArrayView(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments();
+	}
+	else
+	{
+		STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments();
+	}
 
 	// readPropertiesFromuAMQPMessage
 	STRICT_EXPECTED_CALL(message_get_properties(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
@@ -310,6 +368,12 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
 	REGISTER_UMOCK_ALIAS_TYPE(AMQP_TYPE, int);
+	REGISTER_UMOCK_ALIAS_TYPE(application_properties, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(AMQPVALUE_ENCODER_OUTPUT, void*);
+
+	REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+	REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+	REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, test_amqpvalue_encode);
 
 	REGISTER_GLOBAL_MOCK_HOOK(properties_get_message_id, test_properties_get_message_id);
 	REGISTER_GLOBAL_MOCK_HOOK(properties_get_correlation_id, test_properties_get_correlation_id);
@@ -365,6 +429,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	
 	REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromByteArray, TEST_IOTHUB_MESSAGE_HANDLE);
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromByteArray, NULL);
+	REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromByteArrayView, TEST_IOTHUB_MESSAGE_HANDLE);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromByteArrayView, NULL);
 		
 	REGISTER_GLOBAL_MOCK_RETURN(message_get_body_type, 0);
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_get_body_type, 1);
@@ -375,6 +441,13 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_GLOBAL_MOCK_RETURN(properties_create, TEST_PROPERTIES_HANDLE);
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(properties_create, NULL);
 
+	REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_properties, TEST_AMQP_VALUE);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_properties, NULL);
+	REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_application_properties, TEST_AMQP_VALUE);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_application_properties, NULL);
+	REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_encoded_size, 0);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_get_encoded_size, 1);
+
 	// Initialization of variables.
 	TEST_MAP_KEYS = (char**)real_malloc(sizeof(char*) * 5);
 	ASSERT_IS_NOT_NULL_WITH_MSG(TEST_MAP_KEYS, "Could not allocate memory for TEST_MAP_KEYS");
@@ -706,7 +779,7 @@ TEST_FUNCTION(IoTHubMessage_CreateFromUamqpMessage_success)
 {
 	// arrange
 	umock_c_reset_all_calls();
-	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(1, true, true, true);
+	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(false, 1, true, true, true);
 
 	// act
 	IOTHUB_MESSAGE_HANDLE iothub_client_message = NULL;
@@ -720,12 +793,32 @@ TEST_FUNCTION(IoTHubMessage_CreateFromUamqpMessage_success)
 	// cleanup
 }
 
+// Tests_SRS_UAMQP_MESSAGING_09_119: [IoTHubMessage_CreateViewFromUamqpMessage shall read the uAMQP message exactly as IoTHubMessage_CreateFromUamqpMessage does, except for how the body is stored.]
+// Tests_SRS_UAMQP_MESSAGING_09_120: [IoTHubMessage_CreateViewFromUamqpMessage shall create the IOTHUB_MESSAGE instance using IoTHubMessage_CreateFromByteArrayView(), referencing the uAMQP body bytes instead of copying them.]
+TEST_FUNCTION(IoTHubMessage_CreateViewFromUamqpMessage_success)
+{
+	// arrange
+	umock_c_reset_all_calls();
+	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(true, 1, true, true, true);
+
+	// act
+	IOTHUB_MESSAGE_HANDLE iothub_client_message = NULL;
+	int result = IoTHubMessage_CreateViewFromUamqpMessage(TEST_MESSAGE_HANDLE, &iothub_client_message);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, result, 0);
+	ASSERT_ARE_EQUAL(void_ptr, (void*)iothub_client_message, (void*)TEST_IOTHUB_MESSAGE_HANDLE);
+
+	// cleanup
+}
+
 // Tests_SRS_UAMQP_MESSAGING_09_013: [If the type of the message-id property value is AMQP_TYPE_NULL, IoTHubMessage_CreateFromuAMQPMessage() shall skip processing the message-id (as it is optional) and continue normally.]
 TEST_FUNCTION(IoTHubMessage_CreateFromUamqpMessage_no_message_id_success)
 {
 	// arrange
 	umock_c_reset_all_calls();
-	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(1, false, true, true);
+	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(false, 1, false, true, true);
 
 	// act
 	IOTHUB_MESSAGE_HANDLE iothub_client_message = NULL;
@@ -744,7 +837,7 @@ TEST_FUNCTION(IoTHubMessage_CreateFromUamqpMessage_no_correlation_id_success)
 {
 	// arrange
 	umock_c_reset_all_calls();
-	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(1, true, false, true);
+	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(false, 1, true, false, true);
 
 	// act
 	IOTHUB_MESSAGE_HANDLE iothub_client_message = NULL;
@@ -780,7 +873,7 @@ TEST_FUNCTION(IoTHubMessage_CreateFromUamqpMessage_error_returns_fails)
 {
 	// arrange
 	umock_c_reset_all_calls();
-	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(1, true, true, true);
+	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(false, 1, true, true, true);
 
 	// act
 	IOTHUB_MESSAGE_HANDLE iothub_client_message = NULL;
@@ -799,7 +892,7 @@ TEST_FUNCTION(IoTHubMessage_CreateFromUamqpMessage_no_app_properties_success)
 {
 	// arrange
 	umock_c_reset_all_calls();
-	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(0, true, true, false);
+	set_exp_calls_for_IoTHubMessage_CreateFromUamqpMessage(false, 0, true, true, false);
 
 	// act
 	IOTHUB_MESSAGE_HANDLE iothub_client_message = NULL;
@@ -813,4 +906,109 @@ TEST_FUNCTION(IoTHubMessage_CreateFromUamqpMessage_no_app_properties_success)
 	// cleanup
 }
 
+// Tests_SRS_UAMQP_MESSAGING_09_100: [If `message_handle` or `body_binary_data` are NULL, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_NULL_message_handle)
+{
+	// arrange
+	BINARY_DATA binary_data;
+	umock_c_reset_all_calls();
+
+	// act
+	int result = message_create_uamqp_encoding_from_iothub_message(NULL, &binary_data);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_NOT_EQUAL(int, result, 0);
+
+	// cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_09_100: [If `message_handle` or `body_binary_data` are NULL, message_create_uamqp_encoding_from_iothub_message() shall fail and return a non-zero value.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_NULL_body_binary_data)
+{
+	// arrange
+	umock_c_reset_all_calls();
+
+	// act
+	int result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, NULL);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_NOT_EQUAL(int, result, 0);
+
+	// cleanup
+}
+
+// Tests_SRS_UAMQP_MESSAGING_09_115: [The content of `message_handle` shall be obtained the same way as in message_create_from_iothub_message(), without being copied]
+// Tests_SRS_UAMQP_MESSAGING_09_101: [A uAMQP message without body shall be created using message_create() to hold the properties and application properties of `message_handle`]
+// Tests_SRS_UAMQP_MESSAGING_09_117: [The properties and application properties of `message_handle` shall be set on the uAMQP message the same way as in message_create_from_iothub_message()]
+// Tests_SRS_UAMQP_MESSAGING_09_103: [The properties of the uAMQP message shall be encoded as a properties section, using message_get_properties() and amqpvalue_create_properties()]
+// Tests_SRS_UAMQP_MESSAGING_09_104: [The application properties of the uAMQP message, if any, shall be encoded as an application-properties section, using message_get_application_properties() and amqpvalue_create_application_properties()]
+// Tests_SRS_UAMQP_MESSAGING_09_105: [The content shall be encoded as a data section written directly into the buffer, copying the content bytes only once]
+// Tests_SRS_UAMQP_MESSAGING_09_107: [The size of the encoding shall be the sum of the sizes of each section, obtained using amqpvalue_get_encoded_size(), and of the data section holding the content]
+// Tests_SRS_UAMQP_MESSAGING_09_109: [A buffer of that size shall be allocated using malloc()]
+// Tests_SRS_UAMQP_MESSAGING_09_111: [Each section shall be encoded into the buffer, in order, using amqpvalue_encode()]
+// Tests_SRS_UAMQP_MESSAGING_09_113: [The buffer and its length shall be returned in `body_binary_data`; the caller owns the buffer and shall free it]
+// Tests_SRS_UAMQP_MESSAGING_09_114: [The sections and the uAMQP message shall be destroyed before message_create_uamqp_encoding_from_iothub_message() returns]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_success)
+{
+	// arrange
+	BINARY_DATA binary_data;
+	umock_c_reset_all_calls();
+	set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message();
+
+	// act
+	int result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, result, 0);
+	ASSERT_ARE_EQUAL(size_t, TEST_ENCODING_SIZE, binary_data.length);
+	ASSERT_ARE_EQUAL(int, 0x75, binary_data.bytes[2 * TEST_ENCODED_SECTION_SIZE + 2]);
+	ASSERT_ARE_EQUAL(int, 0xA0, binary_data.bytes[2 * TEST_ENCODED_SECTION_SIZE + 3]);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_STRING, binary_data.bytes + 2 * TEST_ENCODED_SECTION_SIZE + TEST_DATA_SECTION_HEADER_SIZE, sizeof(TEST_STRING) - 1));
+
+	// cleanup
+	real_free((void*)binary_data.bytes);
+}
+
+#if SIZE_MAX > UINT32_MAX
+// Tests_SRS_UAMQP_MESSAGING_09_121: [If the content is larger than UINT32_MAX bytes, message_create_uamqp_encoding_from_iothub_message() shall free the buffer, fail and return a non-zero value.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_content_larger_than_a_vbin32_fails)
+{
+	// arrange
+	BINARY_DATA binary_data;
+	const unsigned char* content = (const unsigned char*)TEST_STRING; // never read, the size is rejected first
+	size_t content_size = (size_t)UINT32_MAX + 1;
+	unsigned char* encoding_buffer = (unsigned char*)real_malloc(4 * TEST_ENCODED_SECTION_SIZE);
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(IOTHUBMESSAGE_BYTEARRAY);
+	STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument_buffer()
+		.IgnoreArgument_size()
+		.CopyOutArgumentBuffer_buffer(&content, sizeof(content))
+		.CopyOutArgumentBuffer_size(&content_size, sizeof(content_size));
+	set_exp_calls_for_message_encoding_sections();
+	STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG)) // only the properties and application-properties sections get written
+		.IgnoreArgument(1)
+		.SetReturn(encoding_buffer);
+	STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreArgument(2).IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).IgnoreArgument(2).IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(free(encoding_buffer));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+	STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_HANDLE));
+
+	// act
+	int result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_NOT_EQUAL(int, result, 0);
+
+	// cleanup
+}
+#endif
+
 END_TEST_SUITE(uamqp_messaging_ut)
@@ -83,54 +83,36 @@ static void NoFreeFunction(void* value)
 
 
 #define IS_DIGIT(a) (('0'<=(a)) &&((a)<='9'))
-#define splitInt(intVal, bytePos)   (char)((intVal >> (bytePos << 3)) & 0xFF)
-#define joinChars(a, b, c, d) (uint32_t)( (uint32_t)a + ((uint32_t)b << 8) + ((uint32_t)c << 16) + ((uint32_t)d << 24))
-
-static char base64char(unsigned char val)
-{
-    char result;
-
-    if (val < 26)
-    {
-        result = 'A' + (char)val;
-    }
-    else if (val < 52)
-    {
-        result = 'a' + ((char)val - 26);
-    }
-    else if (val < 62)
-    {
-        result = '0' + ((char)val - 52);
-    }
-    else if (val == 62)
-    {
-        result = '-';
-    }
-    else
-    {
-        result = '_';
-    }
-
-    return result;
-}
-
-static char base64b16(unsigned char val)
-{
-    const uint32_t base64b16values[4] = {
-        joinChars('A', 'E', 'I', 'M'),
-        joinChars('Q', 'U', 'Y', 'c'),
-        joinChars('g', 'k', 'o', 's'),
-        joinChars('w', '0', '4', '8')
-    };
-    return splitInt(base64b16values[val >> 2], (val & 0x03));
-}
-
-static char base64b8(unsigned char val)
-{
-    const uint32_t base64b8values = joinChars('A', 'Q', 'g', 'w');
-    return splitInt(base64b8values, val);
+/*EDM_BINARY uses the URL safe base64 alphabet*/
+static const char base64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+#define BASE64_INVALID 0xFF
+
+/*value of every base64 character, BASE64_INVALID for anything else. Lookups replace the per character range tests*/
+static const unsigned char base64values[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0x3F,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
 };
 
+#define base64char(val) (base64chars[(val) & 0x3F])
+/*the 3rd character of a base64b16 group only carries 4 bits, the 2nd character of a base64b8 group only 2 bits*/
+#define base64b16(val) (base64chars[((val) & 0x0F) << 2])
+#define base64b8(val) (base64chars[((val) & 0x03) << 4])
+
 /*creates an AGENT_DATA_TYPE containing a EDM_BOOLEAN from a int*/
 AGENT_DATA_TYPES_RESULT Create_EDM_BOOLEAN_from_int(AGENT_DATA_TYPE* agentData, int v)
 {
@@ -514,34 +496,15 @@ static int ValidateDecimal(const char* v, size_t vlen)
 static int base64toValue(char base64charSource, unsigned char* value)
 {
     int result;
-    if (('A' <= base64charSource) && (base64charSource <= 'Z'))
+    unsigned char decoded = base64values[(unsigned char)base64charSource];
+    if (decoded == BASE64_INVALID)
     {
-        *value = base64charSource - 'A';
-        result = 0;
-    }
-    else if (('a' <= base64charSource) && (base64charSource <= 'z'))
-    {
-        *value = ('Z' - 'A') +1+ (base64charSource - 'a');
-        result = 0;
-    }
-    else if (('0' <= base64charSource) && (base64charSource <= '9'))
-    {
-        *value = ('Z' - 'A') +1+('z'-'a')+1 +(base64charSource - '0');
-        result = 0;
-    }
-    else if ('-' == base64charSource)
-    {
-        *value = 62;
-        result = 0;
-    }
-    else if ('_' == base64charSource)
-    {
-        *value = 63;
-        result = 0;
+        result = 1;
     }
     else
     {
-        result = 1;
+        *value = decoded;
+        result = 0;
     }
     return result;
 }
@@ -557,13 +520,12 @@ static int scan4base64char(const char* source, size_t sourceSize, unsigned char
     }
     else
     {
-        unsigned char b0, b1, b2, b3;
-        if (
-            (base64toValue(source[0], &b0) == 0) &&
-            (base64toValue(source[1], &b1) == 0) &&
-            (base64toValue(source[2], &b2) == 0) &&
-            (base64toValue(source[3], &b3) == 0)
-            )
+        unsigned char b0 = base64values[(unsigned char)source[0]];
+        unsigned char b1 = base64values[(unsigned char)source[1]];
+        unsigned char b2 = base64values[(unsigned char)source[2]];
+        unsigned char b3 = base64values[(unsigned char)source[3]];
+        /*valid values are below 64, so one test catches an invalid character in any position*/
+        if (((b0 | b1 | b2 | b3) & 0xC0) == 0)
         {
             *destination0 = (b0 << 2) | ((b1 & 0x30) >> 4);
             *destination1 = ((b1 & 0x0F)<<4) | ((b2 & 0x3C) >>2 );
@@ -581,31 +543,35 @@ static int scan4base64char(const char* source, size_t sourceSize, unsigned char
 /*return 0 if the character is one of ( 'A' / 'E' / 'I' / 'M' / 'Q' / 'U' / 'Y' / 'c' / 'g' / 'k' / 'o' / 's' / 'w' / '0' / '4' / '8' )*/
 static int base64b16toValue(unsigned char source, unsigned char* destination)
 {
-    unsigned char i;
-    for (i = 0; i <= 15; i++)
+    int result;
+    unsigned char decoded = base64values[source];
+    if ((decoded == BASE64_INVALID) || ((decoded & 0x03) != 0))
     {
-        if (base64b16(i) == source)
-        {
-            *destination = i;
-            return 0;
-        }
+        result = 1;
     }
-    return 1;
+    else
+    {
+        *destination = decoded >> 2;
+        result = 0;
+    }
+    return result;
 }
 
 /*return 0 if the character is one of ( 'A' / 'Q' / 'g' / 'w' )*/
 static int base64b8toValue(unsigned char source, unsigned char* destination)
 {
-    unsigned char i;
-    for (i = 0; i <= 3; i++)
+    int result;
+    unsigned char decoded = base64values[source];
+    if ((decoded == BASE64_INVALID) || ((decoded & 0x0F) != 0))
     {
-        if (base64b8(i) == source)
-        {
-            *destination = i;
-            return 0;
-        }
+        result = 1;
     }
-    return 1;
+    else
+    {
+        *destination = decoded >> 4;
+        result = 0;
+    }
+    return result;
 }
 
 
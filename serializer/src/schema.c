@@ -12,6 +12,8 @@
 
 DEFINE_ENUM_STRINGS(SCHEMA_RESULT, SCHEMA_RESULT_VALUES);
 
+#define SCHEMA_METHOD_BUCKET_COUNT 16
+
 typedef struct SCHEMA_PROPERTY_HANDLE_DATA_TAG
 {
     const char* PropertyName;
@@ -58,6 +60,8 @@ typedef struct SCHEMA_METHOD_HANDLE_DATA_TAG
 {
     char* methodName;
     VECTOR_HANDLE methodArguments; /*holds SCHEMA_METHOD_ARGUMENT_HANDLE*/
+    size_t methodNameHash;
+    struct SCHEMA_METHOD_HANDLE_DATA_TAG* nextInBucket; /*next method of the model that hashes in the same bucket*/
 } SCHEMA_METHOD_HANDLE_DATA;
 
 typedef struct MODEL_IN_MODEL_TAG
@@ -71,6 +75,7 @@ typedef struct MODEL_IN_MODEL_TAG
 typedef struct SCHEMA_MODEL_TYPE_HANDLE_DATA_TAG
 {
     VECTOR_HANDLE methods; /*holds SCHEMA_METHOD_HANDLE*/
+    SCHEMA_METHOD_HANDLE methodBuckets[SCHEMA_METHOD_BUCKET_COUNT]; /*index over methods, by name*/
     VECTOR_HANDLE desiredProperties; /*holds SCHEMA_DESIRED_PROPERTY_HANDLE_DATA*/
     const char* Name;
     SCHEMA_HANDLE SchemaHandle;
@@ -699,6 +704,7 @@ SCHEMA_MODEL_TYPE_HANDLE Schema_CreateModelType(SCHEMA_HANDLE schemaHandle, cons
                                 }
                                 else
                                 {
+                                    (void)memset(modelType->methodBuckets, 0, sizeof(modelType->methodBuckets));
                                     modelType->PropertyCount = 0;
                                     modelType->Properties = NULL;
                                     modelType->ActionCount = 0;
@@ -936,10 +942,26 @@ SCHEMA_ACTION_HANDLE Schema_CreateModelAction(SCHEMA_MODEL_TYPE_HANDLE modelType
 }
 
 
-static bool methodExists(const void* element, const void* value)
+static size_t hashMethodName(const char* methodName)
 {
-    const SCHEMA_METHOD_HANDLE* method = (const SCHEMA_METHOD_HANDLE*)element;
-    return (strcmp((*method)->methodName, value) == 0);
+    /*djb2*/
+    size_t result = 5381;
+    while (*methodName != '\0')
+    {
+        result = (result * 33) ^ (unsigned char)*methodName++;
+    }
+    return result;
+}
+
+static SCHEMA_METHOD_HANDLE findModelMethod(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle, const char* methodName, size_t methodNameHash)
+{
+    SCHEMA_METHOD_HANDLE result = modelTypeHandle->methodBuckets[methodNameHash % SCHEMA_METHOD_BUCKET_COUNT];
+    while ((result != NULL) &&
+        ((result->methodNameHash != methodNameHash) || (strcmp(result->methodName, methodName) != 0)))
+    {
+        result = result->nextInBucket;
+    }
+    return result;
 }
 
 
@@ -957,8 +979,9 @@ SCHEMA_METHOD_HANDLE Schema_CreateModelMethod(SCHEMA_MODEL_TYPE_HANDLE modelType
     }
     else
     {
+        size_t methodNameHash = hashMethodName(methodName);
         /*Codes_SRS_SCHEMA_02_103: [ If methodName already exists, then Schema_CreateModelMethod shall fail and return NULL. ]*/
-        if (VECTOR_find_if(modelTypeHandle->methods, methodExists, methodName) != NULL)
+        if (findModelMethod(modelTypeHandle, methodName, methodNameHash) != NULL)
         {
             LogError("method %s already exists", methodName);
             result = NULL;
@@ -1009,6 +1032,10 @@ SCHEMA_METHOD_HANDLE Schema_CreateModelMethod(SCHEMA_MODEL_TYPE_HANDLE modelType
                         }
                         else
                         {
+                            /*Codes_SRS_SCHEMA_21_001: [ Schema_CreateModelMethod shall index the method by the hash of its name so that looking it up does not depend on the number of methods in the model. ]*/
+                            result->methodNameHash = methodNameHash;
+                            result->nextInBucket = modelTypeHandle->methodBuckets[methodNameHash % SCHEMA_METHOD_BUCKET_COUNT];
+                            modelTypeHandle->methodBuckets[methodNameHash % SCHEMA_METHOD_BUCKET_COUNT] = result;
                             /*Codes_SRS_SCHEMA_02_104: [ Otherwise, Schema_CreateModelMethod shall succeed and return a non-NULL SCHEMA_METHOD_HANDLE. ]*/
                             /*return as is*/
                         }
@@ -1415,14 +1442,6 @@ SCHEMA_ACTION_HANDLE Schema_GetModelActionByName(SCHEMA_MODEL_TYPE_HANDLE modelT
     return result;
 }
 
-static bool matchModelMethod(const void* element, const void* value)
-{
-    /*element is a pointer to SCHEMA_METHOD_HANDLE_DATA*/
-    const SCHEMA_METHOD_HANDLE* decodedElement = (const SCHEMA_METHOD_HANDLE* )element;
-    const char* name = (const char*)value;
-    return (strcmp((*decodedElement)->methodName, name) == 0);
-}
-
 SCHEMA_METHOD_HANDLE Schema_GetModelMethodByName(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle, const char* methodName)
 {
     SCHEMA_METHOD_HANDLE result;
@@ -1438,16 +1457,11 @@ SCHEMA_METHOD_HANDLE Schema_GetModelMethodByName(SCHEMA_MODEL_TYPE_HANDLE modelT
     else
     {
         /*Codes_SRS_SCHEMA_02_117: [ If a method with the name methodName exists then Schema_GetModelMethodByName shall succeed and returns its handle. ]*/
-        SCHEMA_METHOD_HANDLE* found = VECTOR_find_if(modelTypeHandle->methods, matchModelMethod, methodName);
-        if (found == NULL)
+        result = findModelMethod(modelTypeHandle, methodName, hashMethodName(methodName));
+        if (result == NULL)
         {
             /*Codes_SRS_SCHEMA_02_118: [ Otherwise, Schema_GetModelMethodByName shall fail and return NULL. ]*/
             LogError("no such method by name = %s", methodName);
-            result = NULL;
-        }
-        else
-        {
-            result = *found;
         }
     }
 
@@ -13326,6 +13326,52 @@ BEGIN_TEST_SUITE(AgentTypeSystem_ut)
             }
         }
 
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_99_100:[ EDM_BINARY]*/
+        TEST_FUNCTION(EDM_BINARY_round_trips_all_byte_values)
+        {
+            ///arrange
+            unsigned char allBytes[256];
+            EDM_BINARY input;
+            AGENT_DATA_TYPE ag;
+            AGENT_DATA_TYPE decoded;
+            for (size_t i = 0; i < sizeof(allBytes); i++)
+            {
+                allBytes[i] = (unsigned char)i;
+            }
+            input.size = sizeof(allBytes);
+            input.data = allBytes;
+            STRING_empty(global_bufferTemp);
+            (void)Create_AGENT_DATA_TYPE_from_EDM_BINARY(&ag, input);
+            (void)AgentDataTypes_ToString(global_bufferTemp, &ag);
+
+            ///act
+            auto result = CreateAgentDataType_From_String(STRING_c_str(global_bufferTemp), EDM_BINARY_TYPE, &decoded);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(size_t, sizeof(allBytes), decoded.value.edmBinary.size);
+            ASSERT_ARE_EQUAL(int, 0, memcmp(allBytes, decoded.value.edmBinary.data, sizeof(allBytes)));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+            Destroy_AGENT_DATA_TYPE(&decoded);
+        }
+
+        /*validating base64 decode with invalid base64 encoded strings*/
+        TEST_FUNCTION(CreateAgentDataType_From_String_for_a_EDM_BINARY_with_standard_base64_characters_fails)
+        {
+            ///arrange
+            AGENT_DATA_TYPE ag;
+
+            ///act
+            auto result1 = CreateAgentDataType_From_String("\"ab+d\"", EDM_BINARY_TYPE, &ag);
+            auto result2 = CreateAgentDataType_From_String("\"ab/d\"", EDM_BINARY_TYPE, &ag);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_INVALID_ARG, result1);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_INVALID_ARG, result2);
+        }
+
         /*validating base64 decode with invalid base64 encoded strings*/
         TEST_FUNCTION(CreateAgentDataType_From_String_for_a_EDM_BINARY_when_input_string_contains_1_garbage_character_inserted_fails)
         {
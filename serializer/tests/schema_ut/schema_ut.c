@@ -5953,11 +5953,6 @@ BEGIN_TEST_SUITE(Schema_ut)
         (void)Schema_CreateModelMethod(model, "method");
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .IgnoreArgument_pred()
-            .IgnoreArgument_value();
-
         ///act
         SCHEMA_METHOD_HANDLE methodHandle = Schema_CreateModelMethod(model, "method");
 
@@ -5971,11 +5966,6 @@ BEGIN_TEST_SUITE(Schema_ut)
 
     static void Schema_CreateModelMethod_inert_path(void)
     {
-        STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .IgnoreArgument_pred()
-            .IgnoreArgument_value();
-
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreArgument_size();
 
@@ -6027,19 +6017,14 @@ BEGIN_TEST_SUITE(Schema_ut)
 
         for (size_t i = 0;i < umock_c_negative_tests_call_count(); i++)
         {
-            if (
-                (i != 0)
-                )
-            {
-                umock_c_negative_tests_reset();
-                umock_c_negative_tests_fail_call(i);
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
 
-                ///act
-                SCHEMA_METHOD_HANDLE methodHandle = Schema_CreateModelMethod(model, "method");
+            ///act
+            SCHEMA_METHOD_HANDLE methodHandle = Schema_CreateModelMethod(model, "method");
 
-                ///assert
-                ASSERT_IS_NULL(methodHandle);
-            }
+            ///assert
+            ASSERT_IS_NULL(methodHandle);
         }
 
         ///cleanup
@@ -6246,11 +6231,6 @@ BEGIN_TEST_SUITE(Schema_ut)
 
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .IgnoreArgument_pred()
-            .IgnoreArgument_value();
-
         ///act
         SCHEMA_METHOD_HANDLE methodHandle = Schema_GetModelMethodByName(model, "method");
 
@@ -6272,11 +6252,6 @@ BEGIN_TEST_SUITE(Schema_ut)
 
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .IgnoreArgument_pred()
-            .IgnoreArgument_value();
-
         ///act
         SCHEMA_METHOD_HANDLE methodHandle = Schema_GetModelMethodByName(model, "NO WAY THIS EXISTS!");
 
@@ -6288,6 +6263,36 @@ BEGIN_TEST_SUITE(Schema_ut)
         Schema_Destroy(schemaHandle);
     }
 
+    /*Tests_SRS_SCHEMA_21_001: [ Schema_CreateModelMethod shall index the method by the hash of its name so that looking it up does not depend on the number of methods in the model. ]*/
+    TEST_FUNCTION(Schema_GetModelMethodByName_finds_every_method_of_a_large_model)
+    {
+        ///arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE model = Schema_CreateModelType(schemaHandle, "model");
+        SCHEMA_METHOD_HANDLE created[40];
+        char methodName[16];
+        for (size_t i = 0; i < 40; i++)
+        {
+            (void)sprintf(methodName, "method%u", (unsigned int)i);
+            created[i] = Schema_CreateModelMethod(model, methodName);
+            ASSERT_IS_NOT_NULL(created[i]);
+        }
+        umock_c_reset_all_calls();
+
+        ///act
+        for (size_t i = 0; i < 40; i++)
+        {
+            (void)sprintf(methodName, "method%u", (unsigned int)i);
+
+            ///assert
+            ASSERT_ARE_EQUAL(void_ptr, created[i], Schema_GetModelMethodByName(model, methodName));
+        }
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
     /*Tests_SRS_SCHEMA_02_119: [ If methodHandle is NULL then Schema_GetModelMethodArgumentCount shall fail and return SCHEMA_INVALID_ARG. ]*/
     TEST_FUNCTION(Schema_GetModelMethodArgumentCount_with_NULL_methodHandle_fails)
     {